@@ -14,6 +14,8 @@
 //ActionЯ
 struct SActionParam 
 {
+	SActionParam():m_bHitTerrain(false) { m_ptScreen.x = m_ptScreen.y = 0; }
+
 	POINT		m_ptScreen;		//Ļ
 	VEC2		m_ptPixel;		//View,ض
 	VEC2		m_ptRelative;	//View,Զ
@@ -7,19 +7,42 @@
 void ActionVegetationGrass::Enter()
 {
 	ManipulatorSystem.GetTerrain().SetGrassModeEnabled(true);
+	m_bInPaint = false;
 }
 
 void ActionVegetationGrass::Leave()
 {
 	ManipulatorSystem.GetTerrain().SetGrassModeEnabled(false);
+	m_bInPaint = false;
 }
 
 void ActionVegetationGrass::OnMouseLButtonDown( const SActionParam& param )
 {
 	if(!param.m_bHitTerrain)
 		return;
-	
-	//ManipulatorSystem.GetObject().AddGrass(param.m_ptTerrain, ORIENT_IDENTITY, VEC3(50,50,50));
+
+	m_paintPos = param.m_ptTerrain;
+	m_bInPaint = true;
+}
+
+void ActionVegetationGrass::OnMouseLButtonUp( const SActionParam& param )
+{
+	m_bInPaint = false;
+}
+
+void ActionVegetationGrass::OnMouseMove( const SActionParam& param )
+{
+	if(!param.m_bHitTerrain)
+		return;
+
+	m_paintPos = param.m_ptTerrain;
+	ManipulatorSystem.GetTerrain().SetBrushPosition(param.m_ptTerrain);
+}
+
+void ActionVegetationGrass::OnFrameMove( float dt )
+{
+	if(m_bInPaint)
+		ManipulatorSystem.GetTerrain().PaintGrass(m_paintPos, dt);
 }
 
 
@@ -14,13 +14,20 @@
 class ActionVegetationGrass : public ActionBase
 {
 public:
-	ActionVegetationGrass() {}
+	ActionVegetationGrass():m_bInPaint(false) {}
 	~ActionVegetationGrass() {}
 
 public:
 	virtual	void	Enter();
 	virtual void	Leave();
 	virtual	void	OnMouseLButtonDown(const SActionParam& param);
+	virtual void	OnMouseLButtonUp(const SActionParam& param);
+	virtual void	OnMouseMove(const SActionParam& param);
+	virtual void	OnFrameMove(float dt);
+
+private:
+	bool			m_bInPaint;
+	VEC3			m_paintPos;
 };
 
 
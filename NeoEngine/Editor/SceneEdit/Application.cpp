@@ -263,24 +263,37 @@ void Application::OnMouseWheel( short nNotch )
 
 void Application::_CreateActionParam( const POINT& viewClientPt, SActionParam& retParam )
 {
-// 	retParam.m_ptScreen = viewClientPt;
-// 	::ClientToScreen(g_env.hwnd, &retParam.m_ptScreen);
-// 
-// 	const IRRSIZE& screenSize = RenderSys.GetScreenSize();
-// 
-// 	retParam.m_ptPixel = VEC2((float)viewClientPt.x, (float)viewClientPt.y);
-// 	retParam.m_ptRelative.x = viewClientPt.x / (float)screenSize.Width;
-// 	retParam.m_ptRelative.y = viewClientPt.y / (float)screenSize.Height;
-// 
-// 	static VEC2 lastPt = retParam.m_ptPixel;
-// 	retParam.m_ptDeltaRel = retParam.m_ptPixel - lastPt;
-// 	retParam.m_ptDeltaRel.x /= screenSize.Width;
-// 	retParam.m_ptDeltaRel.y /= screenSize.Height;
-// 
-// 	const RAY ray = RenderSys.GetCameraToViewportRay(INT2(viewClientPt.x, viewClientPt.y));
-// 	retParam.m_bHitTerrain = ManipulatorSystem.GetTerrain().GetRayIntersectPoint(ray, retParam.m_ptTerrain);
-// 
-// 	lastPt = retParam.m_ptPixel;
+	retParam.m_ptScreen = viewClientPt;
+	::ClientToScreen(g_env.hwnd, &retParam.m_ptScreen);
+
+	const float screenW = (float)m_pRenderSystem->GetWndWidth();
+	const float screenH = (float)m_pRenderSystem->GetWndHeight();
+
+	retParam.m_ptPixel = VEC2((float)viewClientPt.x, (float)viewClientPt.y);
+	retParam.m_ptRelative.x = viewClientPt.x / screenW;
+	retParam.m_ptRelative.y = viewClientPt.y / screenH;
+
+	static VEC2 lastPt = retParam.m_ptPixel;
+	retParam.m_ptDeltaRel = Common::Sub_Vec2_By_Vec2(retParam.m_ptPixel, lastPt);
+	retParam.m_ptDeltaRel.x /= screenW;
+	retParam.m_ptDeltaRel.y /= screenH;
+
+	// Camera ray through the pixel, built from the view basis and the projection scale
+	Neo::Camera* pCam = g_env.pSceneMgr->GetCamera();
+	const MAT44& matProj = pCam->GetProjMatrix();
+	const float viewX = (retParam.m_ptRelative.x * 2 - 1) / matProj.m00;
+	const float viewY = (1 - retParam.m_ptRelative.y * 2) / matProj.m11;
+
+	const VEC3 forward = pCam->GetDirection();
+	const VEC3 right = pCam->GetRight();
+	const VEC3 up = Common::CrossProduct_Vec3_By_Vec3(forward, right);
+
+	VEC3 dir = Common::Add_Vec3_By_Vec3(forward, Common::Multiply_Vec3_By_K(right, viewX));
+	Common::Add_Vec3_By_Vec3(dir, dir, Common::Multiply_Vec3_By_K(up, viewY));
+
+	retParam.m_bHitTerrain = ManipulatorSystem.GetTerrain().GetRayIntersectPoint(pCam->GetPos(), dir, retParam.m_ptTerrain);
+
+	lastPt = retParam.m_ptPixel;
 }
 
 void Application::OnKeyDown( UINT nChar )
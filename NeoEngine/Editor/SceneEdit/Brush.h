@@ -53,10 +53,10 @@ public:
 	~BrushCircle();
 
 public:
-	virtual	void	SetPosition(const VEC3& pos) {}
+	virtual	void	SetPosition(const VEC3& pos) { Brush::SetPosition(pos); }
 	virtual void	OnGizmoNodeReset() {}
 	virtual void	SetDimension(float dim1, float dim2) {}
-	virtual void	GetDimension(float& dim1, float& dim2) {}
+	virtual void	GetDimension(float& dim1, float& dim2) { dim1 = dim2 = 0; }
 
 private:
 	GizmoCircle*	m_pRenderable;
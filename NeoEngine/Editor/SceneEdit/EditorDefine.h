@@ -14,6 +14,9 @@ const	int		EDITOR_CLIENT_W			=	1024;
 const	int		EDITOR_CLIENT_H			=	768;
 const	int		MESH_ICON_SIZE			=	64;
 const	int		RES_SELECTOR_COLUMN_WIDTH	=	80;
+const	float	GRASS_PAINT_SPEED		=	2.0f;		// Grass density per second at the brush center
+const	float	TERRAIN_DEFORM_SPEED	=	10.0f;		// Height per second at the brush center
+const	float	TERRAIN_SPLAT_SPEED		=	1.0f;		// Layer weight per second
 
 //
 enum eCameraType
@@ -2,6 +2,7 @@
 #include "Gizmo.h"
 #include "EditorDefine.h"
 #include "Manipulator/ManipulatorScene.h"
+#include "Terrain.h"
 
 
 GizmoRectangle::~GizmoRectangle()
@@ -61,106 +62,48 @@ void GizmoRectangle::InitRenderable(float w, float h)
 
 void GizmoRectangle::UpdatePosition( const VEC3& pos, float w, float h )
 {
-// 	ManipulatorTerrain& terrain = ManipulatorSystem.GetTerrain();
-// 	//γϷֲĸ
-// 	const int ptCountOfWidth = (int)std::ceil(w * POINT_DENSITY);
-// 	const int ptCountOfHeight = (int)std::ceil(h * POINT_DENSITY);
-// 
-// 	const float halfW = w / 2, halfH = h / 2;
-// 	const float ptDist = 1 / POINT_DENSITY;
-// 
-// 	HardwareVertexBufferSharedPtr vbuf = 
-// 		mRenderOp.vertexData->vertexBufferBinding->getBuffer(0);
-// 	float* pFloat = static_cast<float*>(vbuf->lock(HardwareBuffer::HBL_DISCARD));
-// 	
-// 	const float yOffset = 0.01f;
-// 	//ϱ
-// 	for (int i=0; i<ptCountOfWidth-1; ++i)
-// 	{
-// 		//position
-// 		float x = pos.x - halfW + i * ptDist;
-// 		float z = pos.z - halfH;
-// 		float y = terrain.GetHeightAt(Ogre::Vector2(x, z));
-// 
-// 		*pFloat++ = x;
-// 		*pFloat++ = y + yOffset;
-// 		*pFloat++ = z;
-// 
-// 		//color
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 1.0f;
-// 	}
-// 
-// 	//ұ
-// 	for (int i=0; i<ptCountOfHeight-1; ++i)
-// 	{
-// 		//position
-// 		float x = pos.x + halfW;
-// 		float z = pos.z - halfH + i * ptDist;
-// 		float y = terrain.GetHeightAt(Ogre::Vector2(x, z));
-// 
-// 		*pFloat++ = x;
-// 		*pFloat++ = y + yOffset;
-// 		*pFloat++ = z;
-// 
-// 		//color
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 1.0f;
-// 	}
-// 
-// 	//±
-// 	for (int i=0; i<ptCountOfWidth-1; ++i)
-// 	{
-// 		//position
-// 		float x = pos.x + halfW - i * ptDist;
-// 		float z = pos.z + halfH;
-// 		float y = terrain.GetHeightAt(Ogre::Vector2(x, z));
-// 
-// 		*pFloat++ = x;
-// 		*pFloat++ = y + yOffset;
-// 		*pFloat++ = z;
-// 
-// 		//color
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 1.0f;
-// 	}
-// 
-// 	//
-// 	for (int i=0; i<ptCountOfHeight-1; ++i)
-// 	{
-// 		//position
-// 		float x = pos.x - halfW;
-// 		float z = pos.z + halfH - i * ptDist;
-// 		float y = terrain.GetHeightAt(Ogre::Vector2(x, z));
-// 
-// 		*pFloat++ = x;
-// 		*pFloat++ = y + yOffset;
-// 		*pFloat++ = z;
-// 
-// 		//color
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 0.0f;
-// 		*pFloat++ = 1.0f;
-// 	}
-// 
-// 	//һ,
-// 	float x = pos.x - halfW;
-// 	float z = pos.z - halfH;
-// 	float y = terrain.GetHeightAt(Ogre::Vector2(x, z));
-// 
-// 	*pFloat++ = x;
-// 	*pFloat++ = y + yOffset;
-// 	*pFloat++ = z;
-// 
-// 	//color
-// 	*pFloat++ = 0.0f;
-// 	*pFloat++ = 0.0f;
-// 	*pFloat++ = 1.0f;
-// 
-// 	vbuf->unlock();
+	const int ptCountOfWidth = max((int)std::ceil(w * POINT_DENSITY), 1);
+	const int ptCountOfHeight = max((int)std::ceil(h * POINT_DENSITY), 1);
+	const float halfW = w / 2, halfH = h / 2;
+	const float stepW = w / ptCountOfWidth, stepH = h / ptCountOfHeight;
+
+	//Top, right, bottom and left edges, each without its last corner, then back to the start
+	m_vecXZ.clear();
+	for (int i=0; i<ptCountOfWidth; ++i)
+	{
+		m_vecXZ.push_back(pos.x - halfW + i * stepW);
+		m_vecXZ.push_back(pos.z - halfH);
+	}
+	for (int i=0; i<ptCountOfHeight; ++i)
+	{
+		m_vecXZ.push_back(pos.x + halfW);
+		m_vecXZ.push_back(pos.z - halfH + i * stepH);
+	}
+	for (int i=0; i<ptCountOfWidth; ++i)
+	{
+		m_vecXZ.push_back(pos.x + halfW - i * stepW);
+		m_vecXZ.push_back(pos.z + halfH);
+	}
+	for (int i=0; i<ptCountOfHeight; ++i)
+	{
+		m_vecXZ.push_back(pos.x - halfW);
+		m_vecXZ.push_back(pos.z + halfH - i * stepH);
+	}
+	m_vecXZ.push_back(pos.x - halfW);
+	m_vecXZ.push_back(pos.z - halfH);
+
+	const uint32 count = m_vecXZ.size() / 2;
+	m_vecHeights.assign(count, pos.y);
+
+	Neo::Terrain* pTerrain = g_env.pSceneMgr->GetTerrain();
+	if(pTerrain)
+		pTerrain->GetHeightField().GetHeights(&m_vecXZ[0], &m_vecHeights[0], count, false);
+
+	//Lift the line a bit so it isn't z-fighting the terrain
+	const float yOffset = 0.01f;
+	m_vecPoints.resize(count);
+	for (uint32 i=0; i<count; ++i)
+		m_vecPoints[i].Set(m_vecXZ[i * 2], m_vecHeights[i] + yOffset, m_vecXZ[i * 2 + 1]);
 }
 
 void GizmoRectangle::DestroyRenderable()
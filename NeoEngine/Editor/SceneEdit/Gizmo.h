@@ -26,7 +26,10 @@ public:
 public:
 	void	InitRenderable(float w, float h);
 	void	DestroyRenderable();
+	//Outline points follow the terrain, heights are queried in one batch
 	void	UpdatePosition(const VEC3& pos, float w, float h);
+	//Line strip of the outline, the first point is repeated at the end
+	const std::vector<VEC3>&	GetPoints() const { return m_vecPoints; }
 
 protected:
 	//صλ.ΪֱӸ
@@ -35,6 +38,10 @@ protected:
 private:
 	//ķֲܶ,1絥λӦĸ
 	static const int POINT_DENSITY = 5;
+
+	std::vector<VEC3>	m_vecPoints;
+	std::vector<float>	m_vecXZ;		//Scratch for the batched height query
+	std::vector<float>	m_vecHeights;
 };
 
 //
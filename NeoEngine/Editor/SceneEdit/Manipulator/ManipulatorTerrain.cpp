@@ -4,6 +4,8 @@
 #include "../EditorDefine.h"
 #include "Utility.h"
 #include "Scene.h"
+#include "Terrain.h"
+#include "Grass.h"
 
 
 ManipulatorTerrain::ManipulatorTerrain()
@@ -66,12 +68,11 @@ void ManipulatorTerrain::Serialize( rapidxml::xml_document<>* doc, rapidxml::xml
 
 float ManipulatorTerrain::GetHeightAt( const VEC2& worldPos )
 {
-// 	Terrain* pTerrain = nullptr;
-// 	float retH = ManipulatorSystem.GetScene()->GetTerrainGroup()->getHeightAtWorldPosition(worldPos.x, 0, worldPos.y, &pTerrain);
-// 	//assert(pTerrain && "worldPos is invalid!");
-// 
-// 	return retH;
-	return 0;
+	Neo::Terrain* pTerrain = g_env.pSceneMgr->GetTerrain();
+	if(!pTerrain)
+		return 0;
+
+	return pTerrain->GetHeightAt(worldPos.x, worldPos.y);
 }
 
 void ManipulatorTerrain::SetTerrainDeformEnabled(bool bEnable)
@@ -89,41 +90,38 @@ void ManipulatorTerrain::SetTerrainSplatEnabled( bool bEnable )
 void ManipulatorTerrain::SetBrushPosition( const VEC3& pos )
 {
 	//ֹˢΧα߽
-// 	VEC3 clampPos(pos);
-// 	float brushDim1, brushDim2;
-// 	m_brush[m_curBrushIndex]->GetDimension(brushDim1, brushDim2);
-// 
-// 	float worldSize = GetWorldSize();
-// 
-// 	if (m_curBrushIndex == 0)	//circle
-// 	{
-// 		if(clampPos.x - brushDim2 < -worldSize/2)	clampPos.x = brushDim2 - worldSize/2;
-// 		if(clampPos.x + brushDim2 > worldSize/2)	clampPos.x = worldSize/2 - brushDim2;
-// 		if(clampPos.z - brushDim2 < -worldSize/2)	clampPos.z = brushDim2 - worldSize/2;
-// 		if(clampPos.z + brushDim2 > worldSize/2)	clampPos.z = worldSize/2 - brushDim2;
-// 	}
-// 	else	//square
-// 	{
-// 		if(clampPos.x - brushDim1/2 < -worldSize/2)	clampPos.x = brushDim1/2 - worldSize/2;
-// 		if(clampPos.x + brushDim1/2 > worldSize/2)	clampPos.x = worldSize/2 - brushDim1/2;
-// 		if(clampPos.z - brushDim2/2 < -worldSize/2)	clampPos.z = brushDim2/2 - worldSize/2;
-// 		if(clampPos.z + brushDim2/2 > worldSize/2)	clampPos.z = worldSize/2 - brushDim2/2;
-// 	}
-// 
-// 	m_brush[m_curBrushIndex]->SetPosition(clampPos);
+	VEC3 clampPos(pos);
+	float brushDim1, brushDim2;
+	m_brush[m_curBrushIndex]->GetDimension(brushDim1, brushDim2);
+
+	float worldSize = GetWorldSize();
+
+	if (m_curBrushIndex == 0)	//circle
+	{
+		if(clampPos.x - brushDim2 < -worldSize/2)	clampPos.x = brushDim2 - worldSize/2;
+		if(clampPos.x + brushDim2 > worldSize/2)	clampPos.x = worldSize/2 - brushDim2;
+		if(clampPos.z - brushDim2 < -worldSize/2)	clampPos.z = brushDim2 - worldSize/2;
+		if(clampPos.z + brushDim2 > worldSize/2)	clampPos.z = worldSize/2 - brushDim2;
+	}
+	else	//square
+	{
+		if(clampPos.x - brushDim1/2 < -worldSize/2)	clampPos.x = brushDim1/2 - worldSize/2;
+		if(clampPos.x + brushDim1/2 > worldSize/2)	clampPos.x = worldSize/2 - brushDim1/2;
+		if(clampPos.z - brushDim2/2 < -worldSize/2)	clampPos.z = brushDim2/2 - worldSize/2;
+		if(clampPos.z + brushDim2/2 > worldSize/2)	clampPos.z = worldSize/2 - brushDim2/2;
+	}
+
+	m_brush[m_curBrushIndex]->SetPosition(clampPos);
 }
 
-// bool ManipulatorTerrain::GetRayIntersectPoint( const RAY& worldRay, VEC3& retHitPos )
-// {
-// 	irr::scene::ITerrainSceneNode* terrain = ManipulatorScene::GetSingleton().GetScene()->GetTerrain();
-// 	assert(terrain);
-// 
-// 	irr::core::triangle3df hitTri;
-// 	SCENENODE* hitNode = RenderSys.GetSceneManager()->getSceneCollisionManager()->getSceneNodeAndCollisionPointFromRay(
-// 		worldRay, retHitPos, hitTri, Kratos::eQueryMask_Terrain);
-// 
-// 	return hitNode != nullptr;
-// }
+bool ManipulatorTerrain::GetRayIntersectPoint( const VEC3& origin, const VEC3& dir, VEC3& retHitPos )
+{
+	Neo::Terrain* pTerrain = g_env.pSceneMgr->GetTerrain();
+	if(!pTerrain)
+		return false;
+
+	return pTerrain->RayIntersect(origin, dir, retHitPos);
+}
 
 void ManipulatorTerrain::OnGizmoNodeReset()
 {
@@ -161,87 +159,110 @@ float ManipulatorTerrain::GetSquareBrushHeight()
 	return oldH;
 }
 
+void ManipulatorTerrain::PaintGrass( const VEC3& pos, float dt )
+{
+	Neo::Grass* pGrass = g_env.pSceneMgr->GetGrass();
+	if(!pGrass || !m_bGrassMode)
+		return;
+
+	float brushSizeW, brushSizeH;
+	m_brush[m_curBrushIndex]->GetDimension(brushSizeW, brushSizeH);
+
+	const float amount = GRASS_PAINT_SPEED * dt;
+	pGrass->PaintDensity(pos.x, pos.z, brushSizeW / 2, GetAsyncKeyState(VK_SHIFT) < 0 ? -amount : amount);
+}
+
 void ManipulatorTerrain::OnEdit( float dt )
 {
-// 	assert(m_curEditMode != eTerrainEditMode_None);
-// 
-// 	//0㲻ܱ༭BlendMap,Ӧôӵ1㿪ʼ
-// 	if(m_curEditMode == eTerrainEditMode_Splat && m_curEditLayer == 0)
-// 		return;
-// 
-// 	Ogre::Terrain* pTerrain = ManipulatorSystem.GetScene()->GetTerrain();
-// 
-// 	const Vector3 brushPos = m_brush[m_curBrushIndex]->GetPosition();
-// 	Vector3 tsPos;
-// 	pTerrain->getTerrainPosition(brushPos, &tsPos);
-// 
-// 	float brushSizeW, brushSizeH;
-// 	m_brush[m_curBrushIndex]->GetDimension(brushSizeW, brushSizeH);
-// 	float worldSize = GetWorldSize();
-// 	brushSizeW /= worldSize;
-// 	brushSizeH /= worldSize;
-// 
-// 	int multiplier;
-// 	Ogre::TerrainLayerBlendMap* layer = nullptr;
-// 	if(m_curEditMode == eTerrainEditMode_Deform)
-// 	{
-// 		multiplier = pTerrain->getSize() - 1;
-// 	}
-// 	else
-// 	{
-// 		multiplier = pTerrain->getLayerBlendMapSize();
-// 		layer = pTerrain->getLayerBlendMap(m_curEditLayer);
-// 	}
-// 
-// 	long startx = (long)((tsPos.x - brushSizeW / 2) * multiplier);
-// 	long starty = (long)((tsPos.y - brushSizeH / 2) * multiplier);
-// 	long endx = (long)((tsPos.x + brushSizeW / 2) * multiplier);
-// 	long endy= (long)((tsPos.y + brushSizeH / 2) * multiplier);
-// 	startx = max(startx, 0L);
-// 	starty = max(starty, 0L);
-// 	endx = min(endx, (long)multiplier);
-// 	endy = min(endy, (long)multiplier);
-// 	
-// 	for (long y = starty; y <= endy; ++y)
-// 	{
-// 		for (long x = startx; x <= endx; ++x)
-// 		{
-// 			float tsXdist = (x / multiplier) - tsPos.x;
-// 			float tsYdist = (y / multiplier)  - tsPos.y;
-// 
-// 			if(m_curEditMode == eTerrainEditMode_Deform)
-// 			{
-// 				float* pData = pTerrain->getHeightData();
-// 				pData[y*GetMapSize()+x] += 100.0f * dt;
-// 
-// 			}
-// 			else
-// 			{
-// 				float* pData = layer->getBlendPointer();
-// 				size_t imgY = multiplier - y;
-// 				float newValue = pData[imgY*multiplier+x] + dt;
-// 				newValue = Ogre::Math::Clamp(newValue, 0.0f, 1.0f);
-// 				pData[imgY*multiplier+x] = newValue;
-// 			}
-// 		}
-// 	}
-// 	
-// 	
-// 	if(m_curEditMode == eTerrainEditMode_Deform)
-// 	{
-// 		Ogre::Rect rect(startx, starty, endx, endy);
-// 		pTerrain->dirtyRect(rect);
-// 		pTerrain->update();
-// 	}
-// 	else
-// 	{
-// 		size_t imgStartY = multiplier - starty;
-// 		size_t imgEndY = multiplier - endy;
-// 		Ogre::Rect rect(startx, min(imgStartY,imgEndY), endx, max(imgStartY,imgEndY));
-// 
-// 		layer->dirtyRect(rect);
-// 		layer->update();
-// 	}
+	assert(m_curEditMode != eTerrainEditMode_None);
+
+	// Layer 0 is the base, the blend map only weights layers from 1 on
+	if(m_curEditMode == eTerrainEditMode_Splat && m_curEditLayer == 0)
+		return;
+
+	Neo::Terrain* pTerrain = g_env.pSceneMgr->GetTerrain();
+	if(!pTerrain)
+		return;
+
+	const VEC3& brushPos = m_brush[m_curBrushIndex]->GetPosition();
+	float brushSizeW, brushSizeH;
+	m_brush[m_curBrushIndex]->GetDimension(brushSizeW, brushSizeH);
+
+	const bool bShift = GetAsyncKeyState(VK_SHIFT) < 0;
+
+	if(m_curEditMode == eTerrainEditMode_Deform)
+	{
+		Neo::STerrainBrush brush;
+		brush.centerX = brushPos.x;
+		brush.centerZ = brushPos.z;
+		brush.strength = TERRAIN_DEFORM_SPEED;
+
+		if (m_curBrushIndex == 0)	//circle, inner radius keeps full strength
+		{
+			brush.shape = Neo::eTerrainBrushShape_Circle;
+			brush.radius = brushSizeH;
+			brush.falloff = brushSizeH > 0 ? 1 - brushSizeW / brushSizeH : 0;
+		}
+		else	//square, kept inside the drawn rectangle
+		{
+			brush.shape = Neo::eTerrainBrushShape_Square;
+			brush.radius = min(brushSizeW, brushSizeH) / 2;
+		}
+
+		// Shift lowers, Ctrl smooths
+		if(GetAsyncKeyState(VK_CONTROL) < 0)
+			brush.op = Neo::eTerrainBrushOp_Smooth;
+		else
+			brush.op = bShift ? Neo::eTerrainBrushOp_Lower : Neo::eTerrainBrushOp_Raise;
+
+		pTerrain->ApplyBrush(brush, dt);
+	}
+	else
+	{
+		assert(m_curEditLayer >= 1 && m_curEditLayer <= 4);
+
+		uint32 mapW, mapH;
+		const uint8* pBlendMap = pTerrain->GetBlendMapData(mapW, mapH);
+		if(!pBlendMap)
+			return;
+
+		// Same mapping as the patch vertices, uv spans the terrain extent along x and z
+		const AABB& aabb = pTerrain->GetTerrainAABB();
+		const VEC3 worldSize = aabb.GetSize();
+		const float tsX = (brushPos.x - aabb.m_minCorner.x) / worldSize.x;
+		const float tsZ = (brushPos.z - aabb.m_minCorner.z) / worldSize.z;
+		const float halfW = brushSizeW / 2 / worldSize.x;
+		const float halfH = brushSizeH / 2 / worldSize.z;
+
+		const long startx = max((long)((tsX - halfW) * mapW), 0L);
+		const long starty = max((long)((tsZ - halfH) * mapH), 0L);
+		const long endx = min((long)((tsX + halfW) * mapW), (long)mapW - 1);
+		const long endy = min((long)((tsZ + halfH) * mapH), (long)mapH - 1);
+		if(startx > endx || starty > endy)
+			return;
+
+		const uint32 regionW = endx - startx + 1, regionH = endy - starty + 1;
+		m_vecSplatRegion.resize(regionW * regionH * 4);
+
+		// Shift erases the layer
+		const int delta = max((int)(TERRAIN_SPLAT_SPEED * dt * 255), 1) * (bShift ? -1 : 1);
+		const int channel = m_curEditLayer - 1;
+
+		for (uint32 y=0; y<regionH; ++y)
+		{
+			const uint8* pSrc = pBlendMap + ((starty + y) * mapW + startx) * 4;
+			uint8* pDst = &m_vecSplatRegion[y * regionW * 4];
+			memcpy(pDst, pSrc, regionW * 4);
+
+			for (uint32 x=0; x<regionW; ++x)
+			{
+				const int newValue = pDst[x*4+channel] + delta;
+				pDst[x*4+channel] = (uint8)min(max(newValue, 0), 255);
+			}
+		}
+
+		pTerrain->UpdateBlendMap(&m_vecSplatRegion[0], startx, starty, regionW, regionH, regionW * 4);
+	}
 }
 
 // const Ogre::StringVector& ManipulatorTerrain::GetAllLayerTexThumbnailNames()
@@ -319,8 +340,11 @@ const std::string ManipulatorTerrain::GetLayerNormalMap( int nLayer ) const
 
 float ManipulatorTerrain::GetWorldSize() const
 {
-	//return ManipulatorSystem.GetScene()->GetTerrainGroup()->getTerrainWorldSize();
-	return 0;
+	Neo::Terrain* pTerrain = g_env.pSceneMgr->GetTerrain();
+	if(!pTerrain)
+		return 0;
+
+	return pTerrain->GetTerrainAABB().GetSize().x;
 }
 
 size_t ManipulatorTerrain::GetMapSize() const
@@ -35,7 +35,8 @@ public:
 	void	Serialize(rapidxml::xml_document<>* doc, rapidxml::xml_node<>* XMLNode);
 	void	OnGizmoNodeReset();
 	float	GetHeightAt(const VEC2& worldPos);
-	//bool	GetRayIntersectPoint(const RAY& worldRay, VEC3& retHitPos);
+	//dir needn't be normalized
+	bool	GetRayIntersectPoint(const VEC3& origin, const VEC3& dir, VEC3& retHitPos);
 	float	GetWorldSize() const;
 	size_t	GetMapSize() const;
 	float	GetMaxPixelError() const;
@@ -68,6 +69,8 @@ public:
 	//grass
 	void	SetGrassModeEnabled(bool bEnable) { m_bGrassMode = bEnable; }
 	bool	GetGrassModeEnabled() const { return m_bGrassMode; }
+	//raise grass density under the brush, lower it with shift held
+	void	PaintGrass(const VEC3& pos, float dt);
 
 	///ûȡLayer
 	void	SetLayerTexWorldSize(int nLayer, float fSize);
@@ -88,6 +91,7 @@ private:
 	eTerrainEditMode			m_curEditMode;
 	int							m_curEditLayer;		
 	bool						m_bGrassMode;
+	std::vector<uint8>			m_vecSplatRegion;	// Blend map texels under the brush, reused each edit
 };
 
 
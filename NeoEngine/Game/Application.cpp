@@ -5,6 +5,9 @@
 #include "MathDef.h"
 #include "SceneManager.h"
 #include "Camera.h"
+#include "Profiler.h"
+#include "FrameAllocator.h"
+#include "Benchmark.h"
 
 SGlobalEnv			g_env;
 
@@ -14,13 +17,50 @@ static const uint32	SCREEN_HEIGHT	=	768;
 Application::Application()
 :m_hInstance(nullptr)
 ,m_pRenderSystem(nullptr)
+,m_pBenchmark(nullptr)
 {
 
 }
 //----------------------------------------------------------------------------------------
 Application::~Application()
 {
-	
+	SAFE_DELETE(m_pBenchmark);
+}
+//----------------------------------------------------------------------------------------
+bool Application::ParseCommandLine( int argc, char* argv[] )
+{
+	Neo::SBenchmarkDesc desc;
+	bool bBenchmark = false;
+
+	for (int i=1; i<argc; ++i)
+	{
+		const STRING arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!value)
+		{
+			printf("Missing value for %s\n", arg.c_str());
+			return false;
+		}
+
+		if (arg == "-benchmark")		{ desc.scene = value; bBenchmark = true; }
+		else if (arg == "-frames")		{ desc.frames = max(atoi(value), 1); }
+		else if (arg == "-warmup")		{ desc.warmupFrames = max(atoi(value), 0); }
+		else if (arg == "-path")		{ desc.cameraPath = value; }
+		else if (arg == "-out")			{ desc.output = value; }
+		else
+		{
+			printf("Unknown argument %s\n", arg.c_str());
+			return false;
+		}
+
+		++i;
+	}
+
+	if(bBenchmark)
+		m_pBenchmark = new Neo::Benchmark(desc);
+
+	return true;
 }
 //----------------------------------------------------------------------------------------
 void Application::Init()
@@ -31,6 +71,9 @@ void Application::Init()
 		return;
 	}
 
+	// Before anything that compiles shaders
+	Neo::FrameAllocator::Init();
+
 	m_pRenderSystem = new Neo::D3D11RenderSystem;
 	g_env.pRenderSystem = m_pRenderSystem;
 
@@ -44,7 +87,21 @@ void Application::Init()
 
 	g_env.pSceneMgr = new Neo::SceneManager;
 	g_env.pSceneMgr->Init();
-	g_env.pSceneMgr->ToggleScene();
+
+	if (m_pBenchmark)
+	{
+		if (!m_pBenchmark->Init())
+		{
+			printf("Benchmark: can't load scene \"%s\" or camera path \"%s\"\n",
+				m_pBenchmark->GetDesc().scene.c_str(), m_pBenchmark->GetDesc().cameraPath.c_str());
+			SAFE_DELETE(m_pBenchmark);
+			PostQuitMessage(1);
+		}
+	}
+	else
+	{
+		g_env.pSceneMgr->ToggleScene();
+	}
 }
 //----------------------------------------------------------------------------------------
 void Application::ShutDown()
@@ -53,6 +110,21 @@ void Application::ShutDown()
 
 	m_pRenderSystem->ShutDown();
 	SAFE_DELETE(m_pRenderSystem);
+
+	Neo::FrameAllocator::ShutDown();
+}
+//----------------------------------------------------------------------------------------
+void Application::_EndBenchmark()
+{
+	const Neo::SBenchmarkDesc& desc = m_pBenchmark->GetDesc();
+
+	if(m_pBenchmark->WriteReport())
+		printf("Benchmark: %u frames of \"%s\" written to %s\n", desc.frames, desc.scene.c_str(), desc.output.c_str());
+	else
+		printf("Benchmark: can't write %s\n", desc.output.c_str());
+
+	SAFE_DELETE(m_pBenchmark);
+	DestroyWindow(g_env.hwnd);
 }
 //----------------------------------------------------------------------------------------
 bool Application::_InitWindow()
@@ -101,8 +173,12 @@ bool Application::_InitWindow()
 
 	g_env.hwnd = hWnd;
 
-	ShowWindow(hWnd, SW_SHOWNORMAL);
-	UpdateWindow(hWnd);
+	// Benchmark runs headless
+	if (!m_pBenchmark)
+	{
+		ShowWindow(hWnd, SW_SHOWNORMAL);
+		UpdateWindow(hWnd);
+	}
 
 	return true;
 }
@@ -163,6 +239,25 @@ LRESULT CALLBACK Application::WndProc( HWND hWnd, UINT message, WPARAM wParam, L
 				}
 				break;
 
+			case 'p':
+				{
+					Neo::Profiler::SetEnabled(!Neo::Profiler::IsEnabled());
+				}
+				break;
+
+			case 'c':
+				{
+					// Open in chrome://tracing
+					Neo::Profiler::BeginCapture(300, "profile.json");
+				}
+				break;
+
+			case 'm':
+				{
+					g_env.pSceneMgr->ShowMemoryStats(!g_env.pSceneMgr->IsShowMemoryStats());
+				}
+				break;
+
 			case 'r':
 				{
 					// Toggle fill mode
@@ -205,13 +300,38 @@ void Application::Run()
 			// Render a frame during idle time (no messages are waiting)
 			Neo::SceneManager* pSceneMgr = g_env.pSceneMgr;
 
-			pSceneMgr->GetCamera()->Update();
-			m_pRenderSystem->Update();
-			pSceneMgr->Update();
-			
-			m_pRenderSystem->BeginScene();
-			pSceneMgr->GetCurScene()->Render();
-			m_pRenderSystem->EndScene();
+			Neo::Profiler::BeginFrame();
+			{
+				PROFILE_SCOPE("Frame");
+
+				{
+					PROFILE_SCOPE("Update");
+
+					if(m_pBenchmark)
+						m_pBenchmark->BeginFrame();
+					else
+						pSceneMgr->GetCamera()->Update();
+
+					m_pRenderSystem->Update();
+					pSceneMgr->Update();
+				}
+
+				PROFILE_SCOPE("Render");
+
+				m_pRenderSystem->BeginScene();
+				pSceneMgr->GetCurScene()->Render();
+				m_pRenderSystem->EndScene();
+			}
+			Neo::Profiler::EndFrame();
+			Neo::FrameAllocator::EndFrame();
+
+			if (m_pBenchmark)
+			{
+				m_pBenchmark->EndFrame();
+
+				if(m_pBenchmark->IsFinished())
+					_EndBenchmark();
+			}
 		}
 	}
 }
@@ -18,18 +18,24 @@ public:
 	~Application();
 
 public:
+	/**	"-benchmark <scene> [-frames n] [-warmup n] [-path file] [-out file]"
+		runs a benchmark with a hidden window and quits. False on bad arguments.
+	*/
+	bool	ParseCommandLine(int argc, char* argv[]);
 	void	Init();
 	void	Run();
 	void	ShutDown();
 
 private:
 	bool	_InitWindow();
+	void	_EndBenchmark();
 
 	static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
 private:
 	HINSTANCE				m_hInstance;
 	Neo::D3D11RenderSystem*	m_pRenderSystem;
+	Neo::Benchmark*			m_pBenchmark;
 };
 
 #endif // Application_h__
\ No newline at end of file
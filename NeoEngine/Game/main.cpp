@@ -8,11 +8,14 @@
 #include "Application.h"
 
 
-int main()
+int main(int argc, char* argv[])
 {
 	try
 	{
 		Application app;
+		if(!app.ParseCommandLine(argc, argv))
+			return 1;
+
 		app.Init();
 		app.Run();
 		app.ShutDown();
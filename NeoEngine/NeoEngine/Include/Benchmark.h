@@ -0,0 +1,70 @@
+/********************************************************************
+	created:	23:10:2014   17:30
+	filename	Benchmark.h
+	author:		maval
+
+	purpose:	Repeatable performance run. Enters a named test scene, flies the
+				camera along a CameraPath with a fixed simulated timestep and
+				writes CPU frame time percentiles and per-pass counters as json.
+				No input is read, so it can run with a hidden window.
+*********************************************************************/
+#ifndef Benchmark_h__
+#define Benchmark_h__
+
+#include "Prerequiestity.h"
+#include "CameraPath.h"
+#include "Profiler.h"
+
+namespace Neo
+{
+	struct SBenchmarkDesc
+	{
+		SBenchmarkDesc()
+			:frames(1000),warmupFrames(60),timeStep(1.0f / 60),output("benchmark.json") {}
+
+		STRING		scene;			// Test scene name, see TestScene.cpp
+		STRING		cameraPath;		// Empty orbits the scene bounds
+		uint32		frames;			// Measured frames
+		uint32		warmupFrames;	// Rendered at the first key and not measured
+		float		timeStep;		// Simulated seconds per frame
+		STRING		output;
+	};
+
+	class Benchmark
+	{
+	public:
+		Benchmark(const SBenchmarkDesc& desc);
+
+	public:
+		// Enter the scene and set up the path, false if either is missing
+		bool		Init();
+		// Before the frame's update, replaces Camera::Update
+		void		BeginFrame();
+		// After Profiler::EndFrame, records what it measured
+		void		EndFrame();
+		bool		IsFinished() const		{ return m_frame >= m_desc.warmupFrames + m_desc.frames; }
+
+		bool		WriteReport() const;
+		const SBenchmarkDesc&	GetDesc() const	{ return m_desc; }
+
+		// Nearest rank percentile, p in [0, 1]. Sorts the values.
+		static float	CalcPercentile(std::vector<float>& values, float p);
+
+	private:
+		struct SPassTotal
+		{
+			STRING		name;
+			double		ms;
+			double		counters[eProfileCounter_Max];
+		};
+
+		SBenchmarkDesc			m_desc;
+		CameraPath				m_path;
+		uint32					m_frame;
+		std::vector<float>		m_frameMs;
+		double					m_counters[eProfileCounter_Max];
+		std::vector<SPassTotal>	m_passes;
+	};
+}
+
+#endif // Benchmark_h__
@@ -0,0 +1,51 @@
+/********************************************************************
+	created:	23:10:2014   16:40
+	filename	CameraPath.h
+	author:		maval
+
+	purpose:	Camera spline for repeatable flythroughs. Keys are time, position
+				and look direction, positions are interpolated with Catmull-Rom.
+				Text format, one key per line: "t px py pz dx dy dz", # comments.
+*********************************************************************/
+#ifndef CameraPath_h__
+#define CameraPath_h__
+
+#include "Prerequiestity.h"
+#include "MathDef.h"
+
+namespace Neo
+{
+	class CameraPath
+	{
+	public:
+		struct SKey
+		{
+			float	time;			// Seconds, increasing
+			VEC3	pos;
+			VEC3	dir;			// Normalized
+		};
+
+	public:
+		bool		Load(const STRING& filename);
+		bool		Save(const STRING& filename) const;
+
+		// Time must be after the last key
+		void		AddKey(float time, const VEC3& pos, const VEC3& dir);
+		void		Clear()							{ m_keys.clear(); }
+		uint32		GetKeyCount() const				{ return m_keys.size(); }
+		float		GetDuration() const				{ return m_keys.empty() ? 0 : m_keys.back().time; }
+
+		// Clamped to the path ends
+		void		Evaluate(float time, VEC3& pos, VEC3& dir) const;
+		// Apply to camera and rebuild its view matrix
+		void		Apply(float time, Camera* pCamera) const;
+
+		// Fallback path circling a box, looking at its center
+		static void	CreateOrbit(const AABB& box, float duration, uint32 nKeys, CameraPath& path);
+
+	private:
+		std::vector<SKey>	m_keys;
+	};
+}
+
+#endif // CameraPath_h__
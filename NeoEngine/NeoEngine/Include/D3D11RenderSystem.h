@@ -11,6 +11,7 @@
 #include "Prerequiestity.h"
 #include "MathDef.h"
 #include "Color.h"
+#include "Handle.h"
 
 namespace Neo
 {
@@ -70,14 +71,24 @@ namespace Neo
 		void						SetRasterizeDesc(const D3D11_RASTERIZER_DESC& desc);
 		void						SetBlendStateDesc(const D3D11_BLEND_DESC& desc);
 
-		// Add a new material to MatLib
-		void		AddMaterial(const STRING& name, Material* pMaterial);
+		// Add a new material to MatLib, it keeps a reference until ShutDown
+		MaterialHandle	AddMaterial(const STRING& name, Material* pMaterial);
 		// Get a material from MatLib
 		Material*	GetMaterial(const STRING& name);
+		MaterialHandle	GetMaterialHandle(const STRING& name) const;
+		Material*	GetMaterial(MaterialHandle hMaterial) const	{ return m_materialPool.Resolve(hMaterial); }
 		// Set texture to device
 		void		SetActiveTexture(int stage, D3D11Texture* pTexture, ID3D11SamplerState* sampler);
 		// This texture will be recreated after window resized.
 		void		AddResizableTexture(D3D11Texture* pTexture);
+		// SRV of this texture changed, forget cached bindings so it gets set again
+		void		OnTextureRecreated(D3D11Texture* pTexture);
+		// Texture cache for textures loaded from file
+		TextureManager*	GetTextureManager()	{ return m_pTextureMgr; }
+		// Compiled shader bytecode, memory and disk
+		ShaderCache*	GetShaderCache()	{ return m_pShaderCache; }
+		// Shader objects shared by materials with the same permutation
+		ShaderLibrary*	GetShaderLibrary()	{ return m_pShaderLibrary; }
 
 		// Create a RT
 		D3D11RenderTarget* CreateRenderTarget();
@@ -87,6 +98,8 @@ namespace Neo
 		// Enable/Disable clipping plane
 		void		EnableClipPlane(bool bEnable, const PLANE* plane);
 		bool		IsClipPlaneEnabled() const { return m_bClipPlaneEnabled; }
+		// Drive shader time from the caller instead of the clock, negative goes back to the clock
+		void		SetFixedTime(float seconds)	{ m_fixedTime = seconds; }
 		// Update global constant buffer to device
 		void		UpdateGlobalCBuffer(bool bTessellate = false);
 		// Extract frustum planes in world space from view projection matrix
@@ -99,7 +112,9 @@ namespace Neo
 		void		CopyFrameBufferToTexture(D3D11Texture* pTexture);
 
 		void		SetTransform(eTransform type, const MAT44& matrix, bool bUpdateCBuffer);
+		// Text is queued and drawn in one batch by FlushText, EndScene flushes what's left
 		void		DrawText(const STRING& text, const IPOINT& pos, const SColor& color);
+		void		FlushText();
 
 	private:
 		bool		_InitDevice(uint32 wndWidth, uint32 wndHeight, HWND hwnd);
@@ -123,15 +138,21 @@ namespace Neo
 		ID3D11Texture2D*			m_pDepthStencil;
 		D3D11Texture*				m_pTexture[MAX_TEXTURE_STAGE];
 		Font*						m_pFont;
+		TextureManager*				m_pTextureMgr;
+		D3D11ShaderCompiler*		m_pShaderCompiler;
+		ShaderCache*				m_pShaderCache;
+		ShaderLibrary*				m_pShaderLibrary;
 
 		uint32						m_wndWidth, m_wndHeight;
 
 		cBufferGlobal				m_cBufferGlobal;
 		ID3D11Buffer*				m_pGlobalCBuf;
 		bool						m_bClipPlaneEnabled;
+		float						m_fixedTime;
 
-		typedef std::unordered_map<STRING, Material*>	MaterialLib;
+		typedef std::unordered_map<STRING, MaterialHandle>	MaterialLib;
 		MaterialLib					m_matLib;
+		HandlePool<Material, HandleRelease>	m_materialPool;
 
 		// We centralize them here for supporting to resize window.
 		std::vector<D3D11RenderTarget*>			m_vecRT;
@@ -0,0 +1,24 @@
+/********************************************************************
+	created:	26:10:2014   11:05
+	filename	D3D11ShaderCompiler.h
+	author:		maval
+
+	purpose:	ShaderCache compiler backed by D3DX11CompileFromFile.
+*********************************************************************/
+#ifndef D3D11ShaderCompiler_h__
+#define D3D11ShaderCompiler_h__
+
+#include "Prerequiestity.h"
+#include "ShaderCache.h"
+
+namespace Neo
+{
+	class D3D11ShaderCompiler : public IShaderCompiler
+	{
+	public:
+		virtual bool	LoadSource(const STRING& filename, STRING& text);
+		virtual bool	Compile(const SShaderCompileDesc& desc, ShaderBytecode& code, STRING& errors);
+	};
+}
+
+#endif // D3D11ShaderCompiler_h__
@@ -5,13 +5,16 @@
 	author:		maval
 	
 	purpose:	D3D11 texture warpper
-				Using D3DX.
+				DDS files are loaded natively (see DDSLoader), D3DX for the others.
+				2D DDS textures created with eTextureUsage_Streamed keep their file
+				mapped and only have the mips TextureStreamer asks for resident.
 *********************************************************************/
 #ifndef D3D11Texture_h__
 #define D3D11Texture_h__
 
 #include "Prerequiestity.h"
 #include "IRefCount.h"
+#include "MemoryTracker.h"
 
 namespace Neo
 {
@@ -24,7 +27,9 @@ namespace Neo
 		// Create as manual
 		D3D11Texture(uint32 width, uint32 height, const char* pTexData, ePixelFormat format, uint32 usage, bool bMipMap);
 		// Create as texture array
-		D3D11Texture(const StringVector& vecTexNames);
+		D3D11Texture(const StringVector& vecTexNames, uint32 usage = 0);
+		// Create from memory, e.g. built on CPU. Type is 2D or texture array.
+		D3D11Texture(const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* pInitData, eTextureType type);
 
 		~D3D11Texture();
 
@@ -42,16 +47,41 @@ namespace Neo
 		uint32								GetHeight() const { return m_height; }
 		uint32								GetUsage() const { return m_usage; }
 		ePixelFormat						GetFormat() const { return m_texFormat; }
+		// Estimated GPU memory of all mips, slices and faces
+		uint32								GetEstimatedBytes() const;
+
+		// Streaming, see TextureStreamer. Mips finer than the resident one are not in GPU memory.
+		bool								IsStreamed() const { return !m_streamSources.empty(); }
+		uint32								GetMipCount() const { return m_mipCount; }
+		uint32								GetResidentMip() const { return m_residentMip; }
+		// Recreate the texture from mip downward, keeps the old one on failure
+		bool								SetResidentMip(uint32 mip);
+		// Bytes of each mip level including all slices
+		void								GetMipBytes(std::vector<uint32>& mipBytes) const;
 
 		// NB: Only for render texture!
 		void								Resize(uint32 width, uint32 height);
 
+		/**	Memory tracking defaults to Texture or RenderTarget by usage and the file
+			name, owners can charge it to their subsystem and give it a readable name.
+		*/
+		void								SetMemoryTag(eMemTag tag, const STRING& name = "");
+
 		static ePixelFormat					ConvertFromDXFormat(DXGI_FORMAT dxformat);
 		static DXGI_FORMAT					ConvertToDXFormat(ePixelFormat format);
 		static uint32						GetBytesPerPixelFromFormat(ePixelFormat format);
+		static bool							IsBlockCompressed(ePixelFormat format);
+		// Byte size of one 2D surface, handles 4x4 block compressed formats
+		static uint32						CalcSurfaceBytes(ePixelFormat format, uint32 width, uint32 height);
 
 	private:
 		void				_CreateManual(const char* pTexData);
+		// Native DDS path, return false to fall back to D3DX
+		bool				_CreateFromDDS(const STRING& filename);
+		bool				_CreateArrayFromDDS(const StringVector& vecTexNames);
+		static bool			_IsDDSFile(const STRING& filename);
+		// Record estimated size with MemoryTracker, again whenever it's recreated
+		void				_TrackMemory();
 
 	private:
 		ID3D11Device*		m_pd3dDevice;
@@ -67,6 +97,13 @@ namespace Neo
 		uint32				m_width, m_height;
 		ePixelFormat		m_texFormat;
 		bool				m_bMipMap;
+
+		std::vector<DDSLoader*>	m_streamSources;	// Kept mapped while streamed
+		uint32				m_mipCount;			// Only valid for streamed texture
+		uint32				m_residentMip;
+
+		STRING				m_name;				// File name or set by SetMemoryTag
+		eMemTag				m_memTag;			// eMemTag_Max picks by usage
 	};
 }
 
@@ -0,0 +1,77 @@
+/********************************************************************
+	created:	19:10:2014   9:40
+	filename	DDSLoader.h
+	author:		maval
+
+	purpose:	Native DDS reader. The file is memory mapped and subresource
+				data points straight into the mapped blocks, no decoding or
+				intermediate copy. Header parsing and layout computation are
+				static and don't need a device.
+*********************************************************************/
+#ifndef DDSLoader_h__
+#define DDSLoader_h__
+
+#include "Prerequiestity.h"
+
+namespace Neo
+{
+	// Image description read from DX9 or DX10 header
+	struct SDDSDesc
+	{
+		SDDSDesc():width(0),height(0),depth(1),mipCount(1),arraySize(1)
+			,format(DXGI_FORMAT_UNKNOWN),bCubeMap(false),bVolume(false) {}
+
+		uint32		width, height, depth;
+		uint32		mipCount;
+		uint32		arraySize;		// Array elements, a cube map counts as one
+		DXGI_FORMAT	format;
+		bool		bCubeMap;
+		bool		bVolume;
+
+		// Number of 2D images per mip level: array size, times 6 for cube map
+		uint32		GetImageCount() const { return arraySize * (bCubeMap ? 6 : 1); }
+	};
+
+	typedef std::vector<D3D11_SUBRESOURCE_DATA>	SubresourceVector;
+
+	class DDSLoader
+	{
+	public:
+		DDSLoader();
+		~DDSLoader();
+
+	public:
+		// Map the file and build subresource layout. Data stays valid until Close().
+		bool		Load(const STRING& filename);
+		void		Close();
+
+		const SDDSDesc&				GetDesc() const				{ return m_desc; }
+		const SubresourceVector&	GetSubresources() const		{ return m_subresources; }
+
+		/**	Parse DDS magic and header(s).
+			@param dataOffset Receives offset of the first pixel block from pData.
+		*/
+		static bool	ParseHeader(const void* pData, uint32 size, SDDSDesc& desc, uint32& dataOffset);
+		// Row pitch and row count of one surface, rows are 4 pixels high for BC formats
+		static bool	GetSurfaceInfo(DXGI_FORMAT format, uint32 width, uint32 height, uint32& rowPitch, uint32& numRows);
+		/**	Build subresources in D3D11 order (mip fastest, then face, then array element).
+			Fails if pBits is shorter than the image needs.
+		*/
+		static bool	BuildSubresources(const SDDSDesc& desc, const void* pBits, uint32 bitsSize, SubresourceVector& out);
+
+	private:
+		// Owns the file handles
+		DDSLoader(const DDSLoader&);
+		DDSLoader& operator=(const DDSLoader&);
+
+		HANDLE				m_hFile;
+		HANDLE				m_hMapping;
+		const uint8*		m_pView;
+		uint32				m_fileSize;
+
+		SDDSDesc			m_desc;
+		SubresourceVector	m_subresources;
+	};
+}
+
+#endif // DDSLoader_h__
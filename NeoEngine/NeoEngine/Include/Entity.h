@@ -28,20 +28,23 @@ namespace Neo
 		// Set material
 		void			SetMaterial(uint32 iSubMesh, Material* pMaterial);
 		void			SetMaterial(Material* pMaterial);
+		void			SetMaterialInstance(uint32 iSubMesh, MaterialInstance* pInstance);
+		// Of the first sub mesh, see Material::GetSortKey
+		uint32			GetSortKey() const;
 
 		void			SetPosition(const VEC3& pos);
 		void			SetRotation(const QUATERNION& quat);
 		void			SetScale(float scale);
 
-		const VEC3&		GetPosition() { return m_position; }
-		const QUATERNION&	GetRotation() { return m_rotation; }
-		const VEC3&		GetScale() { return m_scale; }
+		VEC3			GetPosition() const;
+		QUATERNION		GetRotation() const;
+		VEC3			GetScale() const;
 
 		const MAT44&	GetWorldMatrix();
 		const MAT44&	GetWorldITMatrix();
 
-		void			SetUpdateAABB(bool b)	{ m_bUpdateAABB = b; }
-		void			SetLocalAABB(const AABB& aabb) { m_localAABB = aabb; }
+		void			SetUpdateAABB(bool b)	{ m_bUpdateAABB = b; m_bWorldAABBInvalid = true; }
+		void			SetLocalAABB(const AABB& aabb) { m_localAABB = aabb; m_bWorldAABBInvalid = true; }
 		const AABB&		GetWorldAABB() const	{ return m_worldAABB; }
 
 		void			SetCastShadow(bool bCast) { m_bCastShadow = bCast; }
@@ -49,26 +52,36 @@ namespace Neo
 		void			SetReceiveShadow(bool bReceive) { m_bReceiveShadow = bReceive; }
 		bool			GetReceiveShadow() const	{ return m_bReceiveShadow; }
 
+		// Max screen space error in pixels allowed when picking mesh LOD
+		void			SetLodPixelError(float fPixels) { m_lodPixelError = fPixels; }
+		uint32			GetCurLod(eLodPass pass) const	{ return m_curLod[pass]; }
+		// Scales the pixel error threshold of a pass, larger value gives coarser LOD
+		static void		SetLodPassBias(eLodPass pass, float bias) { s_lodPassBias[pass] = bias; }
+
 	protected:
-		void			_UpdateTransform();
 		void			_ComputeAABB();
+		uint32			_SelectLod(eLodPass pass);
+		// Distance from camera to the nearest point of bounding sphere
+		float			_CalcViewDistance();
+		// Tell the texture streamer which mips the submesh textures need at current distance
+		void			_RequestTextureMips();
 
 	protected:
 		Mesh*			m_pMesh;
 
-		VEC3			m_position;
-		QUATERNION		m_rotation;
-		VEC3			m_scale;
-
-		bool			m_bMatrixInvalid;
-		MAT44			m_matWorld;
-		MAT44			m_matWorldIT;		//ת,ڷ߱任
+		// SRT and world matrices live in TransformStorage
+		uint32			m_transformSlot;
 
 		bool			m_bUpdateAABB;
+		bool			m_bWorldAABBInvalid;	// Local AABB changed, rebuild even if not moved
 		AABB			m_localAABB;		//ذΧ
 		AABB			m_worldAABB;		//Χ
 		bool			m_bCastShadow;		// Is shadow caster?
 		bool			m_bReceiveShadow;	// Is shadow receiver?
+		uint32			m_curLod[eLodPass_Count];
+		float			m_lodPixelError;
+
+		static float	s_lodPassBias[eLodPass_Count];
 	};
 }
 
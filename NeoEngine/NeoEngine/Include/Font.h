@@ -4,14 +4,25 @@
 	author:		maval
 	
 	purpose:	Draw text. ݲֺ֧.
+				All text of a frame is batched into one dynamic buffer and drawn together.
 *********************************************************************/
 #ifndef Font_h__
 #define Font_h__
 
 #include "Prerequiestity.h"
+#include "FrameAllocator.h"
 
 namespace Neo
 {
+	// Compact vertex for text, position is already in NDC
+	struct STextVertex
+	{
+		float	x, y;
+		float	u, v;
+		DWORD	color;		// R8G8B8A8
+	};
+
+	//------------------------------------------------------------------------------------
 	class Font
 	{
 	public:
@@ -19,16 +30,36 @@ namespace Neo
 		~Font();
 
 	public:
+		// Queue text for this frame, layout of unchanged strings is reused
 		void			DrawText(const STRING& text, const IPOINT& pos, const SColor& color);
+		// Draw all queued text in one call, done by the render system at latest before Present
+		void			Flush();
 
 	private:
-		void			_InitMesh(const STRING& text, const IPOINT& pos, const SColor& color);
+		struct SCachedText
+		{
+			std::vector<STextVertex>	verts;
+			uint32						lastFrame;
+		};
+
+		typedef std::unordered_map<STRING, SCachedText>	TextCache;
+		// Vertices of this frame, given back to the frame arena by Flush
+		typedef std::vector<STextVertex, FrameStlAllocator<STextVertex>>	TextBatch;
+
+		void			_Layout(const STRING& text, const IPOINT& pos, DWORD color, std::vector<STextVertex>& verts) const;
 		void			_InitMaterial();
+		// Grow vertex and index buffers to hold nQuads glyphs
+		bool			_EnsureBuffers(uint32 nQuads);
+		void			_PurgeCache();
 
 		D3D11RenderSystem* m_pRenderSystem;
-		Mesh*			m_pMesh;
-		Entity*			m_pEntity;
 		Material*		m_pMaterial;
+		ID3D11Buffer*	m_pVertexBuf;			// Dynamic, rewritten each flush
+		ID3D11Buffer*	m_pIndexBuf;			// Static quad indices
+		uint32			m_maxQuads;
+		TextBatch		m_batch;
+		TextCache		m_cache;				// Entries are aged in FrameAllocator frames
+		uint32			m_cacheWndWidth, m_cacheWndHeight;	// Cached layouts are in NDC of this size
 	};
 }
 
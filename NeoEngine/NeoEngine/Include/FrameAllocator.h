@@ -0,0 +1,136 @@
+/********************************************************************
+	created:	24:10:2014   15:20
+	filename	FrameAllocator.h
+	author:		maval
+
+	purpose:	Bump allocator for transient per-frame data. Two arenas are used
+				in turn, memory allocated in frame N stays valid until the end of
+				frame N+1 and is then reset as a whole, nothing is freed one by one.
+				Each thread bumps its own chunk carved from the shared arena with
+				one interlocked add, so allocation doesn't lock.
+				Debug builds stamp each block with its frame and fill reset arenas,
+				see FramePtr and FrameAllocator::CheckAlive for catching pointers
+				that escape the frame.
+*********************************************************************/
+#ifndef FrameAllocator_h__
+#define FrameAllocator_h__
+
+#include "Prerequiestity.h"
+
+namespace Neo
+{
+	class FrameAllocator
+	{
+	public:
+		// Bytes of each of the two arenas
+		static void		Init(uint32 arenaSize = 4 * 1024 * 1024);
+		static void		ShutDown();
+
+		// Any thread. Falls back to the heap when the arena is full.
+		static void*	Alloc(uint32 bytes, uint32 align = 16);
+		template<class T>
+		static T*		AllocArray(uint32 n)					{ return (T*)Alloc(sizeof(T) * n, __alignof(T)); }
+
+		/**	Main thread, once all threads are done allocating for this frame.
+			Resets the arena used two frames ago.
+		*/
+		static void		EndFrame();
+		static uint32	GetFrame()								{ return s_frame; }
+		static bool		IsFrameAlive(uint32 frame)				{ return frame + 1 >= s_frame; }
+
+		// Inside one of the arenas. Use to assert persistent data doesn't keep frame memory.
+		static bool		IsTransient(const void* p);
+		// Debug only: asserts p was allocated in a frame that's still alive
+		static void		CheckAlive(const void* p);
+
+		static uint32	GetLastFrameBytes()						{ return s_lastFrameBytes; }
+		static uint32	GetPeakFrameBytes()						{ return s_peakFrameBytes; }
+		// Bytes that didn't fit in the arena last frame, should stay 0
+		static uint32	GetLastOverflowBytes()					{ return s_lastOverflowBytes; }
+
+	private:
+		struct SArena
+		{
+			char*				base;
+			uint32				size;
+			volatile long		used;
+		};
+
+		static char*	_Reserve(SArena& arena, uint32 bytes);
+		static void*	_AllocOverflow(uint32 bytes, uint32 align);
+
+		static SArena			s_arenas[2];
+		static volatile uint32	s_frame;
+		static uint32			s_lastFrameBytes;
+		static uint32			s_peakFrameBytes;
+		static uint32			s_lastOverflowBytes;
+	};
+
+	//------------------------------------------------------------------------------------
+	// STL allocator on the frame arena, deallocate is a no-op
+	template<class T>
+	class FrameStlAllocator
+	{
+	public:
+		typedef T					value_type;
+		typedef T*					pointer;
+		typedef const T*			const_pointer;
+		typedef T&					reference;
+		typedef const T&			const_reference;
+		typedef size_t				size_type;
+		typedef ptrdiff_t			difference_type;
+
+		template<class U> struct rebind { typedef FrameStlAllocator<U> other; };
+
+		FrameStlAllocator() {}
+		template<class U> FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+		pointer			address(reference x) const				{ return &x; }
+		const_pointer	address(const_reference x) const		{ return &x; }
+		size_type		max_size() const						{ return 0x7fffffff / sizeof(T); }
+
+		pointer			allocate(size_type n, const void* = 0)	{ return FrameAllocator::AllocArray<T>(n); }
+		// A container still releasing memory of a dead frame has escaped it
+		void			deallocate(pointer p, size_type)		{ FrameAllocator::CheckAlive(p); }
+
+		void			construct(pointer p, const T& val)		{ new((void*)p) T(val); }
+		void			destroy(pointer p)						{ p->~T(); }
+
+		bool			operator==(const FrameStlAllocator&) const	{ return true; }
+		bool			operator!=(const FrameStlAllocator&) const	{ return false; }
+	};
+
+	//------------------------------------------------------------------------------------
+	// Pointer to frame memory that asserts on use after its frame died. Plain pointer in release.
+	template<class T>
+	class FramePtr
+	{
+	public:
+		FramePtr(T* p = nullptr)
+		:m_ptr(p)
+#ifdef _DEBUG
+		,m_frame(FrameAllocator::GetFrame())
+#endif
+		{
+		}
+
+		T*		Get() const
+		{
+#ifdef _DEBUG
+			assert(FrameAllocator::IsFrameAlive(m_frame) && "Frame memory used after its frame!");
+#endif
+			return m_ptr;
+		}
+		T*		operator->() const		{ return Get(); }
+		T&		operator*() const		{ return *Get(); }
+		T&		operator[](int i) const	{ return Get()[i]; }
+
+	private:
+		T*		m_ptr;
+#ifdef _DEBUG
+		uint32	m_frame;
+#endif
+	};
+}
+
+#endif // FrameAllocator_h__
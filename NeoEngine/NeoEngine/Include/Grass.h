@@ -0,0 +1,87 @@
+/********************************************************************
+	created:	3:11:2014   15:30
+	filename	Grass.h
+	author:		maval
+
+	purpose:	Grass over the terrain. Instances come from a GrassLayer
+				whose density starts from the terrain, flat and low ground
+				only, and can be painted. Every visible page is one
+				instanced draw of a single blade mesh, its instance buffer
+				created when the page is first drawn and released when the
+				layer drops or regenerates the page.
+*********************************************************************/
+#ifndef Grass_h__
+#define Grass_h__
+
+#include "Prerequiestity.h"
+#include "MathDef.h"
+#include "GrassLayer.h"
+
+namespace Neo
+{
+	// Blade in its own space, x across and y up, both scaled in the shader
+	struct SGrassVertex
+	{
+		VEC3	pos;
+		VEC2	uv;
+	};
+
+	class Grass
+	{
+	public:
+		Grass(Terrain* pTerrain);
+		~Grass();
+
+	public:
+		// Stream pages around the camera
+		void		Update();
+		void		Render();
+
+		GrassLayer&	GetLayer()	{ return m_layer; }
+		// Editor brush, amount in [-1, 1] at the center
+		void		PaintDensity(float x, float z, float radius, float amount) { m_layer.PaintDensity(x, z, radius, amount); }
+
+	private:
+		void		_InitLayer(Terrain* pTerrain);
+		void		_InitBladeMesh();
+		void		_InitMaterial();
+		void		_InitConstantBuf();
+		// Instance buffer of the page, created if it has none of its current version
+		ID3D11Buffer*	_GetInstanceBuffer(const SGrassPage* pPage);
+		// Of pages the layer dropped or regenerated
+		void		_ReleaseStaleBuffers();
+
+		struct SPageBuffer
+		{
+			ID3D11Buffer*	pBuffer;
+			uint32			version;
+		};
+
+		__declspec(align(16))
+		struct cBufferGrass
+		{
+			VEC3	baseColor;
+			float	fadeStart;
+			VEC3	tipColor;
+			float	viewDistance;
+			VEC3	dryColor;
+			float	bladeWidth;
+			float	bladeHeight;
+			float	windStrength;
+			float	padding[2];
+		};
+
+		D3D11RenderSystem*			m_pRenderSystem;
+		Material*					m_pMaterial;
+		ID3D11Buffer*				m_pBladeVB;
+		ID3D11Buffer*				m_pBladeIB;
+		uint32						m_bladeIndexCount;
+		cBufferGrass				m_cBuffer;
+		ID3D11Buffer*				m_pCB;
+		GrassLayer					m_layer;
+		std::vector<SPageBuffer>	m_pageBuffers;		// Per page of the layer
+		std::vector<SGrassDrawPage>	m_drawPages;		// Of the last Render
+	};
+}
+
+#endif // Grass_h__
@@ -0,0 +1,141 @@
+/********************************************************************
+	created:	3:11:2014   11:10
+	filename	GrassLayer.h
+	author:		maval
+
+	purpose:	Grass instances in square pages over the terrain. One
+				Poisson disk pattern, periodic over a page so it tiles
+				without points closer than the spacing across page
+				borders, is shared by all pages. Its points carry a
+				random rank and are kept where the rank is below the
+				density mask, so every page is an array sorted by rank
+				and drawing a prefix of it thins evenly with range. Scale,
+				rotation and tint come from a hash of page and point, so
+				a page is a pure function of the layer desc, density and
+				heights. Pages near the camera are generated a few per
+				update and dropped once out of range.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef GrassLayer_h__
+#define GrassLayer_h__
+
+#include <vector>
+#include <functional>
+
+namespace Neo
+{
+	// Per instance vertex data of Grass.hlsl
+	struct SGrassInstance
+	{
+		float			x, y, z;		// Root in world space
+		float			scale;
+		float			rotation;		// Around y, radians
+		float			tint;			// [0, 1], towards dry colour
+	};
+
+	struct SGrassLayerDesc
+	{
+		SGrassLayerDesc():originX(0),originZ(0),sizeX(0),sizeZ(0),pageSize(16),spacing(0.3f)
+			,minScale(0.6f),maxScale(1.2f),bladeHeight(0.8f),fadeStart(30),viewDistance(100),seed(1) {}
+
+		float			originX, originZ;	// World min corner
+		float			sizeX, sizeZ;		// World extent, the density mask covers it
+		float			pageSize;
+		float			spacing;			// Poisson disk radius, no two instances are closer
+		float			minScale, maxScale;
+		float			bladeHeight;		// At scale 1, only for page bounds
+		float			fadeStart;			// Instances thin out linearly from here
+		float			viewDistance;		// to none here
+		unsigned int	seed;
+	};
+
+	struct SGrassPage
+	{
+		unsigned int				pageX, pageZ;
+		float						minY, maxY;		// Over the whole blades
+		unsigned int				version;		// Changes whenever the page is regenerated
+		std::vector<SGrassInstance>	instances;		// Thinning order
+	};
+
+	struct SGrassDrawPage
+	{
+		const SGrassPage*	pPage;
+		unsigned int		count;			// Instances to draw, a prefix of the page
+		float				distance;
+	};
+
+	// Ground height at (x, z), called from several threads at once
+	typedef std::function<float(float, float)>	GrassHeightFunc;
+
+	class GrassLayer
+	{
+	public:
+		GrassLayer();
+		~GrassLayer();
+
+	public:
+		// Builds the pattern, no page is resident and the density is 0 until set
+		void			Init(const SGrassLayerDesc& desc, const GrassHeightFunc& heightFunc);
+
+		/**	Density in [0, 255] over the layer extent, rows along +z, samples on the
+			corners like the terrain height map. Resident pages are regenerated.
+		*/
+		void			SetDensityMap(const unsigned char* pDensity, unsigned int width, unsigned int height);
+		// Add amount (negative removes) times a smooth falloff inside the circle
+		void			PaintDensity(float x, float z, float radius, float amount);
+		// Bilinear, [0, 1]
+		float			GetDensityAt(float x, float z) const;
+		// Regenerate resident pages touching the rectangle, e.g. after the heights under it changed
+		void			InvalidateRegion(float x0, float z0, float x1, float z1);
+
+		/**	Drop pages gone out of range, then generate up to maxPages pages on the
+			calling thread, invalidated ones first, then missing ones nearest first.
+		*/
+		void			Update(float camX, float camZ, unsigned int maxPages);
+		/**	Resident pages inside all planes and in range, near to far, each with
+			the instance count left after thinning by its distance.
+			@param pPlanes (nx, ny, nz, d) each, inside when >= 0. Null culls nothing.
+		*/
+		void			Cull(const float* pPlanes, unsigned int numPlanes, float camX, float camZ, std::vector<SGrassDrawPage>& pages) const;
+		// Fraction of a page's instances drawn at this distance, same as Grass.hlsl widens blades by
+		float			GetThinning(float distance) const;
+
+		// The same page for the same desc, density and heights, whatever else happened before
+		void			GeneratePage(unsigned int pageX, unsigned int pageZ, SGrassPage& page) const;
+
+		const SGrassLayerDesc&	GetDesc() const				{ return m_desc; }
+		unsigned int	GetPagesX() const					{ return m_pagesX; }
+		unsigned int	GetPagesZ() const					{ return m_pagesZ; }
+		// Null if not resident
+		const SGrassPage*	GetPage(unsigned int pageX, unsigned int pageZ) const	{ return m_pages[pageZ * m_pagesX + pageX]; }
+		unsigned int	GetResidentCount() const			{ return m_residentCount; }
+		// Points of the pattern, the most instances a page can have
+		unsigned int	GetPatternSize() const				{ return (unsigned int)m_pattern.size(); }
+
+	private:
+		struct SPatternPoint
+		{
+			float			x, z;			// In [0, pageSize)
+			float			rank;			// [0, 1)
+
+			bool operator< (const SPatternPoint& rhs) const { return rank < rhs.rank; }
+		};
+
+		void			_BuildPattern();
+		float			_DistanceToPage(float camX, float camZ, unsigned int pageX, unsigned int pageZ) const;
+		void			_Clear();
+
+		SGrassLayerDesc				m_desc;
+		GrassHeightFunc				m_heightFunc;
+		std::vector<SPatternPoint>	m_pattern;		// By rank
+		std::vector<unsigned char>	m_density;
+		unsigned int				m_densityWidth, m_densityHeight;
+		unsigned int				m_pagesX, m_pagesZ;
+		std::vector<SGrassPage*>	m_pages;		// Null if not resident
+		std::vector<bool>			m_dirty;		// Resident but stale
+		unsigned int				m_residentCount;
+		unsigned int				m_nextVersion;
+	};
+}
+
+#endif // GrassLayer_h__
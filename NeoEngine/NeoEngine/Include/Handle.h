@@ -0,0 +1,208 @@
+/********************************************************************
+	created:	25:10:2014   15:40
+	filename	Handle.h
+	author:		maval
+
+	purpose:	Generational handles to pooled resources. A handle is 32 bits,
+				slot index and the slot's generation when it was handed out, so
+				a handle to a destroyed resource resolves to null instead of
+				dangling, and it's plain data safe to pass to other threads.
+				Each HandlePool is fixed capacity so slots never move and
+				Resolve is lock free O(1). Reference counts are atomic, the
+				last Release destroys the object. Live objects are also kept
+				dense for iterating without chasing holes.
+*********************************************************************/
+#ifndef Handle_h__
+#define Handle_h__
+
+#include "Prerequiestity.h"
+
+namespace Neo
+{
+	template<class T>
+	class Handle
+	{
+	public:
+		enum
+		{
+			INDEX_BITS	=	20,
+			GEN_BITS	=	32 - INDEX_BITS,
+			INDEX_MASK	=	(1 << INDEX_BITS) - 1,
+			GEN_MASK	=	(1 << GEN_BITS) - 1
+		};
+
+		Handle():m_value(0) {}
+		Handle(uint32 index, uint32 generation):m_value(((generation & GEN_MASK) << INDEX_BITS) | index) { assert(index <= INDEX_MASK); }
+
+		// Generations start at 1, so a zero value never resolves
+		bool	IsNull() const					{ return m_value == 0; }
+		uint32	GetIndex() const				{ return m_value & INDEX_MASK; }
+		uint32	GetGeneration() const			{ return m_value >> INDEX_BITS; }
+		uint32	GetValue() const				{ return m_value; }
+
+		bool	operator==(const Handle& rhs) const	{ return m_value == rhs.m_value; }
+		bool	operator!=(const Handle& rhs) const	{ return m_value != rhs.m_value; }
+		bool	operator<(const Handle& rhs) const	{ return m_value < rhs.m_value; }
+
+	private:
+		uint32	m_value;
+	};
+
+	// Destroy policy for pooled objects owned by plain pointer
+	struct HandleDelete
+	{
+		template<class T> void operator()(T* p) const	{ delete p; }
+	};
+
+	// Destroy policy for IRefCount objects, the pool owns one reference
+	struct HandleRelease
+	{
+		template<class T> void operator()(T* p) const	{ p->Release(); }
+	};
+
+	//------------------------------------------------------------------------------------
+	template<class T, class Destroy = HandleDelete>
+	class HandlePool
+	{
+	public:
+		typedef Handle<T>		HandleType;
+
+		HandlePool(uint32 capacity = 4096)
+		:m_slots(capacity)
+		,m_numSlots(0)
+		{
+			assert(capacity > 0 && capacity - 1 <= HandleType::INDEX_MASK);
+			m_dense.reserve(capacity);
+			m_denseSlot.reserve(capacity);
+			InitializeCriticalSection(&m_lock);
+		}
+
+		~HandlePool()
+		{
+			// Whatever is still referenced goes down with the pool
+			for (size_t i=0; i<m_dense.size(); ++i)
+				Destroy()(m_dense[i]);
+
+			DeleteCriticalSection(&m_lock);
+		}
+
+		// Takes ownership of pObject, the returned handle holds the first reference
+		HandleType	Create(T* pObject)
+		{
+			assert(pObject);
+
+			EnterCriticalSection(&m_lock);
+
+			uint32 index;
+			if (!m_freeSlots.empty())
+			{
+				index = m_freeSlots.back();
+				m_freeSlots.pop_back();
+			}
+			else
+			{
+				assert(m_numSlots < m_slots.size() && "Handle pool full!");
+				index = m_numSlots++;
+				m_slots[index].generation = 1;
+			}
+
+			SSlot& slot = m_slots[index];
+			slot.pObject = pObject;
+			slot.refCount = 1;
+			slot.dense = (uint32)m_dense.size();
+
+			m_dense.push_back(pObject);
+			m_denseSlot.push_back(index);
+
+			const HandleType h(index, slot.generation);
+
+			LeaveCriticalSection(&m_lock);
+
+			return h;
+		}
+
+		// Null for null or stale handles. Any thread.
+		T*		Resolve(HandleType h) const
+		{
+			if(h.IsNull())
+				return nullptr;
+
+			const SSlot& slot = m_slots[h.GetIndex()];
+			return slot.generation == h.GetGeneration() ? slot.pObject : nullptr;
+		}
+
+		bool	IsValid(HandleType h) const				{ return Resolve(h) != nullptr; }
+
+		// Any thread, h must be alive
+		void	AddRef(HandleType h)
+		{
+			assert(IsValid(h));
+			InterlockedIncrement(&m_slots[h.GetIndex()].refCount);
+		}
+
+		// Any thread. Destroys the object on the last reference, stale handles are ignored.
+		void	Release(HandleType h)
+		{
+			if(!IsValid(h))
+				return;
+
+			SSlot& slot = m_slots[h.GetIndex()];
+			if(InterlockedDecrement(&slot.refCount) > 0)
+				return;
+
+			EnterCriticalSection(&m_lock);
+
+			T* pObject = slot.pObject;
+			slot.pObject = nullptr;
+			slot.generation = (slot.generation & HandleType::GEN_MASK) == HandleType::GEN_MASK ? 1 : slot.generation + 1;
+
+			// Swap the last one into the hole
+			const uint32 last = (uint32)m_dense.size() - 1;
+			m_dense[slot.dense] = m_dense[last];
+			m_denseSlot[slot.dense] = m_denseSlot[last];
+			m_slots[m_denseSlot[slot.dense]].dense = slot.dense;
+			m_dense.pop_back();
+			m_denseSlot.pop_back();
+
+			m_freeSlots.push_back(h.GetIndex());
+
+			LeaveCriticalSection(&m_lock);
+
+			Destroy()(pObject);
+		}
+
+		long	GetRefCount(HandleType h) const			{ return IsValid(h) ? m_slots[h.GetIndex()].refCount : 0; }
+
+		// Dense iteration over live objects, main thread only
+		uint32	GetCount() const					{ return (uint32)m_dense.size(); }
+		T*		GetDense(uint32 i) const			{ return m_dense[i]; }
+		HandleType	GetDenseHandle(uint32 i) const		{ const uint32 index = m_denseSlot[i]; return HandleType(index, m_slots[index].generation); }
+
+	private:
+		HandlePool(const HandlePool&);
+		HandlePool& operator=(const HandlePool&);
+
+		struct SSlot
+		{
+			SSlot():pObject(nullptr),refCount(0),generation(0),dense(0) {}
+
+			T*				pObject;
+			volatile long	refCount;
+			volatile uint32	generation;
+			uint32			dense;
+		};
+
+		std::vector<SSlot>	m_slots;		// Fixed size, never reallocated
+		uint32				m_numSlots;		// Ever used
+		std::vector<uint32>	m_freeSlots;
+		std::vector<T*>		m_dense;
+		std::vector<uint32>	m_denseSlot;	// Dense index -> slot index
+		CRITICAL_SECTION	m_lock;			// Create and destroy
+	};
+
+	typedef Handle<Mesh>			MeshHandle;
+	typedef Handle<Material>		MaterialHandle;
+	typedef Handle<D3D11Texture>	TextureHandle;
+}
+
+#endif // Handle_h__
@@ -4,7 +4,7 @@
 	author:		maval
 	
 	purpose:	ü.
-				Ŀǰ̰߳ȫ֧.
+				ΪԭӲ,ɿ߳AddRef/Release.
 *********************************************************************/
 #ifndef IRefCount_h__
 #define IRefCount_h__
@@ -15,19 +15,20 @@ public:
 	IRefCount():m_refCnt(1) {}
 	virtual ~IRefCount() { Release(); }
 
-	void	AddRef() const	{ ++m_refCnt; }
+	void	AddRef() const	{ InterlockedIncrement(&m_refCnt); }
+	int		GetRefCount() const	{ return m_refCnt; }
 	void	Release() const
 	{
 		assert(m_refCnt >= 0);
 		if (m_refCnt > 0)
 		{
-			if (--m_refCnt == 0)
+			if (InterlockedDecrement(&m_refCnt) == 0)
 				delete this;
 		}
 	}
 
 private:
-	mutable int		m_refCnt;
+	mutable volatile long	m_refCnt;
 };
 
 #endif // IRefCount_h__
\ No newline at end of file
@@ -11,24 +11,49 @@
 #include "Prerequiestity.h"
 #include "Color.h"
 #include "IRefCount.h"
+#include "FrameAllocator.h"
 
 namespace Neo
 {
+	// Only lives while the shader is compiled
+	typedef std::vector<D3D_SHADER_MACRO, FrameStlAllocator<D3D_SHADER_MACRO>>	ShaderMacros;
+
 	struct SDirectionLight
 	{
 		VEC3	lightDir;
 		SColor	lightColor;
 	};
+
+	// Per material shader params, cbufferMaterial in shaders
+	const int	MATERIAL_CBUFFER_SLOT	=	3;
+
+	__declspec(align(16))
+	struct cBufferMaterial
+	{
+		SColor	ambient;
+		SColor	diffuse;
+		SColor	specular;
+		float	shiness;
+		float	padding[3];
+	};
 	//------------------------------------------------------------------------------------
 	class Material : public IRefCount
 	{
+		friend class MaterialInstance;
 	public:
 		Material(eVertexType type = eVertexType_General);
 		~Material();
 
 	public:
-		SColor		ambient, diffuse, specular;
-		float		shiness;
+		// Uploaded on the next Activate after a change, never otherwise
+		void			SetAmbient(const SColor& color)		{ m_ambient = color; m_bCBufferDirty = true; }
+		void			SetDiffuse(const SColor& color)		{ m_diffuse = color; m_bCBufferDirty = true; }
+		void			SetSpecular(const SColor& color)	{ m_specular = color; m_bCBufferDirty = true; }
+		void			SetShiness(float shiness)			{ m_shiness = shiness; m_bCBufferDirty = true; }
+		const SColor&	GetAmbient() const					{ return m_ambient; }
+		const SColor&	GetDiffuse() const					{ return m_diffuse; }
+		const SColor&	GetSpecular() const					{ return m_specular; }
+		float			GetShiness() const					{ return m_shiness; }
 
 		void		Activate();
 		void		TurnOffTessellation();
@@ -37,25 +62,33 @@ namespace Neo
 		bool		InitTessellationShader(const STRING& filename, uint32 shaderFalg = 0, const D3D_SHADER_MACRO* pMacro = nullptr);
 
 		void					SetTexture(int stage, D3D11Texture* pTexture);
+		D3D11Texture*			GetTexture(int stage) const			{ return m_pTexture[stage]; }
 		void					SetSamplerStateDesc(int stage, const D3D11_SAMPLER_DESC& desc);
 		D3D11_SAMPLER_DESC&		GetSamplerStateDesc(int stage)		{ return m_samplerStateDesc[stage]; }
 		void					SetCullMode(D3D11_CULL_MODE mode)	{ m_cullMode = mode; }
+		// Same id means same shader objects, 0 before InitShader. Meant for sort keys.
+		uint32					GetShaderId() const;
+		// Groups by shader first, then by material, so instances of a parent draw together
+		uint32					GetSortKey() const;
 
 	private:
-		bool		_CompileShaderFromFile( const char* szFileName, const char* szEntryPoint, const char* szShaderModel, 
-			const std::vector<D3D_SHADER_MACRO>& vecMacro, ID3DBlob** ppBlobOut );		
-		void		_CreateVertexLayout();
-		std::vector<D3D_SHADER_MACRO> _InternelInitShader(const D3D_SHADER_MACRO* pMacro);
+		void		_InternelInitShader(const D3D_SHADER_MACRO* pMacro, ShaderMacros& retMacros);
+		void		_Activate(D3D11Texture* const* ppTextures, ID3D11Buffer* pCBuffer);
+		void		_UpdateCBuffer();
+		// Create pCBuffer if needed and upload the params to it
+		static void	_UploadCBuffer(ID3D11Buffer*& pCBuffer, const SColor& ambient, const SColor& diffuse,
+			const SColor& specular, float shiness);
+
+		static uint32				s_nextId;
+		uint32						m_id;
+		SColor						m_ambient, m_diffuse, m_specular;
+		float						m_shiness;
+		ID3D11Buffer*				m_pCBuffer;				// Created on first Activate
+		bool						m_bCBufferDirty;
 
 		D3D11RenderSystem*			m_pRenderSystem;
-		ID3D11VertexShader*			m_pVertexShader;
-		ID3D11PixelShader*			m_pPixelShader;
-		ID3D11HullShader*			m_pHullShader;
-		ID3D11DomainShader*			m_pDomainShader;
-		ID3D11VertexShader*			m_pVS_WithClipPlane;
-		ID3D11InputLayout*			m_pInputLayout;			// Why keep it here? Because it's depend on m_vsCode
-
-		std::vector<char>			m_vsCode;				// Cached for creating vertex layout
+		ShaderProgram*				m_pProgram;				// VS, PS and input layout, shared through ShaderLibrary
+		ShaderProgram*				m_pTessProgram;			// HS and DS
 		uint32						m_shaderFlag;
 		D3D11_CULL_MODE				m_cullMode;
 		eVertexType					m_vertType;
@@ -64,6 +97,60 @@ namespace Neo
 		D3D11_SAMPLER_DESC	m_samplerStateDesc[MAX_TEXTURE_STAGE];
 		ID3D11SamplerState*	m_pSamplerState[MAX_TEXTURE_STAGE];
 	};
+
+	//------------------------------------------------------------------------------------
+	/**	Shares everything of a parent material (shaders, layout, samplers, cull mode)
+		and overrides only textures and parameters. Creating one compiles nothing and
+		creates no D3D object, and it sorts with its parent. The overrides live in a
+		block allocated on the first override, so the instance itself stays 16 bytes
+		on Win32.
+	*/
+	class MaterialInstance : public IRefCount
+	{
+	public:
+		MaterialInstance(Material* pParent);
+		~MaterialInstance();
+
+	public:
+		void			Activate();
+
+		Material*		GetParent() const		{ return m_pParent; }
+		uint32			GetSortKey() const		{ return m_pParent->GetSortKey(); }
+
+		// Null is a valid override, ClearTexture goes back to the parent's
+		void			SetTexture(int stage, D3D11Texture* pTexture);
+		void			ClearTexture(int stage);
+		D3D11Texture*	GetTexture(int stage) const;
+
+		void			SetAmbient(const SColor& color);
+		void			SetDiffuse(const SColor& color);
+		void			SetSpecular(const SColor& color);
+		void			SetShiness(float shiness);
+		const SColor&	GetAmbient() const		{ return m_pOverrides && m_pOverrides->bParams ? m_pOverrides->ambient : m_pParent->GetAmbient(); }
+		const SColor&	GetDiffuse() const		{ return m_pOverrides && m_pOverrides->bParams ? m_pOverrides->diffuse : m_pParent->GetDiffuse(); }
+		const SColor&	GetSpecular() const		{ return m_pOverrides && m_pOverrides->bParams ? m_pOverrides->specular : m_pParent->GetSpecular(); }
+		float			GetShiness() const		{ return m_pOverrides && m_pOverrides->bParams ? m_pOverrides->shiness : m_pParent->GetShiness(); }
+
+	private:
+		struct SOverrides
+		{
+			SOverrides();
+
+			D3D11Texture*	pTexture[MAX_TEXTURE_STAGE];
+			uint32			textureMask;		// Bit per overridden stage
+			bool			bParams;			// Parameters below are in use
+			SColor			ambient, diffuse, specular;
+			float			shiness;
+			ID3D11Buffer*	pCBuffer;			// Own cbuffer once parameters are overridden
+			bool			bCBufferDirty;
+		};
+
+		SOverrides&		_GetOverrides();
+		SOverrides&		_GetParamOverrides();
+
+		Material*		m_pParent;
+		SOverrides*		m_pOverrides;			// Null until something is overridden
+	};
 }
 
 #endif // Material_h__
\ No newline at end of file
@@ -0,0 +1,125 @@
+/********************************************************************
+	created:	24:10:2014   9:40
+	filename	MemoryTracker.h
+	author:		maval
+
+	purpose:	Memory accounting by subsystem tag. CPU heap goes through Alloc/Free
+				or TaggedAllocator, which prefix each block with its tag and size.
+				GPU resources can't be measured, their estimated size is recorded
+				with Add/Remove keyed by the owning object wherever buffers and
+				textures are created. Keeps current and peak bytes per tag and per
+				resource name, snapshots can be diffed, e.g. around ToggleScene.
+*********************************************************************/
+#ifndef MemoryTracker_h__
+#define MemoryTracker_h__
+
+#include "Prerequiestity.h"
+
+namespace Neo
+{
+	enum eMemTag
+	{
+		eMemTag_Mesh,
+		eMemTag_Terrain,
+		eMemTag_Water,
+		eMemTag_Texture,
+		eMemTag_RenderTarget,
+		eMemTag_Material,			// Shaders and constant buffers
+		eMemTag_Font,
+		eMemTag_Vegetation,
+		eMemTag_Misc,
+		eMemTag_Max
+	};
+
+	enum eMemPool
+	{
+		eMemPool_CPU,
+		eMemPool_GPU,				// Estimated
+		eMemPool_Max
+	};
+
+	//------------------------------------------------------------------------------------
+	class MemoryTracker
+	{
+	public:
+		struct SStat
+		{
+			SStat():current(0),peak(0),count(0) {}
+
+			size_t		current;
+			size_t		peak;
+			uint32		count;		// Live allocations
+		};
+
+		struct SSnapshot
+		{
+			size_t						tags[eMemTag_Max][eMemPool_Max];
+			std::map<STRING, size_t>	names[eMemPool_Max];
+		};
+
+	public:
+		// Engine heap entry points. Name must be a string literal or null.
+		static void*	Alloc(size_t bytes, eMemTag tag, const char* name = nullptr);
+		static void		Free(void* p);
+
+		/**	Record a resource of given estimated size. The owner is only a key, e.g.
+			the ID3D11Buffer or the texture object. Adding an owner again replaces
+			its previous record, so recreated resources just call it again.
+		*/
+		static void		Add(const void* owner, eMemTag tag, eMemPool pool, size_t bytes, const STRING& name);
+		// Does nothing if owner is unknown, e.g. null
+		static void		Remove(const void* owner);
+		// Size from the buffer desc
+		static void		AddBuffer(ID3D11Buffer* pBuffer, eMemTag tag, const STRING& name);
+
+		static SStat	GetTagStat(eMemTag tag, eMemPool pool);
+		static SStat	GetNameStat(const STRING& name, eMemPool pool);
+		static size_t	GetTotal(eMemPool pool);
+
+		static void		TakeSnapshot(SSnapshot& snapshot);
+		// Lines of what changed from a to b, tags first then the largest maxNames resources
+		static void		Diff(const SSnapshot& a, const SSnapshot& b, StringVector& lines, uint32 maxNames = 8);
+		// Current and peak of each used tag, ready for DrawText
+		static void		GetSummary(StringVector& lines);
+
+		static const char*	GetTagName(eMemTag tag);
+
+	private:
+		static void		_Account(eMemTag tag, eMemPool pool, const char* name, size_t bytes, bool bAdd);
+	};
+
+	//------------------------------------------------------------------------------------
+	// STL allocator charging its tag, e.g. std::vector<float, TaggedAllocator<float, eMemTag_Terrain>>
+	template<class T, eMemTag TAG>
+	class TaggedAllocator
+	{
+	public:
+		typedef T					value_type;
+		typedef T*					pointer;
+		typedef const T*			const_pointer;
+		typedef T&					reference;
+		typedef const T&			const_reference;
+		typedef size_t				size_type;
+		typedef ptrdiff_t			difference_type;
+
+		template<class U> struct rebind { typedef TaggedAllocator<U, TAG> other; };
+
+		TaggedAllocator() {}
+		template<class U> TaggedAllocator(const TaggedAllocator<U, TAG>&) {}
+
+		pointer			address(reference x) const				{ return &x; }
+		const_pointer	address(const_reference x) const		{ return &x; }
+		size_type		max_size() const						{ return size_t(-1) / sizeof(T); }
+
+		pointer			allocate(size_type n, const void* = 0)	{ return (pointer)MemoryTracker::Alloc(n * sizeof(T), TAG); }
+		void			deallocate(pointer p, size_type)		{ MemoryTracker::Free(p); }
+
+		void			construct(pointer p, const T& val)		{ new((void*)p) T(val); }
+		void			destroy(pointer p)						{ p->~T(); }
+
+		bool			operator==(const TaggedAllocator&) const	{ return true; }
+		bool			operator!=(const TaggedAllocator&) const	{ return false; }
+	};
+}
+
+#endif // MemoryTracker_h__
@@ -10,6 +10,7 @@
 
 #include "Prerequiestity.h"
 #include "VertexData.h"
+#include "MemoryTracker.h"
 
 namespace Neo
 {
@@ -18,7 +19,8 @@ namespace Neo
 	class SubMesh
 	{
 	public:
-		SubMesh();
+		// Tag its buffers are charged to, e.g. eMemTag_Water for the water grid
+		SubMesh(eMemTag memTag = eMemTag_Mesh);
 		~SubMesh();
 
 	public:
@@ -30,14 +32,37 @@ namespace Neo
 
 		const VertexData&	GetVertData() const { return m_vertData; }
 
-		void		Render(Material* pMaterial);		
+		/**	Build up to nLod levels (including the original one) by QEM simplification.
+			Each level keeps about reduction times the indices of the previous one and
+			shares the vertex buffer. Stops early when the mesh can't be reduced further.
+		*/
+		bool		GenerateLods(uint32 nLod, float reduction = 0.5f);
+		uint32		GetLodCount() const { return 1 + m_lodIndexBufs.size(); }
+		// Object space simplification error of given LOD, 0 for the original mesh
+		float		GetLodError(uint32 lod) const;
+		DWORD		GetLodIndexCount(uint32 lod) const;
+
+		void		Render(Material* pMaterial, uint32 lod = 0);		
+
+		/**	UV units per object space unit along the surface, area weighted over all
+			triangles. Texels per unit is this times the texture size.
+		*/
+		float		GetUVDensity();
 
 		void		SetMaterial(Material* pMaterial);
 		Material*	GetMaterial()	{ return m_pMaterial; }
+		// Drawn with the instance, GetMaterial then returns its parent
+		void				SetMaterialInstance(MaterialInstance* pInstance);
+		MaterialInstance*	GetMaterialInstance()	{ return m_pMaterialInstance; }
+		uint32		GetSortKey() const;
+
+	private:
+		void		_ClearLods();
 
 	private:
 		STRING			m_name;
 		Material*		m_pMaterial;
+		MaterialInstance*	m_pMaterialInstance;
 
 		ID3D11Buffer*	m_pVertexBuf;
 		VertexData		m_vertData;
@@ -45,6 +70,14 @@ namespace Neo
 		ID3D11Buffer*	m_pIndexBuf;
 		DWORD*			m_pIndexData;
 		DWORD			m_nIndexCnt;
+
+		// Extra LODs, element i is LOD i+1. LOD 0 is m_pIndexBuf.
+		std::vector<ID3D11Buffer*>	m_lodIndexBufs;
+		std::vector<DWORD>			m_lodIndexCnt;
+		std::vector<float>			m_lodErrors;
+
+		float			m_uvDensity;		// Computed on first use, negative until then
+		eMemTag			m_memTag;
 	};
 
 	typedef std::vector<SubMesh*>	SubMeshes;
@@ -60,7 +93,13 @@ namespace Neo
 		SubMesh*	GetSubMesh(uint32 i);
 		uint32		GetSubMeshCount() const;
 
-		void		Render(Material* pMaterial = nullptr);
+		// Generate LODs for all sub meshes
+		void		GenerateLods(uint32 nLod, float reduction = 0.5f);
+		uint32		GetLodCount() const;
+		// Largest error of all sub meshes at given LOD
+		float		GetLodError(uint32 lod) const;
+
+		void		Render(Material* pMaterial = nullptr, uint32 lod = 0);
 
 	private:
 		SubMeshes	m_submeshes;
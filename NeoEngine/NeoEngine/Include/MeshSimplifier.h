@@ -0,0 +1,106 @@
+/********************************************************************
+	created:	18:10:2014   10:12
+	filename	MeshSimplifier.h
+	author:		maval
+
+	purpose:	Quadric error metric mesh simplifier used to build LOD index buffers.
+				Uses half-edge collapse (a vertex collapses onto one of its neighbours)
+				so that every LOD keeps referencing the original vertex buffer.
+*********************************************************************/
+#ifndef MeshSimplifier_h__
+#define MeshSimplifier_h__
+
+#include "Prerequiestity.h"
+#include "MathDef.h"
+
+namespace Neo
+{
+	class MeshSimplifier
+	{
+	public:
+		/**	Vertex attributes are read through strides, so both SVertex and STreeLeafVertex
+			buffers can be fed directly. pNormal/pUV may be null to ignore that attribute.
+		*/
+		MeshSimplifier(const VEC3* pPos, const VEC3* pNormal, const VEC2* pUV, uint32 stride,
+			uint32 nVert, const DWORD* pIdx, uint32 nIdx);
+
+	public:
+		// Penalty weights of attribute discontinuity, scaled by squared edge length
+		void		SetAttributeWeights(float normalWeight, float uvWeight);
+		/**	Collapse edges until no more than targetIndexCount indices remain or no legal
+			collapse is left. Successive calls continue from the current state, so LODs
+			built in sequence are nested and their errors never decrease.
+		*/
+		void		Simplify(uint32 targetIndexCount);
+		// Indices of remaining triangles, in their original order
+		void		GetIndices(std::vector<DWORD>& outIndices) const;
+		uint32		GetIndexCount() const	{ return m_nLiveTri * 3; }
+		// Object space error: square root of the largest collapse cost applied so far
+		float		GetError() const;
+
+	private:
+		struct SQuadric
+		{
+			SQuadric() { memset(m, 0, sizeof(m)); }
+
+			void	AddPlane(double a, double b, double c, double d);
+			void	Add(const SQuadric& rhs);
+			double	Evaluate(const VEC3& p) const;
+
+			double	m[10];		// Upper triangle of symmetric 4x4 matrix
+		};
+
+		struct SCollapse
+		{
+			double	cost;
+			uint32	from, to;	// Raw vertex indices
+			uint32	stamp;
+
+			// Make std::priority_queue a min heap, ties broken by index for determinism
+			bool operator < (const SCollapse& rhs) const
+			{
+				if(cost != rhs.cost) return cost > rhs.cost;
+				if(from != rhs.from) return from > rhs.from;
+				return to > rhs.to;
+			}
+		};
+
+		const VEC3&	_Pos(uint32 i) const;
+		const VEC3*	_Normal(uint32 i) const;
+		const VEC2*	_UV(uint32 i) const;
+
+		void		_WeldPositions();
+		void		_LockBorders();
+		void		_ComputeQuadrics();
+		// Find cheapest legal collapse of vertex v, return false if none
+		bool		_FindBestCollapse(uint32 v, SCollapse& out) const;
+		double		_CollapseCost(uint32 v, uint32 u) const;
+		bool		_IsCollapseLegal(uint32 v, uint32 u) const;
+		void		_ApplyCollapse(uint32 v, uint32 u);
+		void		_GatherNeighbours(uint32 v, std::vector<uint32>& out) const;
+		void		_PushCandidate(uint32 v);
+
+	private:
+		const uint8*	m_pPos;
+		const uint8*	m_pNormal;
+		const uint8*	m_pUV;
+		uint32			m_stride;
+		uint32			m_nVert;
+
+		std::vector<DWORD>		m_tris;			// 3 raw indices per triangle
+		std::vector<bool>		m_triLive;
+		uint32					m_nLiveTri;
+		std::vector<uint32>		m_canon;		// Raw index -> first vertex with identical position
+		std::vector<bool>		m_locked;		// By canonical index
+		std::vector<std::vector<uint32>>	m_vertTris;		// Canonical index -> adjacent triangles
+		std::vector<SQuadric>	m_quadrics;		// By canonical index
+		std::vector<uint32>		m_stamps;
+
+		std::priority_queue<SCollapse>	m_heap;
+		double			m_maxCost;
+		float			m_normalWeight;
+		float			m_uvWeight;
+	};
+}
+
+#endif // MeshSimplifier_h__
@@ -0,0 +1,28 @@
+/********************************************************************
+	created:	20:10:2014   10:12
+	filename	ParallelFor.h
+	author:		maval
+
+	purpose:	Minimal parallel for over an index range. Win32 threads on
+				Windows, pthreads elsewhere so offline tools build on Linux too.
+				Doesn't use the precompiled header.
+*********************************************************************/
+#ifndef ParallelFor_h__
+#define ParallelFor_h__
+
+#include <functional>
+
+namespace Neo
+{
+	// Number of logical processors
+	unsigned int	GetHardwareThreadCount();
+
+	/**	Call func(i) for every i in [0, count) and block until all done.
+		Indices are handed out one at a time, so uneven work balances itself.
+		Threads are created per call, use it for coarse grained work only.
+		@param numThreads 0 means GetHardwareThreadCount()
+	*/
+	void			ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func, unsigned int numThreads = 0);
+}
+
+#endif // ParallelFor_h__
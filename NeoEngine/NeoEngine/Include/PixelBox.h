@@ -10,6 +10,7 @@
 
 #include "Prerequiestity.h"
 #include "Color.h"
+#include "TextureCooker.h"
 
 namespace Neo
 {
@@ -29,6 +30,8 @@ namespace Neo
 		int		GetBytesPerPixel() const	{ return m_bytesPerPixel; }
 		void	SetPixelAt(int x, int y, SColor p);
 		SColor	GetPixelAt(int x, int y) const;
+		// Build mips, block compress and write as DDS
+		bool	SaveAsDDS(const STRING& filename, const SCookOptions& options = SCookOptions()) const;
 
 	private:
 		char*		m_data;
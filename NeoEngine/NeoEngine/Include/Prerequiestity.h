@@ -34,7 +34,8 @@ enum eTextureUsage
 	eTextureUsage_DomainShader	= 1 << 3,		// Bind to domain shader
 	eTextureUsage_HullShader	= 1 << 4,		// Bind to hull shader
 	eTextureUsage_RecreateOnWndResized = 1 << 5,
-	eTextureUsage_Depth			= 1 << 6
+	eTextureUsage_Depth			= 1 << 6,
+	eTextureUsage_Streamed		= 1 << 7		// DDS only, mips resident on demand
 };
 
 enum eEntity
@@ -46,7 +47,9 @@ enum eEntity
 enum eVertexType
 {
 	eVertexType_General,		// SVertex
-	eVertexType_TreeLeaf		// Svertex_TreeLeaf
+	eVertexType_TreeLeaf,		// Svertex_TreeLeaf
+	eVertexType_Text,			// STextVertex
+	eVertexType_Grass			// SGrassVertex, SGrassInstance per instance in slot 1
 };
 
 // Use for render target to control which part to render
@@ -65,6 +68,15 @@ enum eRenderPhase
 	eRenderPhase_All = eRenderPhase_Geometry | eRenderPhase_UI | eRenderPhase_SSAO
 };
 
+// Passes that select mesh LOD independently
+enum eLodPass
+{
+	eLodPass_Main,
+	eLodPass_Shadow,
+	eLodPass_Reflection,
+	eLodPass_Count
+};
+
 enum eRenderQueue
 {
 	eRenderQueue_Entity		=	0,
@@ -157,11 +169,14 @@ namespace Neo
 	struct	SDirectionLight;
 	class	VertexData;
 	class	Material;
+	class	MaterialInstance;
 	class	D3D11Texture;
+	class	TextureManager;
 	class	D3D11RenderTarget;
 	class	Terrain;
 	class	Water;
 	class	Sky;
+	class	Grass;
 	class	Scene;
 	class	SceneManager;
 	class	Font;
@@ -172,6 +187,16 @@ namespace Neo
 	class	Entity;
 	class	SubMesh;
 	class	Mesh;
+	class	DDSLoader;
+	class	TextureStreamer;
+	class	TextureAtlas;
+	struct	SAtlasEntry;
+	class	CameraPath;
+	class	Benchmark;
+	class	ShaderCache;
+	class	D3D11ShaderCompiler;
+	class	ShaderLibrary;
+	class	ShaderProgram;
 }
 
 
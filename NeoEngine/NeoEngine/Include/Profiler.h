@@ -0,0 +1,205 @@
+/********************************************************************
+	created:	23:10:2014   10:05
+	filename	Profiler.h
+	author:		maval
+
+	purpose:	CPU profiler. Nested scopes are timed with QueryPerformanceCounter
+				and written to a per-thread ring buffer without locking, the main
+				thread drains all of them in EndFrame(). Also keeps per-frame
+				render counters, a smoothed summary for the screen and can capture
+				frames to a Chrome trace (chrome://tracing).
+				Define USE_PROFILER 0 to compile it out, when compiled in but
+				disabled a scope costs one branch.
+*********************************************************************/
+#ifndef Profiler_h__
+#define Profiler_h__
+
+#include "Prerequiestity.h"
+
+#ifndef USE_PROFILER
+	#define USE_PROFILER	1
+#endif
+
+namespace Neo
+{
+	enum eProfileCounter
+	{
+		eProfileCounter_DrawCall,
+		eProfileCounter_Triangle,
+		eProfileCounter_StateChange,		// Render states and shader bindings
+		eProfileCounter_CBufferBytes,
+		eProfileCounter_TextureBind,
+		eProfileCounter_MaterialUpload,		// Material cbuffers uploaded, 0 when nothing changed
+		eProfileCounter_Max
+	};
+
+	//------------------------------------------------------------------------------------
+	class Profiler
+	{
+	public:
+		// Scope names must be string literals, only the pointer is kept
+		struct SEvent
+		{
+			const char*		name;
+			__int64			start, end;		// QPC ticks
+			uint32			depth;
+		};
+
+		struct SScopeStat
+		{
+			const char*		name;
+			uint32			depth;
+			float			avgMs;			// Smoothed over frames
+			float			lastMs;			// Last frame
+			uint32			calls;			// Last frame
+		};
+
+		// Counters and time of a render pass, inclusive of nested passes
+		struct SPassStat
+		{
+			const char*		name;
+			float			ms;
+			uint32			calls;
+			uint32			counters[eProfileCounter_Max];
+		};
+
+	public:
+		static void		SetEnabled(bool bEnable);
+		static bool		IsEnabled()								{ return s_bEnabled; }
+
+		static __int64	GetTicks();
+		static double	TicksToMs(__int64 ticks);
+
+		// Called by ScopedProfile
+		static void		BeginScope();
+		static void		EndScope(const char* name, __int64 start);
+		// Render thread only
+		static void		AddCounter(eProfileCounter counter, uint32 value)	{ s_counters[counter] += value; }
+		static const uint32*	GetCounters()						{ return s_counters; }
+		// Called by ScopedPass, adds counters since countersAtBegin to the pass
+		static void		EndPass(const char* name, const uint32* countersAtBegin, __int64 start);
+
+		// Call once per frame on the main thread
+		static void		BeginFrame();
+		static void		EndFrame();
+
+		static uint32	GetLastCounter(eProfileCounter counter)	{ return s_lastCounters[counter]; }
+		static float	GetLastFrameMs()						{ return s_lastFrameMs; }
+		// Main thread scopes in first-seen order, for the on-screen summary
+		static const std::vector<SScopeStat>&	GetScopeStats()	{ return s_scopeStats; }
+		// Passes of last frame in first-seen order
+		static const std::vector<SPassStat>&	GetPassStats()	{ return s_lastPasses; }
+		// A few lines of text ready for DrawText
+		static void		GetSummary(StringVector& lines, uint32 maxScopes = 8);
+
+		/**	Record the next frames and write them as Chrome trace json once done.
+			Enables the profiler while capturing.
+		*/
+		static void		BeginCapture(uint32 frames, const STRING& filename);
+		static bool		IsCapturing()							{ return s_captureFrames > 0; }
+		static const char*	GetCounterName(eProfileCounter counter);
+
+		// Per-thread event ring, defined in Profiler.cpp
+		struct SThreadBuffer;
+
+	private:
+		struct SCapturedEvent
+		{
+			SEvent			evt;
+			uint32			threadId;
+		};
+		struct SCapturedFrame
+		{
+			__int64			start, end;
+			uint32			counters[eProfileCounter_Max];
+		};
+
+		static SThreadBuffer*	_GetThreadBuffer();
+		static void		_Drain(SThreadBuffer* pBuffer, bool bMainThread);
+		static void		_AddScopeStat(const SEvent& evt);
+		static bool		_WriteTrace();
+
+		static bool						s_bEnabled;
+		static uint32					s_counters[eProfileCounter_Max];
+		static uint32					s_lastCounters[eProfileCounter_Max];
+		static float					s_lastFrameMs;
+		static __int64					s_frameStart;
+		static std::vector<SScopeStat>	s_scopeStats;
+		static std::vector<SPassStat>	s_passes;
+		static std::vector<SPassStat>	s_lastPasses;
+
+		static uint32					s_captureFrames;
+		static STRING					s_captureFile;
+		static std::vector<SCapturedEvent>	s_capturedEvents;
+		static std::vector<SCapturedFrame>	s_capturedFrames;
+	};
+
+	//------------------------------------------------------------------------------------
+	class ScopedProfile
+	{
+	public:
+		ScopedProfile(const char* name)
+		:m_name(nullptr)
+		{
+			if (Profiler::IsEnabled())
+			{
+				m_name = name;
+				Profiler::BeginScope();
+				m_start = Profiler::GetTicks();
+			}
+		}
+
+		~ScopedProfile()
+		{
+			if(m_name)
+				Profiler::EndScope(m_name, m_start);
+		}
+
+	private:
+		const char*		m_name;
+		__int64			m_start;
+	};
+
+	//------------------------------------------------------------------------------------
+	class ScopedPass
+	{
+	public:
+		ScopedPass(const char* name)
+		:m_scope(name)
+		,m_name(nullptr)
+		{
+			if (Profiler::IsEnabled())
+			{
+				m_name = name;
+				memcpy(m_counters, Profiler::GetCounters(), sizeof(m_counters));
+				m_start = Profiler::GetTicks();
+			}
+		}
+
+		~ScopedPass()
+		{
+			if(m_name)
+				Profiler::EndPass(m_name, m_counters, m_start);
+		}
+
+	private:
+		ScopedProfile	m_scope;
+		const char*		m_name;
+		__int64			m_start;
+		uint32			m_counters[eProfileCounter_Max];
+	};
+}
+
+#if USE_PROFILER
+	#define PROFILE_CONCAT_(a, b)			a##b
+	#define PROFILE_CONCAT(a, b)			PROFILE_CONCAT_(a, b)
+	#define PROFILE_SCOPE(name)				Neo::ScopedProfile PROFILE_CONCAT(_profileScope, __LINE__)(name)
+	#define PROFILE_PASS(name)				Neo::ScopedPass PROFILE_CONCAT(_profilePass, __LINE__)(name)
+	#define PROFILE_COUNTER(counter, value)	Neo::Profiler::AddCounter(counter, value)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_PASS(name)
+	#define PROFILE_COUNTER(counter, value)
+#endif
+
+#endif // Profiler_h__
@@ -20,7 +20,7 @@ namespace Neo
 		typedef std::vector<Entity*>	EntityList;
 
 	public:
-		Scene(StrategyFunc& setupFunc, StrategyFunc& enterFunc);
+		Scene(const STRING& name, StrategyFunc& setupFunc, StrategyFunc& enterFunc);
 		~Scene();
 
 	public:
@@ -28,6 +28,7 @@ namespace Neo
 		void	Update();
 		void	Render();
 
+		const STRING&		GetName() const	{ return m_name; }
 		void				AddEntity(Entity* pEntity);
 		EntityList&			GetEntityList() { return m_lstEntity; }
 
@@ -36,6 +37,7 @@ namespace Neo
 		const AABB&			GetSceneShadowReceiverAABB() const { return m_sceneShadowReceiverAABB; }
 
 	private:
+		STRING			m_name;
 		StrategyFunc	m_setupFunc;
 		StrategyFunc	m_enterFunc;
 		bool			m_bSetup;
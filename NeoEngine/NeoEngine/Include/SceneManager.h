@@ -10,6 +10,7 @@
 
 #include "Prerequiestity.h"
 #include "Material.h"
+#include "Handle.h"
 
 namespace Neo
 {
@@ -26,26 +27,42 @@ namespace Neo
 		void		RenderPipline(uint32 phaseFlag = eRenderPhase_All, Material* pMaterial = nullptr);
 
 		void		ToggleScene();
+		/**	Enter a test scene by name, e.g. "Vegetation". Scenes not in the
+			toggle list are created on demand. False if no such scene.
+		*/
+		bool		EnterScene(const STRING& name);
 		Camera*		GetCamera()	{ return m_camera; }
 		Scene*		GetCurScene() { return m_pCurScene; }
 		void		ClearScene();
 
 		// Create entity from loaded mesh
 		Entity*		CreateEntity(eEntity type, const STRING& meshname);
+		// Load mesh once by name, the scene manager owns it
+		MeshHandle	LoadMesh(const STRING& meshname);
+		Mesh*		GetMesh(MeshHandle hMesh) const	{ return m_meshPool.Resolve(hMesh); }
 
 		void		SetRenderFlag(uint32 flag) { m_renderFlag = flag; }
 		uint32		GetRenderFlag() const	{ return m_renderFlag; }
+		// Pass being rendered, entities pick their LOD by it
+		eLodPass	GetLodPass() const		{ return m_lodPass; }
 
 		void		SetupSunLight(const VEC3& dir, const SColor& color);
 		void		CreateSky();
 		void		CreateTerrain();
 		void		CreateWater(float waterHeight = 0.0f);
+		// Over the terrain, create it first
+		void		CreateGrass();
 
 		const SDirectionLight& GetSunLight() const { return m_sunLight; }
 		SSAO*		GetSSAO()		{ return m_pSSAO; }
 		Terrain*	GetTerrain()	{ return m_pTerrain; }
+		Grass*		GetGrass()		{ return m_pGrass; }
 		ShadowMap*	GetShadowMap()	{ return m_pShadowMap; }
 		void		EnableDebugRT(eDebugRT type);
+		// Memory per tag and what the last scene switch changed
+		void		ShowMemoryStats(bool bShow)	{ m_bShowMemory = bShow; }
+		bool		IsShowMemoryStats() const	{ return m_bShowMemory; }
+		const StringVector&	GetSceneMemoryDiff() const	{ return m_sceneMemDiff; }
 
 		// Convenient mesh create function
 		static Mesh*	CreatePlaneMesh(float w, float h);
@@ -54,15 +71,20 @@ namespace Neo
 
 	private:
 		void		_InitAllScene();	
+		Scene*		_CreateTestScene(const STRING& name);
+		void		_EnterScene(uint32 index);
 
 		std::vector<Scene*>		m_scenes;	
 		Scene*					m_pCurScene;
+		uint32					m_curSceneIndex;
 
 		D3D11RenderSystem* m_pRenderSystem;
 		uint32			m_renderFlag;	// Render phase control flag
+		eLodPass		m_lodPass;
 		Camera*			m_camera;
 		SDirectionLight	m_sunLight;
 		Terrain*		m_pTerrain;
+		Grass*			m_pGrass;
 		Water*			m_pWater;
 		Sky*			m_pSky;
 		ShadowMap*		m_pShadowMap;
@@ -70,13 +92,17 @@ namespace Neo
 		
 
 		MeshLoader*		m_pMeshLoader;
-		typedef std::unordered_map<STRING, Mesh*>	MeshContainer;
+		typedef std::unordered_map<STRING, MeshHandle>	MeshContainer;
 		MeshContainer	m_meshes;
+		HandlePool<Mesh>	m_meshPool;
 
 		
 		eDebugRT		m_debugRT;
 		Mesh*			m_pDebugRTMesh;
 		Material*		m_pDebugRTMaterial;
+
+		bool			m_bShowMemory;
+		StringVector	m_sceneMemDiff;
 	};
 }
 
@@ -0,0 +1,121 @@
+/********************************************************************
+	created:	26:10:2014   10:20
+	filename	ShaderCache.h
+	author:		maval
+
+	purpose:	Shader bytecode cache. Entries are keyed by a hash of the source
+				text, every file it includes, the macros, entry point, profile
+				and compile flags, so an edit anywhere invalidates exactly the
+				entries it affects. Looked up in memory first, then in a disk
+				directory that persists across runs, and compiled only when
+				both miss. Every shader obtained is written to a manifest, Precompile
+				builds the missing ones of it on worker threads at startup.
+				The compiler is an interface, so the cache itself doesn't
+				depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef ShaderCache_h__
+#define ShaderCache_h__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <set>
+
+namespace Neo
+{
+	typedef std::vector<char>	ShaderBytecode;
+
+	struct SShaderMacro
+	{
+		SShaderMacro() {}
+		SShaderMacro(const std::string& _name, const std::string& _value):name(_name),value(_value) {}
+
+		std::string		name;
+		std::string		value;
+	};
+
+	struct SShaderCompileDesc
+	{
+		SShaderCompileDesc():flags(0) {}
+
+		std::string					filename;
+		std::string					entryPoint;
+		std::string					profile;		// e.g. "vs_4_0"
+		std::vector<SShaderMacro>	macros;
+		unsigned int				flags;			// Passed to the compiler as is
+	};
+
+	// Does the actual work, D3DX for the engine or a stub in tests
+	class IShaderCompiler
+	{
+	public:
+		virtual ~IShaderCompiler() {}
+
+		// Text of a source or include file, false if it can't be read
+		virtual bool	LoadSource(const std::string& filename, std::string& text) = 0;
+		// Called from worker threads during Precompile
+		virtual bool	Compile(const SShaderCompileDesc& desc, ShaderBytecode& code, std::string& errors) = 0;
+	};
+
+	//------------------------------------------------------------------------------------
+	class ShaderCache
+	{
+	public:
+		struct SStats
+		{
+			SStats():memoryHits(0),diskHits(0),compiles(0),failures(0) {}
+
+			unsigned int	memoryHits;
+			unsigned int	diskHits;
+			unsigned int	compiles;
+			unsigned int	failures;
+		};
+
+		/**	@param cacheDir Where entries and the manifest are stored, created if missing.
+				Empty keeps the cache in memory only.
+		*/
+		ShaderCache(IShaderCompiler* pCompiler, const std::string& cacheDir);
+		~ShaderCache();
+
+	public:
+		// Cached bytecode of desc, compiled if needed. Errors are only set on failure.
+		bool			GetBytecode(const SShaderCompileDesc& desc, ShaderBytecode& code, std::string& errors);
+
+		/**	Compile every entry of descs that is neither in memory nor on disk,
+			spread over numThreads workers (0 means all cores). Returns the number
+			of failed entries.
+		*/
+		unsigned int	Precompile(const std::vector<SShaderCompileDesc>& descs, unsigned int numThreads = 0);
+		// Precompile what the manifest recorded in earlier runs
+		unsigned int	PrecompileManifest(unsigned int numThreads = 0);
+
+		// Hash of source, includes and compile parameters, 0 if the source can't be read
+		unsigned long long	ComputeKey(const SShaderCompileDesc& desc);
+
+		const SStats&	GetStats() const				{ return m_stats; }
+		void			ClearMemory()					{ m_entries.clear(); }
+
+		static bool		SaveManifest(const std::string& filename, const std::vector<SShaderCompileDesc>& descs);
+		static bool		LoadManifest(const std::string& filename, std::vector<SShaderCompileDesc>& descs);
+
+	private:
+		// Hash filename's text and, recursively, files it #include's. False if filename can't be read.
+		bool			_HashSource(const std::string& filename, unsigned long long& hash, std::vector<std::string>& visited);
+		std::string		_GetEntryPath(unsigned long long key) const;
+		bool			_ReadEntry(unsigned long long key, ShaderBytecode& code) const;
+		void			_WriteEntry(unsigned long long key, const ShaderBytecode& code) const;
+		// Append desc to the manifest the first time it succeeds
+		void			_Record(const SShaderCompileDesc& desc);
+		static std::string	_ToManifestLine(const SShaderCompileDesc& desc);
+
+		typedef std::unordered_map<unsigned long long, ShaderBytecode>	EntryMap;
+
+		IShaderCompiler*				m_pCompiler;
+		std::string						m_cacheDir;
+		EntryMap						m_entries;
+		std::set<std::string>			m_manifestLines;	// Recorded so far, this run and earlier ones
+		SStats							m_stats;
+	};
+}
+
+#endif // ShaderCache_h__
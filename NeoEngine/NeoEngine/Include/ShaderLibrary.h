@@ -0,0 +1,92 @@
+/********************************************************************
+	created:	27:10:2014   14:10
+	filename	ShaderLibrary.h
+	author:		maval
+
+	purpose:	Registry of shader permutations. A permutation is the set of
+				D3D objects built from one (shader files, flag mask, vertex
+				type, macros) combination: VS, PS, clip plane VS and input
+				layout, or HS and DS for tessellation. Materials asking for
+				the same combination share one ref counted ShaderProgram
+				instead of each creating its own, and the program id lets
+				draws be sorted so materials using the same shaders end up
+				next to each other.
+*********************************************************************/
+#ifndef ShaderLibrary_h__
+#define ShaderLibrary_h__
+
+#include "Prerequiestity.h"
+#include "IRefCount.h"
+#include "ShaderCache.h"
+
+namespace Neo
+{
+	class ShaderProgram : public IRefCount
+	{
+		friend class ShaderLibrary;
+	public:
+		ShaderProgram(uint32 id);
+		~ShaderProgram();
+
+	public:
+		// Dense, starting from 1. Same id means same shader objects, use it in sort keys.
+		uint32					GetId() const				{ return m_id; }
+
+		ID3D11VertexShader*		GetVertexShader() const		{ return m_pVertexShader; }
+		ID3D11PixelShader*		GetPixelShader() const		{ return m_pPixelShader; }
+		// Null unless compiled with eShaderFlag_EnableClipPlane
+		ID3D11VertexShader*		GetClipPlaneVS() const		{ return m_pVS_WithClipPlane; }
+		ID3D11InputLayout*		GetInputLayout() const		{ return m_pInputLayout; }
+		ID3D11HullShader*		GetHullShader() const		{ return m_pHullShader; }
+		ID3D11DomainShader*		GetDomainShader() const		{ return m_pDomainShader; }
+
+	private:
+		uint32						m_id;
+		ID3D11VertexShader*			m_pVertexShader;
+		ID3D11PixelShader*			m_pPixelShader;
+		ID3D11VertexShader*			m_pVS_WithClipPlane;
+		ID3D11InputLayout*			m_pInputLayout;
+		ID3D11HullShader*			m_pHullShader;
+		ID3D11DomainShader*			m_pDomainShader;
+		ShaderBytecode				m_vsCode;				// Input layout is validated against it
+	};
+
+	//------------------------------------------------------------------------------------
+	class ShaderLibrary
+	{
+	public:
+		ShaderLibrary(D3D11RenderSystem* pRenderSystem);
+		~ShaderLibrary();
+
+	public:
+		/**	VS/PS program for the combination, created on the first request.
+			@param macros Null terminated, the flag dependent ones included.
+			@return AddRef'ed for the caller, null if compiling failed.
+		*/
+		ShaderProgram*	GetProgram(const STRING& vsFileName, const STRING& psFileName, uint32 shaderFlag,
+			eVertexType vertType, const D3D_SHADER_MACRO* macros);
+		// HS/DS program, same rules
+		ShaderProgram*	GetTessellationProgram(const STRING& filename, uint32 shaderFlag, const D3D_SHADER_MACRO* macros);
+
+		// Programs handed out, and how many distinct ones that took
+		uint32			GetRequestCount() const		{ return m_numRequests; }
+		uint32			GetUniqueCount() const		{ return (uint32)m_programs.size(); }
+
+	private:
+		static STRING	_MakeKey(const STRING& files, uint32 shaderFlag, eVertexType vertType, const D3D_SHADER_MACRO* macros);
+		bool			_Compile(const STRING& filename, const char* szEntryPoint, const char* szShaderModel,
+			const D3D_SHADER_MACRO* macros, ShaderBytecode& code);
+		bool			_CreateProgram(ShaderProgram* pProgram, const STRING& vsFileName, const STRING& psFileName,
+			uint32 shaderFlag, eVertexType vertType, const D3D_SHADER_MACRO* macros);
+		bool			_CreateTessellationProgram(ShaderProgram* pProgram, const STRING& filename, const D3D_SHADER_MACRO* macros);
+		bool			_CreateVertexLayout(ShaderProgram* pProgram, eVertexType vertType);
+
+		typedef std::unordered_map<STRING, ShaderProgram*>	ProgramMap;
+
+		D3D11RenderSystem*		m_pRenderSystem;
+		ProgramMap				m_programs;			// Owns one reference of each
+		uint32					m_numRequests;
+	};
+}
+
+#endif // ShaderLibrary_h__
@@ -12,9 +12,47 @@
 #include "Prerequiestity.h"
 #include "MathDef.h"
 #include "AABB.h"
+#include "MemoryTracker.h"
+#include "TerrainHeightField.h"
+#include "TerrainQuadTree.h"
+#include "TerrainDensityMap.h"
+#include "TerrainCompositeMap.h"
+#include "TerrainTileStreamer.h"
 
 namespace Neo
 {
+	typedef std::vector<float, TaggedAllocator<float, eMemTag_Terrain>>	TerrainHeights;
+
+	enum eTerrainBrushShape
+	{
+		eTerrainBrushShape_Circle,
+		eTerrainBrushShape_Square
+	};
+
+	enum eTerrainBrushOp
+	{
+		eTerrainBrushOp_Raise,
+		eTerrainBrushOp_Lower,
+		eTerrainBrushOp_Smooth,		// Towards the 3x3 average
+		eTerrainBrushOp_Flatten		// Towards flattenHeight
+	};
+
+	struct STerrainBrush
+	{
+		STerrainBrush()
+		:shape(eTerrainBrushShape_Circle),op(eTerrainBrushOp_Raise),centerX(0),centerZ(0)
+		,radius(10),falloff(0.5f),strength(10),flattenHeight(0) {}
+
+		eTerrainBrushShape	shape;
+		eTerrainBrushOp		op;
+		float				centerX, centerZ;	// World space
+		float				radius;				// Half the side for squares
+		float				falloff;			// Outer fraction of radius fading to zero, [0, 1]
+		// Height per second for raise and lower, blend rate per second for smooth and flatten
+		float				strength;
+		float				flattenHeight;
+	};
+
 	class Terrain
 	{
 	public:
@@ -22,29 +60,82 @@ namespace Neo
 		~Terrain();
 
 	public:
+		// Once per frame, streams the open tile set around the camera
+		void		Update();
 		void		Render(Material* pMaterial = nullptr);
 		Material*	GetShadowMaterial() { return m_pShadowMaterial; }
 		const AABB&	GetTerrainAABB() const { return m_terrainAABB; }
 
+		/**	Serve GetHeightAt from a tile set made by TerrainTileConverter where its tiles
+			are resident, the height map answers everywhere else. False if it can't be opened.
+		*/
+		bool		OpenTileSet(const STRING& filename, const STerrainStreamSettings& settings = STerrainStreamSettings());
+		void		CloseTileSet()	{ m_tileStreamer.Close(); }
+		const TerrainTileStreamer&	GetTileStreamer() const { return m_tileStreamer; }
+
+		// CPU side queries in world space. Exact ones follow the two triangles of each cell,
+		// except over resident tiles, which are always bilinear.
+		float		GetHeightAt(float x, float z, bool bExact = false) const;
+		VEC3		GetNormalAt(float x, float z, bool bExact = false) const;
+		// dir needn't be normalized, maxDist is in units of it
+		bool		RayIntersect(const VEC3& origin, const VEC3& dir, VEC3& hitPos, float maxDist = FLT_MAX) const;
+		const TerrainHeightField&	GetHeightField() const { return m_heightField; }
+		// Per sample curvature and its per patch max, mean and percentile
+		const TerrainDensityMap&	GetDensityMap() const { return m_densityMap; }
+
+		/**	Deform the height map under the brush for dt seconds. CPU queries see the
+			change at once, the GPU copy and patch bounds are refreshed by the next
+			Render, only over the region edited since the last one.
+		*/
+		void		ApplyBrush(const STerrainBrush& brush, float dt);
+
+		// Beyond this distance pixels sample the baked composite map instead of splatting layers
+		void		SetCompositeMapDist(float fDist) { m_cBuffer.compositeMapDist = fDist; }
+		float		GetCompositeMapDist() const { return m_cBuffer.compositeMapDist; }
+		/**	Overwrite a region of the blend map, RGBA8. The region and its mips go to
+			the GPU at once, the first edit swaps the streamed blend map for a default
+			usage copy of the CPU one. The next Render re-bakes and uploads only the
+			composite tiles it reaches.
+		*/
+		void		UpdateBlendMap(const uint8* pRGBA, uint32 x, uint32 y, uint32 width, uint32 height, uint32 pitch);
+		// CPU copy of the blend map, RGBA8 tightly packed, uv runs along world x and z. NULL if it failed to load
+		const uint8*	GetBlendMapData(uint32& width, uint32& height) const;
+
 	private:
 		// Init height map
 		void		_InitHeightMap(const STRING& filename, uint32 width, uint32 height);
-		// Init the mesh which is the least tessellated level
-		void		_InitMesh();
+		// Dynamic buffer the selected nodes are written to as quad patches
+		void		_InitNodeBuffer();
+		void		_InitQuadTree();
+		// Pick the nodes to draw for the current pass and fill the node buffer
+		void		_SelectNodes(Camera* pCam, const PLANE* frustumPlane);
 		// Init material
 		void		_InitMaterial();
 		// Init constant buffer
 		void		_InitConstantBuf();
+		// Bake the composite map from CPU copies of the layers and blend map
+		void		_InitCompositeMap();
+		// Re-bake and upload dirty composite tiles
+		void		_UpdateCompositeMap();
+		// Replace the streamed blend map with one UpdateBlendMap can write to
+		void		_InitEditableBlendMap();
 
-		void		_SmoothHeightMap(std::vector<float>& vecData);
+		// 3x3 box filter, scratch is the ping-pong buffer so repeated passes don't allocate
+		void		_SmoothHeightMap(TerrainHeights& vecData, TerrainHeights& scratch);
 
-		// Patch y-bounds for GPU frustum culling
+		// Patch y-bounds for the quadtree and GPU frustum culling
 		void		_CalcAllPatchBoundY();
 		void		_CalcPatchBoundY(uint32 i, uint32 j);
-		// Create density map from height map
+		// CPU ray casts and height queries
+		void		_InitHeightField();
+		// Curvature of the height map, drives the tessellation of flat patches down
 		void		_CreateDensityMap();
 		// Compute ans store aabb of terrain
 		void		_CalcAABB();
+		// Request layer, normal and blend map mips for the nearest visible patch
+		void		_RequestTextureMips(const PLANE* frustumPlane);
+		// Upload heights and patch bounds of the region edited since last time
+		void		_FlushEdits();
 
 		__declspec(align(16))
 		struct cBufferTerrain
@@ -65,20 +156,32 @@ namespace Neo
 
 			VEC2	invTexSize;
 			float	terrainCellSpace;
+			float	compositeMapDist;
 		};
 
 		D3D11RenderSystem*	m_pRenderSystem;
-		Mesh*				m_pMesh;
-		Entity*				m_pEntity;
+		Material*			m_pMaterial;
+		TerrainQuadTree		m_quadTree;
+		std::vector<STerrainNode>	m_visibleNodes;		// Of the last pass
+		ID3D11Buffer*		m_pNodeVB;
+		uint32				m_maxNodes;
 		AABB				m_terrainAABB;
 		D3D11Texture*		m_pHeightMap;
 		D3D11Texture*		m_pLayerTexArray;
 		D3D11Texture*		m_pBlendMap;
-		D3D11Texture*		m_pDensityMap;
+		D3D11Texture*		m_pCompositeMap;
+		TerrainCompositeMap	m_compositeBaker;
+		bool				m_bBlendMapEditable;
 		cBufferTerrain		m_cBuffer;
 		ID3D11Buffer*		m_pCB;
-		std::vector<float>	m_heightData;
+		TerrainHeights		m_heightData;
 		std::vector<VEC2>	m_patchBoundY;
+		TerrainHeightField	m_heightField;		// Min/max pyramid over m_heightData
+		TerrainDensityMap	m_densityMap;		// Over m_heightData too
+		TerrainTileStreamer	m_tileStreamer;
+		TerrainHeights		m_brushScratch;		// Smooth brush input
+		// Samples edited since the last flush, inclusive. Empty when m_dirtyRow0 > m_dirtyRow1.
+		uint32				m_dirtyRow0, m_dirtyCol0, m_dirtyRow1, m_dirtyCol1;
 		Material*			m_pShadowMaterial;
 	};
 }
@@ -0,0 +1,119 @@
+/********************************************************************
+	created:	31:10:2014   11:15
+	filename	TerrainCompositeMap.h
+	author:		maval
+
+	purpose:	CPU baker of the terrain composite map, the layer textures
+				already blended by the blend map into one colour map that
+				distant patches sample instead of splatting. Every texel
+				samples each layer trilinearly at the mip its footprint
+				would get on the GPU, then blends them like Terrain.hlsl.
+				The map is split into tiles that carry their own mips, so
+				a blend map edit only re-bakes and re-uploads the tiles it
+				reaches. Mips coarser than one texel per tile are rebuilt
+				from the whole map after each bake. Tiles are baked with
+				SSE on worker threads. The blend map keeps a mip chain too,
+				so the GPU copy of an edited region can be refreshed.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef TerrainCompositeMap_h__
+#define TerrainCompositeMap_h__
+
+#include <vector>
+
+namespace Neo
+{
+	class TerrainCompositeMap
+	{
+	public:
+		// Same as the layer texture array of Terrain.hlsl
+		static const unsigned int	MAX_LAYERS	=	5;
+
+	public:
+		TerrainCompositeMap();
+
+	public:
+		/**	@param size Texels per side, a multiple of tileSize
+			@param tileSize Power of 2, tiles carry mips down to 1x1 so there are
+			log2(tileSize) + 1 of them. The map as a whole has log2(size) + 1 when
+			size / tileSize is a power of 2 too.
+			@param layerTexScale Times the layer textures repeat across the terrain
+		*/
+		void			Init(unsigned int size, unsigned int tileSize, float layerTexScale);
+
+		/**	Images are RGBA8, rows along +v. They are copied, so the source
+			can go away after the call. Marks all tiles dirty.
+		*/
+		void			SetLayer(unsigned int layer, const unsigned char* pRGBA, unsigned int width, unsigned int height, unsigned int pitch);
+		// r, g, b, a weight layers 1 to 4 over what is below, like the terrain shader
+		void			SetBlendMap(const unsigned char* pRGBA, unsigned int width, unsigned int height, unsigned int pitch);
+		/**	Overwrite blend map texels [x, x + width) x [y, y + height), refresh the
+			blend map mips over them and mark the tiles they reach dirty
+		*/
+		void			UpdateBlendMap(const unsigned char* pRGBA, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned int pitch);
+		void			MarkAllDirty();
+
+		// Bake all dirty tiles, bakedTiles receives their indices
+		void			Bake(std::vector<unsigned int>& bakedTiles);
+		bool			HasDirtyTiles() const				{ return m_numDirty > 0; }
+
+		unsigned int	GetSize() const						{ return m_size; }
+		unsigned int	GetTileSize() const					{ return m_tileSize; }
+		unsigned int	GetTilesPerSide() const				{ return m_tilesPerSide; }
+		// Mips of a tile
+		unsigned int	GetMipCount() const					{ return m_mipCount; }
+		// Mips of the whole map, the ones past GetMipCount() are coarser than a tile
+		unsigned int	GetMapMipCount() const				{ return m_mipCount + (unsigned int)m_coarseMips.size(); }
+		// RGBA8 texels of a mip of a tile, tightly packed, (tileSize >> mip) per side
+		const unsigned char*	GetTileData(unsigned int tile, unsigned int mip) const;
+		// RGBA8 texels of a whole map mip past the tile ones, tightly packed, (size >> mip) per side
+		const unsigned char*	GetCoarseMipData(unsigned int mip) const;
+
+		// Blend map mips down to 1x1, 0 until a blend map is set
+		unsigned int	GetBlendMipCount() const			{ return (unsigned int)m_blendMap.size(); }
+		// RGBA8 texels of a blend map mip, tightly packed
+		const unsigned char*	GetBlendMipData(unsigned int mip, unsigned int& width, unsigned int& height) const;
+
+	private:
+		struct SImage
+		{
+			SImage():width(0),height(0) {}
+
+			unsigned int				width, height;
+			std::vector<unsigned char>	texels;
+		};
+
+		// Mip chain, [0] is the source
+		typedef std::vector<SImage>	MipChain;
+
+		struct SLayerSampler
+		{
+			const SImage*	pMip0;
+			const SImage*	pMip1;
+			float			mipBlend;		// Weight of pMip1
+			float			uvScale;		// Composite uv to layer uv
+		};
+
+		void			_BakeTile(unsigned int tile, const SLayerSampler* pLayers, unsigned int numLayers);
+		// Gather the last mip of every tile and halve it down to 1x1
+		void			_BuildCoarseMips();
+		// Blend map mips over mip 0 texels [x0, x1) x [y0, y1)
+		void			_BuildBlendMips(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1);
+		void			_MarkTilesDirty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1);
+
+		unsigned int		m_size;
+		unsigned int		m_tileSize;
+		unsigned int		m_tilesPerSide;
+		unsigned int		m_mipCount;
+		float				m_layerTexScale;
+		MipChain			m_layers[MAX_LAYERS];
+		unsigned int		m_numLayers;
+		MipChain			m_blendMap;
+		std::vector<std::vector<unsigned char>>	m_tiles;	// All mips of a tile, finest first
+		std::vector<SImage>	m_coarseMips;		// Whole map mips past the tile ones, finest first
+		std::vector<bool>	m_dirty;
+		unsigned int		m_numDirty;
+	};
+}
+
+#endif // TerrainCompositeMap_h__
@@ -0,0 +1,68 @@
+/********************************************************************
+	created:	30:10:2014   14:20
+	filename	TerrainDensityMap.h
+	author:		maval
+
+	purpose:	Per sample roughness of a terrain height map. The density
+				of a sample is the largest absolute principal curvature of
+				the height function there, the larger eigenvalue of its
+				Hessian from central differences. A flat grid of spacing s
+				strays at most about density * s^2 / 4 from the surface, so
+				it tells how fine a patch has to be tessellated.
+				Samples are computed 4 at a time with SSE over worker
+				threads, then reduced per patch to max, mean and percentile.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef TerrainDensityMap_h__
+#define TerrainDensityMap_h__
+
+#include <vector>
+
+namespace Neo
+{
+	class TerrainDensityMap
+	{
+	public:
+		TerrainDensityMap();
+
+	public:
+		/**	Compute densities of the whole map. Keeps the pointer like TerrainHeightField,
+			call UpdateRegion after changing heights in place.
+			@param size Samples per side, cellsPerPatch * n + 1
+			@param percentile Of the per patch percentile stat, in [0, 1]
+		*/
+		void			Build(const float* pHeights, unsigned int size, float cellSpace, unsigned int cellsPerPatch, float percentile = 0.9f);
+		/**	Recompute samples [row0, row1] x [col0, col1], inclusive, and the patches they
+			belong to. The density of a sample depends on its 8 neighbours, widen the
+			region by one sample around the heights edited.
+		*/
+		void			UpdateRegion(unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+
+		float			GetDensity(unsigned int row, unsigned int col) const	{ return m_density[row * m_size + col]; }
+		const float*	GetDensityData() const			{ return m_density.empty() ? nullptr : &m_density[0]; }
+
+		// Per patch stats, row major with rows along +z. Patches share their edge samples.
+		unsigned int	GetPatchesPerSide() const		{ return m_patchesPerSide; }
+		const float*	GetPatchMax() const				{ return m_patchMax.empty() ? nullptr : &m_patchMax[0]; }
+		const float*	GetPatchMean() const			{ return m_patchMean.empty() ? nullptr : &m_patchMean[0]; }
+		// Ignores the few spiky samples the max would pick up
+		const float*	GetPatchPercentile() const		{ return m_patchPercentile.empty() ? nullptr : &m_patchPercentile[0]; }
+
+	private:
+		void			_ComputeRows(unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+		void			_ReducePatches(unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+
+		const float*		m_pHeights;
+		unsigned int		m_size;
+		unsigned int		m_cellsPerPatch;
+		unsigned int		m_patchesPerSide;
+		float				m_invCellSpaceSq;
+		float				m_percentile;
+		std::vector<float>	m_density;
+		std::vector<float>	m_patchMax;
+		std::vector<float>	m_patchMean;
+		std::vector<float>	m_patchPercentile;
+	};
+}
+
+#endif // TerrainDensityMap_h__
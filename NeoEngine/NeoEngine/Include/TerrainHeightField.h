@@ -0,0 +1,96 @@
+/********************************************************************
+	created:	28:10:2014   16:05
+	filename	TerrainHeightField.h
+	author:		maval
+
+	purpose:	CPU side queries on a terrain height map. A min/max height
+				pyramid over blocks of cells lets ray casts skip everything
+				the ray passes above or below, and only the leaf blocks it
+				may hit are walked cell by cell and intersected with the two
+				triangles of each cell. Also bilinear and triangle exact
+				height and normal lookups, singly or batched with SSE.
+				Cell (r, c) is split along the diagonal from sample (r, c+1)
+				to sample (r+1, c). Heights are row major with rows along +z.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef TerrainHeightField_h__
+#define TerrainHeightField_h__
+
+#include <vector>
+
+namespace Neo
+{
+	struct STerrainRayHit
+	{
+		float			t;				// Along the ray, in units of the direction passed in
+		float			pos[3];
+		float			normal[3];		// Of the hit triangle
+		unsigned int	row, col;		// Cell hit
+	};
+
+	class TerrainHeightField
+	{
+	public:
+		TerrainHeightField();
+
+	public:
+		/**	Build the pyramid over heights. Keeps the pointer, pHeights must outlive
+			the field, call UpdateRegion after changing heights in place.
+			@param size Samples per side
+			@param originX, originZ World position of sample (0, 0)
+		*/
+		void	Build(const float* pHeights, unsigned int size, float originX, float originZ, float cellSpace);
+		// Refit the pyramid over samples [row0, row1] x [col0, col1], inclusive
+		void	UpdateRegion(unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+
+		/**	First hit of origin + t * dir with t in [0, maxT], false on a miss.
+			dir needn't be normalized.
+		*/
+		bool	RayCast(const float origin[3], const float dir[3], float maxT, STerrainRayHit& hit) const;
+
+		// Positions outside the map are clamped to its border
+		float	GetHeightBilinear(float x, float z) const;
+		float	GetHeightExact(float x, float z) const;
+		void	GetNormalBilinear(float x, float z, float normal[3]) const;
+		void	GetNormalExact(float x, float z, float normal[3]) const;
+		// pXZ holds count (x, z) pairs
+		void	GetHeights(const float* pXZ, float* pHeights, unsigned int count, bool bExact) const;
+
+		// Height range of the whole map
+		float	GetMinHeight() const		{ return m_levels.empty() ? 0 : m_levels.back()[0].fMin; }
+		float	GetMaxHeight() const		{ return m_levels.empty() ? 0 : m_levels.back()[0].fMax; }
+
+	private:
+		struct SMinMax
+		{
+			float	fMin, fMax;
+		};
+
+		typedef std::vector<SMinMax>	Level;
+
+		unsigned int	_GetLevelDim(unsigned int level) const		{ return ((m_numBlocks - 1) >> level) + 1; }
+		float			_Sample(unsigned int row, unsigned int col) const	{ return m_pHeights[row * m_size + col]; }
+		// Grid coordinates of a world position, clamped, and the cell containing it
+		void			_ToCell(float x, float z, unsigned int& row, unsigned int& col, float& fx, float& fz) const;
+		void			_BuildLeaves(unsigned int blockRow0, unsigned int blockCol0, unsigned int blockRow1, unsigned int blockCol1);
+		void			_BuildParents(unsigned int level, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+		// Walk the cells of a leaf block the ray crosses in [tEnter, tExit]
+		bool			_RayCastLeaf(const float o[3], const float d[3], unsigned int blockRow, unsigned int blockCol,
+			float tEnter, float tExit, STerrainRayHit& hit) const;
+		bool			_RayCastCell(const float o[3], const float d[3], unsigned int row, unsigned int col,
+			float tMax, STerrainRayHit& hit) const;
+		void			_GetHeightsRange(const float* pXZ, float* pHeights, unsigned int count, bool bExact) const;
+
+		const float*		m_pHeights;
+		unsigned int		m_size;
+		unsigned int		m_numCells;		// Per side
+		unsigned int		m_numBlocks;	// Leaf blocks per side
+		float				m_originX;
+		float				m_originZ;
+		float				m_cellSpace;
+		float				m_invCellSpace;
+		std::vector<Level>	m_levels;		// [0] is the leaf blocks, back() a single node
+	};
+}
+
+#endif // TerrainHeightField_h__
@@ -0,0 +1,111 @@
+/********************************************************************
+	created:	29:10:2014   10:30
+	filename	TerrainQuadTree.h
+	author:		maval
+
+	purpose:	CDLOD style quadtree over terrain patches. Every node keeps
+				the Y range of its patches. Per view, nodes outside the
+				frustum are dropped and each remaining area gets the
+				coarsest LOD whose grid spacing stays under a pixel error
+				on screen. LOD L covers distances up to range L, which
+				doubles per level, and the outer part of that band morphs
+				towards the grid of LOD L+1 so neighbours of different LODs
+				meet without cracks or popping. The output is a compact list
+				of nodes with their tessellation factor and morph band.
+				With a per patch roughness, nodes flat enough for a coarser
+				grid to stay within a height error on screen get a lower
+				inner tessellation than their LOD. Edges always keep the
+				LOD's tessellation so they match neighbours of the same LOD.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef TerrainQuadTree_h__
+#define TerrainQuadTree_h__
+
+#include <vector>
+
+namespace Neo
+{
+	struct STerrainNode
+	{
+		float			x, z;			// World min corner
+		float			size;			// World side
+		float			minY, maxY;
+		unsigned int	lod;			// 0 is the finest
+		float			tessFactor;		// Inner grid quads per side, even
+		float			edgeTessFactor;	// Quads along each edge, the same for all nodes of a LOD
+		float			morphStart;		// Distance where morphing to lod + 1 starts
+		float			morphScale;		// 1 / morph band width, 0 for the coarsest lod
+	};
+
+	struct STerrainView
+	{
+		STerrainView():pPlanes(nullptr),numPlanes(0),pixelsPerUnit(1),maxPixelError(8),maxHeightError(0) {}
+
+		float			camPos[3];
+		const float*	pPlanes;		// (nx, ny, nz, d) each, inside when >= 0. Null culls nothing.
+		unsigned int	numPlanes;
+		float			pixelsPerUnit;	// Pixels one world unit covers at distance 1
+		float			maxPixelError;	// Grid spacing allowed on screen, in pixels
+		float			maxHeightError;	// Pixels a coarser grid may stray from the surface, 0 never lowers tessellation
+	};
+
+	class TerrainQuadTree
+	{
+	public:
+		TerrainQuadTree();
+
+	public:
+		/**	@param patchesPerSide Leaf nodes per side, power of 2
+			@param originX, originZ World min corner of the terrain
+			@param patchSize World side of a leaf
+			@param leafTess Tessellation of a leaf at full detail, power of 2 in [4, 64]
+			@param pPatchBoundY (min, max) per patch, row major with rows along +z
+		*/
+		void			Build(unsigned int patchesPerSide, float originX, float originZ, float patchSize,
+			unsigned int leafTess, const float* pPatchBoundY);
+		// Refit nodes over patches [row0, row1] x [col0, col1] after their bounds changed
+		void			UpdateBounds(const float* pPatchBoundY, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+		/**	Set roughness of patches [row0, row1] x [col0, col1], 0 until then.
+			@param pPatchRoughness One per patch, the largest second derivative of the
+			heights (see TerrainDensityMap), a grid of spacing s strays roughness * s^2 / 4
+		*/
+		void			UpdateRoughness(const float* pPatchRoughness, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+
+		// Replace nodes with what to draw for the view, near to far
+		void			Select(const STerrainView& view, std::vector<STerrainNode>& nodes) const;
+
+		unsigned int	GetLevelCount() const		{ return (unsigned int)m_levels.size(); }
+
+	private:
+		struct SBound
+		{
+			float	minY, maxY;
+			float	roughness;
+		};
+
+		struct SSelectContext
+		{
+			const STerrainView*			pView;
+			std::vector<STerrainNode>*	pNodes;
+			float						ranges[32];		// Per level
+		};
+
+		typedef std::vector<SBound>	Level;
+
+		unsigned int	_GetLevelDim(unsigned int level) const		{ return m_patchesPerSide >> level; }
+		void			_RefitParents(unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1);
+		// False if the node is beyond the range of its level, the parent covers it then
+		bool			_Select(SSelectContext& ctx, unsigned int level, unsigned int row, unsigned int col) const;
+		void			_AddNode(SSelectContext& ctx, unsigned int level, unsigned int row, unsigned int col, unsigned int lod) const;
+		void			_GetBox(unsigned int level, unsigned int row, unsigned int col, float vMin[3], float vMax[3]) const;
+
+		unsigned int		m_patchesPerSide;
+		float				m_originX;
+		float				m_originZ;
+		float				m_patchSize;
+		unsigned int		m_leafTess;
+		std::vector<Level>	m_levels;		// [0] is the patches, back() the root
+	};
+}
+
+#endif // TerrainQuadTree_h__
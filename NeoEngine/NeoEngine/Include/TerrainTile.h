@@ -0,0 +1,100 @@
+/********************************************************************
+	created:	1:11:2014   10:20
+	filename	TerrainTile.h
+	author:		maval
+
+	purpose:	Paged terrain storage. A tile set file holds a grid of
+				square tiles, each tileCells + 1 samples per side so
+				neighbours share their edge samples, with mips that keep
+				every 2^mip-th sample. Heights are quantized to 16 bits
+				over the range of the whole set, so shared samples decode
+				to the same value in every tile, then coded as zigzag
+				varints of the gradient predictor residual. A table up
+				front gives offset, size and y-bounds of every tile mip,
+				so a single mip can be read on its own.
+				Doesn't depend on D3D or the precompiled header, tiles are
+				built offline by Tools/TerrainTileConverter.
+*********************************************************************/
+#ifndef TerrainTile_h__
+#define TerrainTile_h__
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+namespace Neo
+{
+	struct STerrainTileSetDesc
+	{
+		STerrainTileSetDesc():tilesX(0),tilesZ(0),tileCells(0),mipCount(0),cellSpace(1)
+			,originX(0),originZ(0),minY(0),maxY(0) {}
+
+		unsigned int	tilesX, tilesZ;
+		unsigned int	tileCells;		// Per side at mip 0, power of 2
+		unsigned int	mipCount;
+		float			cellSpace;		// At mip 0
+		float			originX;		// World position of sample (0, 0) of tile (0, 0)
+		float			originZ;
+		float			minY, maxY;		// Of the whole set, also the quantization range
+
+		unsigned int	GetSamples(unsigned int mip) const		{ return (tileCells >> mip) + 1; }
+		float			GetTileSize() const						{ return tileCells * cellSpace; }
+	};
+
+	// Table entry of one mip of one tile
+	struct STerrainTileMip
+	{
+		unsigned int	offset;			// From the start of the file
+		unsigned int	size;
+		float			minY, maxY;
+	};
+
+	struct STerrainTileData
+	{
+		unsigned int		tileX, tileZ;
+		unsigned int		mip;
+		unsigned int		samples;	// Per side
+		float				minY, maxY;
+		std::vector<float>	heights;	// Row major with rows along +z
+	};
+
+	namespace TerrainTileCodec
+	{
+		// Quantize samples x samples heights over [minY, maxY] and append the code to out
+		void	Encode(const float* pHeights, unsigned int samples, float minY, float maxY, std::vector<unsigned char>& out);
+		// False if the code is truncated or doesn't fill the tile
+		bool	Decode(const unsigned char* pData, unsigned int size, unsigned int samples, float minY, float maxY, float* pHeights);
+	}
+
+	/**	Cut a height map into a tile set file.
+		@param width, height Samples, the map is extended with its border samples to whole tiles
+		@param tileCells Power of 2, mipCount is at most log2(tileCells) + 1
+	*/
+	bool	BuildTerrainTileSet(const std::string& filename, const float* pHeights, unsigned int width, unsigned int height,
+		float cellSpace, unsigned int tileCells, unsigned int mipCount);
+
+	class TerrainTileFile
+	{
+	public:
+		TerrainTileFile();
+
+	public:
+		bool	Open(const std::string& filename);
+		void	Close();
+		bool	IsOpen() const			{ return m_file.is_open(); }
+
+		const STerrainTileSetDesc&	GetDesc() const		{ return m_desc; }
+		const STerrainTileMip&		GetMipEntry(unsigned int tileX, unsigned int tileZ, unsigned int mip) const;
+
+		// Read and decode one mip of a tile. Not thread safe, use one file per thread.
+		bool	ReadTile(unsigned int tileX, unsigned int tileZ, unsigned int mip, STerrainTileData& tile);
+
+	private:
+		std::ifstream					m_file;
+		STerrainTileSetDesc				m_desc;
+		std::vector<STerrainTileMip>	m_table;
+		std::vector<unsigned char>		m_readBuf;
+	};
+}
+
+#endif // TerrainTile_h__
@@ -0,0 +1,108 @@
+/********************************************************************
+	created:	1:11:2014   15:40
+	filename	TerrainTileStreamer.h
+	author:		maval
+
+	purpose:	Keeps the tiles of a terrain tile set around the camera
+				resident. Each frame Update picks the mip every tile in
+				range should have from its distance, and hands the missing
+				ones to a background thread, tiles with nothing resident
+				first, then nearest first. Loaded tiles are installed on
+				the calling thread. Tiles out of range stay cached until
+				the memory budget is exceeded, then the least recently
+				wanted ones go first. Where a tile meets a coarser
+				neighbour, its edge samples between the neighbour's are
+				moved onto the neighbour's edge so there are no cracks.
+				Doesn't depend on D3D or the precompiled header.
+*********************************************************************/
+#ifndef TerrainTileStreamer_h__
+#define TerrainTileStreamer_h__
+
+#include "TerrainTile.h"
+
+namespace Neo
+{
+	enum eTerrainTileEdge
+	{
+		eTerrainTileEdge_MinZ,		// Row 0
+		eTerrainTileEdge_MaxX,		// Last column
+		eTerrainTileEdge_MaxZ,		// Last row
+		eTerrainTileEdge_MinX,		// Column 0
+		eTerrainTileEdge_Count
+	};
+
+	struct STerrainResidentTile
+	{
+		STerrainTileData	data;			// Heights stitched to coarser neighbours
+		unsigned int		lastWanted;		// Frame the tile was last in range
+		unsigned int		bytes;
+		// Mip each edge was stitched against, ~0 when the neighbour wasn't resident
+		unsigned int		stitchMip[eTerrainTileEdge_Count];
+		std::vector<float>	edges[eTerrainTileEdge_Count];	// As decoded
+	};
+
+	struct STerrainStreamSettings
+	{
+		STerrainStreamSettings():lodDistance(200),loadRadius(1500),budgetBytes(64 * 1024 * 1024) {}
+
+		float			lodDistance;	// Mip 0 up to this distance, every doubling drops a mip
+		float			loadRadius;		// Tiles closer than this are wanted
+		unsigned int	budgetBytes;	// Resident tiles beyond it are evicted if not wanted
+	};
+
+	class TerrainTileStreamer
+	{
+	public:
+		TerrainTileStreamer();
+		~TerrainTileStreamer();
+
+	public:
+		// Opens the tile set and starts the loading thread
+		bool			Open(const std::string& filename, const STerrainStreamSettings& settings);
+		// Stops the loading thread and drops all tiles
+		void			Close();
+
+		// Once per frame
+		void			Update(float camX, float camZ);
+		// Update until everything wanted around the camera is resident, for loading screens
+		void			Flush(float camX, float camZ);
+
+		const STerrainTileSetDesc&		GetDesc() const		{ return m_desc; }
+		const STerrainStreamSettings&	GetSettings() const	{ return m_settings; }
+		void			SetSettings(const STerrainStreamSettings& settings)	{ m_settings = settings; }
+
+		// Null when nothing of the tile is resident
+		const STerrainResidentTile*		GetTile(unsigned int tileX, unsigned int tileZ) const;
+		// Bilinear over the resident mip, false if the tile isn't resident
+		bool			GetHeightAt(float x, float z, float& height) const;
+		// Mip a tile at this distance from the camera should have
+		unsigned int	CalcWantedMip(float distance) const;
+
+		unsigned int	GetResidentBytes() const	{ return m_residentBytes; }
+		unsigned int	GetResidentCount() const	{ return m_residentCount; }
+		// Loads not installed yet, queued, running or waiting for the next Update
+		unsigned int	GetPendingCount() const		{ return m_pendingCount; }
+
+	private:
+		struct SWorker;
+
+		float			_DistanceToTile(float camX, float camZ, unsigned int tileX, unsigned int tileZ) const;
+		void			_Install(STerrainTileData* pData);
+		void			_Evict(unsigned int index);
+		void			_Stitch(unsigned int tileX, unsigned int tileZ);
+		void			_EvictOverBudget();
+
+		SWorker*							m_pWorker;
+		STerrainTileSetDesc					m_desc;
+		STerrainStreamSettings				m_settings;
+		std::vector<STerrainResidentTile*>	m_tiles;		// Per tile, null if not resident
+		std::vector<unsigned int>			m_wantedMip;	// Per tile, of the last Update
+		std::vector<bool>					m_failed;		// Tiles that failed to load aren't asked for again
+		unsigned int						m_frame;
+		unsigned int						m_residentBytes;
+		unsigned int						m_residentCount;
+		unsigned int						m_pendingCount;
+	};
+}
+
+#endif // TerrainTileStreamer_h__
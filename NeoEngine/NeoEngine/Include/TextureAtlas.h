@@ -0,0 +1,47 @@
+/********************************************************************
+	created:	22:10:2014   14:05
+	filename	TextureAtlas.h
+	author:		maval
+
+	purpose:	Small textures packed into one GPU texture (see TexturePacker),
+				so draws using any of them share a single binding. Images that
+				don't fit one page go to further slices of a texture array.
+*********************************************************************/
+#ifndef TextureAtlas_h__
+#define TextureAtlas_h__
+
+#include "Prerequiestity.h"
+#include "TexturePacker.h"
+
+namespace Neo
+{
+	class TextureAtlas
+	{
+	public:
+		/**	@param bArray Create a texture array with a slice per page,
+			otherwise everything must fit in one page and a plain 2D texture is made.
+		*/
+		TextureAtlas(const SPackOptions& options, bool bArray);
+		~TextureAtlas();
+
+	public:
+		// Any format D3DX reads, call before Build()
+		bool			AddImage(const STRING& filename);
+		bool			AddImage(const STRING& name, const void* pRGBA, uint32 width, uint32 height, uint32 pitch);
+		bool			Build();
+
+		D3D11Texture*	GetTexture() const		{ return m_pTexture; }
+		// UV remap of an image, nullptr if it isn't in the atlas
+		const SAtlasEntry*	GetEntry(const STRING& name) const;
+
+	private:
+		typedef std::unordered_map<STRING, uint32>	EntryMap;
+
+		TexturePacker	m_packer;
+		EntryMap		m_entries;
+		D3D11Texture*	m_pTexture;
+		bool			m_bArray;
+	};
+}
+
+#endif // TextureAtlas_h__
@@ -0,0 +1,107 @@
+/********************************************************************
+	created:	20:10:2014   10:40
+	filename	TextureCooker.h
+	author:		maval
+
+	purpose:	Offline texture cooker. Builds the mip chain on CPU (SSE, in
+				linear space for sRGB data), block compresses it to BC1/BC3/
+				BC4/BC5 on all cores and writes a DDS that DDSLoader reads.
+				Doesn't depend on D3D or the precompiled header, so it also
+				builds for tools running on Linux build servers.
+*********************************************************************/
+#ifndef TextureCooker_h__
+#define TextureCooker_h__
+
+#include <string>
+#include <vector>
+
+namespace Neo
+{
+	enum eCookFormat
+	{
+		eCookFormat_RGBA8,		// Uncompressed, DXGI_FORMAT_R8G8B8A8_UNORM
+		eCookFormat_BC1,		// RGB, 1 bit alpha if bAlphaCutout
+		eCookFormat_BC3,		// RGBA
+		eCookFormat_BC4,		// R, height maps and masks
+		eCookFormat_BC5			// RG, tangent space normal maps
+	};
+
+	enum eCookQuality
+	{
+		eCookQuality_Fast,		// Bounding box endpoints
+		eCookQuality_Normal,	// Principal axis endpoints, one refinement
+		eCookQuality_High		// Iterative refinement and endpoint search
+	};
+
+	enum eMipFilter
+	{
+		eMipFilter_Box,
+		eMipFilter_Kaiser
+	};
+
+	struct SCookOptions
+	{
+		SCookOptions()
+			:format(eCookFormat_BC1),quality(eCookQuality_Normal),mipFilter(eMipFilter_Kaiser)
+			,bSRGB(true),bGenMips(true),bAlphaCutout(false),numThreads(0) {}
+
+		eCookFormat		format;
+		eCookQuality	quality;
+		eMipFilter		mipFilter;
+		bool			bSRGB;			// Color data, filter RGB in linear space. Ignored by BC4/BC5, which hold data
+		bool			bGenMips;
+		bool			bAlphaCutout;	// BC1 only: alpha < 128 becomes transparent
+		unsigned int	numThreads;		// 0 means all cores
+	};
+
+	// RGBA float image, linear space
+	struct SFloatImage
+	{
+		SFloatImage():width(0),height(0) {}
+
+		unsigned int		width, height;
+		std::vector<float>	pixels;
+
+		void	Resize(unsigned int w, unsigned int h) { width = w; height = h; pixels.resize(w * h * 4); }
+	};
+
+	class TextureCooker
+	{
+	public:
+		TextureCooker(const SCookOptions& options);
+
+	public:
+		/**	Set source image. Byte order is the one PixelBox uses: BGR or BGRA,
+			1 byte per pixel is luminance.
+		*/
+		bool			SetSource(const void* pData, unsigned int width, unsigned int height, unsigned int pitch, unsigned int bytesPerPixel);
+		// Generate mips and encode, results are in GetMipData()
+		void			Cook();
+		bool			SaveDDS(const std::string& filename) const;
+
+		unsigned int	GetMipCount() const					{ return m_mipData.size(); }
+		const std::vector<unsigned char>&	GetMipData(unsigned int mip) const	{ return m_mipData[mip]; }
+
+		// Next mip level, dst size is half of src clamped to 1
+		static void		GenerateMip(const SFloatImage& src, SFloatImage& dst, eMipFilter filter);
+		/**	Encode one 4x4 block, input is 16 RGBA texels in row order.
+			@param bThreeColor Allow BC1 3 color + transparent mode for alpha < 128
+		*/
+		static void		EncodeBC1Block(const unsigned char* pRGBA, unsigned char* pOut, eCookQuality quality, bool bThreeColor);
+		// Single channel block, 16 values
+		static void		EncodeBC4Block(const unsigned char* pValues, unsigned char* pOut, eCookQuality quality);
+		// Bytes per 4x4 block, 0 for uncompressed
+		static unsigned int	GetBlockBytes(eCookFormat format);
+
+	private:
+		void			_Encode(const SFloatImage& image, std::vector<unsigned char>& out) const;
+		void			_Quantize(const SFloatImage& image, std::vector<unsigned char>& out) const;
+
+		SCookOptions	m_options;
+		SFloatImage		m_source;
+		std::vector<std::vector<unsigned char>>	m_mipData;
+		std::vector<std::pair<unsigned int, unsigned int>>	m_mipSize;
+	};
+}
+
+#endif // TextureCooker_h__
@@ -0,0 +1,90 @@
+/********************************************************************
+	created:	18:10:2014   15:36
+	filename	TextureManager.h
+	author:		maval
+
+	purpose:	Texture resource cache. Textures loaded from file are shared by
+				normalized path and creation parameters, unreferenced ones are
+				evicted in LRU order when over memory budget. Textures loaded
+				with eTextureUsage_Streamed are handed to the TextureStreamer.
+*********************************************************************/
+#ifndef TextureManager_h__
+#define TextureManager_h__
+
+#include "Prerequiestity.h"
+#include "TextureStreamer.h"
+#include "Handle.h"
+
+namespace Neo
+{
+	class TextureManager
+	{
+	public:
+		TextureManager();
+		~TextureManager();
+
+	public:
+		/**	Get texture from cache or load it.
+			NB: The returned texture is owned by the manager, AddRef it if you keep it
+			(Material::SetTexture does that for you).
+		*/
+		D3D11Texture*	Load(const STRING& filename, eTextureType type = eTextureType_2D, uint32 usage = 0);
+		// Load texture array, all elements are a single cache entry
+		D3D11Texture*	LoadArray(const StringVector& vecTexNames, uint32 usage = 0);
+
+		/**	Same as Load, but the handle stays safe to hold after eviction and
+			to pass to other threads, it just resolves to null once evicted.
+			Doesn't add a reference, use AddRef/Release on the texture for that.
+		*/
+		TextureHandle	LoadHandle(const STRING& filename, eTextureType type = eTextureType_2D, uint32 usage = 0);
+		TextureHandle	LoadArrayHandle(const StringVector& vecTexNames, uint32 usage = 0);
+		D3D11Texture*	GetTexture(TextureHandle hTexture) const	{ return m_texturePool.Resolve(hTexture); }
+
+		// Estimated GPU memory budget in bytes, 0 means no limit
+		void			SetBudget(uint32 bytes);
+		uint32			GetBudget() const			{ return m_budget; }
+		uint32			GetUsedBytes() const		{ return m_usedBytes; }
+		uint32			GetTextureCount() const		{ return m_texturePool.GetCount(); }
+		// Evict unreferenced textures until memory usage fits the budget
+		void			EvictToBudget();
+		// Evict all unreferenced textures regardless of budget
+		void			EvictUnused();
+
+		// Report the mip wanted this frame, does nothing for non-streamed textures
+		void			RequestMip(D3D11Texture* pTexture, float mip)	{ m_streamer.RequestMip(pTexture, mip); }
+		// Apply streaming decisions, call once per frame after all requests
+		void			UpdateStreaming();
+		TextureStreamer&	GetStreamer()				{ return m_streamer; }
+
+		// Lower case, unified separator, "." and ".." resolved
+		static STRING	NormalizePath(const STRING& filename);
+
+	private:
+		struct STextureEntry
+		{
+			TextureHandle	handle;
+			D3D11Texture*	pTexture;
+			uint32			bytes;
+			uint32			lastUse;
+		};
+
+		typedef std::unordered_map<STRING, STextureEntry>	TextureMap;
+
+		STRING			_MakeKey(const STRING& name, eTextureType type, uint32 usage) const;
+		TextureHandle	_Touch(TextureMap::iterator iter);
+		TextureHandle	_Add(const STRING& key, D3D11Texture* pTexture);
+		// Evict LRU unreferenced textures until used bytes not exceed targetBytes
+		void			_Evict(uint32 targetBytes);
+
+		TextureMap		m_textures;
+		// Holds the manager's reference of each cached texture
+		HandlePool<D3D11Texture, HandleRelease>	m_texturePool;
+		uint32			m_budget;
+		uint32			m_usedBytes;
+		uint32			m_useCounter;
+		TextureStreamer	m_streamer;
+		MipChangeVector	m_mipChanges;
+	};
+}
+
+#endif // TextureManager_h__
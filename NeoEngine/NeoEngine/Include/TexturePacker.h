@@ -0,0 +1,115 @@
+/********************************************************************
+	created:	22:10:2014   11:20
+	filename	TexturePacker.h
+	author:		maval
+
+	purpose:	Packs small RGBA8 images into atlas pages with a skyline
+				packer. Each image gets an extruded border and an aligned cell
+				so the first few mips don't bleed into neighbours. Pages are
+				meant to become one texture or the slices of a texture array,
+				the remap table tells where every image went.
+				No D3D or precompiled header, tools can use it too.
+*********************************************************************/
+#ifndef TexturePacker_h__
+#define TexturePacker_h__
+
+#include <cstddef>
+#include <vector>
+
+namespace Neo
+{
+	struct SPackOptions
+	{
+		SPackOptions()
+			:pageWidth(1024),pageHeight(1024),padding(2),alignment(4),maxPages(8) {}
+
+		unsigned int	pageWidth, pageHeight;	// Multiple of alignment
+		unsigned int	padding;				// Border texels around each image, filled with its edge
+		unsigned int	alignment;				// Power of 2, cells start and end on it
+		unsigned int	maxPages;
+	};
+
+	// Where an image ended up, uv' = uv * uvScale + uvOffset
+	struct SAtlasEntry
+	{
+		unsigned int	page;					// Texture array slice
+		unsigned int	x, y, width, height;		// Texels in page, without the border
+		float			uvOffset[2];
+		float			uvScale[2];
+
+		void	RemapUV(float& u, float& v) const
+		{
+			u = u * uvScale[0] + uvOffset[0];
+			v = v * uvScale[1] + uvOffset[1];
+		}
+	};
+
+	// Bottom-left skyline bin for a single page
+	class SkylinePacker
+	{
+	public:
+		SkylinePacker(unsigned int width, unsigned int height);
+
+	public:
+		// Find the position keeping the skyline lowest, false if it doesn't fit
+		bool			Insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y);
+		unsigned int	GetUsedArea() const		{ return m_usedArea; }
+
+	private:
+		struct SNode
+		{
+			unsigned int	x, y, width;
+		};
+
+		bool			_Fit(size_t index, unsigned int width, unsigned int height, unsigned int& y) const;
+		void			_AddLevel(size_t index, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+		std::vector<SNode>	m_skyline;
+		unsigned int		m_width, m_height;
+		unsigned int		m_usedArea;
+	};
+
+	class TexturePacker
+	{
+	public:
+		TexturePacker(const SPackOptions& options);
+
+	public:
+		// Image is copied. Returns its index in the remap table.
+		unsigned int		AddImage(const void* pRGBA, unsigned int width, unsigned int height, unsigned int pitch);
+		// Place all images and fill pages, false if they need more than maxPages
+		bool				Pack();
+
+		unsigned int		GetImageCount() const					{ return m_images.size(); }
+		unsigned int		GetPageCount() const					{ return m_pages.size(); }
+		// RGBA8, pitch is pageWidth * 4
+		const std::vector<unsigned char>&	GetPageData(unsigned int page) const	{ return m_pages[page]; }
+		const SAtlasEntry&	GetEntry(unsigned int image) const		{ return m_entries[image]; }
+		const SPackOptions&	GetOptions() const						{ return m_options; }
+
+		// Mips whose bilinear footprint stays inside each cell, including mip 0
+		unsigned int		GetSafeMipCount() const;
+		/**	Box filtered mip chain of a page, mips[0] is the page itself.
+			Page size should be power of 2 for exact 2x2 footprints.
+		*/
+		void				BuildPageMips(unsigned int page, unsigned int mipCount, std::vector<std::vector<unsigned char>>& mips) const;
+
+	private:
+		struct SImage
+		{
+			std::vector<unsigned char>	pixels;
+			unsigned int				width, height;
+		};
+
+		unsigned int		_AlignUp(unsigned int v) const	{ return (v + m_options.alignment - 1) & ~(m_options.alignment - 1); }
+		// Copy image into its cell and extrude the edges over the rest of the cell
+		void				_Blit(const SImage& image, unsigned int cellX, unsigned int cellY, std::vector<unsigned char>& page) const;
+
+		SPackOptions				m_options;
+		std::vector<SImage>			m_images;
+		std::vector<SAtlasEntry>	m_entries;
+		std::vector<std::vector<unsigned char>>	m_pages;
+	};
+}
+
+#endif // TexturePacker_h__
@@ -0,0 +1,102 @@
+/********************************************************************
+	created:	21:10:2014   14:05
+	filename	TextureStreamer.h
+	author:		maval
+
+	purpose:	Mip residency for streamed textures. Users report the mip they
+				need each frame, Update() decides which mips stay resident under
+				the memory budget. Pure bookkeeping, applying the changes is up
+				to the caller (see TextureManager::UpdateStreaming), so it works
+				without a device.
+*********************************************************************/
+#ifndef TextureStreamer_h__
+#define TextureStreamer_h__
+
+#include "Prerequiestity.h"
+
+namespace Neo
+{
+	struct SMipChange
+	{
+		D3D11Texture*	pTexture;
+		uint32			residentMip;	// New most detailed resident mip
+	};
+
+	typedef std::vector<SMipChange>	MipChangeVector;
+
+	class TextureStreamer
+	{
+	public:
+		TextureStreamer();
+
+	public:
+		/**	Start tracking a texture, it must have been created with only its tail resident.
+			@param mipBytes Bytes of each mip level including all slices, finest first
+			@param tailMip Coarsest level it may drop to, see CalcTailMip()
+		*/
+		void		Register(D3D11Texture* pTexture, const std::vector<uint32>& mipBytes, uint32 tailMip);
+		void		Unregister(D3D11Texture* pTexture);
+		bool		IsRegistered(D3D11Texture* pTexture) const	{ return m_textures.find(pTexture) != m_textures.end(); }
+
+		// Report demand for this frame, the finest request wins. Unknown textures are ignored.
+		void		RequestMip(D3D11Texture* pTexture, float mip);
+		/**	Decide residency from this frame's requests and reset them.
+			Resident state is updated as if all changes succeed, call SetResidentMip if one fails.
+		*/
+		void		Update(MipChangeVector& changes);
+		void		SetResidentMip(D3D11Texture* pTexture, uint32 mip);
+
+		uint32		GetResidentMip(D3D11Texture* pTexture) const;
+		uint32		GetWantedMip(D3D11Texture* pTexture) const;
+		uint32		GetResidentBytes() const;
+
+		// Memory for all streamed textures. Tail mips are always resident even when over it.
+		void		SetBudget(uint32 bytes)				{ m_budget = bytes; }
+		uint32		GetBudget() const					{ return m_budget; }
+		// Limits bytes recreated per frame to avoid hitches, at least one texture is always processed
+		void		SetUploadLimit(uint32 bytes)		{ m_uploadLimit = bytes; }
+		// Frames a texture keeps its mips after the last request asking for them
+		void		SetDropDelay(uint32 frames)			{ m_dropDelay = frames; }
+
+		// First mip not larger than the tail size, which is the coarsest level a texture drops to
+		static uint32	CalcTailMip(uint32 width, uint32 height, uint32 mipCount);
+		/**	Mip giving about one texel per pixel.
+			@param texelsPerUnit Texels per world unit along the surface at mip 0
+			@param pixelsPerUnit Screen pixels per world unit at the viewing distance
+		*/
+		static float	CalcRequiredMip(float texelsPerUnit, float pixelsPerUnit);
+		// Screen pixels covered by one world unit at given distance
+		static float	CalcPixelsPerUnit(float distance, float projScaleY, uint32 screenHeight);
+
+	private:
+		struct SStreamEntry
+		{
+			D3D11Texture*		pTexture;
+			uint32				id;				// Registration order, keeps Update deterministic
+			std::vector<uint32>	mipBytes;
+			uint32				tailMip;
+			uint32				residentMip;
+			uint32				wantedMip;
+			uint32				targetMip;
+			float				requestedMip;	// Finest request this frame, FLT_MAX if none
+			uint32				lastRequestFrame;
+
+			uint32		GetBytesFrom(uint32 mip) const;
+		};
+
+		typedef std::unordered_map<D3D11Texture*, SStreamEntry>	EntryMap;
+
+		void		_UpdateWanted();
+		void		_AllocateBudget(std::vector<SStreamEntry*>& entries);
+		void		_EmitChanges(std::vector<SStreamEntry*>& entries, MipChangeVector& changes);
+
+		EntryMap	m_textures;
+		uint32		m_budget;
+		uint32		m_uploadLimit;
+		uint32		m_dropDelay;
+		uint32		m_frame;
+		uint32		m_nextId;
+	};
+}
+
+#endif // TextureStreamer_h__
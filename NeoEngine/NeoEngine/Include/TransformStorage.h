@@ -0,0 +1,77 @@
+/********************************************************************
+	created:	25:10:2014   10:05
+	filename	TransformStorage.h
+	author:		maval
+
+	purpose:	Entity transforms kept as structure of arrays. Each entity owns a
+				slot, setters only write the SRT components and set a dirty bit.
+				UpdateDirty walks the dirty bitset once per frame and composes
+				world matrices four at a time with SSE straight from the SRT,
+				the normal matrix is derived analytically instead of inverting.
+				Slots rebuilt since the owner last looked are flagged as changed,
+				so world bounds are only recomputed for what actually moved.
+*********************************************************************/
+#ifndef TransformStorage_h__
+#define TransformStorage_h__
+
+#include "Prerequiestity.h"
+#include "MathDef.h"
+
+namespace Neo
+{
+	class TransformStorage
+	{
+	public:
+		static const uint32	INVALID_SLOT = 0xffffffff;
+
+		// Identity transform, marked dirty
+		static uint32	AllocSlot();
+		static void		FreeSlot(uint32 slot);
+
+		static void		SetPosition(uint32 slot, const VEC3& pos);
+		static void		SetRotation(uint32 slot, const QUATERNION& quat);
+		static void		SetScale(uint32 slot, const VEC3& scale);
+
+		static VEC3			GetPosition(uint32 slot);
+		static QUATERNION	GetRotation(uint32 slot);
+		static VEC3			GetScale(uint32 slot);
+
+		// Rebuild all dirty slots, call once per frame before entities update
+		static void		UpdateDirty();
+		// Rebuild one slot now if dirty, for reads between UpdateDirty calls
+		static void		Flush(uint32 slot);
+
+		// Valid after Flush. References stay valid until the next AllocSlot.
+		static const MAT44&	GetWorldMatrix(uint32 slot)		{ return s_world[slot]; }
+		static const MAT44&	GetWorldITMatrix(uint32 slot)	{ return s_worldIT[slot]; }
+
+		// Was the slot rebuilt since last asked? Clears the flag.
+		static bool		ConsumeChanged(uint32 slot);
+
+		static uint32	GetSlotCount()						{ return (uint32)s_world.size(); }
+		static uint32	GetLastDirtyCount()					{ return s_lastDirtyCount; }
+
+	private:
+		static void		_Compose(const uint32* slots, uint32 count);
+		static void		_SetBit(std::vector<uint32>& bits, uint32 slot)		{ bits[slot >> 5] |= 1u << (slot & 31); }
+		static void		_ClearBit(std::vector<uint32>& bits, uint32 slot)	{ bits[slot >> 5] &= ~(1u << (slot & 31)); }
+		static bool		_TestBit(const std::vector<uint32>& bits, uint32 slot)	{ return (bits[slot >> 5] & (1u << (slot & 31))) != 0; }
+
+		// SRT, one array per component
+		static std::vector<float>	s_posX, s_posY, s_posZ;
+		static std::vector<float>	s_rotX, s_rotY, s_rotZ, s_rotW;
+		static std::vector<float>	s_scaleX, s_scaleY, s_scaleZ;
+
+		static std::vector<MAT44>	s_world;
+		static std::vector<MAT44>	s_worldIT;
+
+		// One bit per slot
+		static std::vector<uint32>	s_dirty;
+		static std::vector<uint32>	s_changed;
+
+		static std::vector<uint32>	s_freeSlots;
+		static uint32				s_lastDirtyCount;
+	};
+}
+
+#endif // TransformStorage_h__
@@ -68,6 +68,7 @@ namespace Neo
 		uint32			GetVertexStride() const;
 		const PosData&	GetPosData() const	{ return m_vecPos; }
 		uint32			GetVertCount() const { return m_nVerts; }
+		eVertexType		GetType() const { return m_type; }
 
 	private:
 		eVertexType		m_type;
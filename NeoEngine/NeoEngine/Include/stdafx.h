@@ -25,6 +25,7 @@
 #include <map>
 #include <set>
 #include <deque>
+#include <queue>
 #include <unordered_map>
 #include <algorithm>
 #include <functional>
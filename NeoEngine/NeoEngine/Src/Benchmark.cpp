@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "Benchmark.h"
+#include "SceneManager.h"
+#include "Scene.h"
+#include "D3D11RenderSystem.h"
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	Benchmark::Benchmark( const SBenchmarkDesc& desc )
+		:m_desc(desc)
+		,m_frame(0)
+	{
+		assert(desc.frames > 0 && desc.timeStep > 0);
+		memset(m_counters, 0, sizeof(m_counters));
+	}
+	//------------------------------------------------------------------------------------
+	bool Benchmark::Init()
+	{
+		if(!g_env.pSceneMgr->EnterScene(m_desc.scene))
+			return false;
+
+		if (m_desc.cameraPath.empty())
+		{
+			CameraPath::CreateOrbit(g_env.pSceneMgr->GetCurScene()->GetSceneAABB(),
+				m_desc.frames * m_desc.timeStep, 16, m_path);
+		}
+		else if (!m_path.Load(m_desc.cameraPath))
+		{
+			return false;
+		}
+
+		m_frameMs.reserve(m_desc.frames);
+
+		// Passes are only tracked while enabled
+		Profiler::SetEnabled(true);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void Benchmark::BeginFrame()
+	{
+		// Warm up frames stay at the start so streaming and caches settle
+		const uint32 simFrame = m_frame > m_desc.warmupFrames ? m_frame - m_desc.warmupFrames : 0;
+		const float time = simFrame * m_desc.timeStep;
+
+		m_path.Apply(time, g_env.pSceneMgr->GetCamera());
+		g_env.pRenderSystem->SetFixedTime(time);
+	}
+	//------------------------------------------------------------------------------------
+	void Benchmark::EndFrame()
+	{
+		if (m_frame++ < m_desc.warmupFrames)
+			return;
+
+		m_frameMs.push_back(Profiler::GetLastFrameMs());
+
+		for (int i=0; i<eProfileCounter_Max; ++i)
+			m_counters[i] += Profiler::GetLastCounter((eProfileCounter)i);
+
+		const std::vector<Profiler::SPassStat>& passes = Profiler::GetPassStats();
+		for (size_t i=0; i<passes.size(); ++i)
+		{
+			const Profiler::SPassStat& pass = passes[i];
+
+			auto iter = std::find_if(m_passes.begin(), m_passes.end(), [&](const SPassTotal& total)
+			{
+				return total.name == pass.name;
+			});
+
+			if (iter == m_passes.end())
+			{
+				SPassTotal total;
+				total.name = pass.name;
+				total.ms = 0;
+				memset(total.counters, 0, sizeof(total.counters));
+				m_passes.push_back(total);
+				iter = m_passes.end() - 1;
+			}
+
+			iter->ms += pass.ms;
+			for (int j=0; j<eProfileCounter_Max; ++j)
+				iter->counters[j] += pass.counters[j];
+		}
+	}
+	//------------------------------------------------------------------------------------
+	float Benchmark::CalcPercentile( std::vector<float>& values, float p )
+	{
+		if(values.empty())
+			return 0;
+
+		std::sort(values.begin(), values.end());
+
+		const uint32 rank = (uint32)ceilf(p * values.size());
+		return values[Clamp<uint32>(rank, 1, values.size()) - 1];
+	}
+	//------------------------------------------------------------------------------------
+	bool Benchmark::WriteReport() const
+	{
+		std::ofstream file(m_desc.output.c_str());
+		if(!file || m_frameMs.empty())
+			return false;
+
+		const double nFrames = (double)m_frameMs.size();
+		double totalMs = 0;
+		for (size_t i=0; i<m_frameMs.size(); ++i)
+			totalMs += m_frameMs[i];
+
+		std::vector<float> sorted(m_frameMs);
+		char szBuf[512];
+
+		sprintf_s(szBuf, sizeof(szBuf),
+			"{\n"
+			"\t\"scene\": \"%s\",\n"
+			"\t\"frames\": %u,\n"
+			"\t\"warmupFrames\": %u,\n"
+			"\t\"timeStep\": %f,\n"
+			"\t\"resolution\": [%u, %u],\n"
+			"\t\"cpuFrameMs\": { \"avg\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f },\n",
+			m_desc.scene.c_str(), (uint32)m_frameMs.size(), m_desc.warmupFrames, m_desc.timeStep,
+			g_env.pRenderSystem->GetWndWidth(), g_env.pRenderSystem->GetWndHeight(),
+			totalMs / nFrames,
+			CalcPercentile(sorted, 0.5f),
+			CalcPercentile(sorted, 0.95f),
+			CalcPercentile(sorted, 0.99f),
+			sorted.front(), sorted.back());
+		file << szBuf;
+
+		// Per frame averages
+		file << "\t\"counters\": {";
+		for (int i=0; i<eProfileCounter_Max; ++i)
+		{
+			sprintf_s(szBuf, sizeof(szBuf), "%s \"%s\": %.1f", i ? "," : "",
+				Profiler::GetCounterName((eProfileCounter)i), m_counters[i] / nFrames);
+			file << szBuf;
+		}
+		file << " },\n";
+
+		file << "\t\"passes\": {\n";
+		for (size_t i=0; i<m_passes.size(); ++i)
+		{
+			const SPassTotal& pass = m_passes[i];
+
+			sprintf_s(szBuf, sizeof(szBuf), "\t\t\"%s\": { \"ms\": %.4f", pass.name.c_str(), pass.ms / nFrames);
+			file << szBuf;
+
+			for (int j=0; j<eProfileCounter_Max; ++j)
+			{
+				sprintf_s(szBuf, sizeof(szBuf), ", \"%s\": %.1f",
+					Profiler::GetCounterName((eProfileCounter)j), pass.counters[j] / nFrames);
+				file << szBuf;
+			}
+
+			file << (i + 1 < m_passes.size() ? " },\n" : " }\n");
+		}
+		file << "\t}\n}\n";
+
+		return true;
+	}
+}
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "CameraPath.h"
+#include "Camera.h"
+#include "AABB.h"
+
+namespace Neo
+{
+	namespace
+	{
+		VEC3 CatmullRom(const VEC3& p0, const VEC3& p1, const VEC3& p2, const VEC3& p3, float t)
+		{
+			const float t2 = t * t, t3 = t2 * t;
+			const float w0 = -0.5f * t3 + t2 - 0.5f * t;
+			const float w1 = 1.5f * t3 - 2.5f * t2 + 1.0f;
+			const float w2 = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+			const float w3 = 0.5f * t3 - 0.5f * t2;
+
+			return VEC3(p0.x * w0 + p1.x * w1 + p2.x * w2 + p3.x * w3,
+				p0.y * w0 + p1.y * w1 + p2.y * w2 + p3.y * w3,
+				p0.z * w0 + p1.z * w1 + p2.z * w2 + p3.z * w3);
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	bool CameraPath::Load( const STRING& filename )
+	{
+		std::ifstream file(filename.c_str());
+		if(!file)
+			return false;
+
+		m_keys.clear();
+
+		STRING line;
+		while (std::getline(file, line))
+		{
+			if(line.empty() || line[0] == '#')
+				continue;
+
+			float t, px, py, pz, dx, dy, dz;
+			if(sscanf_s(line.c_str(), "%f %f %f %f %f %f %f", &t, &px, &py, &pz, &dx, &dy, &dz) != 7)
+				continue;
+
+			AddKey(t, VEC3(px, py, pz), VEC3(dx, dy, dz));
+		}
+
+		return !m_keys.empty();
+	}
+	//------------------------------------------------------------------------------------
+	bool CameraPath::Save( const STRING& filename ) const
+	{
+		std::ofstream file(filename.c_str());
+		if(!file)
+			return false;
+
+		file << "# time posX posY posZ dirX dirY dirZ\n";
+
+		char szBuf[256];
+		for (size_t i=0; i<m_keys.size(); ++i)
+		{
+			const SKey& key = m_keys[i];
+			sprintf_s(szBuf, sizeof(szBuf), "%.3f %.3f %.3f %.3f %.4f %.4f %.4f\n", key.time,
+				key.pos.x, key.pos.y, key.pos.z, key.dir.x, key.dir.y, key.dir.z);
+			file << szBuf;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void CameraPath::AddKey( float time, const VEC3& pos, const VEC3& dir )
+	{
+		assert((m_keys.empty() || time > m_keys.back().time) && "Key times must increase!");
+
+		SKey key;
+		key.time = time;
+		key.pos = pos;
+		key.dir = dir;
+		key.dir.Normalize();
+
+		m_keys.push_back(key);
+	}
+	//------------------------------------------------------------------------------------
+	void CameraPath::Evaluate( float time, VEC3& pos, VEC3& dir ) const
+	{
+		assert(!m_keys.empty());
+
+		const uint32 nKeys = m_keys.size();
+		if (nKeys == 1 || time <= m_keys[0].time)
+		{
+			pos = m_keys[0].pos;
+			dir = m_keys[0].dir;
+			return;
+		}
+		if (time >= m_keys.back().time)
+		{
+			pos = m_keys.back().pos;
+			dir = m_keys.back().dir;
+			return;
+		}
+
+		uint32 i = 0;
+		while(m_keys[i + 1].time < time)
+			++i;
+
+		const SKey& k1 = m_keys[i];
+		const SKey& k2 = m_keys[i + 1];
+		const SKey& k0 = m_keys[i > 0 ? i - 1 : i];
+		const SKey& k3 = m_keys[min(i + 2, nKeys - 1)];
+
+		const float t = (time - k1.time) / (k2.time - k1.time);
+
+		pos = CatmullRom(k0.pos, k1.pos, k2.pos, k3.pos, t);
+		dir = CatmullRom(k0.dir, k1.dir, k2.dir, k3.dir, t);
+
+		// Opposite directions would collapse
+		if(dir.IsZeroLength())
+			dir = t < 0.5f ? k1.dir : k2.dir;
+
+		dir.Normalize();
+	}
+	//------------------------------------------------------------------------------------
+	void CameraPath::Apply( float time, Camera* pCamera ) const
+	{
+		VEC3 pos, dir;
+		Evaluate(time, pos, dir);
+
+		pCamera->SetPosition(pos);
+		pCamera->SetDirection(dir);
+		pCamera->_BuildViewMatrix();
+	}
+	//------------------------------------------------------------------------------------
+	void CameraPath::CreateOrbit( const AABB& box, float duration, uint32 nKeys, CameraPath& path )
+	{
+		assert(nKeys > 1);
+
+		const VEC3 center = box.GetCenter();
+		const VEC3 size = box.GetSize();
+		const float radius = max(max(size.x, size.z) * 0.75f, 10.0f);
+		const float height = center.y + max(size.y * 0.5f, 5.0f);
+
+		path.Clear();
+		for (uint32 i=0; i<nKeys; ++i)
+		{
+			const float angle = i / (float)(nKeys - 1) * TWO_PI;
+			const VEC3 pos(center.x + radius * cosf(angle), height, center.z + radius * sinf(angle));
+			const VEC3 dir(center.x - pos.x, center.y - pos.y, center.z - pos.z);
+
+			path.AddKey(i / (float)(nKeys - 1) * duration, pos, dir);
+		}
+	}
+}
@@ -8,6 +8,11 @@
 #include "SceneManager.h"
 #include "Material.h"
 #include "ShadowMap.h"
+#include "TextureManager.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "D3D11ShaderCompiler.h"
+#include "ShaderLibrary.h"
 
 namespace Neo
 {
@@ -26,6 +31,12 @@ namespace Neo
 	,m_depthState(nullptr)
 	,m_pGlobalCBuf(nullptr)
 	,m_bClipPlaneEnabled(false)
+	,m_fixedTime(-1)
+	,m_pFont(nullptr)
+	,m_pTextureMgr(nullptr)
+	,m_pShaderCompiler(nullptr)
+	,m_pShaderCache(nullptr)
+	,m_pShaderLibrary(nullptr)
 	{
 		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
 			m_pTexture[i] = nullptr;
@@ -36,6 +47,16 @@ namespace Neo
 		if(!_InitDevice(wndWidth, wndHeight, hwnd))
 			return false;
 
+		m_pTextureMgr = new TextureManager;
+		m_pTextureMgr->SetBudget(256 * 1024 * 1024);
+
+		// Before anything creates a material. Shaders used by earlier runs are
+		// compiled up front on all cores, so materials mostly hit the cache.
+		m_pShaderCompiler = new D3D11ShaderCompiler;
+		m_pShaderCache = new ShaderCache(m_pShaderCompiler, GetResPath("ShaderCache"));
+		m_pShaderCache->PrecompileManifest();
+		m_pShaderLibrary = new ShaderLibrary(this);
+
 		m_pFont = new Font;
 		
 		return true;
@@ -146,6 +167,7 @@ namespace Neo
 		bd.ByteWidth = sizeof(cBufferGlobal);
 
 		V_RETURN(m_pd3dDevice->CreateBuffer( &bd, NULL, &m_pGlobalCBuf ));
+		MemoryTracker::AddBuffer(m_pGlobalCBuf, eMemTag_Misc, "Global cbuffer");
 
 		return true;
 	}
@@ -186,6 +208,12 @@ namespace Neo
 		descDSV.Texture2D.MipSlice = 0;
 		V(m_pd3dDevice->CreateDepthStencilView( m_pDepthStencil, &descDSV, &m_pDepthStencilView ));
 
+		// Keyed by stable addresses, resizing replaces the records
+		MemoryTracker::Add(m_pSwapChain, eMemTag_RenderTarget, eMemPool_GPU, 
+			D3D11Texture::CalcSurfaceBytes(ePF_A8R8G8B8, BBDesc.Width, BBDesc.Height) * m_swapChainDesc.BufferCount, "Back buffer");
+		MemoryTracker::Add(&m_pDepthStencil, eMemTag_RenderTarget, eMemPool_GPU,
+			D3D11Texture::CalcSurfaceBytes(ePF_R32F, BBDesc.Width, BBDesc.Height), "Back buffer depth");
+
 		m_pDeviceContext->OMSetRenderTargets( 1, &m_pRenderTargetView, m_pDepthStencilView );
 
 		pBackBuffer->Release();
@@ -196,6 +224,9 @@ namespace Neo
 	void D3D11RenderSystem::_ShutDownDevice()
 	{
 		if( m_pDeviceContext ) m_pDeviceContext->ClearState();
+		MemoryTracker::Remove(m_pGlobalCBuf);
+		MemoryTracker::Remove(m_pSwapChain);
+		MemoryTracker::Remove(&m_pDepthStencil);
 		SAFE_RELEASE(m_pGlobalCBuf);
 		SAFE_RELEASE(m_pRenderTargetView);
 		SAFE_RELEASE(m_pDepthStencilView);
@@ -212,6 +243,10 @@ namespace Neo
 	void D3D11RenderSystem::ShutDown()
 	{
 		SAFE_DELETE(m_pFont);
+		SAFE_DELETE(m_pTextureMgr);
+		SAFE_DELETE(m_pShaderLibrary);
+		SAFE_DELETE(m_pShaderCache);
+		SAFE_DELETE(m_pShaderCompiler);
 
 		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
 			SAFE_RELEASE(m_pTexture[i]);
@@ -227,6 +262,10 @@ namespace Neo
 		}
 		m_mapTexNeedResize.clear();
 
+		for (auto iter=m_matLib.begin(); iter!=m_matLib.end(); ++iter)
+			m_materialPool.Release(iter->second);
+		m_matLib.clear();
+
 		_ShutDownDevice();
 	}
 	//----------------------------------------------------------------------------------------
@@ -240,27 +279,40 @@ namespace Neo
 	void D3D11RenderSystem::EndScene()
 	{
 		HRESULT hr = S_OK;
+
+		FlushText();
+
+		PROFILE_SCOPE("Present");
 		V(m_pSwapChain->Present(0, 0));
 	}
 	//-------------------------------------------------------------------------------
-	void D3D11RenderSystem::AddMaterial( const STRING& name, Material* pMaterial )
+	MaterialHandle D3D11RenderSystem::AddMaterial( const STRING& name, Material* pMaterial )
 	{
 		auto iter = m_matLib.find(name);
 		if (iter != m_matLib.end())
 		{
 			throw std::exception("Error! There is already a same name material!");
-			return;
+			return MaterialHandle();
 		}
 
-		m_matLib.insert(std::make_pair(name, pMaterial));
+		pMaterial->AddRef();
+		const MaterialHandle hMaterial = m_materialPool.Create(pMaterial);
+		m_matLib.insert(std::make_pair(name, hMaterial));
+
+		return hMaterial;
 	}
 	//-------------------------------------------------------------------------------
 	Material* D3D11RenderSystem::GetMaterial( const STRING& name )
+	{
+		return m_materialPool.Resolve(GetMaterialHandle(name));
+	}
+	//-------------------------------------------------------------------------------
+	MaterialHandle D3D11RenderSystem::GetMaterialHandle( const STRING& name ) const
 	{
 		auto iter = m_matLib.find(name);
 		if (iter == m_matLib.end())
 		{
-			return nullptr;
+			return MaterialHandle();
 		} 
 		else
 		{
@@ -281,6 +333,7 @@ namespace Neo
 		if(pTexture)
 		{
 			pTexture->AddRef();
+			PROFILE_COUNTER(eProfileCounter_TextureBind, 1);
 
 			if (pTexture->GetUsage() & eTextureUsage_DomainShader)
 			{
@@ -366,6 +419,7 @@ namespace Neo
 		V(m_pd3dDevice->CreateDepthStencilState(&m_depthStencilDesc, &m_depthState));	
 
 		m_pDeviceContext->OMSetDepthStencilState(m_depthState, 1);
+		PROFILE_COUNTER(eProfileCounter_StateChange, 1);
 	}
 	//------------------------------------------------------------------------------------
 	void D3D11RenderSystem::SetRasterizeDesc( const D3D11_RASTERIZER_DESC& desc )
@@ -378,6 +432,7 @@ namespace Neo
 		V(m_pd3dDevice->CreateRasterizerState(&m_rasterDesc, &m_rasterState));
 
 		m_pDeviceContext->RSSetState(m_rasterState);
+		PROFILE_COUNTER(eProfileCounter_StateChange, 1);
 	}
 	//------------------------------------------------------------------------------------
 	void D3D11RenderSystem::SetBlendStateDesc( const D3D11_BLEND_DESC& desc )
@@ -397,6 +452,7 @@ namespace Neo
 		blendFactor[3] = 0.0f;
 
 		m_pDeviceContext->OMSetBlendState(m_blendState, blendFactor, 0xffffffff);
+		PROFILE_COUNTER(eProfileCounter_StateChange, 1);
 	}
 	//-------------------------------------------------------------------------------
 	void D3D11RenderSystem::CopyFrameBufferToTexture( D3D11Texture* pTexture )
@@ -428,24 +484,27 @@ namespace Neo
 	//-------------------------------------------------------------------------------
 	void D3D11RenderSystem::Update()
 	{
-		DWORD curTime = GetTickCount();
-		static DWORD lastTime = curTime, nFrameCnt = 0, nFrameTime = 0;
+		// GetTickCount only has 10-16ms resolution
+		__int64 curTime = Profiler::GetTicks();
+		static __int64 lastTime = curTime, nFrameTime = 0;
+		static DWORD nFrameCnt = 0;
 
-		DWORD dt = curTime - lastTime;
+		nFrameTime += curTime - lastTime;
 		lastTime = curTime;
 
 		// Calc FPS
 		++nFrameCnt;
-		nFrameTime += dt;
 
-		if (nFrameTime >= 1000)
+		const double frameTimeMs = Profiler::TicksToMs(nFrameTime);
+		if (frameTimeMs >= 1000)
 		{
-			g_env.pFrameStat->lastFPS = nFrameCnt / (nFrameTime * 0.001f);
-			nFrameCnt = nFrameTime = 0;
+			g_env.pFrameStat->lastFPS = (float)(nFrameCnt / (frameTimeMs * 0.001));
+			nFrameCnt = 0;
+			nFrameTime = 0;
 		}
 
 		// Update cBuffer
-		m_cBufferGlobal.time = GetTickCount() / 1000.0f;
+		m_cBufferGlobal.time = m_fixedTime >= 0 ? m_fixedTime : GetTickCount() / 1000.0f;
 
 		Camera* cam = g_env.pSceneMgr->GetCamera();
 		const MAT44& matView = cam->GetViewMatrix();
@@ -487,6 +546,7 @@ namespace Neo
 	void D3D11RenderSystem::UpdateGlobalCBuffer(bool bTessellate)
 	{
 		m_pDeviceContext->UpdateSubresource( m_pGlobalCBuf, 0, NULL, &m_cBufferGlobal, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_cBufferGlobal));
 		m_pDeviceContext->VSSetConstantBuffers( 0, 1, &m_pGlobalCBuf );
 		m_pDeviceContext->PSSetConstantBuffers( 0, 1, &m_pGlobalCBuf );
 
@@ -502,6 +562,11 @@ namespace Neo
 		m_pFont->DrawText(text, pos, color);
 	}
 	//------------------------------------------------------------------------------------
+	void D3D11RenderSystem::FlushText()
+	{
+		m_pFont->Flush();
+	}
+	//------------------------------------------------------------------------------------
 	void D3D11RenderSystem::AddResizableTexture( D3D11Texture* pTexture )
 	{
 		assert(m_mapTexNeedResize.find(pTexture) == m_mapTexNeedResize.end() && "This texture already added!");
@@ -512,6 +577,15 @@ namespace Neo
 
 		pTexture->AddRef();
 	}
+	//------------------------------------------------------------------------------------
+	void D3D11RenderSystem::OnTextureRecreated( D3D11Texture* pTexture )
+	{
+		for (int i=0; i<MAX_TEXTURE_STAGE; ++i)
+		{
+			if(m_pTexture[i] == pTexture)
+				SAFE_RELEASE(m_pTexture[i]);
+		}
+	}
 	//-------------------------------------------------------------------------------
 	void D3D11RenderSystem::RestoreViewport()
 	{
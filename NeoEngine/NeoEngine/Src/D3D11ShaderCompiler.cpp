@@ -0,0 +1,58 @@
+#include "stdafx.h"
+#include "D3D11ShaderCompiler.h"
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	bool D3D11ShaderCompiler::LoadSource( const STRING& filename, STRING& text )
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		if(!file)
+			return false;
+
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool D3D11ShaderCompiler::Compile( const SShaderCompileDesc& desc, ShaderBytecode& code, STRING& errors )
+	{
+		// Null terminated list pointing into desc
+		std::vector<D3D_SHADER_MACRO> macros;
+		macros.reserve(desc.macros.size() + 1);
+		for (size_t i=0; i<desc.macros.size(); ++i)
+		{
+			D3D_SHADER_MACRO macro = { desc.macros[i].name.c_str(), desc.macros[i].value.c_str() };
+			macros.push_back(macro);
+		}
+		D3D_SHADER_MACRO end = { 0, 0 };
+		macros.push_back(end);
+
+		ID3DBlob* pCodeBlob = nullptr;
+		ID3DBlob* pErrorBlob = nullptr;
+
+		HRESULT hr = D3DX11CompileFromFileA( desc.filename.c_str(), &macros[0], NULL, desc.entryPoint.c_str(),
+			desc.profile.c_str(), desc.flags, 0, NULL, &pCodeBlob, &pErrorBlob, NULL );
+
+		if (pErrorBlob)
+		{
+			if(FAILED(hr))
+				errors.assign((const char*)pErrorBlob->GetBufferPointer(), pErrorBlob->GetBufferSize());
+			pErrorBlob->Release();
+		}
+
+		if (FAILED(hr))
+		{
+			if(errors.empty())
+				errors = "Failed to compile " + desc.filename;
+			SAFE_RELEASE(pCodeBlob);
+			return false;
+		}
+
+		const char* pData = (const char*)pCodeBlob->GetBufferPointer();
+		code.assign(pData, pData + pCodeBlob->GetBufferSize());
+		pCodeBlob->Release();
+
+		return true;
+	}
+}
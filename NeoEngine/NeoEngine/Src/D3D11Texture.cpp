@@ -1,6 +1,9 @@
 #include "stdafx.h"
 #include "D3D11Texture.h"
 #include "D3D11RenderSystem.h"
+#include "DDSLoader.h"
+#include "TextureStreamer.h"
+#include "MemoryTracker.h"
 
 namespace Neo
 {
@@ -17,6 +20,10 @@ namespace Neo
 	,m_width(0)
 	,m_height(0)
 	,m_bMipMap(true)
+	,m_mipCount(1)
+	,m_residentMip(0)
+	,m_name(filename)
+	,m_memTag(eMemTag_Max)
 	{
 		m_pd3dDevice = m_pRenderSystem->GetDevice();
 		if (m_pd3dDevice)
@@ -24,6 +31,12 @@ namespace Neo
 
 		////////////////////////////////////////////////////////////////
 		////////////// Load texture
+		if (_IsDDSFile(filename) && _CreateFromDDS(filename))
+		{
+			_TrackMemory();
+			return;
+		}
+
 		HRESULT hr = S_OK;
 		D3DX11_IMAGE_LOAD_INFO loadInfo;
 		loadInfo.MipLevels = 0;
@@ -88,6 +101,8 @@ namespace Neo
 
 		default: assert(0);
 		}
+
+		_TrackMemory();
 	}
 	//-------------------------------------------------------------------------------
 	D3D11Texture::D3D11Texture( uint32 width, uint32 height, const char* pTexData, ePixelFormat format, uint32 usage, bool bMipMap )
@@ -103,6 +118,9 @@ namespace Neo
 	,m_texType(eTextureType_2D)
 	,m_bMipMap(bMipMap)
 	,m_texFormat(format)
+	,m_mipCount(1)
+	,m_residentMip(0)
+	,m_memTag(eMemTag_Max)
 	{
 		m_pd3dDevice = m_pRenderSystem->GetDevice();
 		if (m_pd3dDevice)
@@ -114,22 +132,32 @@ namespace Neo
 			m_pRenderSystem->AddResizableTexture(this);
 	}
 	//------------------------------------------------------------------------------------
-	D3D11Texture::D3D11Texture( const StringVector& vecTexNames )
+	D3D11Texture::D3D11Texture( const StringVector& vecTexNames, uint32 usage )
 	:m_pTexture2D(nullptr)
 	,m_pTexture3D(nullptr)
 	,m_pRenderSystem(g_env.pRenderSystem)
 	,m_rtView(nullptr)
 	,m_pSRV(nullptr)
 	,m_pDSV(nullptr)
-	,m_usage(0)
+	,m_usage(usage)
 	,m_texType(eTextureType_TextureArray)
 	,m_bMipMap(true)
+	,m_mipCount(1)
+	,m_residentMip(0)
+	,m_memTag(eMemTag_Max)
 	{
 		m_pd3dDevice = m_pRenderSystem->GetDevice();
 		if (m_pd3dDevice)
 			m_pd3dDevice->AddRef();
 
 		assert(!vecTexNames.empty());
+		m_name = vecTexNames[0] + " (array)";
+
+		if (_CreateArrayFromDDS(vecTexNames))
+		{
+			_TrackMemory();
+			return;
+		}
 
 		HRESULT hr = S_OK;
 		// First load all texture elements
@@ -202,16 +230,337 @@ namespace Neo
 
 		for(size_t i=0; i<vecTexs.size(); ++i)
 			vecTexs[i]->Release();
+
+		_TrackMemory();
+	}
+	//------------------------------------------------------------------------------------
+	D3D11Texture::D3D11Texture( const D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* pInitData, eTextureType type )
+	:m_pTexture2D(nullptr)
+	,m_pTexture3D(nullptr)
+	,m_pRenderSystem(g_env.pRenderSystem)
+	,m_rtView(nullptr)
+	,m_pSRV(nullptr)
+	,m_pDSV(nullptr)
+	,m_usage(0)
+	,m_texType(type)
+	,m_width(desc.Width)
+	,m_height(desc.Height)
+	,m_bMipMap(desc.MipLevels != 1)
+	,m_texFormat(ConvertFromDXFormat(desc.Format))
+	,m_mipCount(1)
+	,m_residentMip(0)
+	,m_memTag(eMemTag_Max)
+	{
+		m_pd3dDevice = m_pRenderSystem->GetDevice();
+		if (m_pd3dDevice)
+			m_pd3dDevice->AddRef();
+
+		assert(type == eTextureType_TextureArray || (type == eTextureType_2D && desc.ArraySize == 1));
+
+		HRESULT hr = S_OK;
+		V(m_pd3dDevice->CreateTexture2D(&desc, pInitData, &m_pTexture2D));
+
+		CreateSRV();
+
+		_TrackMemory();
+	}
+	//------------------------------------------------------------------------------------
+	bool D3D11Texture::_IsDDSFile( const STRING& filename )
+	{
+		if(filename.length() < 4)
+			return false;
+
+		STRING ext = filename.substr(filename.length() - 4);
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+		return ext == ".dds";
+	}
+	//------------------------------------------------------------------------------------
+	namespace
+	{
+		/**	Create 2D texture from mip firstMip downward. Each loader adds its images
+			as array slices, a single cube map loader makes a cube texture.
+		*/
+		HRESULT CreateTexture2DFromDDS(ID3D11Device* pDevice, const std::vector<DDSLoader*>& loaders, uint32 firstMip, ID3D11Texture2D** ppTex,
+			DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN)
+		{
+			const SDDSDesc& dds = loaders[0]->GetDesc();
+			assert(firstMip < dds.mipCount);
+
+			SubresourceVector subres;
+			uint32 arraySize = 0;
+
+			for (size_t i=0; i<loaders.size(); ++i)
+			{
+				const SDDSDesc& desc = loaders[i]->GetDesc();
+				const SubresourceVector& src = loaders[i]->GetSubresources();
+
+				for (uint32 iImage=0; iImage<desc.GetImageCount(); ++iImage)
+				{
+					for(uint32 iMip=firstMip; iMip<desc.mipCount; ++iMip)
+						subres.push_back(src[iImage * desc.mipCount + iMip]);
+				}
+
+				arraySize += desc.GetImageCount();
+			}
+
+			D3D11_TEXTURE2D_DESC desc;
+			desc.Width				= max(dds.width >> firstMip, 1u);
+			desc.Height				= max(dds.height >> firstMip, 1u);
+			desc.MipLevels			= dds.mipCount - firstMip;
+			desc.ArraySize			= arraySize;
+			desc.Format				= format != DXGI_FORMAT_UNKNOWN ? format : dds.format;
+			desc.SampleDesc.Count	= 1;
+			desc.SampleDesc.Quality	= 0;
+			desc.Usage				= D3D11_USAGE_IMMUTABLE;
+			desc.BindFlags			= D3D11_BIND_SHADER_RESOURCE;
+			desc.CPUAccessFlags		= 0;
+			desc.MiscFlags			= (loaders.size() == 1 && dds.bCubeMap) ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+			return pDevice->CreateTexture2D(&desc, &subres[0], ppTex);
+		}
+
+		/**	Format both can be uploaded as, or unknown. X8 and A8 variants share the
+			memory layout, the unused X8 byte just becomes alpha.
+		*/
+		DXGI_FORMAT GetCommonFormat(DXGI_FORMAT a, DXGI_FORMAT b)
+		{
+			if(a == b)
+				return a;
+
+			struct SPair { DXGI_FORMAT x8, a8; };
+			static const SPair PAIRS[] =
+			{
+				{ DXGI_FORMAT_B8G8R8X8_UNORM,		DXGI_FORMAT_B8G8R8A8_UNORM },
+				{ DXGI_FORMAT_B8G8R8X8_UNORM_SRGB,	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB },
+			};
+
+			for (int i=0; i<ARRAYSIZE(PAIRS); ++i)
+			{
+				if((a == PAIRS[i].x8 || a == PAIRS[i].a8) && (b == PAIRS[i].x8 || b == PAIRS[i].a8))
+					return PAIRS[i].a8;
+			}
+
+			return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool D3D11Texture::_CreateFromDDS( const STRING& filename )
+	{
+		DDSLoader* pLoader = new DDSLoader;
+		if (!pLoader->Load(filename))
+		{
+			delete pLoader;
+			return false;
+		}
+
+		// Copy, the loader is gone below unless streamed
+		const SDDSDesc dds = pLoader->GetDesc();
+
+		HRESULT hr = S_OK;
+
+		// No mips in the file, D3DX builds the chain as before if the format can be rendered to
+		if (dds.mipCount == 1 && (dds.width > 1 || dds.height > 1))
+		{
+			UINT support = 0;
+			if (SUCCEEDED(m_pd3dDevice->CheckFormatSupport(dds.format, &support)) && (support & D3D11_FORMAT_SUPPORT_RENDER_TARGET))
+			{
+				delete pLoader;
+				return false;
+			}
+		}
+
+		if (dds.bVolume)
+		{
+			D3D11_TEXTURE3D_DESC desc;
+			desc.Width			= dds.width;
+			desc.Height			= dds.height;
+			desc.Depth			= dds.depth;
+			desc.MipLevels		= dds.mipCount;
+			desc.Format			= dds.format;
+			desc.Usage			= D3D11_USAGE_IMMUTABLE;
+			desc.BindFlags		= D3D11_BIND_SHADER_RESOURCE;
+			desc.CPUAccessFlags	= 0;
+			desc.MiscFlags		= 0;
+
+			hr = m_pd3dDevice->CreateTexture3D(&desc, &pLoader->GetSubresources()[0], &m_pTexture3D);
+		}
+		else
+		{
+			m_streamSources.push_back(pLoader);
+
+			// Streamed texture starts with the tail only
+			const bool bStream = (m_usage & eTextureUsage_Streamed) && !dds.bCubeMap && dds.mipCount > 1;
+			if (bStream)
+			{
+				m_mipCount = dds.mipCount;
+				m_residentMip = TextureStreamer::CalcTailMip(dds.width, dds.height, dds.mipCount);
+			}
+
+			hr = CreateTexture2DFromDDS(m_pd3dDevice, m_streamSources, m_residentMip, &m_pTexture2D);
+
+			if (!bStream || FAILED(hr))
+			{
+				m_streamSources.clear();
+				m_residentMip = 0;
+			}
+			else
+			{
+				pLoader = nullptr;		// Kept mapped for streaming
+			}
+		}
+
+		delete pLoader;
+
+		// Let D3DX have a try, e.g. format not supported by device
+		if (FAILED(hr))
+			return false;
+
+		// Header decides the real type
+		if(dds.bVolume)
+			m_texType = eTextureType_3D;
+		else if(dds.bCubeMap)
+			m_texType = eTextureType_CubeMap;
+		else if(dds.arraySize > 1)
+			m_texType = eTextureType_TextureArray;
+		else
+			m_texType = eTextureType_2D;
+
+		m_width = dds.width;
+		m_height = dds.height;
+		m_texFormat = ConvertFromDXFormat(dds.format);
+
+		CreateSRV();
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool D3D11Texture::_CreateArrayFromDDS( const StringVector& vecTexNames )
+	{
+		std::vector<DDSLoader*> loaders;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		bool bOk = true;
+
+		for (size_t i=0; i<vecTexNames.size() && bOk; ++i)
+		{
+			DDSLoader* pLoader = new DDSLoader;
+			loaders.push_back(pLoader);
+
+			if (!_IsDDSFile(vecTexNames[i]) || !pLoader->Load(vecTexNames[i]))
+			{
+				bOk = false;
+				break;
+			}
+
+			const SDDSDesc& first = loaders[0]->GetDesc();
+			const SDDSDesc& dds = pLoader->GetDesc();
+
+			// Elements must be plain 2D textures with identical layout
+			if(dds.bCubeMap || dds.bVolume || dds.arraySize != 1)
+				bOk = false;
+			if(dds.width != first.width || dds.height != first.height || dds.mipCount != first.mipCount)
+				bOk = false;
+
+			format = GetCommonFormat(i == 0 ? dds.format : format, dds.format);
+			if(format == DXGI_FORMAT_UNKNOWN)
+				bOk = false;
+		}
+
+		const SDDSDesc dds = loaders[0]->GetDesc();
+		const bool bStream = bOk && (m_usage & eTextureUsage_Streamed) && dds.mipCount > 1;
+
+		if (bStream)
+		{
+			m_mipCount = dds.mipCount;
+			m_residentMip = TextureStreamer::CalcTailMip(dds.width, dds.height, dds.mipCount);
+		}
+
+		if (bOk && FAILED(CreateTexture2DFromDDS(m_pd3dDevice, loaders, m_residentMip, &m_pTexture2D, format)))
+			bOk = false;
+
+		if (bOk && bStream)
+		{
+			m_streamSources.swap(loaders);
+		}
+		else
+		{
+			m_residentMip = 0;
+			for (size_t i=0; i<loaders.size(); ++i)
+				SAFE_DELETE(loaders[i]);
+		}
+
+		// D3DX loads the whole array at once and it never streams
+		if (!bOk)
+		{
+			OutputDebugStringA(("Texture array not loaded from DDS, elements differ or unsupported, not streamed: " + m_name + "\n").c_str());
+			return false;
+		}
+
+		m_width = dds.width;
+		m_height = dds.height;
+		m_texFormat = ConvertFromDXFormat(format);
+
+		CreateSRV();
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool D3D11Texture::SetResidentMip( uint32 mip )
+	{
+		assert(IsStreamed() && mip < m_mipCount);
+
+		if(mip == m_residentMip)
+			return true;
+
+		// Keep the format, array elements may have been promoted to a common one
+		D3D11_TEXTURE2D_DESC curDesc;
+		m_pTexture2D->GetDesc(&curDesc);
+
+		ID3D11Texture2D* pTexture = nullptr;
+		if(FAILED(CreateTexture2DFromDDS(m_pd3dDevice, m_streamSources, mip, &pTexture, curDesc.Format)))
+			return false;
+
+		SAFE_RELEASE(m_pTexture2D);
+		m_pTexture2D = pTexture;
+		m_residentMip = mip;
+
+		CreateSRV();
+		_TrackMemory();
+
+		// SRV changed, make sure it gets bound again
+		m_pRenderSystem->OnTextureRecreated(this);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void D3D11Texture::GetMipBytes( std::vector<uint32>& mipBytes ) const
+	{
+		mipBytes.assign(m_mipCount, 0);
+
+		for (size_t i=0; i<m_streamSources.size(); ++i)
+		{
+			const SDDSDesc& desc = m_streamSources[i]->GetDesc();
+			const SubresourceVector& subres = m_streamSources[i]->GetSubresources();
+
+			for (uint32 iMip=0; iMip<m_mipCount; ++iMip)
+				mipBytes[iMip] += subres[iMip].SysMemSlicePitch * desc.GetImageCount();
+		}
 	}
 	//-------------------------------------------------------------------------------
 	D3D11Texture::~D3D11Texture()
 	{
 		Destroy();
 		SAFE_RELEASE(m_pd3dDevice);
+
+		for (size_t i=0; i<m_streamSources.size(); ++i)
+			SAFE_DELETE(m_streamSources[i]);
+		m_streamSources.clear();
 	}
 	//-----------------------------------------------------------------------------------
 	void D3D11Texture::Destroy()
 	{
+		MemoryTracker::Remove(this);
+
 		SAFE_RELEASE(m_pTexture2D);
 		SAFE_RELEASE(m_pTexture3D);
 		SAFE_RELEASE(m_pSRV);
@@ -331,6 +680,8 @@ namespace Neo
 		{
 			V(m_pd3dDevice->CreateRenderTargetView( m_pTexture2D, NULL, &m_rtView ));
 		}
+
+		_TrackMemory();
 	}
 	//-------------------------------------------------------------------------------
 	bool D3D11Texture::SaveToFile( const char* filename )
@@ -472,6 +823,7 @@ namespace Neo
 		switch(dxformat)
 		{
 		case DXGI_FORMAT_B8G8R8A8_UNORM:	format = ePF_A8R8G8B8 ;break;
+		case DXGI_FORMAT_B8G8R8X8_UNORM:	format = ePF_R8G8B8; break;
 		case DXGI_FORMAT_R8G8B8A8_UNORM:	format = ePF_A8B8G8R8; break;
 		case DXGI_FORMAT_R16_UNORM:			format = ePF_L16; break;
 		case DXGI_FORMAT_R16G16B16A16_FLOAT: format = ePF_A16B16G16R16F; break;
@@ -550,4 +902,90 @@ namespace Neo
 
 		return bytesPerPixel;
 	}
+	//------------------------------------------------------------------------------------
+	bool D3D11Texture::IsBlockCompressed( ePixelFormat format )
+	{
+		return format >= ePF_DXT1 && format <= ePF_DXT5;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 D3D11Texture::CalcSurfaceBytes( ePixelFormat format, uint32 width, uint32 height )
+	{
+		if (IsBlockCompressed(format))
+		{
+			// BC1 and BC4 use 8 bytes per block, the others 16
+			const uint32 blockBytes = (format == ePF_DXT1 || format == ePF_DXT4) ? 8 : 16;
+			return max(1u, (width + 3) / 4) * max(1u, (height + 3) / 4) * blockBytes;
+		}
+
+		return width * height * GetBytesPerPixelFromFormat(format);
+	}
+	//------------------------------------------------------------------------------------
+	uint32 D3D11Texture::GetEstimatedBytes() const
+	{
+		uint32 nMips = 1, nSlices = 1, depth = 1;
+
+		if (m_pTexture2D)
+		{
+			D3D11_TEXTURE2D_DESC desc;
+			m_pTexture2D->GetDesc(&desc);
+			nMips = desc.MipLevels;
+			nSlices = desc.ArraySize;		// Cube map has 6
+		}
+		else if (m_pTexture3D)
+		{
+			D3D11_TEXTURE3D_DESC desc;
+			m_pTexture3D->GetDesc(&desc);
+			nMips = desc.MipLevels;
+			depth = desc.Depth;
+		}
+		else
+		{
+			return 0;
+		}
+
+		uint32 bytes = 0;
+		uint32 w = max(m_width >> m_residentMip, 1u), h = max(m_height >> m_residentMip, 1u);
+		for (uint32 i=0; i<nMips; ++i)
+		{
+			bytes += CalcSurfaceBytes(m_texFormat, w, h) * depth;
+
+			w = max(w / 2, 1u);
+			h = max(h / 2, 1u);
+			depth = max(depth / 2, 1u);
+		}
+
+		return bytes * nSlices;
+	}
+	//------------------------------------------------------------------------------------
+	void D3D11Texture::SetMemoryTag( eMemTag tag, const STRING& name )
+	{
+		m_memTag = tag;
+		if(!name.empty())
+			m_name = name;
+
+		_TrackMemory();
+	}
+	//------------------------------------------------------------------------------------
+	void D3D11Texture::_TrackMemory()
+	{
+		if(!m_pTexture2D && !m_pTexture3D)
+			return;
+
+		eMemTag tag = m_memTag;
+		if (tag == eMemTag_Max)
+		{
+			const uint32 rtUsage = eTextureUsage_RenderTarget | eTextureUsage_Depth | eTextureUsage_RecreateOnWndResized;
+			tag = (m_usage & rtUsage) ? eMemTag_RenderTarget : eMemTag_Texture;
+		}
+
+		STRING name = m_name;
+		if (name.empty())
+		{
+			char szBuf[64];
+			sprintf_s(szBuf, sizeof(szBuf), "%s %ux%u", MemoryTracker::GetTagName(tag), m_width, m_height);
+			name = szBuf;
+		}
+
+		MemoryTracker::Add(this, tag, eMemPool_GPU, GetEstimatedBytes(), name);
+	}
 }
@@ -0,0 +1,443 @@
+#include "stdafx.h"
+#include "DDSLoader.h"
+
+namespace Neo
+{
+	namespace
+	{
+		const uint32 DDS_MAGIC				= 0x20534444;	// "DDS "
+
+		const uint32 DDPF_ALPHAPIXELS		= 0x1;
+		const uint32 DDPF_FOURCC			= 0x4;
+		const uint32 DDPF_RGB				= 0x40;
+		const uint32 DDPF_LUMINANCE			= 0x20000;
+
+		const uint32 DDSCAPS2_CUBEMAP		= 0x200;
+		const uint32 DDSCAPS2_ALLFACES		= 0xFC00;
+		const uint32 DDSCAPS2_VOLUME		= 0x200000;
+
+		const uint32 DX10_MISC_TEXTURECUBE	= 0x4;
+		const uint32 DX10_DIMENSION_TEXTURE2D = 3;
+		const uint32 DX10_DIMENSION_TEXTURE3D = 4;
+
+#pragma pack(push, 1)
+		struct SDDSPixelFormat
+		{
+			uint32	size;
+			uint32	flags;
+			uint32	fourCC;
+			uint32	RGBBitCount;
+			uint32	RBitMask;
+			uint32	GBitMask;
+			uint32	BBitMask;
+			uint32	ABitMask;
+		};
+
+		struct SDDSHeader
+		{
+			uint32			size;
+			uint32			flags;
+			uint32			height;
+			uint32			width;
+			uint32			pitchOrLinearSize;
+			uint32			depth;
+			uint32			mipMapCount;
+			uint32			reserved1[11];
+			SDDSPixelFormat	ddspf;
+			uint32			caps;
+			uint32			caps2;
+			uint32			caps3;
+			uint32			caps4;
+			uint32			reserved2;
+		};
+
+		struct SDDSHeaderDX10
+		{
+			uint32			dxgiFormat;
+			uint32			resourceDimension;
+			uint32			miscFlag;
+			uint32			arraySize;
+			uint32			miscFlags2;
+		};
+#pragma pack(pop)
+
+		static_assert(sizeof(SDDSHeader) == 124, "Wrong DDS header size!");
+		static_assert(sizeof(SDDSHeaderDX10) == 20, "Wrong DDS DX10 header size!");
+
+		inline uint32 MakeFourCC(char a, char b, char c, char d)
+		{
+			return (uint32)(uint8)a | ((uint32)(uint8)b << 8) | ((uint32)(uint8)c << 16) | ((uint32)(uint8)d << 24);
+		}
+
+		inline bool IsBitMask(const SDDSPixelFormat& pf, uint32 r, uint32 g, uint32 b, uint32 a)
+		{
+			return pf.RBitMask == r && pf.GBitMask == g && pf.BBitMask == b && pf.ABitMask == a;
+		}
+
+		// Map legacy pixel format to DXGI, only formats we use are supported
+		DXGI_FORMAT GetDXGIFormat(const SDDSPixelFormat& pf)
+		{
+			if (pf.flags & DDPF_FOURCC)
+			{
+				const uint32 cc = pf.fourCC;
+
+				if(cc == MakeFourCC('D','X','T','1'))	return DXGI_FORMAT_BC1_UNORM;
+				if(cc == MakeFourCC('D','X','T','2'))	return DXGI_FORMAT_BC2_UNORM;
+				if(cc == MakeFourCC('D','X','T','3'))	return DXGI_FORMAT_BC2_UNORM;
+				if(cc == MakeFourCC('D','X','T','4'))	return DXGI_FORMAT_BC3_UNORM;
+				if(cc == MakeFourCC('D','X','T','5'))	return DXGI_FORMAT_BC3_UNORM;
+				if(cc == MakeFourCC('A','T','I','1'))	return DXGI_FORMAT_BC4_UNORM;
+				if(cc == MakeFourCC('B','C','4','U'))	return DXGI_FORMAT_BC4_UNORM;
+				if(cc == MakeFourCC('B','C','4','S'))	return DXGI_FORMAT_BC4_SNORM;
+				if(cc == MakeFourCC('A','T','I','2'))	return DXGI_FORMAT_BC5_UNORM;
+				if(cc == MakeFourCC('B','C','5','U'))	return DXGI_FORMAT_BC5_UNORM;
+				if(cc == MakeFourCC('B','C','5','S'))	return DXGI_FORMAT_BC5_SNORM;
+
+				// D3DFORMAT values stored as fourCC
+				switch (cc)
+				{
+				case 111: return DXGI_FORMAT_R16_FLOAT;
+				case 112: return DXGI_FORMAT_R16G16_FLOAT;
+				case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+				case 114: return DXGI_FORMAT_R32_FLOAT;
+				case 115: return DXGI_FORMAT_R32G32_FLOAT;
+				case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+				}
+
+				return DXGI_FORMAT_UNKNOWN;
+			}
+
+			if (pf.flags & DDPF_RGB)
+			{
+				if (pf.RGBBitCount == 32)
+				{
+					if(IsBitMask(pf, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+						return DXGI_FORMAT_R8G8B8A8_UNORM;
+					if(IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+						return DXGI_FORMAT_B8G8R8A8_UNORM;
+					if(IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+						return DXGI_FORMAT_B8G8R8X8_UNORM;
+					if(IsBitMask(pf, 0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+						return DXGI_FORMAT_R32_FLOAT;
+				}
+
+				return DXGI_FORMAT_UNKNOWN;
+			}
+
+			if (pf.flags & DDPF_LUMINANCE)
+			{
+				if(pf.RGBBitCount == 8 && pf.RBitMask == 0xff)
+					return DXGI_FORMAT_R8_UNORM;
+				if(pf.RGBBitCount == 16 && pf.RBitMask == 0xffff)
+					return DXGI_FORMAT_R16_UNORM;
+			}
+
+			return DXGI_FORMAT_UNKNOWN;
+		}
+
+		// Bytes per 4x4 block, 0 if not block compressed
+		uint32 GetBlockBytes(DXGI_FORMAT format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_BC1_TYPELESS:
+			case DXGI_FORMAT_BC1_UNORM:
+			case DXGI_FORMAT_BC1_UNORM_SRGB:
+			case DXGI_FORMAT_BC4_TYPELESS:
+			case DXGI_FORMAT_BC4_UNORM:
+			case DXGI_FORMAT_BC4_SNORM:
+				return 8;
+
+			case DXGI_FORMAT_BC2_TYPELESS:
+			case DXGI_FORMAT_BC2_UNORM:
+			case DXGI_FORMAT_BC2_UNORM_SRGB:
+			case DXGI_FORMAT_BC3_TYPELESS:
+			case DXGI_FORMAT_BC3_UNORM:
+			case DXGI_FORMAT_BC3_UNORM_SRGB:
+			case DXGI_FORMAT_BC5_TYPELESS:
+			case DXGI_FORMAT_BC5_UNORM:
+			case DXGI_FORMAT_BC5_SNORM:
+			case DXGI_FORMAT_BC6H_TYPELESS:
+			case DXGI_FORMAT_BC6H_UF16:
+			case DXGI_FORMAT_BC6H_SF16:
+			case DXGI_FORMAT_BC7_TYPELESS:
+			case DXGI_FORMAT_BC7_UNORM:
+			case DXGI_FORMAT_BC7_UNORM_SRGB:
+				return 16;
+
+			default:
+				return 0;
+			}
+		}
+
+		uint32 GetBitsPerPixel(DXGI_FORMAT format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_R32G32B32A32_FLOAT:	return 128;
+			case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			case DXGI_FORMAT_R16G16B16A16_UNORM:
+			case DXGI_FORMAT_R32G32_FLOAT:			return 64;
+			case DXGI_FORMAT_R8G8B8A8_UNORM:
+			case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			case DXGI_FORMAT_B8G8R8A8_UNORM:
+			case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			case DXGI_FORMAT_B8G8R8X8_UNORM:
+			case DXGI_FORMAT_R16G16_FLOAT:
+			case DXGI_FORMAT_R32_FLOAT:				return 32;
+			case DXGI_FORMAT_R16_FLOAT:
+			case DXGI_FORMAT_R16_UNORM:
+			case DXGI_FORMAT_R8G8_UNORM:			return 16;
+			case DXGI_FORMAT_R8_UNORM:
+			case DXGI_FORMAT_A8_UNORM:				return 8;
+			default:								return 0;
+			}
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	DDSLoader::DDSLoader()
+		:m_hFile(INVALID_HANDLE_VALUE)
+		,m_hMapping(nullptr)
+		,m_pView(nullptr)
+		,m_fileSize(0)
+	{
+
+	}
+	//------------------------------------------------------------------------------------
+	DDSLoader::~DDSLoader()
+	{
+		Close();
+	}
+	//------------------------------------------------------------------------------------
+	void DDSLoader::Close()
+	{
+		m_subresources.clear();
+
+		if (m_pView)
+		{
+			UnmapViewOfFile(m_pView);
+			m_pView = nullptr;
+		}
+		if (m_hMapping)
+		{
+			CloseHandle(m_hMapping);
+			m_hMapping = nullptr;
+		}
+		if (m_hFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_hFile);
+			m_hFile = INVALID_HANDLE_VALUE;
+		}
+
+		m_fileSize = 0;
+	}
+	//------------------------------------------------------------------------------------
+	bool DDSLoader::Load( const STRING& filename )
+	{
+		Close();
+
+		m_hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(m_hFile == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.HighPart != 0)
+		{
+			Close();
+			return false;
+		}
+		m_fileSize = fileSize.LowPart;
+
+		m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_hMapping)
+		{
+			Close();
+			return false;
+		}
+
+		m_pView = (const uint8*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_pView)
+		{
+			Close();
+			return false;
+		}
+
+		uint32 dataOffset = 0;
+		if (!ParseHeader(m_pView, m_fileSize, m_desc, dataOffset) ||
+			!BuildSubresources(m_desc, m_pView + dataOffset, m_fileSize - dataOffset, m_subresources))
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool DDSLoader::ParseHeader( const void* pData, uint32 size, SDDSDesc& desc, uint32& dataOffset )
+	{
+		const uint8* pBytes = (const uint8*)pData;
+
+		if(size < sizeof(uint32) + sizeof(SDDSHeader))
+			return false;
+		if(*(const uint32*)pBytes != DDS_MAGIC)
+			return false;
+
+		const SDDSHeader* pHeader = (const SDDSHeader*)(pBytes + sizeof(uint32));
+		if(pHeader->size != sizeof(SDDSHeader) || pHeader->ddspf.size != sizeof(SDDSPixelFormat))
+			return false;
+
+		desc = SDDSDesc();
+		desc.width = pHeader->width;
+		desc.height = pHeader->height;
+		desc.mipCount = max(pHeader->mipMapCount, 1u);
+		dataOffset = sizeof(uint32) + sizeof(SDDSHeader);
+
+		if ((pHeader->ddspf.flags & DDPF_FOURCC) && pHeader->ddspf.fourCC == MakeFourCC('D','X','1','0'))
+		{
+			if(size < dataOffset + sizeof(SDDSHeaderDX10))
+				return false;
+
+			const SDDSHeaderDX10* pHeader10 = (const SDDSHeaderDX10*)(pBytes + dataOffset);
+			dataOffset += sizeof(SDDSHeaderDX10);
+
+			desc.format = (DXGI_FORMAT)pHeader10->dxgiFormat;
+			desc.arraySize = pHeader10->arraySize;
+
+			if(desc.arraySize == 0)
+				return false;
+
+			switch (pHeader10->resourceDimension)
+			{
+			case DX10_DIMENSION_TEXTURE2D:
+				desc.bCubeMap = (pHeader10->miscFlag & DX10_MISC_TEXTURECUBE) != 0;
+				break;
+
+			case DX10_DIMENSION_TEXTURE3D:
+				if(desc.arraySize > 1)
+					return false;
+				desc.bVolume = true;
+				desc.depth = max(pHeader->depth, 1u);
+				break;
+
+			default:
+				return false;		// 1D textures not supported
+			}
+		}
+		else
+		{
+			desc.format = GetDXGIFormat(pHeader->ddspf);
+
+			if (pHeader->caps2 & DDSCAPS2_CUBEMAP)
+			{
+				// D3D11 can't create partial cube maps
+				if((pHeader->caps2 & DDSCAPS2_ALLFACES) != DDSCAPS2_ALLFACES)
+					return false;
+				desc.bCubeMap = true;
+			}
+			else if (pHeader->caps2 & DDSCAPS2_VOLUME)
+			{
+				desc.bVolume = true;
+				desc.depth = max(pHeader->depth, 1u);
+			}
+		}
+
+		// Reject what D3D11 can't create, this also keeps the size math in range
+		if (desc.bVolume)
+		{
+			if(desc.width > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION || desc.height > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION ||
+				desc.depth > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION)
+				return false;
+		}
+		else if (desc.bCubeMap)
+		{
+			if(desc.width != desc.height || desc.width > D3D11_REQ_TEXTURECUBE_DIMENSION ||
+				desc.arraySize > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION / 6)
+				return false;
+		}
+		else if (desc.width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || desc.height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+			desc.arraySize > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+		{
+			return false;
+		}
+
+		if(desc.mipCount > D3D11_REQ_MIP_LEVELS)
+			return false;
+
+		uint32 rowPitch, numRows;
+		if(desc.width == 0 || desc.height == 0 || !GetSurfaceInfo(desc.format, 1, 1, rowPitch, numRows))
+			return false;
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool DDSLoader::GetSurfaceInfo( DXGI_FORMAT format, uint32 width, uint32 height, uint32& rowPitch, uint32& numRows )
+	{
+		unsigned __int64 pitch;
+
+		const uint32 blockBytes = GetBlockBytes(format);
+		if (blockBytes > 0)
+		{
+			pitch = max(1ull, ((unsigned __int64)width + 3) / 4) * blockBytes;
+			numRows = (uint32)max(1ull, ((unsigned __int64)height + 3) / 4);
+		}
+		else
+		{
+			const uint32 bpp = GetBitsPerPixel(format);
+			if(bpp == 0)
+				return false;
+
+			pitch = ((unsigned __int64)width * bpp + 7) / 8;
+			numRows = height;
+		}
+
+		// Pitches are 32 bit in D3D11_SUBRESOURCE_DATA
+		if(pitch * numRows > 0xffffffff)
+			return false;
+
+		rowPitch = (uint32)pitch;
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool DDSLoader::BuildSubresources( const SDDSDesc& desc, const void* pBits, uint32 bitsSize, SubresourceVector& out )
+	{
+		out.clear();
+		out.reserve(desc.GetImageCount() * desc.mipCount);
+
+		const uint8* pSrc = (const uint8*)pBits;
+		const uint8* pEnd = pSrc + bitsSize;
+
+		// Each image stores its full mip chain before the next one
+		for (uint32 iImage=0; iImage<desc.GetImageCount(); ++iImage)
+		{
+			uint32 w = desc.width, h = desc.height, d = desc.depth;
+
+			for (uint32 iMip=0; iMip<desc.mipCount; ++iMip)
+			{
+				uint32 rowPitch, numRows;
+				if(!GetSurfaceInfo(desc.format, w, h, rowPitch, numRows))
+					return false;
+
+				const uint32 slicePitch = rowPitch * numRows;
+				const unsigned __int64 mipBytes = (unsigned __int64)slicePitch * d;
+				if((unsigned __int64)(pEnd - pSrc) < mipBytes)
+					return false;
+
+				D3D11_SUBRESOURCE_DATA data;
+				data.pSysMem = pSrc;
+				data.SysMemPitch = rowPitch;
+				data.SysMemSlicePitch = slicePitch;
+				out.push_back(data);
+
+				pSrc += mipBytes;
+
+				w = max(w / 2, 1u);
+				h = max(h / 2, 1u);
+				d = max(d / 2, 1u);
+			}
+		}
+
+		return true;
+	}
+}
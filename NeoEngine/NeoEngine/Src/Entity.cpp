@@ -2,86 +2,98 @@
 #include "Entity.h"
 #include "D3D11RenderSystem.h"
 #include "Mesh.h"
+#include "SceneManager.h"
+#include "Camera.h"
+#include "Material.h"
+#include "D3D11Texture.h"
+#include "TextureManager.h"
+#include "TransformStorage.h"
 
 namespace Neo
 {
+	// Shadow map and the half sized reflection map can afford coarser geometry
+	float Entity::s_lodPassBias[eLodPass_Count] = { 1.0f, 2.0f, 2.0f };
+
+	// Going coarser requires the error to drop this fraction below threshold,
+	// so an entity sitting on a switch distance doesn't pop every frame.
+	const float LOD_HYSTERESIS = 0.25f;
+
 	//------------------------------------------------------------------------------------
 	Entity::Entity(Mesh* pMesh, bool bUpdateAABB)
-		:m_position(VEC3::ZERO)
-		,m_rotation(QUATERNION::IDENTITY)
-		,m_scale(1,1,1)
-		,m_bMatrixInvalid(true)
-		,m_pMesh(pMesh)
+		:m_pMesh(pMesh)
+		,m_transformSlot(TransformStorage::AllocSlot())
 		,m_bCastShadow(true)
 		,m_bReceiveShadow(true)
 		,m_bUpdateAABB(bUpdateAABB)
+		,m_bWorldAABBInvalid(true)
+		,m_lodPixelError(1.0f)
 	{
+		for (int i=0; i<eLodPass_Count; ++i)
+			m_curLod[i] = 0;
+
 		if(m_bUpdateAABB)
 			_ComputeAABB();
 	}
 	//------------------------------------------------------------------------------------
 	Entity::~Entity()
 	{
+		TransformStorage::FreeSlot(m_transformSlot);
 	}
 	//------------------------------------------------------------------------------------
 	void Entity::SetPosition( const VEC3& pos )
 	{
-		m_position = pos;
-		m_bMatrixInvalid = true;
+		TransformStorage::SetPosition(m_transformSlot, pos);
 	}
 	//------------------------------------------------------------------------------------
 	void Entity::SetRotation( const QUATERNION& quat )
 	{
-		m_rotation = quat;
-		m_bMatrixInvalid = true;
+		TransformStorage::SetRotation(m_transformSlot, quat);
 	}
 	//------------------------------------------------------------------------------------
 	void Entity::SetScale( float scale )
 	{
-		m_scale.Set(scale, scale, scale);
-		m_bMatrixInvalid = true;
+		TransformStorage::SetScale(m_transformSlot, VEC3(scale, scale, scale));
 	}
 	//------------------------------------------------------------------------------------
-	const MAT44& Entity::GetWorldMatrix()
+	VEC3 Entity::GetPosition() const
 	{
-		_UpdateTransform();
-		return m_matWorld;
+		return TransformStorage::GetPosition(m_transformSlot);
 	}
 	//------------------------------------------------------------------------------------
-	const MAT44& Entity::GetWorldITMatrix()
+	QUATERNION Entity::GetRotation() const
 	{
-		_UpdateTransform();
-		return m_matWorldIT;
+		return TransformStorage::GetRotation(m_transformSlot);
 	}
 	//------------------------------------------------------------------------------------
-	void Entity::_UpdateTransform()
+	VEC3 Entity::GetScale() const
 	{
-		if (m_bMatrixInvalid)
-		{
-			// Compose S-R-T
-			MAT44 s, r, t;
-
-			s.SetScale(m_scale);
-			r.FromQuaternion(m_rotation);
-			t.SetTranslation(m_position);
-
-			m_matWorld = Common::Multiply_Mat44_By_Mat44(s, r);
-			m_matWorld = Common::Multiply_Mat44_By_Mat44(m_matWorld, t);
-
-			m_matWorldIT = m_matWorld.Inverse();
-			m_matWorldIT = m_matWorldIT.Transpose();
-
-			m_bMatrixInvalid = false;
-		}
+		return TransformStorage::GetScale(m_transformSlot);
+	}
+	//------------------------------------------------------------------------------------
+	const MAT44& Entity::GetWorldMatrix()
+	{
+		TransformStorage::Flush(m_transformSlot);
+		return TransformStorage::GetWorldMatrix(m_transformSlot);
+	}
+	//------------------------------------------------------------------------------------
+	const MAT44& Entity::GetWorldITMatrix()
+	{
+		TransformStorage::Flush(m_transformSlot);
+		return TransformStorage::GetWorldITMatrix(m_transformSlot);
 	}
 	//------------------------------------------------------------------------------------
 	void Entity::Update()
 	{
+		// Normally already rebuilt by the batch in SceneManager::Update
+		TransformStorage::Flush(m_transformSlot);
+		const bool bMoved = TransformStorage::ConsumeChanged(m_transformSlot);
+
 		//Χ
-		if (m_bUpdateAABB)
+		if (m_bUpdateAABB && (bMoved || m_bWorldAABBInvalid))
 		{
 			m_worldAABB = m_localAABB;
-			m_worldAABB.Transform(m_matWorld);
+			m_worldAABB.Transform(TransformStorage::GetWorldMatrix(m_transformSlot));
+			m_bWorldAABBInvalid = false;
 		}
 	}
 	//------------------------------------------------------------------------------------
@@ -133,7 +145,113 @@ namespace Neo
 		g_env.pRenderSystem->SetTransform(eTransform_World, GetWorldMatrix(), false);
 		g_env.pRenderSystem->SetTransform(eTransform_WorldIT, GetWorldITMatrix(), true);
 
-		m_pMesh->Render(pMaterial);
+		const eLodPass pass = g_env.pSceneMgr->GetLodPass();
+
+		// Only the main view decides texture residency
+		if(pass == eLodPass_Main && !pMaterial)
+			_RequestTextureMips();
+
+		m_pMesh->Render(pMaterial, _SelectLod(pass));
+	}
+	//------------------------------------------------------------------------------------
+	float Entity::_CalcViewDistance()
+	{
+		const Camera* cam = g_env.pSceneMgr->GetCamera();
+
+		VEC3 center;
+		float fRadius = 0;
+		if (m_bUpdateAABB)
+		{
+			center = m_worldAABB.GetCenter();
+			fRadius = m_worldAABB.m_boundingRadius;
+		}
+		else
+		{
+			center = GetWorldMatrix().GetTranslation().GetVec3();
+		}
+
+		return max(Common::Vec3_Distance(center, cam->GetPos()) - fRadius, cam->GetNearClip());
+	}
+	//------------------------------------------------------------------------------------
+	void Entity::_RequestTextureMips()
+	{
+		const Camera* cam = g_env.pSceneMgr->GetCamera();
+		TextureManager* pTexMgr = g_env.pRenderSystem->GetTextureManager();
+
+		const float fPixelsPerUnit = TextureStreamer::CalcPixelsPerUnit(_CalcViewDistance(),
+			cam->GetProjMatrix().m11, g_env.pRenderSystem->GetWndHeight());
+		// Smallest scale stretches UVs the least, so asks for the most texels
+		const VEC3 scale = GetScale();
+		const float fMinScale = max(min(min(scale.x, scale.y), scale.z), 1e-3f);
+
+		for (uint32 iSub=0; iSub<m_pMesh->GetSubMeshCount(); ++iSub)
+		{
+			SubMesh* pSubMesh = m_pMesh->GetSubMesh(iSub);
+			const Material* pMaterial = pSubMesh->GetMaterial();
+			if(!pMaterial)
+				continue;
+
+			// Instance may draw with other textures than its parent
+			const MaterialInstance* pInstance = pSubMesh->GetMaterialInstance();
+
+			const float fUVPerUnit = pSubMesh->GetUVDensity() / fMinScale;
+
+			for (int stage=0; stage<MAX_TEXTURE_STAGE; ++stage)
+			{
+				D3D11Texture* pTexture = pInstance ? pInstance->GetTexture(stage) : pMaterial->GetTexture(stage);
+				if(!pTexture || !pTexture->IsStreamed())
+					continue;
+
+				const float fTexelsPerUnit = max(pTexture->GetWidth(), pTexture->GetHeight()) * fUVPerUnit;
+				pTexMgr->RequestMip(pTexture, TextureStreamer::CalcRequiredMip(fTexelsPerUnit, fPixelsPerUnit));
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	uint32 Entity::_SelectLod( eLodPass pass )
+	{
+		const uint32 nLod = m_pMesh->GetLodCount();
+		if(nLod <= 1)
+			return 0;
+
+		const Camera* cam = g_env.pSceneMgr->GetCamera();
+		const float fDist = _CalcViewDistance();
+
+		// Object space error -> pixels
+		const VEC3 scale = GetScale();
+		const float fMaxScale = max(max(scale.x, scale.y), scale.z);
+		const float fPixelScale = cam->GetProjMatrix().m11 * g_env.pRenderSystem->GetWndHeight() * 0.5f;
+		const float k = fMaxScale * fPixelScale / fDist;
+		const float fThreshold = m_lodPixelError * s_lodPassBias[pass];
+
+		// Coarsest LOD within threshold, errors grow with LOD
+		uint32 target = 0;
+		for (uint32 i=nLod-1; i>0; --i)
+		{
+			if (m_pMesh->GetLodError(i) * k <= fThreshold)
+			{
+				target = i;
+				break;
+			}
+		}
+
+		uint32& cur = m_curLod[pass];
+		cur = min(cur, nLod - 1);
+
+		if (target < cur)
+		{
+			// Refine at once
+			cur = target;
+		}
+		else if (target > cur)
+		{
+			while(target > cur && m_pMesh->GetLodError(target) * k > fThreshold * (1 - LOD_HYSTERESIS))
+				--target;
+
+			cur = target;
+		}
+
+		return cur;
 	}
 	//------------------------------------------------------------------------------------
 	void Entity::SetMaterial( uint32 iSubMesh, Material* pMaterial )
@@ -148,5 +266,15 @@ namespace Neo
 			m_pMesh->GetSubMesh(i)->SetMaterial(pMaterial);
 		}
 	}
+	//------------------------------------------------------------------------------------
+	void Entity::SetMaterialInstance( uint32 iSubMesh, MaterialInstance* pInstance )
+	{
+		m_pMesh->GetSubMesh(iSubMesh)->SetMaterialInstance(pInstance);
+	}
+	//------------------------------------------------------------------------------------
+	uint32 Entity::GetSortKey() const
+	{
+		return m_pMesh->GetSubMeshCount() ? m_pMesh->GetSubMesh(0)->GetSortKey() : 0;
+	}
 }
 
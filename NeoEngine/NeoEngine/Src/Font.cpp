@@ -1,62 +1,92 @@
 #include "stdafx.h"
 #include "Font.h"
 #include "D3D11Texture.h"
+#include "TextureManager.h"
 #include "D3D11RenderSystem.h"
 #include "Material.h"
-#include "Mesh.h"
-#include "Entity.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 
 
 namespace Neo
 {
+	// Glyphs per draw, 16 bit indices limit it
+	static const uint32		MAX_BATCH_QUADS		=	65536 / 4;
+	static const uint32		BATCH_RESERVE_QUADS	=	1024;
+	// Cached layouts not drawn for this many frames are dropped
+	static const uint32		CACHE_KEEP_FRAMES	=	60;
+	static const uint32		MAX_CACHED_TEXTS	=	256;
+
 	//-------------------------------------------------------------------------------
 	Font::Font()
 	:m_pMaterial(nullptr)
 	,m_pRenderSystem(g_env.pRenderSystem)
+	,m_pVertexBuf(nullptr)
+	,m_pIndexBuf(nullptr)
+	,m_maxQuads(0)
+	,m_cacheWndWidth(0)
+	,m_cacheWndHeight(0)
 	{
 		_InitMaterial();
-
-		m_pMesh = new Mesh;
-		SubMesh* pSubMesh = new SubMesh;
-
-		m_pMesh->AddSubMesh(pSubMesh);
-		pSubMesh->SetMaterial(m_pMaterial);
-
-		m_pEntity = new Entity(m_pMesh, false);
-
-		m_pEntity->SetCastShadow(false);
-		m_pEntity->SetReceiveShadow(false);
 	}
 	//-------------------------------------------------------------------------------
 	Font::~Font()
 	{
-		SAFE_DELETE(m_pMesh);
-		SAFE_DELETE(m_pEntity);
+		MemoryTracker::Remove(m_pVertexBuf);
+		MemoryTracker::Remove(m_pIndexBuf);
+		SAFE_RELEASE(m_pVertexBuf);
+		SAFE_RELEASE(m_pIndexBuf);
 		SAFE_RELEASE(m_pMaterial);
 	}
 	//-------------------------------------------------------------------------------
 	void Font::DrawText( const STRING& text, const IPOINT& pos, const SColor& color )
 	{
-		_InitMesh(text, pos, color);
+		if(text.empty())
+			return;
+
+		// Layouts are in NDC, a new window size invalidates them
+		const uint32 screenW = m_pRenderSystem->GetWndWidth();
+		const uint32 screenH = m_pRenderSystem->GetWndHeight();
+		if (screenW != m_cacheWndWidth || screenH != m_cacheWndHeight)
+		{
+			m_cache.clear();
+			m_cacheWndWidth = screenW;
+			m_cacheWndHeight = screenH;
+		}
+
+		const DWORD packedColor =
+			((DWORD)(Clamp(color.r, 0.0f, 1.0f) * 255 + 0.5f)) |
+			((DWORD)(Clamp(color.g, 0.0f, 1.0f) * 255 + 0.5f) << 8) |
+			((DWORD)(Clamp(color.b, 0.0f, 1.0f) * 255 + 0.5f) << 16) |
+			((DWORD)(Clamp(color.a, 0.0f, 1.0f) * 255 + 0.5f) << 24);
+
+		char szKey[48];
+		sprintf_s(szKey, sizeof(szKey), "%d|%d|%08x|", pos.x, pos.y, packedColor);
+		const STRING key = szKey + text;
+
+		auto iter = m_cache.find(key);
+		if (iter == m_cache.end())
+		{
+			if(m_cache.size() >= MAX_CACHED_TEXTS)
+				_PurgeCache();
 
-		// Enable alpha blend
-		D3D11_BLEND_DESC& blendDesc = m_pRenderSystem->GetBlendStateDesc();
-		blendDesc.RenderTarget[0].BlendEnable = TRUE;
-		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
-		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
-		m_pRenderSystem->SetBlendStateDesc(blendDesc);
+			SCachedText& entry = m_cache[key];
+			_Layout(text, pos, packedColor, entry.verts);
+			iter = m_cache.find(key);
+		}
 
-		m_pEntity->Render();
+		iter->second.lastFrame = FrameAllocator::GetFrame();
 
-		// Reset render state
-		blendDesc.RenderTarget[0].BlendEnable = FALSE;
-		m_pRenderSystem->SetBlendStateDesc(blendDesc);
+		// Growing in the arena leaves the old block behind, start big enough for usual UI
+		if(m_batch.empty())
+			m_batch.reserve(BATCH_RESERVE_QUADS * 4);
+		m_batch.insert(m_batch.end(), iter->second.verts.begin(), iter->second.verts.end());
 	}
 	//------------------------------------------------------------------------------------
-	void Font::_InitMesh( const STRING& text, const IPOINT& pos, const SColor& color )
+	void Font::_Layout( const STRING& text, const IPOINT& pos, DWORD color, std::vector<STextVertex>& verts ) const
 	{
-		const uint32 screenW = g_env.pRenderSystem->GetWndWidth();
-		const uint32 screenH = g_env.pRenderSystem->GetWndHeight();
+		const uint32 screenW = m_pRenderSystem->GetWndWidth();
+		const uint32 screenH = m_pRenderSystem->GetWndHeight();
 
 		const VEC2	GLYGH_SIZE		=	VEC2(15.0f / screenW, 42.0f / screenH);
 		const float	GLYGH_UV_SIZEX	=	0.010526315f;
@@ -67,12 +97,10 @@ namespace Neo
 		startPos.x = startPos.x * 2.0f - 1.0f;
 		startPos.y = 1.0f - startPos.y * 2.0f;
 
-		// Init text mesh
-		const SColor dxColor = color.GetAsDx();
 		const uint32 nChar = text.length();
-		SVertex* pVert = new SVertex[nChar * 2 * 3];	// Each character has two triangles, each triangle has three vertices.
+		verts.resize(nChar * 4);	// Each character is a quad
 
-		for (uint32 iChar=0,iVert=0; iChar<nChar; ++iChar)
+		for (uint32 iChar=0; iChar<nChar; ++iChar)
 		{
 			const char ch = text[iChar];
 			assert(ch >= 32 && ch <= 126 && "Not support this character..");
@@ -87,74 +115,153 @@ namespace Neo
 			float uvTop		= 0.0f;
 			float uvBottom	= 1.0f;
 
-			// First tri
-			pVert[iVert].pos.Set(left, top, 0);
-			pVert[iVert].uv.Set(uvLeft, uvTop);
-			pVert[iVert].color = dxColor;
-
-			++iVert;
+			// Left top, right top, left bottom, right bottom
+			STextVertex* pVert = &verts[iChar * 4];
+			const STextVertex quad[4] =
+			{
+				{ left,	 top,	 uvLeft,  uvTop,	color },
+				{ right, top,	 uvRight, uvTop,	color },
+				{ left,	 bottom, uvLeft,  uvBottom, color },
+				{ right, bottom, uvRight, uvBottom, color }
+			};
+			memcpy(pVert, quad, sizeof(quad));
 
-			pVert[iVert].pos.Set(right, top, 0);
-			pVert[iVert].uv.Set(uvRight, uvTop);
-			pVert[iVert].color = dxColor;
+			startPos.x += GLYGH_SIZE.x;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool Font::_EnsureBuffers( uint32 nQuads )
+	{
+		if(nQuads <= m_maxQuads)
+			return true;
 
-			++iVert;
+		const uint32 maxQuads = min(max(nQuads, m_maxQuads * 2), MAX_BATCH_QUADS);
 
-			pVert[iVert].pos.Set(left, bottom, 0);
-			pVert[iVert].uv.Set(uvLeft, uvBottom);
-			pVert[iVert].color = dxColor;
+		MemoryTracker::Remove(m_pVertexBuf);
+		MemoryTracker::Remove(m_pIndexBuf);
+		SAFE_RELEASE(m_pVertexBuf);
+		SAFE_RELEASE(m_pIndexBuf);
+		m_maxQuads = 0;
 
-			++iVert;
+		ID3D11Device* pDevice = m_pRenderSystem->GetDevice();
+		HRESULT hr = S_OK;
 
-			// Second tri
-			pVert[iVert].pos.Set(right, top, 0);
-			pVert[iVert].uv.Set(uvRight, uvTop);
-			pVert[iVert].color = dxColor;
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.ByteWidth = sizeof(STextVertex) * 4 * maxQuads;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-			++iVert;
+		V_RETURN(pDevice->CreateBuffer( &bd, nullptr, &m_pVertexBuf ));
+		MemoryTracker::AddBuffer(m_pVertexBuf, eMemTag_Font, "Text vertex buffer");
 
-			pVert[iVert].pos.Set(right, bottom, 0);
-			pVert[iVert].uv.Set(uvRight, uvBottom);
-			pVert[iVert].color = dxColor;
+		std::vector<WORD> indices(maxQuads * 6);
+		for (uint32 i=0; i<maxQuads; ++i)
+		{
+			const WORD base = (WORD)(i * 4);
+			WORD* pIdx = &indices[i * 6];
 
-			++iVert;
+			pIdx[0] = base;		pIdx[1] = base + 1;	pIdx[2] = base + 2;
+			pIdx[3] = base + 1;	pIdx[4] = base + 3;	pIdx[5] = base + 2;
+		}
 
-			pVert[iVert].pos.Set(left, bottom, 0);
-			pVert[iVert].uv.Set(uvLeft, uvBottom);
-			pVert[iVert].color = dxColor;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.ByteWidth = sizeof(WORD) * indices.size();
+		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		bd.Usage = D3D11_USAGE_IMMUTABLE;
 
-			++iVert;
+		D3D11_SUBRESOURCE_DATA InitData;
+		ZeroMemory( &InitData, sizeof(InitData) );
+		InitData.pSysMem = &indices[0];
 
-			startPos.x += GLYGH_SIZE.x;
-		}
+		V_RETURN(pDevice->CreateBuffer( &bd, &InitData, &m_pIndexBuf ));
+		MemoryTracker::AddBuffer(m_pIndexBuf, eMemTag_Font, "Text index buffer");
 
-		// Is old buffer big enough?
-		
+		m_maxQuads = maxQuads;
 
-		const uint32 nBufSize = sizeof(SVertex) * nChar;
-		const uint32 nOldSize = sizeof(SVertex) * m_pMesh->GetSubMesh(0)->GetVertData().GetVertCount();
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void Font::Flush()
+	{
+		const uint32 nQuads = m_batch.size() / 4;
 
-		if (/*nOldSize < nBufSize*/true)	// Not enough
+		if (nQuads > 0 && _EnsureBuffers(min(nQuads, MAX_BATCH_QUADS)))
 		{
-			m_pMesh->GetSubMesh(0)->InitVertData(eVertexType_General, pVert, nChar*2*3, false);
+			ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
+
+			// Alpha blend, no depth
+			D3D11_BLEND_DESC& blendDesc = m_pRenderSystem->GetBlendStateDesc();
+			blendDesc.RenderTarget[0].BlendEnable = TRUE;
+			blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+			blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+			m_pRenderSystem->SetBlendStateDesc(blendDesc);
+
+			D3D11_DEPTH_STENCIL_DESC& depthDesc = m_pRenderSystem->GetDepthStencilDesc();
+			const D3D11_DEPTH_STENCIL_DESC oldDepthDesc = depthDesc;
+			depthDesc.DepthEnable = FALSE;
+			depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+			m_pRenderSystem->SetDepthStencelState(depthDesc);
+
+			m_pMaterial->Activate();
+
+			const UINT stride = sizeof(STextVertex);
+			UINT offset = 0;
+			pContext->IASetVertexBuffers( 0, 1, &m_pVertexBuf, &stride, &offset );
+			pContext->IASetIndexBuffer( m_pIndexBuf, DXGI_FORMAT_R16_UINT, 0 );
+
+			// More than one draw only if it overflows 16 bit indices
+			for (uint32 first=0; first<nQuads; first+=m_maxQuads)
+			{
+				const uint32 n = min(nQuads - first, m_maxQuads);
+
+				D3D11_MAPPED_SUBRESOURCE mapped;
+				if(FAILED(pContext->Map(m_pVertexBuf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+					break;
+
+				memcpy(mapped.pData, &m_batch[first * 4], sizeof(STextVertex) * 4 * n);
+				pContext->Unmap(m_pVertexBuf, 0);
+
+				pContext->DrawIndexed(n * 6, 0, 0);
+
+				PROFILE_COUNTER(eProfileCounter_DrawCall, 1);
+				PROFILE_COUNTER(eProfileCounter_Triangle, n * 2);
+			}
+
+			// Reset render state
+			blendDesc.RenderTarget[0].BlendEnable = FALSE;
+			m_pRenderSystem->SetBlendStateDesc(blendDesc);
+
+			depthDesc = oldDepthDesc;
+			m_pRenderSystem->SetDepthStencelState(depthDesc);
 		}
-		else	// Enough
-		{
 
+		// Release the arena memory, it's gone after next frame
+		TextBatch().swap(m_batch);
+	}
+	//------------------------------------------------------------------------------------
+	void Font::_PurgeCache()
+	{
+		const uint32 frame = FrameAllocator::GetFrame();
+
+		for (auto iter=m_cache.begin(); iter!=m_cache.end(); )
+		{
+			if(frame - iter->second.lastFrame > CACHE_KEEP_FRAMES)
+				iter = m_cache.erase(iter);
+			else
+				++iter;
 		}
 
-		delete []pVert;
+		// Everything is recent, e.g. a counter changing every frame
+		if(m_cache.size() >= MAX_CACHED_TEXTS)
+			m_cache.clear();
 	}
 	//------------------------------------------------------------------------------------
 	void Font::_InitMaterial()
 	{
-		m_pMaterial = new Material;
-		m_pMaterial->SetTexture(0, new D3D11Texture(GetResPath("Font.dds")));
+		m_pMaterial = new Material(eVertexType_Text);
+		m_pMaterial->SetTexture(0, m_pRenderSystem->GetTextureManager()->Load(GetResPath("Font.dds")));
 		m_pMaterial->InitShader(GetResPath("Font.hlsl"), GetResPath("Font.hlsl"));
 	}
 }
-
-
-
-
-
@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "FrameAllocator.h"
+#include "MemoryTracker.h"
+
+namespace Neo
+{
+	// Carved from the shared arena per thread, bigger requests reserve on their own
+	static const uint32		THREAD_CHUNK_SIZE	=	16 * 1024;
+
+#ifdef _DEBUG
+	// Frame stamp in front of each debug block
+	static const uint32		DEBUG_HEADER_SIZE	=	16;
+	static const uint32		DEBUG_MAGIC			=	0xF4A3E0C5;
+	static const int		DEAD_FILL			=	0xFE;
+#else
+	static const uint32		DEBUG_HEADER_SIZE	=	0;
+#endif
+
+	namespace
+	{
+		// Thread's current chunk, only valid while frame matches
+		__declspec(thread) char*	t_pCur = nullptr;
+		__declspec(thread) char*	t_pEnd = nullptr;
+		__declspec(thread) uint32	t_frame = 0xffffffff;
+
+		struct SOverflow
+		{
+			SOverflow()		{ InitializeCriticalSection(&lock); }
+			~SOverflow()	{ DeleteCriticalSection(&lock); }
+
+			CRITICAL_SECTION	lock;
+			std::vector<void*>	blocks[2];		// Per arena, freed with it
+			uint32				bytes;
+		};
+
+		SOverflow	g_overflow;
+
+		inline char* AlignUp(char* p, uint32 align)
+		{
+			return (char*)(((size_t)p + align - 1) & ~(size_t)(align - 1));
+		}
+	}
+
+	FrameAllocator::SArena		FrameAllocator::s_arenas[2] = { { nullptr, 0, 0 }, { nullptr, 0, 0 } };
+	volatile uint32				FrameAllocator::s_frame = 0;
+	uint32						FrameAllocator::s_lastFrameBytes = 0;
+	uint32						FrameAllocator::s_peakFrameBytes = 0;
+	uint32						FrameAllocator::s_lastOverflowBytes = 0;
+
+	//------------------------------------------------------------------------------------
+	void FrameAllocator::Init( uint32 arenaSize )
+	{
+		assert(!s_arenas[0].base && "Already initialized!");
+
+		for (int i=0; i<2; ++i)
+		{
+			SArena& arena = s_arenas[i];
+			arena.base = (char*)MemoryTracker::Alloc(arenaSize, eMemTag_Misc, "Frame arena");
+			arena.size = arenaSize;
+			arena.used = 0;
+		}
+
+		g_overflow.bytes = 0;
+	}
+	//------------------------------------------------------------------------------------
+	void FrameAllocator::ShutDown()
+	{
+		for (int i=0; i<2; ++i)
+		{
+			MemoryTracker::Free(s_arenas[i].base);
+			s_arenas[i].base = nullptr;
+			s_arenas[i].size = 0;
+
+			for (size_t j=0; j<g_overflow.blocks[i].size(); ++j)
+				MemoryTracker::Free(g_overflow.blocks[i][j]);
+			g_overflow.blocks[i].clear();
+		}
+	}
+	//------------------------------------------------------------------------------------
+	char* FrameAllocator::_Reserve( SArena& arena, uint32 bytes )
+	{
+		const long offset = InterlockedExchangeAdd(&arena.used, (long)bytes);
+		if((uint32)offset + bytes > arena.size)
+			return nullptr;
+
+		return arena.base + offset;
+	}
+	//------------------------------------------------------------------------------------
+	void* FrameAllocator::Alloc( uint32 bytes, uint32 align )
+	{
+		assert(align > 0 && (align & (align - 1)) == 0 && "Alignment must be power of 2!");
+		assert(s_arenas[0].base && "FrameAllocator::Init not called!");
+
+		const uint32 frame = s_frame;
+		align = max(align, DEBUG_HEADER_SIZE ? DEBUG_HEADER_SIZE : 1u);
+		const uint32 size = bytes + DEBUG_HEADER_SIZE;
+
+		// Chunk of a previous frame was reset under us
+		if (t_frame != frame)
+		{
+			t_pCur = t_pEnd = nullptr;
+			t_frame = frame;
+		}
+
+		char* p = t_pCur ? AlignUp(t_pCur + DEBUG_HEADER_SIZE, align) - DEBUG_HEADER_SIZE : nullptr;
+
+		if (!p || p + size > t_pEnd)
+		{
+			SArena& arena = s_arenas[frame & 1];
+
+			if (size + align > THREAD_CHUNK_SIZE / 2)
+			{
+				// Large block, keep the current chunk
+				char* pBlock = _Reserve(arena, size + align);
+				if(!pBlock)
+					return _AllocOverflow(bytes, align);
+
+				p = AlignUp(pBlock + DEBUG_HEADER_SIZE, align) - DEBUG_HEADER_SIZE;
+			}
+			else
+			{
+				char* pChunk = _Reserve(arena, THREAD_CHUNK_SIZE);
+				if(!pChunk)
+					return _AllocOverflow(bytes, align);
+
+				t_pCur = pChunk;
+				t_pEnd = pChunk + THREAD_CHUNK_SIZE;
+
+				p = AlignUp(t_pCur + DEBUG_HEADER_SIZE, align) - DEBUG_HEADER_SIZE;
+				t_pCur = p + size;
+			}
+		}
+		else
+		{
+			t_pCur = p + size;
+		}
+
+#ifdef _DEBUG
+		uint32* pHeader = (uint32*)p;
+		pHeader[0] = DEBUG_MAGIC;
+		pHeader[1] = frame;
+#endif
+
+		return p + DEBUG_HEADER_SIZE;
+	}
+	//------------------------------------------------------------------------------------
+	void* FrameAllocator::_AllocOverflow( uint32 bytes, uint32 align )
+	{
+		assert(align <= 16 && "Overflow blocks are only 16 byte aligned!");
+
+		// Slow path, the arena needs to grow if this shows up
+		char* p = (char*)MemoryTracker::Alloc(bytes + DEBUG_HEADER_SIZE, eMemTag_Misc, "Frame arena overflow");
+
+		EnterCriticalSection(&g_overflow.lock);
+		g_overflow.blocks[s_frame & 1].push_back(p);
+		g_overflow.bytes += bytes;
+		LeaveCriticalSection(&g_overflow.lock);
+
+#ifdef _DEBUG
+		uint32* pHeader = (uint32*)p;
+		pHeader[0] = DEBUG_MAGIC;
+		pHeader[1] = s_frame;
+#endif
+
+		return p + DEBUG_HEADER_SIZE;
+	}
+	//------------------------------------------------------------------------------------
+	void FrameAllocator::EndFrame()
+	{
+		SArena& finished = s_arenas[s_frame & 1];
+		s_lastFrameBytes = min((uint32)finished.used, finished.size);
+		s_peakFrameBytes = max(s_peakFrameBytes, s_lastFrameBytes);
+
+		EnterCriticalSection(&g_overflow.lock);
+		s_lastOverflowBytes = g_overflow.bytes;
+		g_overflow.bytes = 0;
+		LeaveCriticalSection(&g_overflow.lock);
+
+		++s_frame;
+
+		// Arena of frame N-1 is reused for frame N+1
+		SArena& arena = s_arenas[s_frame & 1];
+
+#ifdef _DEBUG
+		// Stale reads through escaped pointers show up as 0xFEFEFEFE
+		memset(arena.base, DEAD_FILL, min((uint32)arena.used, arena.size));
+#endif
+		arena.used = 0;
+
+		std::vector<void*>& blocks = g_overflow.blocks[s_frame & 1];
+		for (size_t i=0; i<blocks.size(); ++i)
+			MemoryTracker::Free(blocks[i]);
+		blocks.clear();
+	}
+	//------------------------------------------------------------------------------------
+	bool FrameAllocator::IsTransient( const void* p )
+	{
+		for (int i=0; i<2; ++i)
+		{
+			const SArena& arena = s_arenas[i];
+			if(p >= arena.base && p < arena.base + arena.size)
+				return true;
+		}
+
+		return false;
+	}
+	//------------------------------------------------------------------------------------
+	void FrameAllocator::CheckAlive( const void* p )
+	{
+#ifdef _DEBUG
+		if(!p)
+			return;
+
+		const uint32* pHeader = (const uint32*)((const char*)p - DEBUG_HEADER_SIZE);
+		assert(pHeader[0] == DEBUG_MAGIC && "Not frame memory or already reset!");
+		assert(IsFrameAlive(pHeader[1]) && "Frame memory used after its frame!");
+#else
+		(void)p;
+#endif
+	}
+}
@@ -0,0 +1,294 @@
+#include "stdafx.h"
+#include "Grass.h"
+#include "Terrain.h"
+#include "Material.h"
+#include "D3D11RenderSystem.h"
+#include "SceneManager.h"
+#include "Camera.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ParallelFor.h"
+
+
+namespace Neo
+{
+	static const float		GRASS_PAGE_SIZE		=	16;
+	// Poisson disk radius, about 2000 blades per full page
+	static const float		GRASS_SPACING		=	0.3f;
+	static const float		GRASS_FADE_START	=	30;
+	static const float		GRASS_VIEW_DIST		=	100;
+	static const float		BLADE_WIDTH			=	0.06f;
+	static const float		BLADE_HEIGHT		=	0.8f;
+	static const float		WIND_STRENGTH		=	0.15f;
+	// Missing pages generated per Update, more would hitch when the camera jumps
+	static const uint32		PAGES_PER_UPDATE	=	4;
+	// Density mask samples per world unit
+	static const float		DENSITY_PER_UNIT	=	1;
+	// Grass where the normal is steeper than the first fades out by the second
+	static const float		SLOPE_FULL			=	0.95f;
+	static const float		SLOPE_NONE			=	0.85f;
+	// Fraction of the terrain height range above which grass fades out, where snow starts
+	static const float		ALTITUDE_FULL		=	0.5f;
+	static const float		ALTITUDE_NONE		=	0.6f;
+
+	//------------------------------------------------------------------------------------
+	static float SmoothStep(float edge0, float edge1, float x)
+	{
+		const float t = Clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+		return t * t * (3 - 2 * t);
+	}
+	//------------------------------------------------------------------------------------
+	Grass::Grass(Terrain* pTerrain)
+	:m_pRenderSystem(g_env.pRenderSystem)
+	,m_pMaterial(nullptr)
+	,m_pBladeVB(nullptr)
+	,m_pBladeIB(nullptr)
+	,m_bladeIndexCount(0)
+	,m_pCB(nullptr)
+	{
+		_InitLayer(pTerrain);
+		_InitBladeMesh();
+		_InitMaterial();
+		_InitConstantBuf();
+	}
+	//------------------------------------------------------------------------------------
+	Grass::~Grass()
+	{
+		for (size_t i=0; i<m_pageBuffers.size(); ++i)
+		{
+			MemoryTracker::Remove(m_pageBuffers[i].pBuffer);
+			SAFE_RELEASE(m_pageBuffers[i].pBuffer);
+		}
+
+		MemoryTracker::Remove(m_pCB);
+		SAFE_RELEASE(m_pCB);
+		MemoryTracker::Remove(m_pBladeVB);
+		SAFE_RELEASE(m_pBladeVB);
+		MemoryTracker::Remove(m_pBladeIB);
+		SAFE_RELEASE(m_pBladeIB);
+		SAFE_RELEASE(m_pMaterial);
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::_InitLayer(Terrain* pTerrain)
+	{
+		const AABB& aabb = pTerrain->GetTerrainAABB();
+
+		SGrassLayerDesc desc;
+		desc.originX = aabb.m_minCorner.x;
+		desc.originZ = aabb.m_minCorner.z;
+		desc.sizeX = aabb.m_maxCorner.x - aabb.m_minCorner.x;
+		desc.sizeZ = aabb.m_maxCorner.z - aabb.m_minCorner.z;
+		desc.pageSize = GRASS_PAGE_SIZE;
+		desc.spacing = GRASS_SPACING;
+		desc.bladeHeight = BLADE_HEIGHT;
+		desc.fadeStart = GRASS_FADE_START;
+		desc.viewDistance = GRASS_VIEW_DIST;
+
+		m_layer.Init(desc, [=](float x, float z) { return pTerrain->GetHeightAt(x, z); });
+
+		// Initial density, grass on flat ground below the snow line
+		const uint32 width = (uint32)(desc.sizeX * DENSITY_PER_UNIT) + 1;
+		const uint32 height = (uint32)(desc.sizeZ * DENSITY_PER_UNIT) + 1;
+		const float minY = aabb.m_minCorner.y;
+		const float rangeY = max(aabb.m_maxCorner.y - minY, 1e-3f);
+		std::vector<uint8> density(width * height);
+
+		ParallelFor(height, [&](unsigned int row)
+		{
+			const float z = desc.originZ + row * desc.sizeZ / (height - 1);
+			for (uint32 col=0; col<width; ++col)
+			{
+				const float x = desc.originX + col * desc.sizeX / (width - 1);
+				const float altitude = (pTerrain->GetHeightAt(x, z) - minY) / rangeY;
+				const float d = SmoothStep(SLOPE_NONE, SLOPE_FULL, pTerrain->GetNormalAt(x, z).y) *
+					(1 - SmoothStep(ALTITUDE_FULL, ALTITUDE_NONE, altitude));
+
+				density[row * width + col] = (uint8)(d * 255 + 0.5f);
+			}
+		});
+
+		m_layer.SetDensityMap(&density[0], width, height);
+		m_pageBuffers.resize(m_layer.GetPagesX() * m_layer.GetPagesZ());
+		for (size_t i=0; i<m_pageBuffers.size(); ++i)
+		{
+			m_pageBuffers[i].pBuffer = nullptr;
+			m_pageBuffers[i].version = 0;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::_InitBladeMesh()
+	{
+		// Three segments narrowing to the tip
+		const SGrassVertex verts[] =
+		{
+			{ VEC3(-0.5f, 0, 0),		VEC2(0, 0) },
+			{ VEC3( 0.5f, 0, 0),		VEC2(1, 0) },
+			{ VEC3(-0.4f, 0.4f, 0),		VEC2(0, 0.4f) },
+			{ VEC3( 0.4f, 0.4f, 0),		VEC2(1, 0.4f) },
+			{ VEC3(-0.25f, 0.75f, 0),	VEC2(0, 0.75f) },
+			{ VEC3( 0.25f, 0.75f, 0),	VEC2(1, 0.75f) },
+			{ VEC3( 0, 1, 0),			VEC2(0.5f, 1) },
+		};
+
+		const WORD indices[] = { 0,2,1, 1,2,3, 2,4,3, 3,4,5, 4,6,5 };
+		m_bladeIndexCount = ARRAYSIZE(indices);
+
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.Usage = D3D11_USAGE_IMMUTABLE;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.ByteWidth = sizeof(verts);
+
+		D3D11_SUBRESOURCE_DATA initData;
+		ZeroMemory( &initData, sizeof(initData) );
+		initData.pSysMem = verts;
+
+		HRESULT hr = S_OK;
+		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, &initData, &m_pBladeVB ));
+		MemoryTracker::AddBuffer(m_pBladeVB, eMemTag_Vegetation, "Grass blade");
+
+		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		bd.ByteWidth = sizeof(indices);
+		initData.pSysMem = indices;
+
+		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, &initData, &m_pBladeIB ));
+		MemoryTracker::AddBuffer(m_pBladeIB, eMemTag_Vegetation, "Grass blade");
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::_InitMaterial()
+	{
+		m_pMaterial = new Material(eVertexType_Grass);
+		// Blades are seen from both sides
+		m_pMaterial->SetCullMode(D3D11_CULL_NONE);
+		m_pMaterial->InitShader(GetResPath("Grass.hlsl"), GetResPath("Grass.hlsl"), eShaderFlag_EnableShadowReceive);
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::_InitConstantBuf()
+	{
+		m_cBuffer.baseColor.Set(0.12f, 0.25f, 0.05f);
+		m_cBuffer.tipColor.Set(0.45f, 0.62f, 0.2f);
+		m_cBuffer.dryColor.Set(0.55f, 0.5f, 0.25f);
+		m_cBuffer.fadeStart = GRASS_FADE_START;
+		m_cBuffer.viewDistance = GRASS_VIEW_DIST;
+		m_cBuffer.bladeWidth = BLADE_WIDTH;
+		m_cBuffer.bladeHeight = BLADE_HEIGHT;
+		m_cBuffer.windStrength = WIND_STRENGTH;
+
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.Usage = D3D11_USAGE_DEFAULT;
+		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bd.CPUAccessFlags = 0;
+		bd.ByteWidth = sizeof(cBufferGrass);
+
+		D3D11_SUBRESOURCE_DATA initData;
+		ZeroMemory( &initData, sizeof(initData) );
+		initData.pSysMem = &m_cBuffer;
+
+		HRESULT hr = S_OK;
+		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, &initData, &m_pCB ));
+		MemoryTracker::AddBuffer(m_pCB, eMemTag_Vegetation, "Grass cbuffer");
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::Update()
+	{
+		const VEC3& camPos = g_env.pSceneMgr->GetCamera()->GetPos();
+		m_layer.Update(camPos.x, camPos.z, PAGES_PER_UPDATE);
+
+		_ReleaseStaleBuffers();
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::_ReleaseStaleBuffers()
+	{
+		const uint32 pagesX = m_layer.GetPagesX();
+		for (uint32 i=0; i<m_pageBuffers.size(); ++i)
+		{
+			SPageBuffer& buf = m_pageBuffers[i];
+			if(!buf.pBuffer)
+				continue;
+
+			const SGrassPage* pPage = m_layer.GetPage(i % pagesX, i / pagesX);
+			if (!pPage || pPage->version != buf.version)
+			{
+				MemoryTracker::Remove(buf.pBuffer);
+				SAFE_RELEASE(buf.pBuffer);
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	ID3D11Buffer* Grass::_GetInstanceBuffer( const SGrassPage* pPage )
+	{
+		SPageBuffer& buf = m_pageBuffers[pPage->pageZ * m_layer.GetPagesX() + pPage->pageX];
+		if(buf.pBuffer && buf.version == pPage->version)
+			return buf.pBuffer;
+
+		MemoryTracker::Remove(buf.pBuffer);
+		SAFE_RELEASE(buf.pBuffer);
+
+		// Pages never change once generated, a regenerated page gets a new buffer
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.Usage = D3D11_USAGE_IMMUTABLE;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.ByteWidth = sizeof(SGrassInstance) * (UINT)pPage->instances.size();
+
+		D3D11_SUBRESOURCE_DATA initData;
+		ZeroMemory( &initData, sizeof(initData) );
+		initData.pSysMem = &pPage->instances[0];
+
+		if (FAILED(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, &initData, &buf.pBuffer )))
+		{
+			buf.pBuffer = nullptr;
+			return nullptr;
+		}
+
+		MemoryTracker::AddBuffer(buf.pBuffer, eMemTag_Vegetation, "Grass page");
+		buf.version = pPage->version;
+
+		return buf.pBuffer;
+	}
+	//------------------------------------------------------------------------------------
+	void Grass::Render()
+	{
+		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
+
+		Camera* pCam = g_env.pSceneMgr->GetCamera();
+		const MAT44 matViewProj = pCam->GetViewMatrix() * pCam->GetProjMatrix();
+		const VEC3& camPos = pCam->GetPos();
+
+		PLANE frustumPlane[6];
+		m_pRenderSystem->ExtractFrustumWorldPlanes(frustumPlane, matViewProj);
+
+		m_layer.Cull(&frustumPlane[0].n.x, 6, camPos.x, camPos.z, m_drawPages);
+		if(m_drawPages.empty())
+			return;
+
+		m_pRenderSystem->SetTransform(eTransform_World, MAT44::IDENTITY, false);
+		m_pRenderSystem->SetTransform(eTransform_WorldIT, MAT44::IDENTITY, true);
+
+		pContext->VSSetConstantBuffers( 1, 1, &m_pCB );
+		pContext->PSSetConstantBuffers( 1, 1, &m_pCB );
+
+		m_pMaterial->Activate();
+		pContext->IASetIndexBuffer( m_pBladeIB, DXGI_FORMAT_R16_UINT, 0 );
+
+		const UINT strides[2] = { sizeof(SGrassVertex), sizeof(SGrassInstance) };
+		const UINT offsets[2] = { 0, 0 };
+
+		// Pages come near to far, each is a prefix of its instances thinned by its distance
+		for (size_t i=0; i<m_drawPages.size(); ++i)
+		{
+			const SGrassDrawPage& page = m_drawPages[i];
+
+			ID3D11Buffer* buffers[2] = { m_pBladeVB, _GetInstanceBuffer(page.pPage) };
+			if(!buffers[1])
+				continue;
+
+			pContext->IASetVertexBuffers( 0, 2, buffers, strides, offsets );
+			pContext->DrawIndexedInstanced( m_bladeIndexCount, page.count, 0, 0, 0 );
+
+			PROFILE_COUNTER(eProfileCounter_DrawCall, 1);
+			PROFILE_COUNTER(eProfileCounter_Triangle, page.count * m_bladeIndexCount / 3);
+		}
+	}
+}
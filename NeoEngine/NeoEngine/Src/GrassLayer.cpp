@@ -0,0 +1,456 @@
+#include "GrassLayer.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace Neo
+{
+	// Candidates tried around each active point before it retires
+	static const unsigned int	POISSON_ATTEMPTS	=	30;
+	static const float			TWO_PI				=	6.28318531f;
+
+	namespace
+	{
+		// Full avalanche, so neighbouring inputs give unrelated outputs
+		inline unsigned int Hash(unsigned int v)
+		{
+			v ^= v >> 16;
+			v *= 0x7FEB352D;
+			v ^= v >> 15;
+			v *= 0x846CA68B;
+			v ^= v >> 16;
+			return v;
+		}
+
+		inline float ToUnit(unsigned int v)
+		{
+			return (v >> 8) * (1.0f / 16777216.0f);
+		}
+
+		// Deterministic on every platform, unlike rand()
+		struct SRandom
+		{
+			explicit SRandom(unsigned int seed):state(Hash(seed) | 1) {}
+
+			float	Next()
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				return ToUnit(state);
+			}
+
+			unsigned int	state;
+		};
+
+		// Shortest distance on a torus of the given size
+		inline float WrapDelta(float d, float size)
+		{
+			d = fabsf(d);
+			return std::min(d, size - d);
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	GrassLayer::GrassLayer()
+	:m_densityWidth(0)
+	,m_densityHeight(0)
+	,m_pagesX(0)
+	,m_pagesZ(0)
+	,m_residentCount(0)
+	,m_nextVersion(0)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	GrassLayer::~GrassLayer()
+	{
+		_Clear();
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::_Clear()
+	{
+		for (size_t i=0; i<m_pages.size(); ++i)
+			delete m_pages[i];
+
+		m_pages.clear();
+		m_dirty.clear();
+		m_residentCount = 0;
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::Init( const SGrassLayerDesc& desc, const GrassHeightFunc& heightFunc )
+	{
+		assert(desc.sizeX > 0 && desc.sizeZ > 0 && desc.pageSize > 0);
+		assert(desc.spacing > 0 && desc.spacing * 4 < desc.pageSize);
+		assert(desc.fadeStart < desc.viewDistance);
+
+		_Clear();
+
+		m_desc = desc;
+		m_heightFunc = heightFunc;
+		m_pagesX = (unsigned int)ceilf(desc.sizeX / desc.pageSize);
+		m_pagesZ = (unsigned int)ceilf(desc.sizeZ / desc.pageSize);
+		m_pages.assign(m_pagesX * m_pagesZ, nullptr);
+		m_dirty.assign(m_pagesX * m_pagesZ, false);
+
+		m_density.clear();
+		m_densityWidth = m_densityHeight = 0;
+
+		_BuildPattern();
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::_BuildPattern()
+	{
+		// Bridson's algorithm on a torus the size of a page. Cells are small enough
+		// to hold one point at most, and all the same size so the wrap stays exact.
+		const float size = m_desc.pageSize;
+		const float radius = m_desc.spacing;
+		const int gridSize = (int)ceilf(size * 1.41421356f / radius);
+		const float cellSize = size / gridSize;
+		const int reach = (int)ceilf(radius / cellSize);
+
+		std::vector<int> grid(gridSize * gridSize, -1);
+		std::vector<unsigned int> active;
+		SRandom random(m_desc.seed);
+
+		m_pattern.clear();
+
+		auto addPoint = [&](float x, float z)
+		{
+			SPatternPoint pt;
+			pt.x = x;
+			pt.z = z;
+			pt.rank = 0;
+
+			const int cx = std::min((int)(x / cellSize), gridSize - 1);
+			const int cz = std::min((int)(z / cellSize), gridSize - 1);
+			grid[cz * gridSize + cx] = (int)m_pattern.size();
+			active.push_back((unsigned int)m_pattern.size());
+			m_pattern.push_back(pt);
+		};
+
+		auto isFree = [&](float x, float z) -> bool
+		{
+			const int cx = std::min((int)(x / cellSize), gridSize - 1);
+			const int cz = std::min((int)(z / cellSize), gridSize - 1);
+
+			for (int dz=-reach; dz<=reach; ++dz)
+			{
+				const int row = ((cz + dz) % gridSize + gridSize) % gridSize;
+				for (int dx=-reach; dx<=reach; ++dx)
+				{
+					const int other = grid[row * gridSize + ((cx + dx) % gridSize + gridSize) % gridSize];
+					if(other < 0)
+						continue;
+
+					const float ox = WrapDelta(m_pattern[other].x - x, size);
+					const float oz = WrapDelta(m_pattern[other].z - z, size);
+					if(ox * ox + oz * oz < radius * radius)
+						return false;
+				}
+			}
+
+			return true;
+		};
+
+		addPoint(random.Next() * size, random.Next() * size);
+
+		while (!active.empty())
+		{
+			const unsigned int slot = std::min((unsigned int)(random.Next() * active.size()), (unsigned int)active.size() - 1);
+			const SPatternPoint origin = m_pattern[active[slot]];
+			bool bFound = false;
+
+			for (unsigned int i=0; i<POISSON_ATTEMPTS; ++i)
+			{
+				// Annulus [r, 2r) around the active point
+				const float angle = random.Next() * TWO_PI;
+				const float dist = radius * (1 + random.Next());
+
+				float x = fmodf(origin.x + cosf(angle) * dist + size, size);
+				float z = fmodf(origin.z + sinf(angle) * dist + size, size);
+				if(x >= size) x = 0;
+				if(z >= size) z = 0;
+
+				if (isFree(x, z))
+				{
+					addPoint(x, z);
+					bFound = true;
+					break;
+				}
+			}
+
+			if (!bFound)
+			{
+				active[slot] = active.back();
+				active.pop_back();
+			}
+		}
+
+		for (size_t i=0; i<m_pattern.size(); ++i)
+			m_pattern[i].rank = random.Next();
+
+		std::sort(m_pattern.begin(), m_pattern.end());
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::SetDensityMap( const unsigned char* pDensity, unsigned int width, unsigned int height )
+	{
+		assert(width > 1 && height > 1);
+
+		m_densityWidth = width;
+		m_densityHeight = height;
+		m_density.assign(pDensity, pDensity + width * height);
+
+		InvalidateRegion(m_desc.originX, m_desc.originZ, m_desc.originX + m_desc.sizeX, m_desc.originZ + m_desc.sizeZ);
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::PaintDensity( float x, float z, float radius, float amount )
+	{
+		if(m_density.empty() || radius <= 0)
+			return;
+
+		const float stepX = m_desc.sizeX / (m_densityWidth - 1);
+		const float stepZ = m_desc.sizeZ / (m_densityHeight - 1);
+
+		const int c0 = std::max((int)ceilf((x - radius - m_desc.originX) / stepX), 0);
+		const int r0 = std::max((int)ceilf((z - radius - m_desc.originZ) / stepZ), 0);
+		const int c1 = std::min((int)floorf((x + radius - m_desc.originX) / stepX), (int)m_densityWidth - 1);
+		const int r1 = std::min((int)floorf((z + radius - m_desc.originZ) / stepZ), (int)m_densityHeight - 1);
+		if(c0 > c1 || r0 > r1)
+			return;
+
+		for (int r=r0; r<=r1; ++r)
+		{
+			for (int c=c0; c<=c1; ++c)
+			{
+				const float dx = m_desc.originX + c * stepX - x;
+				const float dz = m_desc.originZ + r * stepZ - z;
+				const float t = 1 - sqrtf(dx * dx + dz * dz) / radius;
+				if(t <= 0)
+					continue;
+
+				// Smoothstep falloff to the rim
+				unsigned char& texel = m_density[r * m_densityWidth + c];
+				const float v = texel + amount * 255 * t * t * (3 - 2 * t);
+				texel = (unsigned char)std::min(std::max(v + 0.5f, 0.0f), 255.0f);
+			}
+		}
+
+		InvalidateRegion(x - radius, z - radius, x + radius, z + radius);
+	}
+	//------------------------------------------------------------------------------------
+	float GrassLayer::GetDensityAt( float x, float z ) const
+	{
+		if(m_density.empty())
+			return 0;
+
+		const float fx = std::min(std::max((x - m_desc.originX) / m_desc.sizeX, 0.0f), 1.0f) * (m_densityWidth - 1);
+		const float fz = std::min(std::max((z - m_desc.originZ) / m_desc.sizeZ, 0.0f), 1.0f) * (m_densityHeight - 1);
+		const unsigned int c = std::min((unsigned int)fx, m_densityWidth - 2);
+		const unsigned int r = std::min((unsigned int)fz, m_densityHeight - 2);
+		const float tx = fx - c, tz = fz - r;
+
+		const unsigned char* pRow0 = &m_density[r * m_densityWidth + c];
+		const unsigned char* pRow1 = pRow0 + m_densityWidth;
+		const float d0 = pRow0[0] + (pRow0[1] - pRow0[0]) * tx;
+		const float d1 = pRow1[0] + (pRow1[1] - pRow1[0]) * tx;
+
+		return (d0 + (d1 - d0) * tz) * (1.0f / 255);
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::InvalidateRegion( float x0, float z0, float x1, float z1 )
+	{
+		const float size = m_desc.pageSize;
+		const int px0 = std::max((int)floorf((x0 - m_desc.originX) / size), 0);
+		const int pz0 = std::max((int)floorf((z0 - m_desc.originZ) / size), 0);
+		const int px1 = std::min((int)floorf((x1 - m_desc.originX) / size), (int)m_pagesX - 1);
+		const int pz1 = std::min((int)floorf((z1 - m_desc.originZ) / size), (int)m_pagesZ - 1);
+
+		for (int pz=pz0; pz<=pz1; ++pz)
+		{
+			for (int px=px0; px<=px1; ++px)
+			{
+				const unsigned int index = pz * m_pagesX + px;
+				if(m_pages[index])
+					m_dirty[index] = true;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	float GrassLayer::_DistanceToPage( float camX, float camZ, unsigned int pageX, unsigned int pageZ ) const
+	{
+		const float size = m_desc.pageSize;
+		const float x0 = m_desc.originX + pageX * size;
+		const float z0 = m_desc.originZ + pageZ * size;
+
+		const float dx = std::max(std::max(x0 - camX, camX - x0 - size), 0.0f);
+		const float dz = std::max(std::max(z0 - camZ, camZ - z0 - size), 0.0f);
+
+		return sqrtf(dx * dx + dz * dz);
+	}
+	//------------------------------------------------------------------------------------
+	float GrassLayer::GetThinning( float distance ) const
+	{
+		const float t = (distance - m_desc.fadeStart) / (m_desc.viewDistance - m_desc.fadeStart);
+		return std::min(std::max(1 - t, 0.0f), 1.0f);
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::Update( float camX, float camZ, unsigned int maxPages )
+	{
+		if(m_pages.empty())
+			return;
+
+		const float size = m_desc.pageSize;
+		const float range = m_desc.viewDistance;
+		// Pages are kept a little past the range so moving back and forth doesn't regenerate them
+		const float keepRange = range + size;
+
+		std::vector<std::pair<float, unsigned int>> candidates;
+
+		for (unsigned int index=0; index<m_pages.size(); ++index)
+		{
+			const unsigned int px = index % m_pagesX, pz = index / m_pagesX;
+			const float dist = _DistanceToPage(camX, camZ, px, pz);
+
+			if (m_pages[index])
+			{
+				if (dist > keepRange)
+				{
+					delete m_pages[index];
+					m_pages[index] = nullptr;
+					m_dirty[index] = false;
+					--m_residentCount;
+				}
+				else if (m_dirty[index])
+				{
+					// Stale pages go first, they are on screen already
+					candidates.push_back(std::make_pair(-1.0f, index));
+				}
+			}
+			else if (dist <= range)
+			{
+				candidates.push_back(std::make_pair(dist, index));
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+
+		// A few pages a frame is cheap enough here, the rest waits for the next updates
+		const unsigned int numPages = std::min((unsigned int)candidates.size(), maxPages);
+		for (unsigned int i=0; i<numPages; ++i)
+		{
+			const unsigned int index = candidates[i].second;
+			SGrassPage* pPage = m_pages[index];
+			if (!pPage)
+			{
+				pPage = new SGrassPage;
+				m_pages[index] = pPage;
+				++m_residentCount;
+			}
+
+			GeneratePage(index % m_pagesX, index / m_pagesX, *pPage);
+			pPage->version = ++m_nextVersion;
+			m_dirty[index] = false;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::GeneratePage( unsigned int pageX, unsigned int pageZ, SGrassPage& page ) const
+	{
+		assert(pageX < m_pagesX && pageZ < m_pagesZ);
+
+		const float x0 = m_desc.originX + pageX * m_desc.pageSize;
+		const float z0 = m_desc.originZ + pageZ * m_desc.pageSize;
+		const float maxX = m_desc.originX + m_desc.sizeX;
+		const float maxZ = m_desc.originZ + m_desc.sizeZ;
+		const unsigned int pageSeed = Hash(m_desc.seed ^ Hash(pageX + Hash(pageZ)));
+
+		page.pageX = pageX;
+		page.pageZ = pageZ;
+		page.version = 0;
+		page.instances.clear();
+		page.minY = page.maxY = 0;
+
+		for (unsigned int i=0; i<m_pattern.size(); ++i)
+		{
+			const SPatternPoint& pt = m_pattern[i];
+			const float x = x0 + pt.x;
+			const float z = z0 + pt.z;
+
+			// Last pages may stick out of the layer
+			if(x > maxX || z > maxZ)
+				continue;
+
+			if(pt.rank >= GetDensityAt(x, z))
+				continue;
+
+			const unsigned int h = Hash(pageSeed + i);
+
+			SGrassInstance inst;
+			inst.x = x;
+			inst.y = m_heightFunc ? m_heightFunc(x, z) : 0;
+			inst.z = z;
+			inst.scale = m_desc.minScale + (m_desc.maxScale - m_desc.minScale) * ToUnit(h);
+			inst.rotation = ToUnit(Hash(h)) * TWO_PI;
+			inst.tint = ToUnit(Hash(h + 1));
+
+			if (page.instances.empty())
+			{
+				page.minY = inst.y;
+				page.maxY = inst.y;
+			}
+
+			page.minY = std::min(page.minY, inst.y);
+			page.maxY = std::max(page.maxY, inst.y + m_desc.bladeHeight * inst.scale);
+
+			page.instances.push_back(inst);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void GrassLayer::Cull( const float* pPlanes, unsigned int numPlanes, float camX, float camZ, std::vector<SGrassDrawPage>& pages ) const
+	{
+		pages.clear();
+
+		const float size = m_desc.pageSize;
+		for (unsigned int index=0; index<m_pages.size(); ++index)
+		{
+			const SGrassPage* pPage = m_pages[index];
+			if(!pPage || pPage->instances.empty())
+				continue;
+
+			const float dist = _DistanceToPage(camX, camZ, pPage->pageX, pPage->pageZ);
+			const unsigned int count = (unsigned int)ceilf(pPage->instances.size() * GetThinning(dist));
+			if(count == 0)
+				continue;
+
+			// Box against each plane, by its corner furthest along the normal
+			const float minX = m_desc.originX + pPage->pageX * size;
+			const float minZ = m_desc.originZ + pPage->pageZ * size;
+			bool bVisible = true;
+
+			for (unsigned int i=0; i<numPlanes && bVisible; ++i)
+			{
+				const float* p = pPlanes + i * 4;
+				const float x = p[0] >= 0 ? minX + size : minX;
+				const float y = p[1] >= 0 ? pPage->maxY : pPage->minY;
+				const float z = p[2] >= 0 ? minZ + size : minZ;
+
+				bVisible = p[0] * x + p[1] * y + p[2] * z + p[3] >= 0;
+			}
+
+			if (bVisible)
+			{
+				SGrassDrawPage draw;
+				draw.pPage = pPage;
+				draw.count = count;
+				draw.distance = dist;
+				pages.push_back(draw);
+			}
+		}
+
+		// Near to far for early z
+		std::sort(pages.begin(), pages.end(), [](const SGrassDrawPage& a, const SGrassDrawPage& b)
+		{
+			return a.distance < b.distance;
+		});
+	}
+}
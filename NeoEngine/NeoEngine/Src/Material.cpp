@@ -1,11 +1,13 @@
 #include "stdafx.h"
 #include "Material.h"
-#include <D3Dcompiler.h>
 #include "D3D11RenderSystem.h"
 #include "D3D11Texture.h"
 #include "SceneManager.h"
 #include "SSAO.h"
 #include "ShadowMap.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ShaderLibrary.h"
 
 namespace Neo
 {
@@ -16,19 +18,23 @@ namespace Neo
 	SColor SColor::YELLOW	=	SColor(1.0f, 1.0f, 0.0f);
 	SColor SColor::NICE_BLUE =	SColor(0.0f, 0.125f, 0.3f);
 
+	uint32 Material::s_nextId = 0;
+
+	// Parent pointer and override block pointer after the ref count
+	static_assert(sizeof(MaterialInstance) <= 4 * sizeof(void*), "MaterialInstance should stay 16 bytes on Win32!");
+
 	//-------------------------------------------------------------------------------
 	Material::Material(eVertexType type)
 	:m_pRenderSystem(g_env.pRenderSystem)
-	,ambient(SColor::WHITE)
-	,diffuse(SColor::WHITE)
-	,specular(SColor::WHITE)
-	,shiness(20)
-	,m_pVertexShader(nullptr)
-	,m_pPixelShader(nullptr)
-	,m_pHullShader(nullptr)
-	,m_pDomainShader(nullptr)
-	,m_pVS_WithClipPlane(nullptr)
-	,m_pInputLayout(nullptr)
+	,m_id(++s_nextId)
+	,m_ambient(SColor::WHITE)
+	,m_diffuse(SColor::WHITE)
+	,m_specular(SColor::WHITE)
+	,m_shiness(20)
+	,m_pCBuffer(nullptr)
+	,m_bCBufferDirty(true)
+	,m_pProgram(nullptr)
+	,m_pTessProgram(nullptr)
 	,m_shaderFlag(0)
 	,m_cullMode(D3D11_CULL_BACK)
 	,m_vertType(type)
@@ -50,12 +56,11 @@ namespace Neo
 	//-------------------------------------------------------------------------------
 	Material::~Material()
 	{
-		SAFE_RELEASE(m_pInputLayout);
-		SAFE_RELEASE(m_pVertexShader);
-		SAFE_RELEASE(m_pPixelShader);
-		SAFE_RELEASE(m_pHullShader);
-		SAFE_RELEASE(m_pDomainShader);
-		SAFE_RELEASE(m_pVS_WithClipPlane);
+		SAFE_RELEASE(m_pProgram);
+		SAFE_RELEASE(m_pTessProgram);
+
+		MemoryTracker::Remove(m_pCBuffer);
+		SAFE_RELEASE(m_pCBuffer);
 
 		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
 		{
@@ -66,144 +71,88 @@ namespace Neo
 	//-------------------------------------------------------------------------------
 	bool Material::InitShader( const STRING& vsFileName, const STRING& psFileName, uint32 shaderFalg, const D3D_SHADER_MACRO* pMacro )
 	{
-		HRESULT hr = S_OK;
-		ID3DBlob* pVSBlob = NULL;
-		ID3DBlob* pPSBlob = NULL;
-
 		m_shaderFlag = shaderFalg;
 
-		const std::vector<D3D_SHADER_MACRO> vecMacro = _InternelInitShader(pMacro);
-
-		// Compile
-		V_RETURN(_CompileShaderFromFile( vsFileName.c_str(), "VS", "vs_4_0", vecMacro, &pVSBlob ));
-		V_RETURN(_CompileShaderFromFile( psFileName.c_str(), "PS", "ps_4_0", vecMacro, &pPSBlob ));
-
-		// Create shader
-		V_RETURN(m_pRenderSystem->GetDevice()->CreateVertexShader( pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), NULL, &m_pVertexShader ));
-		V_RETURN(m_pRenderSystem->GetDevice()->CreatePixelShader( pPSBlob->GetBufferPointer(), pPSBlob->GetBufferSize(), NULL, &m_pPixelShader ));
-
-		m_vsCode.resize(pVSBlob->GetBufferSize());
-		memcpy_s(&m_vsCode[0], m_vsCode.size(), pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize());
-
-		pVSBlob->Release();
-		pPSBlob->Release();
+		ShaderMacros vecMacro;
+		_InternelInitShader(pMacro, vecMacro);
 
-		// Create clip plane shader
-		if (m_shaderFlag & eShaderFlag_EnableClipPlane)
-		{
-			V_RETURN(_CompileShaderFromFile( vsFileName.c_str(), "VS_ClipPlane", "vs_4_0", vecMacro, &pVSBlob ));
-
-			V_RETURN(m_pRenderSystem->GetDevice()->CreateVertexShader( pVSBlob->GetBufferPointer(), pVSBlob->GetBufferSize(), NULL, &m_pVS_WithClipPlane ));
-
-			pVSBlob->Release();
-		}
+		// Materials with the same combination share the shader objects
+		SAFE_RELEASE(m_pProgram);
+		m_pProgram = m_pRenderSystem->GetShaderLibrary()->GetProgram(vsFileName, psFileName, m_shaderFlag, m_vertType, &vecMacro[0]);
 
-		// Create vertex layout
-		_CreateVertexLayout();
-
-		return true;
+		return m_pProgram != nullptr;
 	}
 	//------------------------------------------------------------------------------------
 	bool Material::InitTessellationShader( const STRING& filename, uint32 shaderFalg, const D3D_SHADER_MACRO* pMacro )
 	{
-		HRESULT hr = S_OK;
-		ID3DBlob* pHSBlob = NULL;
-		ID3DBlob* pDSBlob = NULL;
-
 		m_shaderFlag = shaderFalg;
 
-		const std::vector<D3D_SHADER_MACRO> vecMacro = _InternelInitShader(pMacro);
-
-		V_RETURN(_CompileShaderFromFile( filename.c_str(), "HS", "hs_5_0", vecMacro, &pHSBlob ));
-		V_RETURN(_CompileShaderFromFile( filename.c_str(), "DS", "ds_5_0", vecMacro, &pDSBlob ));
-
-		V_RETURN(m_pRenderSystem->GetDevice()->CreateHullShader( pHSBlob->GetBufferPointer(), pHSBlob->GetBufferSize(), NULL, &m_pHullShader ));
-		V_RETURN(m_pRenderSystem->GetDevice()->CreateDomainShader( pDSBlob->GetBufferPointer(), pDSBlob->GetBufferSize(), NULL, &m_pDomainShader ));
+		ShaderMacros vecMacro;
+		_InternelInitShader(pMacro, vecMacro);
 
-		pHSBlob->Release();
-		pDSBlob->Release();
+		SAFE_RELEASE(m_pTessProgram);
+		m_pTessProgram = m_pRenderSystem->GetShaderLibrary()->GetTessellationProgram(filename, m_shaderFlag, &vecMacro[0]);
 
-		return true;
+		return m_pTessProgram != nullptr;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 Material::GetShaderId() const
+	{
+		return m_pProgram ? m_pProgram->GetId() : 0;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 Material::GetSortKey() const
+	{
+		return (GetShaderId() << 16) | (m_id & 0xffff);
 	}
 	//-------------------------------------------------------------------------------
-	bool Material::_CompileShaderFromFile( const char* szFileName, const char* szEntryPoint, const char* szShaderModel, 
-		const std::vector<D3D_SHADER_MACRO>& vecMacro, ID3DBlob** ppBlobOut )
+	void Material::Activate()
 	{
-		HRESULT hr = S_OK;
-
-		const D3D_SHADER_MACRO* pMacro = vecMacro.size() == 1 ? nullptr : &vecMacro[0];
-
-		DWORD dwShaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
-#if defined( DEBUG ) || defined( _DEBUG )
-		dwShaderFlags |= D3DCOMPILE_DEBUG;
-#endif
-
-		ID3DBlob* pErrorBlob;
-		hr = D3DX11CompileFromFile( szFileName, pMacro, NULL, szEntryPoint, szShaderModel, 
-			dwShaderFlags, 0, NULL, ppBlobOut, &pErrorBlob, NULL );
-		if( FAILED(hr) )
+		_UpdateCBuffer();
+		_Activate(m_pTexture, m_pCBuffer);
+	}
+	//------------------------------------------------------------------------------------
+	void Material::_UpdateCBuffer()
+	{
+		if (m_bCBufferDirty)
 		{
-			if( pErrorBlob != NULL )
-			{
-				MessageBoxA(nullptr, (char*)pErrorBlob->GetBufferPointer(), "Error", MB_OK | MB_ICONERROR);
-			}
-			if( pErrorBlob ) pErrorBlob->Release();
-			return false;
+			_UploadCBuffer(m_pCBuffer, m_ambient, m_diffuse, m_specular, m_shiness);
+			m_bCBufferDirty = false;
 		}
-		if( pErrorBlob ) pErrorBlob->Release();
-
-		return true;
 	}
-	//-------------------------------------------------------------------------------
-	void Material::_CreateVertexLayout()
+	//------------------------------------------------------------------------------------
+	void Material::_UploadCBuffer( ID3D11Buffer*& pCBuffer, const SColor& ambient, const SColor& diffuse,
+		const SColor& specular, float shiness )
 	{
-		switch (m_vertType)
-		{
-		case eVertexType_General:
-			{
-				D3D11_INPUT_ELEMENT_DESC layout[] =
-				{
-					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				};
-
-				SAFE_RELEASE(m_pInputLayout);
-
-				HRESULT hr = m_pRenderSystem->GetDevice()->CreateInputLayout( 
-					layout, ARRAYSIZE(layout), &m_vsCode[0], m_vsCode.size(), &m_pInputLayout );
-
-				assert(SUCCEEDED( hr ) && "Create vertex input layout failed!");
-			}
-			break;
-
-		case eVertexType_TreeLeaf:
-			{
-				D3D11_INPUT_ELEMENT_DESC layout[] =
-				{
-					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 1, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 2, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 3, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },					
-				};
+		D3D11RenderSystem* pRenderSystem = g_env.pRenderSystem;
 
-				SAFE_RELEASE(m_pInputLayout);
-
-				HRESULT hr = m_pRenderSystem->GetDevice()->CreateInputLayout( 
-					layout, ARRAYSIZE(layout), &m_vsCode[0], m_vsCode.size(), &m_pInputLayout );
+		if (!pCBuffer)
+		{
+			D3D11_BUFFER_DESC bd;
+			ZeroMemory( &bd, sizeof(D3D11_BUFFER_DESC) );
+			bd.Usage = D3D11_USAGE_DEFAULT;
+			bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			bd.CPUAccessFlags = 0;
+			bd.ByteWidth = sizeof(cBufferMaterial);
+
+			HRESULT hr = pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &pCBuffer );
+			assert(SUCCEEDED(hr) && "Create material cbuffer failed!");
+			MemoryTracker::AddBuffer(pCBuffer, eMemTag_Material, "Material cbuffer");
+		}
 
-				assert(SUCCEEDED( hr ) && "Create vertex input layout failed!");
-			}
-			break;
+		cBufferMaterial data;
+		data.ambient = ambient.GetAsDx();
+		data.diffuse = diffuse.GetAsDx();
+		data.specular = specular.GetAsDx();
+		data.shiness = shiness;
+		data.padding[0] = data.padding[1] = data.padding[2] = 0;
 
-		default: assert(0); break;
-		}
+		pRenderSystem->GetDeviceContext()->UpdateSubresource( pCBuffer, 0, NULL, &data, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(data));
+		PROFILE_COUNTER(eProfileCounter_MaterialUpload, 1);
 	}
 	//-------------------------------------------------------------------------------
-	void Material::Activate()
+	void Material::_Activate( D3D11Texture* const* ppTextures, ID3D11Buffer* pCBuffer )
 	{
 		ID3D11DeviceContext* pDeviceContext = m_pRenderSystem->GetDeviceContext();
 
@@ -228,20 +177,28 @@ namespace Neo
 			m_pRenderSystem->SetRasterizeDesc(desc);
 		}
 
+		assert(m_pProgram && "Material activated before InitShader!");
+
 		// Clip plane
-		if (m_pRenderSystem->IsClipPlaneEnabled() && m_pVS_WithClipPlane)
-			pDeviceContext->VSSetShader( m_pVS_WithClipPlane, NULL, 0 );
+		if (m_pRenderSystem->IsClipPlaneEnabled() && m_pProgram->GetClipPlaneVS())
+			pDeviceContext->VSSetShader( m_pProgram->GetClipPlaneVS(), NULL, 0 );
 		else			
-			pDeviceContext->VSSetShader( m_pVertexShader, NULL, 0 );
+			pDeviceContext->VSSetShader( m_pProgram->GetVertexShader(), NULL, 0 );
 
 		// VS PS HS DS
-		pDeviceContext->PSSetShader( m_pPixelShader, NULL, 0 );
-		pDeviceContext->IASetInputLayout( m_pInputLayout );
+		pDeviceContext->PSSetShader( m_pProgram->GetPixelShader(), NULL, 0 );
+		pDeviceContext->IASetInputLayout( m_pProgram->GetInputLayout() );
+
+		PROFILE_COUNTER(eProfileCounter_StateChange, 1);
 
-		if (m_pHullShader && m_pDomainShader)
+		// Binding only, the content is uploaded when it changes
+		pDeviceContext->VSSetConstantBuffers( MATERIAL_CBUFFER_SLOT, 1, &pCBuffer );
+		pDeviceContext->PSSetConstantBuffers( MATERIAL_CBUFFER_SLOT, 1, &pCBuffer );
+
+		if (m_pTessProgram)
 		{
-			pDeviceContext->HSSetShader(m_pHullShader, nullptr, 0);
-			pDeviceContext->DSSetShader(m_pDomainShader, nullptr, 0);
+			pDeviceContext->HSSetShader(m_pTessProgram->GetHullShader(), nullptr, 0);
+			pDeviceContext->DSSetShader(m_pTessProgram->GetDomainShader(), nullptr, 0);
 
 			m_pRenderSystem->UpdateGlobalCBuffer(true);
 
@@ -255,7 +212,7 @@ namespace Neo
 		// Texture stage
 		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
 		{
-			m_pRenderSystem->SetActiveTexture(i, m_pTexture[i], m_pSamplerState[i]);
+			m_pRenderSystem->SetActiveTexture(i, ppTextures[i], m_pSamplerState[i]);
 		}
 	}
 	//------------------------------------------------------------------------------------
@@ -289,15 +246,16 @@ namespace Neo
 		pDeviceContext->DSSetShader(nullptr, nullptr, 0);
 	}
 	//------------------------------------------------------------------------------------
-	std::vector<D3D_SHADER_MACRO> Material::_InternelInitShader( const D3D_SHADER_MACRO* pMacro )
+	void Material::_InternelInitShader( const D3D_SHADER_MACRO* pMacro, ShaderMacros& retMacros )
 	{
-		std::vector<D3D_SHADER_MACRO> retMacros;
+		retMacros.reserve(8);
 
+		// User macros end with a null name
 		if (pMacro)
 		{
-			for (int i=0; i<sizeof(pMacro)/sizeof(pMacro[0]); ++i)
+			for (; pMacro->Name; ++pMacro)
 			{
-				retMacros.push_back(pMacro[i]);
+				retMacros.push_back(*pMacro);
 			}
 		}
 
@@ -344,8 +302,157 @@ namespace Neo
 
 		D3D_SHADER_MACRO macro = { 0, 0 };
 		retMacros.push_back(macro);
+	}
+	//------------------------------------------------------------------------------------
+	MaterialInstance::SOverrides::SOverrides()
+	:textureMask(0)
+	,bParams(false)
+	,shiness(0)
+	,pCBuffer(nullptr)
+	,bCBufferDirty(true)
+	{
+		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
+			pTexture[i] = nullptr;
+	}
+	//------------------------------------------------------------------------------------
+	MaterialInstance::MaterialInstance( Material* pParent )
+	:m_pParent(pParent)
+	,m_pOverrides(nullptr)
+	{
+		assert(pParent);
+		m_pParent->AddRef();
+	}
+	//------------------------------------------------------------------------------------
+	MaterialInstance::~MaterialInstance()
+	{
+		if (m_pOverrides)
+		{
+			for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
+				SAFE_RELEASE(m_pOverrides->pTexture[i]);
 
-		return std::move(retMacros);
+			MemoryTracker::Remove(m_pOverrides->pCBuffer);
+			SAFE_RELEASE(m_pOverrides->pCBuffer);
+			SAFE_DELETE(m_pOverrides);
+		}
+
+		SAFE_RELEASE(m_pParent);
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::Activate()
+	{
+		// Own params get their own cbuffer, otherwise the parent's is shared
+		ID3D11Buffer* pCBuffer;
+		if (m_pOverrides && m_pOverrides->bParams)
+		{
+			if (m_pOverrides->bCBufferDirty)
+			{
+				Material::_UploadCBuffer(m_pOverrides->pCBuffer, m_pOverrides->ambient, m_pOverrides->diffuse,
+					m_pOverrides->specular, m_pOverrides->shiness);
+				m_pOverrides->bCBufferDirty = false;
+			}
+
+			pCBuffer = m_pOverrides->pCBuffer;
+		}
+		else
+		{
+			m_pParent->_UpdateCBuffer();
+			pCBuffer = m_pParent->m_pCBuffer;
+		}
+
+		if (!m_pOverrides || !m_pOverrides->textureMask)
+		{
+			m_pParent->_Activate(m_pParent->m_pTexture, pCBuffer);
+			return;
+		}
+
+		D3D11Texture* textures[MAX_TEXTURE_STAGE];
+		for(int i=0; i<MAX_TEXTURE_STAGE; ++i)
+			textures[i] = (m_pOverrides->textureMask & (1 << i)) ? m_pOverrides->pTexture[i] : m_pParent->m_pTexture[i];
+
+		m_pParent->_Activate(textures, pCBuffer);
+	}
+	//------------------------------------------------------------------------------------
+	MaterialInstance::SOverrides& MaterialInstance::_GetOverrides()
+	{
+		if(!m_pOverrides)
+			m_pOverrides = new SOverrides;
+
+		return *m_pOverrides;
+	}
+	//------------------------------------------------------------------------------------
+	MaterialInstance::SOverrides& MaterialInstance::_GetParamOverrides()
+	{
+		SOverrides& overrides = _GetOverrides();
+
+		// Start from the parent's values, only the one being set differs.
+		// Later changes to the parent's params don't reach this instance.
+		if (!overrides.bParams)
+		{
+			overrides.ambient = m_pParent->GetAmbient();
+			overrides.diffuse = m_pParent->GetDiffuse();
+			overrides.specular = m_pParent->GetSpecular();
+			overrides.shiness = m_pParent->GetShiness();
+			overrides.bParams = true;
+		}
+
+		overrides.bCBufferDirty = true;
+
+		return overrides;
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::SetTexture( int stage, D3D11Texture* pTexture )
+	{
+		assert(stage >= 0 && stage < MAX_TEXTURE_STAGE);
+
+		SOverrides& overrides = _GetOverrides();
+
+		if(pTexture)
+			pTexture->AddRef();
+		SAFE_RELEASE(overrides.pTexture[stage]);
+
+		overrides.pTexture[stage] = pTexture;
+		overrides.textureMask |= 1 << stage;
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::ClearTexture( int stage )
+	{
+		assert(stage >= 0 && stage < MAX_TEXTURE_STAGE);
+
+		if(!m_pOverrides)
+			return;
+
+		SAFE_RELEASE(m_pOverrides->pTexture[stage]);
+		m_pOverrides->textureMask &= ~(1 << stage);
+	}
+	//------------------------------------------------------------------------------------
+	D3D11Texture* MaterialInstance::GetTexture( int stage ) const
+	{
+		assert(stage >= 0 && stage < MAX_TEXTURE_STAGE);
+
+		if(m_pOverrides && (m_pOverrides->textureMask & (1 << stage)))
+			return m_pOverrides->pTexture[stage];
+
+		return m_pParent->GetTexture(stage);
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::SetAmbient( const SColor& color )
+	{
+		_GetParamOverrides().ambient = color;
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::SetDiffuse( const SColor& color )
+	{
+		_GetParamOverrides().diffuse = color;
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::SetSpecular( const SColor& color )
+	{
+		_GetParamOverrides().specular = color;
+	}
+	//------------------------------------------------------------------------------------
+	void MaterialInstance::SetShiness( float shiness )
+	{
+		_GetParamOverrides().shiness = shiness;
 	}
 }
 
@@ -113,7 +113,7 @@ namespace Common
 		float zz = quat.z * quat.z;
 
 		m00 = 1 - 2 * (yy + zz);	m01 = 2 * (xy + zw);	m02 = 2 * (xz - yw);	m03 = 0;
-		m10 = 2 * (xy - zw);		m11 = 1 - 2 * (xx + zz); m12 = 2 * (yz = xw);	m13 = 0;
+		m10 = 2 * (xy - zw);		m11 = 1 - 2 * (xx + zz); m12 = 2 * (yz + xw);	m13 = 0;
 		m20 = 2 * (xz + yw);		m21 = 2 * (yz - xw);	m22 = 1 - 2 * (xx + yy); m23 = 0;
 		m30 = 0;					m31 = 0;				m32 = 0;				m33 = 1;
 	}
@@ -0,0 +1,318 @@
+#include "stdafx.h"
+#include "MemoryTracker.h"
+
+namespace Neo
+{
+	namespace
+	{
+		struct SBlockHeader
+		{
+			size_t			bytes;
+			const char*		name;
+			uint32			tag;
+		};
+
+		// Keeps the user block 16 byte aligned for SSE data
+		const size_t	HEADER_SIZE	=	(sizeof(SBlockHeader) + 15) & ~15;
+
+		struct SResource
+		{
+			eMemTag			tag;
+			eMemPool		pool;
+			size_t			bytes;
+			STRING			name;
+		};
+
+		struct STrackerState
+		{
+			STrackerState()		{ InitializeCriticalSection(&lock); }
+			~STrackerState()	{ DeleteCriticalSection(&lock); }
+
+			CRITICAL_SECTION							lock;
+			MemoryTracker::SStat						tags[eMemTag_Max][eMemPool_Max];
+			std::map<STRING, MemoryTracker::SStat>		names[eMemPool_Max];
+			std::unordered_map<const void*, SResource>	resources;
+		};
+
+		STrackerState	g_state;
+
+		struct SScopedLock
+		{
+			SScopedLock()	{ EnterCriticalSection(&g_state.lock); }
+			~SScopedLock()	{ LeaveCriticalSection(&g_state.lock); }
+		};
+
+		void FormatBytes(char* szBuf, size_t bufSize, double bytes, bool bSigned)
+		{
+			const double mb = bytes / (1024.0 * 1024.0);
+			if (fabs(mb) >= 0.1)
+				sprintf_s(szBuf, bufSize, bSigned ? "%+.1f MB" : "%.1f MB", mb);
+			else
+				sprintf_s(szBuf, bufSize, bSigned ? "%+.1f KB" : "%.1f KB", bytes / 1024.0);
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::_Account( eMemTag tag, eMemPool pool, const char* name, size_t bytes, bool bAdd )
+	{
+		SStat* stats[2] = { &g_state.tags[tag][pool], name ? &g_state.names[pool][name] : nullptr };
+
+		for (int i=0; i<2; ++i)
+		{
+			SStat* pStat = stats[i];
+			if(!pStat)
+				continue;
+
+			if (bAdd)
+			{
+				pStat->current += bytes;
+				pStat->peak = max(pStat->peak, pStat->current);
+				++pStat->count;
+			}
+			else
+			{
+				assert(pStat->current >= bytes && pStat->count > 0);
+				pStat->current -= bytes;
+				--pStat->count;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void* MemoryTracker::Alloc( size_t bytes, eMemTag tag, const char* name )
+	{
+		char* p = (char*)_aligned_malloc(HEADER_SIZE + bytes, 16);
+		if(!p)
+			return nullptr;
+
+		SBlockHeader* pHeader = (SBlockHeader*)p;
+		pHeader->bytes = bytes;
+		pHeader->name = name;
+		pHeader->tag = tag;
+
+		{
+			SScopedLock lock;
+			_Account(tag, eMemPool_CPU, name, bytes, true);
+		}
+
+		return p + HEADER_SIZE;
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::Free( void* p )
+	{
+		if(!p)
+			return;
+
+		SBlockHeader* pHeader = (SBlockHeader*)((char*)p - HEADER_SIZE);
+
+		{
+			SScopedLock lock;
+			_Account((eMemTag)pHeader->tag, eMemPool_CPU, pHeader->name, pHeader->bytes, false);
+		}
+
+		_aligned_free(pHeader);
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::Add( const void* owner, eMemTag tag, eMemPool pool, size_t bytes, const STRING& name )
+	{
+		assert(owner);
+
+		SScopedLock lock;
+
+		auto iter = g_state.resources.find(owner);
+		if (iter != g_state.resources.end())
+		{
+			const SResource& old = iter->second;
+			_Account(old.tag, old.pool, old.name.c_str(), old.bytes, false);
+		}
+
+		SResource& res = g_state.resources[owner];
+		res.tag = tag;
+		res.pool = pool;
+		res.bytes = bytes;
+		res.name = name.empty() ? GetTagName(tag) : name;
+
+		_Account(tag, pool, res.name.c_str(), bytes, true);
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::Remove( const void* owner )
+	{
+		SScopedLock lock;
+
+		auto iter = g_state.resources.find(owner);
+		if(iter == g_state.resources.end())
+			return;
+
+		const SResource& res = iter->second;
+		_Account(res.tag, res.pool, res.name.c_str(), res.bytes, false);
+
+		g_state.resources.erase(iter);
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::AddBuffer( ID3D11Buffer* pBuffer, eMemTag tag, const STRING& name )
+	{
+		if(!pBuffer)
+			return;
+
+		D3D11_BUFFER_DESC desc;
+		pBuffer->GetDesc(&desc);
+
+		Add(pBuffer, tag, eMemPool_GPU, desc.ByteWidth, name);
+	}
+	//------------------------------------------------------------------------------------
+	MemoryTracker::SStat MemoryTracker::GetTagStat( eMemTag tag, eMemPool pool )
+	{
+		SScopedLock lock;
+		return g_state.tags[tag][pool];
+	}
+	//------------------------------------------------------------------------------------
+	MemoryTracker::SStat MemoryTracker::GetNameStat( const STRING& name, eMemPool pool )
+	{
+		SScopedLock lock;
+
+		auto iter = g_state.names[pool].find(name);
+		return iter != g_state.names[pool].end() ? iter->second : SStat();
+	}
+	//------------------------------------------------------------------------------------
+	size_t MemoryTracker::GetTotal( eMemPool pool )
+	{
+		SScopedLock lock;
+
+		size_t total = 0;
+		for (int i=0; i<eMemTag_Max; ++i)
+			total += g_state.tags[i][pool].current;
+
+		return total;
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::TakeSnapshot( SSnapshot& snapshot )
+	{
+		SScopedLock lock;
+
+		for (int iPool=0; iPool<eMemPool_Max; ++iPool)
+		{
+			for (int iTag=0; iTag<eMemTag_Max; ++iTag)
+				snapshot.tags[iTag][iPool] = g_state.tags[iTag][iPool].current;
+
+			snapshot.names[iPool].clear();
+			const std::map<STRING, SStat>& names = g_state.names[iPool];
+			for (auto iter=names.begin(); iter!=names.end(); ++iter)
+			{
+				if(iter->second.current > 0)
+					snapshot.names[iPool][iter->first] = iter->second.current;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::Diff( const SSnapshot& a, const SSnapshot& b, StringVector& lines, uint32 maxNames )
+	{
+		static const char* POOL_NAMES[eMemPool_Max] = { "CPU", "GPU" };
+
+		char szBuf[128], szBytes[32];
+
+		for (int iPool=0; iPool<eMemPool_Max; ++iPool)
+		{
+			for (int iTag=0; iTag<eMemTag_Max; ++iTag)
+			{
+				const double delta = (double)b.tags[iTag][iPool] - (double)a.tags[iTag][iPool];
+				if(delta == 0)
+					continue;
+
+				FormatBytes(szBytes, sizeof(szBytes), delta, true);
+				sprintf_s(szBuf, sizeof(szBuf), "%s %s %s", POOL_NAMES[iPool], GetTagName((eMemTag)iTag), szBytes);
+				lines.push_back(szBuf);
+			}
+		}
+
+		// Largest changes of single resources
+		typedef std::pair<double, std::pair<int, STRING>> NameDelta;
+		std::vector<NameDelta> deltas;
+
+		for (int iPool=0; iPool<eMemPool_Max; ++iPool)
+		{
+			const std::map<STRING, size_t>& namesA = a.names[iPool];
+			const std::map<STRING, size_t>& namesB = b.names[iPool];
+
+			for (auto iter=namesB.begin(); iter!=namesB.end(); ++iter)
+			{
+				auto iterA = namesA.find(iter->first);
+				const double delta = (double)iter->second - (iterA != namesA.end() ? (double)iterA->second : 0);
+				if(delta != 0)
+					deltas.push_back(std::make_pair(delta, std::make_pair(iPool, iter->first)));
+			}
+
+			for (auto iter=namesA.begin(); iter!=namesA.end(); ++iter)
+			{
+				if(namesB.find(iter->first) == namesB.end())
+					deltas.push_back(std::make_pair(-(double)iter->second, std::make_pair(iPool, iter->first)));
+			}
+		}
+
+		std::sort(deltas.begin(), deltas.end(), [](const NameDelta& lhs, const NameDelta& rhs)
+		{
+			return fabs(lhs.first) > fabs(rhs.first);
+		});
+
+		for (size_t i=0; i<deltas.size() && i<maxNames; ++i)
+		{
+			FormatBytes(szBytes, sizeof(szBytes), deltas[i].first, true);
+			sprintf_s(szBuf, sizeof(szBuf), "  %s %s %s", POOL_NAMES[deltas[i].second.first],
+				deltas[i].second.second.c_str(), szBytes);
+			lines.push_back(szBuf);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MemoryTracker::GetSummary( StringVector& lines )
+	{
+		SScopedLock lock;
+
+		char szBuf[128], szCur[32], szPeak[32];
+
+		size_t totals[eMemPool_Max] = { 0 };
+		for (int iTag=0; iTag<eMemTag_Max; ++iTag)
+		{
+			for (int iPool=0; iPool<eMemPool_Max; ++iPool)
+				totals[iPool] += g_state.tags[iTag][iPool].current;
+		}
+
+		char szCpu[32], szGpu[32];
+		FormatBytes(szCpu, sizeof(szCpu), (double)totals[eMemPool_CPU], false);
+		FormatBytes(szGpu, sizeof(szGpu), (double)totals[eMemPool_GPU], false);
+		sprintf_s(szBuf, sizeof(szBuf), "Memory CPU %s GPU %s", szCpu, szGpu);
+		lines.push_back(szBuf);
+
+		for (int iTag=0; iTag<eMemTag_Max; ++iTag)
+		{
+			const SStat& cpu = g_state.tags[iTag][eMemPool_CPU];
+			const SStat& gpu = g_state.tags[iTag][eMemPool_GPU];
+			if(cpu.peak == 0 && gpu.peak == 0)
+				continue;
+
+			STRING line(GetTagName((eMemTag)iTag));
+
+			const SStat* stats[eMemPool_Max] = { &cpu, &gpu };
+			const char* labels[eMemPool_Max] = { " cpu ", " gpu " };
+			for (int iPool=0; iPool<eMemPool_Max; ++iPool)
+			{
+				if(stats[iPool]->peak == 0)
+					continue;
+
+				FormatBytes(szCur, sizeof(szCur), (double)stats[iPool]->current, false);
+				FormatBytes(szPeak, sizeof(szPeak), (double)stats[iPool]->peak, false);
+				sprintf_s(szBuf, sizeof(szBuf), "%s%s (peak %s)", labels[iPool], szCur, szPeak);
+				line += szBuf;
+			}
+
+			lines.push_back(line);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	const char* MemoryTracker::GetTagName( eMemTag tag )
+	{
+		static const char* TAG_NAMES[eMemTag_Max] =
+		{
+			"Mesh", "Terrain", "Water", "Texture", "RenderTarget", "Material", "Font", "Vegetation", "Misc"
+		};
+
+		return TAG_NAMES[tag];
+	}
+}
@@ -2,6 +2,8 @@
 #include "Mesh.h"
 #include "D3D11RenderSystem.h"
 #include "Material.h"
+#include "MeshSimplifier.h"
+#include "Profiler.h"
 
 namespace Neo
 {
@@ -17,14 +19,40 @@ namespace Neo
 		m_submeshes.push_back(submesh);
 	}
 	//------------------------------------------------------------------------------------
-	void Mesh::Render( Material* pMaterial )
+	void Mesh::Render( Material* pMaterial, uint32 lod )
 	{
 		for (size_t i=0; i<m_submeshes.size(); ++i)
 		{
-			m_submeshes[i]->Render(pMaterial);
+			m_submeshes[i]->Render(pMaterial, lod);
 		}
 	}
 	//------------------------------------------------------------------------------------
+	void Mesh::GenerateLods( uint32 nLod, float reduction )
+	{
+		for (size_t i=0; i<m_submeshes.size(); ++i)
+		{
+			m_submeshes[i]->GenerateLods(nLod, reduction);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	uint32 Mesh::GetLodCount() const
+	{
+		uint32 nLod = 1;
+		for (size_t i=0; i<m_submeshes.size(); ++i)
+			nLod = max(nLod, m_submeshes[i]->GetLodCount());
+
+		return nLod;
+	}
+	//------------------------------------------------------------------------------------
+	float Mesh::GetLodError( uint32 lod ) const
+	{
+		float fError = 0;
+		for (size_t i=0; i<m_submeshes.size(); ++i)
+			fError = max(fError, m_submeshes[i]->GetLodError(lod));
+
+		return fError;
+	}
+	//------------------------------------------------------------------------------------
 	SubMesh* Mesh::GetSubMesh( size_t i )
 	{
 		assert(i < m_submeshes.size());
@@ -37,28 +65,37 @@ namespace Neo
 	}
 
 	//------------------------------------------------------------------------------------
-	SubMesh::SubMesh()
+	SubMesh::SubMesh(eMemTag memTag)
 		:m_pMaterial(nullptr)
+		,m_pMaterialInstance(nullptr)
 		,m_pVertexBuf(nullptr)
 		,m_pIndexBuf(nullptr)
 		,m_nIndexCnt(0)
 		,m_pIndexData(nullptr)
+		,m_uvDensity(-1)
+		,m_memTag(memTag)
 	{
 
 	}
 	//------------------------------------------------------------------------------------
 	SubMesh::~SubMesh()
 	{
+		SAFE_RELEASE(m_pMaterialInstance);
 		SAFE_RELEASE(m_pMaterial);
+		MemoryTracker::Remove(&m_vertData);
+		MemoryTracker::Remove(m_pVertexBuf);
 		SAFE_RELEASE(m_pVertexBuf);
+		MemoryTracker::Remove(m_pIndexBuf);
 		SAFE_RELEASE(m_pIndexBuf);
-		SAFE_DELETE(m_pIndexData);
+		MemoryTracker::Free(m_pIndexData);
+		_ClearLods();
 	}
 	//------------------------------------------------------------------------------------
 	bool SubMesh::InitVertData( eVertexType type, const void* pVerts, int nVert, bool bStatic )
 	{
 		assert(pVerts);
 
+		MemoryTracker::Remove(m_pVertexBuf);
 		SAFE_RELEASE(m_pVertexBuf);
 
 		switch (type)
@@ -68,6 +105,9 @@ namespace Neo
 		default: assert(0); break;
 		}
 
+		// System memory copy kept by VertexData
+		MemoryTracker::Add(&m_vertData, m_memTag, eMemPool_CPU, m_vertData.GetVertexStride() * nVert, m_name);
+
 		D3D11_BUFFER_DESC bd;
 		ZeroMemory( &bd, sizeof(bd) );
 		bd.ByteWidth = m_vertData.GetVertexStride() * nVert;
@@ -88,15 +128,19 @@ namespace Neo
 		HRESULT hr = S_OK;
 		V_RETURN(g_env.pRenderSystem->GetDevice()->CreateBuffer( &bd, &InitData, &m_pVertexBuf ));
 
+		MemoryTracker::AddBuffer(m_pVertexBuf, m_memTag, m_name);
+
 		return true;
 	}
 	//------------------------------------------------------------------------------------
 	bool SubMesh::InitIndexData( const DWORD* pIdx, int nIdx, bool bStatic )
 	{
+		MemoryTracker::Remove(m_pIndexBuf);
 		SAFE_RELEASE(m_pIndexBuf);
-		SAFE_DELETE_ARRAY(m_pIndexData);
+		MemoryTracker::Free(m_pIndexData);
+		_ClearLods();
 
-		m_pIndexData = new DWORD[nIdx];
+		m_pIndexData = (DWORD*)MemoryTracker::Alloc(sizeof(DWORD) * nIdx, m_memTag);
 		CopyMemory(m_pIndexData, pIdx, sizeof(DWORD) * nIdx);
 
 		// Create index buffer
@@ -119,16 +163,157 @@ namespace Neo
 
 		HRESULT hr = S_OK;
 		V_RETURN(g_env.pRenderSystem->GetDevice()->CreateBuffer( &bd, &InitData, &m_pIndexBuf ));
+		MemoryTracker::AddBuffer(m_pIndexBuf, m_memTag, m_name);
 
 		m_nIndexCnt = nIdx;
 
 		return true;
 	}
 	//------------------------------------------------------------------------------------
-	void SubMesh::Render( Material* pMaterial )
+	void SubMesh::_ClearLods()
+	{
+		for (size_t i=0; i<m_lodIndexBufs.size(); ++i)
+		{
+			MemoryTracker::Remove(m_lodIndexBufs[i]);
+			SAFE_RELEASE(m_lodIndexBufs[i]);
+		}
+
+		m_lodIndexBufs.clear();
+		m_lodIndexCnt.clear();
+		m_lodErrors.clear();
+	}
+	//------------------------------------------------------------------------------------
+	bool SubMesh::GenerateLods( uint32 nLod, float reduction )
+	{
+		assert(reduction > 0 && reduction < 1);
+
+		_ClearLods();
+
+		if(!m_pIndexData || m_nIndexCnt < 3)
+			return false;
+
+		// SVertex and STreeLeafVertex share the pos-normal-uv prefix
+		const uint8* pVerts = (const uint8*)m_vertData.GetVertexData();
+		const uint32 stride = m_vertData.GetVertexStride();
+		uint32 offNormal = 0, offUV = 0;
+		switch (m_vertData.GetType())
+		{
+		case eVertexType_General: offNormal = offsetof(SVertex, normal); offUV = offsetof(SVertex, uv); break;
+		case eVertexType_TreeLeaf: offNormal = offsetof(STreeLeafVertex, normal); offUV = offsetof(STreeLeafVertex, uv); break;
+		default: assert(0); return false;
+		}
+
+		MeshSimplifier simplifier((const VEC3*)pVerts, (const VEC3*)(pVerts + offNormal), (const VEC2*)(pVerts + offUV),
+			stride, m_vertData.GetVertCount(), m_pIndexData, m_nIndexCnt);
+
+		std::vector<DWORD> indices;
+		DWORD nPrevCnt = m_nIndexCnt;
+		float fTarget = (float)m_nIndexCnt;
+
+		for (uint32 iLod=1; iLod<nLod; ++iLod)
+		{
+			fTarget *= reduction;
+			simplifier.Simplify((uint32)fTarget);
+
+			// Not worth another level
+			const DWORD nCnt = simplifier.GetIndexCount();
+			if(nCnt == 0 || nCnt >= nPrevCnt)
+				break;
+
+			simplifier.GetIndices(indices);
+
+			D3D11_BUFFER_DESC bd;
+			ZeroMemory( &bd, sizeof(bd) );
+			bd.ByteWidth = sizeof(DWORD) * nCnt;
+			bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+			bd.Usage = D3D11_USAGE_IMMUTABLE;
+
+			D3D11_SUBRESOURCE_DATA InitData;
+			ZeroMemory( &InitData, sizeof(InitData) );
+			InitData.pSysMem = &indices[0];
+
+			ID3D11Buffer* pBuf = nullptr;
+			HRESULT hr = S_OK;
+			V_RETURN(g_env.pRenderSystem->GetDevice()->CreateBuffer( &bd, &InitData, &pBuf ));
+			MemoryTracker::AddBuffer(pBuf, m_memTag, m_name);
+
+			m_lodIndexBufs.push_back(pBuf);
+			m_lodIndexCnt.push_back(nCnt);
+			m_lodErrors.push_back(simplifier.GetError());
+
+			nPrevCnt = nCnt;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	float SubMesh::GetUVDensity()
+	{
+		if(m_uvDensity >= 0)
+			return m_uvDensity;
+
+		m_uvDensity = 0;
+
+		if(!m_pIndexData || m_nIndexCnt < 3)
+			return m_uvDensity;
+
+		const uint8* pVerts = (const uint8*)m_vertData.GetVertexData();
+		const uint32 stride = m_vertData.GetVertexStride();
+		uint32 offUV = 0;
+		switch (m_vertData.GetType())
+		{
+		case eVertexType_General: offUV = offsetof(SVertex, uv); break;
+		case eVertexType_TreeLeaf: offUV = offsetof(STreeLeafVertex, uv); break;
+		default: assert(0); return m_uvDensity;
+		}
+
+		// Ratio of total areas, so tiny sliver triangles don't dominate
+		double worldArea = 0, uvArea = 0;
+		for (DWORD i=0; i+2<m_nIndexCnt; i+=3)
+		{
+			const uint8* p0 = pVerts + m_pIndexData[i] * stride;
+			const uint8* p1 = pVerts + m_pIndexData[i+1] * stride;
+			const uint8* p2 = pVerts + m_pIndexData[i+2] * stride;
+
+			const VEC3& v0 = *(const VEC3*)p0;
+			const VEC3 cross = Common::CrossProduct_Vec3_By_Vec3(
+				Common::Sub_Vec3_By_Vec3(*(const VEC3*)p1, v0), Common::Sub_Vec3_By_Vec3(*(const VEC3*)p2, v0));
+			worldArea += sqrtf(Common::DotProduct_Vec3_By_Vec3(cross, cross));
+
+			const float* uv0 = (const float*)(p0 + offUV);
+			const float* uv1 = (const float*)(p1 + offUV);
+			const float* uv2 = (const float*)(p2 + offUV);
+			uvArea += fabsf((uv1[0] - uv0[0]) * (uv2[1] - uv0[1]) - (uv2[0] - uv0[0]) * (uv1[1] - uv0[1]));
+		}
+
+		if(worldArea > 0)
+			m_uvDensity = (float)sqrt(uvArea / worldArea);
+
+		return m_uvDensity;
+	}
+	//------------------------------------------------------------------------------------
+	float SubMesh::GetLodError( uint32 lod ) const
+	{
+		if(lod == 0 || m_lodErrors.empty())
+			return 0;
+
+		return m_lodErrors[min(lod, m_lodErrors.size()) - 1];
+	}
+	//------------------------------------------------------------------------------------
+	DWORD SubMesh::GetLodIndexCount( uint32 lod ) const
+	{
+		if(lod == 0 || m_lodIndexCnt.empty())
+			return m_nIndexCnt;
+
+		return m_lodIndexCnt[min(lod, m_lodIndexCnt.size()) - 1];
+	}
+	//------------------------------------------------------------------------------------
+	void SubMesh::Render( Material* pMaterial, uint32 lod )
 	{
 		if (pMaterial)
 			pMaterial->Activate();
+		else if (m_pMaterialInstance)
+			m_pMaterialInstance->Activate();
 		else
 			m_pMaterial->Activate();
 
@@ -141,20 +326,46 @@ namespace Neo
 
 		if (m_pIndexBuf)
 		{
-			pDeviceContext->IASetIndexBuffer( m_pIndexBuf, DXGI_FORMAT_R32_UINT, 0 );
-			pDeviceContext->DrawIndexed( m_nIndexCnt, 0, 0 );
+			// Sub meshes may have fewer levels than the mesh, use the coarsest one then
+			lod = min(lod, GetLodCount() - 1);
+			ID3D11Buffer* pIndexBuf = lod > 0 ? m_lodIndexBufs[lod - 1] : m_pIndexBuf;
+
+			pDeviceContext->IASetIndexBuffer( pIndexBuf, DXGI_FORMAT_R32_UINT, 0 );
+			pDeviceContext->DrawIndexed( GetLodIndexCount(lod), 0, 0 );
+
+			PROFILE_COUNTER(eProfileCounter_Triangle, GetLodIndexCount(lod) / 3);
 		}
 		else
 		{
 			pDeviceContext->Draw(m_vertData.GetVertCount(), 0);
+
+			PROFILE_COUNTER(eProfileCounter_Triangle, m_vertData.GetVertCount() / 3);
 		}
+
+		PROFILE_COUNTER(eProfileCounter_DrawCall, 1);
 	}
 	//------------------------------------------------------------------------------------
 	void SubMesh::SetMaterial( Material* pMaterial )
 	{
+		// AddRef first, setting the material already in use must not free it
+		pMaterial->AddRef();
+		SAFE_RELEASE(m_pMaterialInstance);
 		SAFE_RELEASE(m_pMaterial);
 		m_pMaterial = pMaterial;
-		pMaterial->AddRef();
+	}
+	//------------------------------------------------------------------------------------
+	void SubMesh::SetMaterialInstance( MaterialInstance* pInstance )
+	{
+		// SetMaterial releases the current instance, which may be this one
+		pInstance->AddRef();
+		SetMaterial(pInstance->GetParent());
+
+		m_pMaterialInstance = pInstance;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 SubMesh::GetSortKey() const
+	{
+		return m_pMaterial ? m_pMaterial->GetSortKey() : 0;
 	}
 }
 
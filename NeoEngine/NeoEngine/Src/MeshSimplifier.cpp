@@ -0,0 +1,503 @@
+#include "stdafx.h"
+#include "MeshSimplifier.h"
+
+namespace Neo
+{
+	namespace
+	{
+		// Sort raw vertex indices by position so identical positions become adjacent
+		struct PosLess
+		{
+			PosLess(const uint8* p, uint32 stride):pPos(p),stride(stride) {}
+
+			bool operator () (uint32 a, uint32 b) const
+			{
+				const VEC3& pa = *(const VEC3*)(pPos + a * stride);
+				const VEC3& pb = *(const VEC3*)(pPos + b * stride);
+				if(pa.x != pb.x) return pa.x < pb.x;
+				if(pa.y != pb.y) return pa.y < pb.y;
+				if(pa.z != pb.z) return pa.z < pb.z;
+				return a < b;
+			}
+
+			const uint8*	pPos;
+			uint32			stride;
+		};
+
+		inline VEC3 TriangleNormal(const VEC3& p0, const VEC3& p1, const VEC3& p2)
+		{
+			return Common::CrossProduct_Vec3_By_Vec3(Common::Sub_Vec3_By_Vec3(p1, p0), Common::Sub_Vec3_By_Vec3(p2, p0));
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::SQuadric::AddPlane( double a, double b, double c, double d )
+	{
+		m[0] += a*a; m[1] += a*b; m[2] += a*c; m[3] += a*d;
+		m[4] += b*b; m[5] += b*c; m[6] += b*d;
+		m[7] += c*c; m[8] += c*d;
+		m[9] += d*d;
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::SQuadric::Add( const SQuadric& rhs )
+	{
+		for (int i=0; i<10; ++i)
+			m[i] += rhs.m[i];
+	}
+	//------------------------------------------------------------------------------------
+	double MeshSimplifier::SQuadric::Evaluate( const VEC3& p ) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+
+		double e =	m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+				+	m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y
+				+	m[7]*z*z + 2*m[8]*z
+				+	m[9];
+
+		// Round-off may give tiny negative values
+		return e > 0 ? e : 0;
+	}
+
+	//------------------------------------------------------------------------------------
+	MeshSimplifier::MeshSimplifier( const VEC3* pPos, const VEC3* pNormal, const VEC2* pUV, uint32 stride,
+		uint32 nVert, const DWORD* pIdx, uint32 nIdx )
+		:m_pPos((const uint8*)pPos)
+		,m_pNormal((const uint8*)pNormal)
+		,m_pUV((const uint8*)pUV)
+		,m_stride(stride)
+		,m_nVert(nVert)
+		,m_tris(pIdx, pIdx + nIdx - nIdx % 3)
+		,m_nLiveTri(0)
+		,m_maxCost(0)
+		,m_normalWeight(1.0f)
+		,m_uvWeight(1.0f)
+	{
+		assert(pPos && pIdx);
+
+		_WeldPositions();
+
+		const uint32 nTri = m_tris.size() / 3;
+		m_triLive.assign(nTri, true);
+		m_vertTris.resize(m_nVert);
+
+		for (uint32 t=0; t<nTri; ++t)
+		{
+			const uint32 c0 = m_canon[m_tris[t*3+0]];
+			const uint32 c1 = m_canon[m_tris[t*3+1]];
+			const uint32 c2 = m_canon[m_tris[t*3+2]];
+
+			// Degenerated triangles are dropped right away
+			if (c0 == c1 || c1 == c2 || c0 == c2)
+			{
+				m_triLive[t] = false;
+				continue;
+			}
+
+			m_vertTris[c0].push_back(t);
+			m_vertTris[c1].push_back(t);
+			m_vertTris[c2].push_back(t);
+			++m_nLiveTri;
+		}
+
+		_LockBorders();
+		_ComputeQuadrics();
+
+		m_stamps.assign(m_nVert, 0);
+		for (uint32 v=0; v<m_nVert; ++v)
+		{
+			if(m_canon[v] == v && !m_locked[v] && !m_vertTris[v].empty())
+				_PushCandidate(v);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::SetAttributeWeights( float normalWeight, float uvWeight )
+	{
+		m_normalWeight = normalWeight;
+		m_uvWeight = uvWeight;
+	}
+	//------------------------------------------------------------------------------------
+	const VEC3& MeshSimplifier::_Pos( uint32 i ) const
+	{
+		return *(const VEC3*)(m_pPos + i * m_stride);
+	}
+	//------------------------------------------------------------------------------------
+	const VEC3* MeshSimplifier::_Normal( uint32 i ) const
+	{
+		return m_pNormal ? (const VEC3*)(m_pNormal + i * m_stride) : nullptr;
+	}
+	//------------------------------------------------------------------------------------
+	const VEC2* MeshSimplifier::_UV( uint32 i ) const
+	{
+		return m_pUV ? (const VEC2*)(m_pUV + i * m_stride) : nullptr;
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_WeldPositions()
+	{
+		std::vector<uint32> order(m_nVert);
+		for(uint32 i=0; i<m_nVert; ++i)
+			order[i] = i;
+
+		std::sort(order.begin(), order.end(), PosLess(m_pPos, m_stride));
+
+		m_canon.resize(m_nVert);
+		m_locked.assign(m_nVert, false);
+
+		// Canonical vertex of a group is its smallest raw index, which is the first after sorting
+		std::vector<bool> bSameAttrib(m_nVert, true);
+		for (uint32 i=0; i<m_nVert; )
+		{
+			uint32 j = i + 1;
+			while(j < m_nVert && _Pos(order[j]) == _Pos(order[i]))
+				++j;
+
+			const uint32 rep = order[i];
+			for (uint32 k=i; k<j; ++k)
+			{
+				const uint32 v = order[k];
+				m_canon[v] = rep;
+
+				const VEC3* n0 = _Normal(v), *n1 = _Normal(rep);
+				const VEC2* t0 = _UV(v), *t1 = _UV(rep);
+				bool bSame = true;
+				if(n0 && !(*n0 == *n1))
+					bSame = false;
+				if(t0 && (t0->x != t1->x || t0->y != t1->y))
+					bSame = false;
+
+				bSameAttrib[v] = bSame;
+				// Attribute seam: lock it so the discontinuity survives simplification
+				if(!bSame)
+					m_locked[rep] = true;
+			}
+
+			i = j;
+		}
+
+		// Plain duplicates are folded onto the canonical vertex
+		for (size_t i=0; i<m_tris.size(); ++i)
+		{
+			const DWORD v = m_tris[i];
+			assert(v < m_nVert);
+			if(bSameAttrib[v])
+				m_tris[i] = m_canon[v];
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_LockBorders()
+	{
+		// Count triangle uses of each edge. Borders and non-manifold edges are locked.
+		std::map<std::pair<uint32,uint32>, uint32> edges;
+
+		for (uint32 t=0; t<m_triLive.size(); ++t)
+		{
+			if(!m_triLive[t])
+				continue;
+
+			for (int e=0; e<3; ++e)
+			{
+				uint32 a = m_canon[m_tris[t*3+e]];
+				uint32 b = m_canon[m_tris[t*3+(e+1)%3]];
+				if(a > b)
+					std::swap(a, b);
+
+				++edges[std::make_pair(a, b)];
+			}
+		}
+
+		for (auto iter=edges.begin(); iter!=edges.end(); ++iter)
+		{
+			if (iter->second != 2)
+			{
+				m_locked[iter->first.first] = true;
+				m_locked[iter->first.second] = true;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_ComputeQuadrics()
+	{
+		m_quadrics.resize(m_nVert);
+
+		for (uint32 t=0; t<m_triLive.size(); ++t)
+		{
+			if(!m_triLive[t])
+				continue;
+
+			const uint32 c0 = m_canon[m_tris[t*3+0]];
+			const uint32 c1 = m_canon[m_tris[t*3+1]];
+			const uint32 c2 = m_canon[m_tris[t*3+2]];
+
+			VEC3 n = TriangleNormal(_Pos(c0), _Pos(c1), _Pos(c2));
+			if(n.IsZeroLength())
+				continue;
+			n.Normalize();
+
+			const double d = -Common::DotProduct_Vec3_By_Vec3(n, _Pos(c0));
+
+			m_quadrics[c0].AddPlane(n.x, n.y, n.z, d);
+			m_quadrics[c1].AddPlane(n.x, n.y, n.z, d);
+			m_quadrics[c2].AddPlane(n.x, n.y, n.z, d);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_GatherNeighbours( uint32 v, std::vector<uint32>& out ) const
+	{
+		// Raw indices as referenced by v's triangles, unique by canonical index
+		out.clear();
+
+		const std::vector<uint32>& tris = m_vertTris[v];
+		for (size_t i=0; i<tris.size(); ++i)
+		{
+			const uint32 t = tris[i];
+			if(!m_triLive[t])
+				continue;
+
+			for (int k=0; k<3; ++k)
+			{
+				const uint32 raw = m_tris[t*3+k];
+				const uint32 c = m_canon[raw];
+				if(c == v)
+					continue;
+
+				bool bFound = false;
+				for (size_t j=0; j<out.size(); ++j)
+				{
+					if (m_canon[out[j]] == c)
+					{
+						bFound = true;
+						break;
+					}
+				}
+
+				if(!bFound)
+					out.push_back(raw);
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	double MeshSimplifier::_CollapseCost( uint32 v, uint32 u ) const
+	{
+		SQuadric q = m_quadrics[v];
+		q.Add(m_quadrics[m_canon[u]]);
+
+		const VEC3& pu = _Pos(u);
+		double cost = q.Evaluate(pu);
+
+		// Attribute penalty, scaled by squared edge length so it is in the same unit as the quadric
+		const VEC3 edge = Common::Sub_Vec3_By_Vec3(pu, _Pos(v));
+		const double lenSq = Common::DotProduct_Vec3_By_Vec3(edge, edge);
+
+		if (m_pNormal)
+		{
+			const double dot = Common::DotProduct_Vec3_By_Vec3(*_Normal(v), *_Normal(u));
+			cost += m_normalWeight * (1.0 - dot) * lenSq;
+		}
+		if (m_pUV)
+		{
+			const VEC2* t0 = _UV(v), *t1 = _UV(u);
+			const double du = t0->x - t1->x, dv = t0->y - t1->y;
+			cost += m_uvWeight * (du*du + dv*dv) * lenSq;
+		}
+
+		return cost;
+	}
+	//------------------------------------------------------------------------------------
+	bool MeshSimplifier::_IsCollapseLegal( uint32 v, uint32 u ) const
+	{
+		const uint32 cu = m_canon[u];
+		if(m_locked[v] || cu == v)
+			return false;
+
+		// Link condition: an interior edge may share only its two opposite vertices
+		std::vector<uint32> ringV, ringU;
+		_GatherNeighbours(v, ringV);
+		_GatherNeighbours(cu, ringU);
+
+		uint32 nShared = 0;
+		for (size_t i=0; i<ringV.size(); ++i)
+		{
+			for (size_t j=0; j<ringU.size(); ++j)
+			{
+				if(m_canon[ringV[i]] == m_canon[ringU[j]])
+					++nShared;
+			}
+		}
+		if(nShared > 2)
+			return false;
+
+		// Reject triangle flips and slivers
+		const VEC3& pu = _Pos(u);
+		const std::vector<uint32>& tris = m_vertTris[v];
+		for (size_t i=0; i<tris.size(); ++i)
+		{
+			const uint32 t = tris[i];
+			if(!m_triLive[t])
+				continue;
+
+			VEC3 p[3], q[3];
+			bool bHasU = false;
+			for (int k=0; k<3; ++k)
+			{
+				const uint32 c = m_canon[m_tris[t*3+k]];
+				p[k] = _Pos(c);
+				q[k] = c == v ? pu : p[k];
+				if(c == cu)
+					bHasU = true;
+			}
+
+			// This triangle vanishes with the collapse
+			if(bHasU)
+				continue;
+
+			VEC3 n0 = TriangleNormal(p[0], p[1], p[2]);
+			VEC3 n1 = TriangleNormal(q[0], q[1], q[2]);
+			if(n1.IsZeroLength())
+				return false;
+
+			n0.Normalize();
+			n1.Normalize();
+			if(Common::DotProduct_Vec3_By_Vec3(n0, n1) < 0.2f)
+				return false;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool MeshSimplifier::_FindBestCollapse( uint32 v, SCollapse& out ) const
+	{
+		std::vector<uint32> ring;
+		_GatherNeighbours(v, ring);
+
+		bool bFound = false;
+		for (size_t i=0; i<ring.size(); ++i)
+		{
+			const uint32 u = ring[i];
+			if(!_IsCollapseLegal(v, u))
+				continue;
+
+			const double cost = _CollapseCost(v, u);
+			if (!bFound || cost < out.cost || (cost == out.cost && u < out.to))
+			{
+				out.cost = cost;
+				out.from = v;
+				out.to = u;
+				bFound = true;
+			}
+		}
+
+		return bFound;
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_PushCandidate( uint32 v )
+	{
+		SCollapse c;
+		if (_FindBestCollapse(v, c))
+		{
+			c.stamp = m_stamps[v];
+			m_heap.push(c);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::_ApplyCollapse( uint32 v, uint32 u )
+	{
+		const uint32 cu = m_canon[u];
+
+		std::vector<uint32> tris;
+		tris.swap(m_vertTris[v]);
+
+		for (size_t i=0; i<tris.size(); ++i)
+		{
+			const uint32 t = tris[i];
+			if(!m_triLive[t])
+				continue;
+
+			bool bHasU = false;
+			for (int k=0; k<3; ++k)
+			{
+				if(m_canon[m_tris[t*3+k]] == cu)
+					bHasU = true;
+			}
+
+			if (bHasU)
+			{
+				m_triLive[t] = false;
+				--m_nLiveTri;
+				continue;
+			}
+
+			for (int k=0; k<3; ++k)
+			{
+				if(m_tris[t*3+k] == v)
+					m_tris[t*3+k] = u;
+			}
+			m_vertTris[cu].push_back(t);
+		}
+
+		// Compact the target's triangle list
+		std::vector<uint32>& uTris = m_vertTris[cu];
+		uTris.erase(std::remove_if(uTris.begin(), uTris.end(),
+			[&](uint32 t) { return !m_triLive[t]; }), uTris.end());
+
+		m_quadrics[cu].Add(m_quadrics[v]);
+		// v is gone for good
+		m_locked[v] = true;
+		++m_stamps[v];
+
+		// Refresh candidates around the new fan
+		std::vector<uint32> ring;
+		_GatherNeighbours(cu, ring);
+		ring.push_back(cu);
+
+		for (size_t i=0; i<ring.size(); ++i)
+		{
+			const uint32 c = m_canon[ring[i]];
+			++m_stamps[c];
+			if(!m_locked[c])
+				_PushCandidate(c);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::Simplify( uint32 targetIndexCount )
+	{
+		while (m_nLiveTri * 3 > targetIndexCount && !m_heap.empty())
+		{
+			const SCollapse c = m_heap.top();
+			m_heap.pop();
+
+			if(c.stamp != m_stamps[c.from] || m_locked[c.from])
+				continue;
+
+			// Neighbourhood of the target may have changed since this was queued
+			if (!_IsCollapseLegal(c.from, c.to))
+			{
+				++m_stamps[c.from];
+				_PushCandidate(c.from);
+				continue;
+			}
+
+			m_maxCost = max(m_maxCost, c.cost);
+			_ApplyCollapse(c.from, c.to);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void MeshSimplifier::GetIndices( std::vector<DWORD>& outIndices ) const
+	{
+		outIndices.clear();
+		outIndices.reserve(m_nLiveTri * 3);
+
+		for (uint32 t=0; t<m_triLive.size(); ++t)
+		{
+			if (m_triLive[t])
+			{
+				outIndices.push_back(m_tris[t*3+0]);
+				outIndices.push_back(m_tris[t*3+1]);
+				outIndices.push_back(m_tris[t*3+2]);
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	float MeshSimplifier::GetError() const
+	{
+		return (float)sqrt(m_maxCost);
+	}
+}
@@ -0,0 +1,124 @@
+#include "ParallelFor.h"
+#include <vector>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+namespace Neo
+{
+	namespace
+	{
+		struct SParallelJob
+		{
+			const std::function<void(unsigned int)>*	pFunc;
+			unsigned int								count;
+			volatile long								next;
+		};
+
+		inline long AtomicIncrement(volatile long* p)
+		{
+#ifdef _WIN32
+			return InterlockedIncrement(p);
+#else
+			return __sync_add_and_fetch(p, 1);
+#endif
+		}
+
+		void RunJob(SParallelJob* pJob)
+		{
+			for (;;)
+			{
+				const unsigned int i = (unsigned int)(AtomicIncrement(&pJob->next) - 1);
+				if(i >= pJob->count)
+					break;
+
+				(*pJob->pFunc)(i);
+			}
+		}
+
+#ifdef _WIN32
+		DWORD WINAPI WorkerProc(LPVOID pParam)
+		{
+			RunJob((SParallelJob*)pParam);
+			return 0;
+		}
+#else
+		void* WorkerProc(void* pParam)
+		{
+			RunJob((SParallelJob*)pParam);
+			return nullptr;
+		}
+#endif
+	}
+
+	//------------------------------------------------------------------------------------
+	unsigned int GetHardwareThreadCount()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+		const long n = sysconf(_SC_NPROCESSORS_ONLN);
+		return n > 0 ? (unsigned int)n : 1;
+#endif
+	}
+	//------------------------------------------------------------------------------------
+	void ParallelFor( unsigned int count, const std::function<void(unsigned int)>& func, unsigned int numThreads )
+	{
+		if(count == 0)
+			return;
+
+		if(numThreads == 0)
+			numThreads = GetHardwareThreadCount();
+		if(numThreads > count)
+			numThreads = count;
+#ifdef _WIN32
+		if(numThreads > MAXIMUM_WAIT_OBJECTS)
+			numThreads = MAXIMUM_WAIT_OBJECTS;
+#endif
+
+		SParallelJob job;
+		job.pFunc = &func;
+		job.count = count;
+		job.next = 0;
+
+		// Calling thread is one of the workers
+		const unsigned int numWorkers = numThreads - 1;
+
+#ifdef _WIN32
+		std::vector<HANDLE> threads;
+		for (unsigned int i=0; i<numWorkers; ++i)
+		{
+			HANDLE hThread = CreateThread(nullptr, 0, WorkerProc, &job, 0, nullptr);
+			if(hThread)
+				threads.push_back(hThread);
+		}
+
+		RunJob(&job);
+
+		if(!threads.empty())
+			WaitForMultipleObjects((DWORD)threads.size(), &threads[0], TRUE, INFINITE);
+		for (size_t i=0; i<threads.size(); ++i)
+			CloseHandle(threads[i]);
+#else
+		std::vector<pthread_t> threads;
+		for (unsigned int i=0; i<numWorkers; ++i)
+		{
+			pthread_t thread;
+			if(pthread_create(&thread, nullptr, WorkerProc, &job) == 0)
+				threads.push_back(thread);
+		}
+
+		RunJob(&job);
+
+		for (size_t i=0; i<threads.size(); ++i)
+			pthread_join(threads[i], nullptr);
+#endif
+	}
+}
@@ -96,5 +96,16 @@ namespace Neo
 		default: assert(0); break;
 		}
 	}
+
+	bool PixelBox::SaveAsDDS( const STRING& filename, const SCookOptions& options ) const
+	{
+		TextureCooker cooker(options);
+		if(!cooker.SetSource(m_data, m_width, m_height, m_pitch, m_bytesPerPixel))
+			return false;
+
+		cooker.Cook();
+
+		return cooker.SaveDDS(filename);
+	}
 }
 
@@ -0,0 +1,381 @@
+#include "stdafx.h"
+#include "Profiler.h"
+
+namespace Neo
+{
+	// Events per thread between two EndFrame, power of 2. Overflow is dropped.
+	static const uint32		THREAD_BUFFER_SIZE	=	8192;
+	static const float		STAT_SMOOTH			=	0.1f;
+
+	struct Profiler::SThreadBuffer
+	{
+		uint32				threadId;
+		uint32				depth;			// Owner thread only
+		volatile long		head;			// Written by owner
+		volatile long		tail;			// Written by EndFrame
+		volatile long		dropped;
+		SEvent				events[THREAD_BUFFER_SIZE];
+	};
+
+	namespace
+	{
+		// Guards the buffer list only, taken once per thread and once per frame
+		struct SBufferRegistry
+		{
+			SBufferRegistry()	{ InitializeCriticalSection(&lock); }
+			~SBufferRegistry()
+			{
+				for (size_t i=0; i<buffers.size(); ++i)
+					delete buffers[i];
+				DeleteCriticalSection(&lock);
+			}
+
+			CRITICAL_SECTION						lock;
+			std::vector<Profiler::SThreadBuffer*>	buffers;
+		};
+
+		SBufferRegistry		g_registry;
+		__declspec(thread) Profiler::SThreadBuffer*	t_pBuffer = nullptr;
+
+		std::vector<Profiler::SEvent>	g_mainEvents;	// Scratch for EndFrame
+
+		uint32				g_mainThreadId = 0;
+		__int64				g_ticksPerSecond = 0;
+		bool				g_bEnabledBeforeCapture = false;
+	}
+
+	bool							Profiler::s_bEnabled = false;
+	uint32							Profiler::s_counters[eProfileCounter_Max] = { 0 };
+	uint32							Profiler::s_lastCounters[eProfileCounter_Max] = { 0 };
+	float							Profiler::s_lastFrameMs = 0;
+	__int64							Profiler::s_frameStart = 0;
+	std::vector<Profiler::SScopeStat>	Profiler::s_scopeStats;
+	std::vector<Profiler::SPassStat>	Profiler::s_passes;
+	std::vector<Profiler::SPassStat>	Profiler::s_lastPasses;
+	uint32							Profiler::s_captureFrames = 0;
+	STRING							Profiler::s_captureFile;
+	std::vector<Profiler::SCapturedEvent>	Profiler::s_capturedEvents;
+	std::vector<Profiler::SCapturedFrame>	Profiler::s_capturedFrames;
+
+	//------------------------------------------------------------------------------------
+	void Profiler::SetEnabled( bool bEnable )
+	{
+		s_bEnabled = bEnable;
+	}
+	//------------------------------------------------------------------------------------
+	__int64 Profiler::GetTicks()
+	{
+		LARGE_INTEGER t;
+		QueryPerformanceCounter(&t);
+		return t.QuadPart;
+	}
+	//------------------------------------------------------------------------------------
+	double Profiler::TicksToMs( __int64 ticks )
+	{
+		if (g_ticksPerSecond == 0)
+		{
+			LARGE_INTEGER freq;
+			QueryPerformanceFrequency(&freq);
+			g_ticksPerSecond = freq.QuadPart;
+		}
+
+		return ticks * 1000.0 / g_ticksPerSecond;
+	}
+	//------------------------------------------------------------------------------------
+	Profiler::SThreadBuffer* Profiler::_GetThreadBuffer()
+	{
+		if (!t_pBuffer)
+		{
+			SThreadBuffer* pBuffer = new SThreadBuffer;
+			pBuffer->threadId = GetCurrentThreadId();
+			pBuffer->depth = 0;
+			pBuffer->head = pBuffer->tail = pBuffer->dropped = 0;
+
+			EnterCriticalSection(&g_registry.lock);
+			g_registry.buffers.push_back(pBuffer);
+			LeaveCriticalSection(&g_registry.lock);
+
+			t_pBuffer = pBuffer;
+		}
+
+		return t_pBuffer;
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::BeginScope()
+	{
+		++_GetThreadBuffer()->depth;
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::EndScope( const char* name, __int64 start )
+	{
+		const __int64 end = GetTicks();
+		SThreadBuffer* pBuffer = _GetThreadBuffer();
+
+		// Scope was opened before the profiler got enabled
+		if(pBuffer->depth == 0)
+			return;
+
+		--pBuffer->depth;
+
+		const long head = pBuffer->head;
+		if (head - pBuffer->tail >= (long)THREAD_BUFFER_SIZE)
+		{
+			InterlockedIncrement(&pBuffer->dropped);
+			return;
+		}
+
+		SEvent& evt = pBuffer->events[head & (THREAD_BUFFER_SIZE - 1)];
+		evt.name = name;
+		evt.start = start;
+		evt.end = end;
+		evt.depth = pBuffer->depth;
+
+		// Publish after the event is written
+		InterlockedExchange(&pBuffer->head, head + 1);
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::BeginFrame()
+	{
+		if(g_mainThreadId == 0)
+			g_mainThreadId = GetCurrentThreadId();
+
+		s_frameStart = GetTicks();
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::EndFrame()
+	{
+		const __int64 frameEnd = GetTicks();
+		s_lastFrameMs = (float)TicksToMs(frameEnd - s_frameStart);
+
+		for (size_t i=0; i<s_scopeStats.size(); ++i)
+		{
+			s_scopeStats[i].lastMs = 0;
+			s_scopeStats[i].calls = 0;
+		}
+
+		EnterCriticalSection(&g_registry.lock);
+		for (size_t i=0; i<g_registry.buffers.size(); ++i)
+		{
+			SThreadBuffer* pBuffer = g_registry.buffers[i];
+			_Drain(pBuffer, pBuffer->threadId == g_mainThreadId);
+		}
+		LeaveCriticalSection(&g_registry.lock);
+
+		// Events are recorded when scopes end, by start time parents come first
+		std::sort(g_mainEvents.begin(), g_mainEvents.end(), [](const SEvent& a, const SEvent& b)
+		{
+			return a.start < b.start;
+		});
+
+		for (size_t i=0; i<g_mainEvents.size(); ++i)
+			_AddScopeStat(g_mainEvents[i]);
+		g_mainEvents.clear();
+
+		for (size_t i=0; i<s_scopeStats.size(); ++i)
+		{
+			SScopeStat& stat = s_scopeStats[i];
+			stat.avgMs = stat.avgMs > 0 ? stat.avgMs + (stat.lastMs - stat.avgMs) * STAT_SMOOTH : stat.lastMs;
+		}
+
+		memcpy(s_lastCounters, s_counters, sizeof(s_counters));
+		memset(s_counters, 0, sizeof(s_counters));
+
+		s_lastPasses.swap(s_passes);
+		s_passes.clear();
+
+		if (s_captureFrames > 0)
+		{
+			SCapturedFrame frame;
+			frame.start = s_frameStart;
+			frame.end = frameEnd;
+			memcpy(frame.counters, s_lastCounters, sizeof(frame.counters));
+			s_capturedFrames.push_back(frame);
+
+			if (--s_captureFrames == 0)
+			{
+				_WriteTrace();
+
+				s_capturedEvents.clear();
+				s_capturedFrames.clear();
+				s_bEnabled = g_bEnabledBeforeCapture;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::_Drain( SThreadBuffer* pBuffer, bool bMainThread )
+	{
+		const long head = pBuffer->head;
+		const bool bCapture = s_captureFrames > 0;
+
+		for (long i=pBuffer->tail; i<head; ++i)
+		{
+			const SEvent& evt = pBuffer->events[i & (THREAD_BUFFER_SIZE - 1)];
+
+			if(bMainThread)
+				g_mainEvents.push_back(evt);
+
+			if (bCapture)
+			{
+				SCapturedEvent captured = { evt, pBuffer->threadId };
+				s_capturedEvents.push_back(captured);
+			}
+		}
+
+		// Hand the slots back to the owner
+		InterlockedExchange(&pBuffer->tail, head);
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::_AddScopeStat( const SEvent& evt )
+	{
+		// Few scopes, and names are literals so pointers compare
+		SScopeStat* pStat = nullptr;
+		for (size_t i=0; i<s_scopeStats.size(); ++i)
+		{
+			if (s_scopeStats[i].name == evt.name && s_scopeStats[i].depth == evt.depth)
+			{
+				pStat = &s_scopeStats[i];
+				break;
+			}
+		}
+
+		if (!pStat)
+		{
+			SScopeStat stat = { evt.name, evt.depth, 0, 0, 0 };
+			s_scopeStats.push_back(stat);
+			pStat = &s_scopeStats.back();
+		}
+
+		pStat->lastMs += (float)TicksToMs(evt.end - evt.start);
+		++pStat->calls;
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::EndPass( const char* name, const uint32* countersAtBegin, __int64 start )
+	{
+		SPassStat* pPass = nullptr;
+		for (size_t i=0; i<s_passes.size(); ++i)
+		{
+			if (s_passes[i].name == name)
+			{
+				pPass = &s_passes[i];
+				break;
+			}
+		}
+
+		if (!pPass)
+		{
+			SPassStat pass;
+			memset(&pass, 0, sizeof(pass));
+			pass.name = name;
+			s_passes.push_back(pass);
+			pPass = &s_passes.back();
+		}
+
+		pPass->ms += (float)TicksToMs(GetTicks() - start);
+		++pPass->calls;
+
+		for (int i=0; i<eProfileCounter_Max; ++i)
+			pPass->counters[i] += s_counters[i] - countersAtBegin[i];
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::GetSummary( StringVector& lines, uint32 maxScopes )
+	{
+		char szBuf[128];
+		lines.clear();
+
+		sprintf_s(szBuf, sizeof(szBuf), "CPU %.2f ms  Draw %u  Tri %u  State %u  CB %u KB  Tex %u  MatCB %u",
+			s_lastFrameMs,
+			s_lastCounters[eProfileCounter_DrawCall],
+			s_lastCounters[eProfileCounter_Triangle],
+			s_lastCounters[eProfileCounter_StateChange],
+			s_lastCounters[eProfileCounter_CBufferBytes] / 1024,
+			s_lastCounters[eProfileCounter_TextureBind],
+			s_lastCounters[eProfileCounter_MaterialUpload]);
+		lines.push_back(szBuf);
+
+		if(!s_bEnabled)
+			return;
+
+		for (size_t i=0; i<s_scopeStats.size() && i<maxScopes; ++i)
+		{
+			const SScopeStat& stat = s_scopeStats[i];
+			sprintf_s(szBuf, sizeof(szBuf), "%*s%s %.2f ms x%u", stat.depth * 2, "", stat.name, stat.avgMs, stat.calls);
+			lines.push_back(szBuf);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Profiler::BeginCapture( uint32 frames, const STRING& filename )
+	{
+		if(IsCapturing() || frames == 0)
+			return;
+
+		g_bEnabledBeforeCapture = s_bEnabled;
+		s_bEnabled = true;
+
+		s_captureFrames = frames;
+		s_captureFile = filename;
+		s_capturedEvents.clear();
+		s_capturedFrames.clear();
+	}
+	//------------------------------------------------------------------------------------
+	const char* Profiler::GetCounterName( eProfileCounter counter )
+	{
+		static const char* NAMES[eProfileCounter_Max] =
+		{
+			"drawCalls", "triangles", "stateChanges", "cbufferBytes", "textureBinds", "materialUploads"
+		};
+
+		return NAMES[counter];
+	}
+	//------------------------------------------------------------------------------------
+	bool Profiler::_WriteTrace()
+	{
+		std::ofstream file(s_captureFile.c_str());
+		if(!file)
+			return false;
+
+		const __int64 origin = s_capturedFrames.empty() ? 0 : s_capturedFrames[0].start;
+		char szBuf[256];
+		bool bFirst = true;
+
+		file << "{\"traceEvents\":[\n";
+
+		// Timestamps in microseconds
+		for (size_t i=0; i<s_capturedFrames.size(); ++i)
+		{
+			const SCapturedFrame& frame = s_capturedFrames[i];
+			const double ts = TicksToMs(frame.start - origin) * 1000.0;
+
+			sprintf_s(szBuf, sizeof(szBuf), "%s{\"name\":\"Frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				bFirst ? "" : ",\n", g_mainThreadId, ts, TicksToMs(frame.end - frame.start) * 1000.0);
+			file << szBuf;
+			bFirst = false;
+
+			sprintf_s(szBuf, sizeof(szBuf), ",\n{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{", ts);
+			file << szBuf;
+
+			for (int iCounter=0; iCounter<eProfileCounter_Max; ++iCounter)
+			{
+				sprintf_s(szBuf, sizeof(szBuf), "%s\"%s\":%u", iCounter ? "," : "",
+					GetCounterName((eProfileCounter)iCounter), frame.counters[iCounter]);
+				file << szBuf;
+			}
+			file << "}}";
+		}
+
+		for (size_t i=0; i<s_capturedEvents.size(); ++i)
+		{
+			const SCapturedEvent& captured = s_capturedEvents[i];
+
+			sprintf_s(szBuf, sizeof(szBuf), "%s{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				bFirst ? "" : ",\n", captured.evt.name, captured.threadId,
+				TicksToMs(captured.evt.start - origin) * 1000.0,
+				TicksToMs(captured.evt.end - captured.evt.start) * 1000.0);
+			file << szBuf;
+			bFirst = false;
+		}
+
+		file << "\n]}\n";
+
+		return true;
+	}
+}
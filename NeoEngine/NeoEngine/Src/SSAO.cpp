@@ -4,6 +4,8 @@
 #include "D3D11Texture.h"
 #include "D3D11RenderSystem.h"
 #include "Material.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 
 
 namespace Neo
@@ -94,6 +96,7 @@ namespace Neo
 		bd.CPUAccessFlags = 0;
 		bd.ByteWidth = sizeof(cBufferBlur);
 		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pCB_Blur ));
+		MemoryTracker::AddBuffer(m_pCB_Blur, eMemTag_Misc, "SSAO cbuffer");
 	}
 	//------------------------------------------------------------------------------------
 	SSAO::~SSAO()
@@ -110,6 +113,7 @@ namespace Neo
 		SAFE_RELEASE(m_pRT_ssao);
 		SAFE_RELEASE(m_pRT_BlurH);
 		SAFE_RELEASE(m_pRT_BlurV);
+		MemoryTracker::Remove(m_pCB_Blur);
 		SAFE_RELEASE(m_pCB_Blur);
 	}
 	//-------------------------------------------------------------------------------
@@ -131,6 +135,7 @@ namespace Neo
 			m_cBufferBlur.texelKernel[i+blurRadius].Set(i*fInvTexW, 0, 0, 0);
 
 		pContext->UpdateSubresource( m_pCB_Blur, 0, NULL, &m_cBufferBlur, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_cBufferBlur));
 		pContext->VSSetConstantBuffers( 1, 1, &m_pCB_Blur );
 		pContext->PSSetConstantBuffers( 1, 1, &m_pCB_Blur );
 
@@ -142,6 +147,7 @@ namespace Neo
 			m_cBufferBlur.texelKernel[i+blurRadius].Set(0, i*fInvTexH, 0, 0);
 
 		pContext->UpdateSubresource( m_pCB_Blur, 0, NULL, &m_cBufferBlur, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_cBufferBlur));
 		pContext->VSSetConstantBuffers( 1, 1, &m_pCB_Blur );
 		pContext->PSSetConstantBuffers( 1, 1, &m_pCB_Blur );
 
@@ -11,8 +11,9 @@
 namespace Neo
 {
 	//------------------------------------------------------------------------------------
-	Scene::Scene( StrategyFunc& setupFunc, StrategyFunc& enterFunc )
-		:m_bSetup(false)
+	Scene::Scene( const STRING& name, StrategyFunc& setupFunc, StrategyFunc& enterFunc )
+		:m_name(name)
+		,m_bSetup(false)
 		,m_setupFunc(setupFunc)
 		,m_enterFunc(enterFunc)
 	{
@@ -4,6 +4,7 @@
 #include "Water.h"
 #include "Sky.h"
 #include "Terrain.h"
+#include "Grass.h"
 #include "Scene.h"
 #include "MeshLoader.h"
 #include "D3D11RenderTarget.h"
@@ -14,6 +15,12 @@
 #include "ShadowMap.h"
 #include "Tree.h"
 #include "Mesh.h"
+#include "TextureManager.h"
+#include "Profiler.h"
+#include "TransformStorage.h"
+#include "MemoryTracker.h"
+#include "FrameAllocator.h"
+#include "ShaderLibrary.h"
 
 
 namespace Neo
@@ -23,13 +30,17 @@ namespace Neo
 	:m_pRenderSystem(g_env.pRenderSystem)
 	,m_camera(nullptr)
 	,m_pCurScene(nullptr)
+	,m_curSceneIndex(0)
 	,m_pTerrain(nullptr)
+	,m_pGrass(nullptr)
 	,m_pWater(nullptr)
 	,m_pSky(nullptr)
 	,m_pMeshLoader(new MeshLoader)
 	,m_debugRT(eDebugRT_None)
 	,m_pShadowMap(new ShadowMap)
 	,m_renderFlag(eRenderPhase_All)
+	,m_lodPass(eLodPass_Main)
+	,m_bShowMemory(false)
 	{
 		
 	}
@@ -97,6 +108,8 @@ namespace Neo
 	void SceneManager::CreateTerrain()
 	{
 		m_pTerrain = new Terrain(GetResPath("terrain.raw"));
+		// Optional, converted from terrain.raw by TerrainTileConverter
+		m_pTerrain->OpenTileSet(GetResPath("terrain.tiles"));
 	}
 	//-------------------------------------------------------------------------------
 	void SceneManager::CreateWater(float waterHeight)
@@ -104,19 +117,39 @@ namespace Neo
 		m_pWater = new Water(waterHeight);
 	}
 	//-------------------------------------------------------------------------------
+	void SceneManager::CreateGrass()
+	{
+		assert(m_pTerrain && "Grass needs the terrain!");
+		m_pGrass = new Grass(m_pTerrain);
+	}
+	//-------------------------------------------------------------------------------
 	void SceneManager::Update()
 	{
+		PROFILE_SCOPE("SceneUpdate");
+
 		if(m_pShadowMap)
 			m_pShadowMap->Update();
 
+		if (m_pTerrain)
+			m_pTerrain->Update();
+
 		if (m_pWater)
 			m_pWater->Update();
 
 		if (m_pSky)
 			m_pSky->Update();
 
+		if (m_pGrass)
+			m_pGrass->Update();
+
+		// Rebuild moved entities' matrices in one batch, their Update then only refits bounds of those
+		TransformStorage::UpdateDirty();
+
 		if(m_pCurScene)
 			m_pCurScene->Update();
+
+		// Apply mip requests made while rendering last frame
+		m_pRenderSystem->GetTextureManager()->UpdateStreaming();
 	}
 	//------------------------------------------------------------------------------------
 	void SceneManager::Render(Material* pMaterial)
@@ -124,6 +157,7 @@ namespace Neo
 		// Render shadow map
 		if (m_pShadowMap)
 		{
+			PROFILE_PASS("ShadowMap");
 			m_pShadowMap->Render();
 		}
 
@@ -137,6 +171,7 @@ namespace Neo
 		//================================================================================
 		if (m_pSky && phaseFlag&eRenderPhase_Sky)
 		{
+			PROFILE_PASS("Sky");
 			m_pSky->Render();
 		}
 
@@ -145,6 +180,7 @@ namespace Neo
 		//================================================================================
 		if (m_pTerrain && phaseFlag&eRenderPhase_Terrain)
 		{
+			PROFILE_PASS("Terrain");
 			m_pTerrain->Render(pMaterial);
 		}
 		else if (m_pTerrain && phaseFlag&eRenderPhase_ShadowMap)
@@ -152,6 +188,13 @@ namespace Neo
 			m_pTerrain->Render(m_pTerrain->GetShadowMaterial());
 		}
 
+		// Neither in the reflection nor with an override material
+		if (m_pGrass && phaseFlag&eRenderPhase_Terrain && !pMaterial && !m_pRenderSystem->IsClipPlaneEnabled())
+		{
+			PROFILE_PASS("Grass");
+			m_pGrass->Render();
+		}
+
 		//================================================================================
 		/// Render SSAO map
 		//================================================================================
@@ -173,13 +216,29 @@ namespace Neo
 
 		if (phaseFlag & eRenderPhase_Solid)
 		{
+			// Water reflection is the only clipped pass
+			m_lodPass = m_pRenderSystem->IsClipPlaneEnabled() ? eLodPass_Reflection : eLodPass_Main;
+
+			PROFILE_PASS("Entities");
+
+			// Same shader and same parent material next to each other, scene order otherwise
+			typedef std::pair<uint32, uint32>	SortEntry;
+			std::vector<SortEntry, FrameStlAllocator<SortEntry>> order;
+			order.reserve(lstEntity.size());
 			for (size_t i=0; i<lstEntity.size(); ++i)
+				order.push_back(SortEntry(pMaterial ? 0 : lstEntity[i]->GetSortKey(), (uint32)i));
+
+			std::sort(order.begin(), order.end());
+
+			for (size_t i=0; i<order.size(); ++i)
 			{
-				lstEntity[i]->Render(pMaterial);
+				lstEntity[order[i].second]->Render(pMaterial);
 			}
 		}
 		else if (phaseFlag & eRenderPhase_ShadowMap)
 		{
+			m_lodPass = eLodPass_Shadow;
+
 			for (size_t i=0; i<lstEntity.size(); ++i)
 			{
 				Entity* ent = lstEntity[i];
@@ -201,6 +260,7 @@ namespace Neo
 		//================================================================================
 		if (m_pWater && phaseFlag&eRenderPhase_Water)
 		{
+			PROFILE_PASS("Water");
 			m_pWater->Render();
 		}
 
@@ -214,10 +274,39 @@ namespace Neo
 			depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
 			m_pRenderSystem->SetDepthStencelState(depthDesc);
 
+			PROFILE_PASS("UI");
+
 			char szBuf[64];
 			sprintf_s(szBuf, sizeof(szBuf), "lastFPS : %f", g_env.pFrameStat->lastFPS);
 			m_pRenderSystem->DrawText(szBuf, IPOINT(10,10), Neo::SColor::YELLOW);
 
+			// Profiler summary of last frame
+			StringVector lines;
+			Profiler::GetSummary(lines);
+			for (size_t i=0; i<lines.size(); ++i)
+				m_pRenderSystem->DrawText(lines[i], IPOINT(10, 50 + (int)i * 40), Neo::SColor::WHITE);
+
+			// Memory on the right half, profiler summary uses the left
+			if (m_bShowMemory)
+			{
+				lines.clear();
+				MemoryTracker::GetSummary(lines);
+
+				sprintf_s(szBuf, sizeof(szBuf), "Frame arena %u KB peak %u KB over %u KB", FrameAllocator::GetLastFrameBytes() / 1024,
+					FrameAllocator::GetPeakFrameBytes() / 1024, FrameAllocator::GetLastOverflowBytes() / 1024);
+				lines.push_back(szBuf);
+
+				const ShaderLibrary* pShaderLib = m_pRenderSystem->GetShaderLibrary();
+				sprintf_s(szBuf, sizeof(szBuf), "Shader permutations %u unique of %u requested",
+					pShaderLib->GetUniqueCount(), pShaderLib->GetRequestCount());
+				lines.push_back(szBuf);
+				lines.insert(lines.end(), m_sceneMemDiff.begin(), m_sceneMemDiff.end());
+
+				const int x = m_pRenderSystem->GetWndWidth() / 2;
+				for (size_t i=0; i<lines.size(); ++i)
+					m_pRenderSystem->DrawText(lines[i], IPOINT(x, 50 + (int)i * 40), Neo::SColor::WHITE);
+			}
+
 			// Debug RT
 			if (m_debugRT == eDebugRT_SSAO)
 			{
@@ -228,6 +317,8 @@ namespace Neo
 				m_pDebugRTMesh->Render();
 			}
 
+			m_pRenderSystem->FlushText();
+
 			depthDesc.DepthEnable = TRUE;
 			depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
 			m_pRenderSystem->SetDepthStencelState(depthDesc);
@@ -236,22 +327,31 @@ namespace Neo
 	//------------------------------------------------------------------------------------
 	void SceneManager::ClearScene()
 	{
+		SAFE_DELETE(m_pGrass);
 		SAFE_DELETE(m_pTerrain);
 		SAFE_DELETE(m_pWater);
 		SAFE_DELETE(m_pSky);
 	}
 	//------------------------------------------------------------------------------------
-	Entity* SceneManager::CreateEntity(eEntity type, const STRING& meshname)
+	MeshHandle SceneManager::LoadMesh( const STRING& meshname )
 	{
 		auto iter = m_meshes.find(meshname);
 
 		if (iter == m_meshes.end())
 		{
 			Mesh* mesh = MeshLoader::LoadMesh(meshname);
-			iter = m_meshes.insert(std::make_pair(meshname, mesh)).first;
+			if(!mesh)
+				return MeshHandle();
+
+			iter = m_meshes.insert(std::make_pair(meshname, m_meshPool.Create(mesh))).first;
 		}
-		
-		Mesh* mesh = iter->second;
+
+		return iter->second;
+	}
+	//------------------------------------------------------------------------------------
+	Entity* SceneManager::CreateEntity(eEntity type, const STRING& meshname)
+	{
+		Mesh* mesh = m_meshPool.Resolve(LoadMesh(meshname));
 		assert(mesh);
 
 		Entity* pEntity = nullptr;
@@ -291,15 +391,53 @@ namespace Neo
 	//----------------------------------------------------------------------------------------
 	void SceneManager::ToggleScene()
 	{
-		EnableDebugRT(eDebugRT_None);
+		uint32 index = m_pCurScene ? m_curSceneIndex + 1 : 0;
+		if(index == m_scenes.size())
+			index = 0;
 
-		static int curScene = -1;
-		++curScene;
-		if(curScene == m_scenes.size())
-			curScene = 0;
+		_EnterScene(index);
+	}
+	//------------------------------------------------------------------------------------
+	bool SceneManager::EnterScene( const STRING& name )
+	{
+		for (size_t i=0; i<m_scenes.size(); ++i)
+		{
+			if (m_scenes[i]->GetName() == name)
+			{
+				_EnterScene(i);
+				return true;
+			}
+		}
 
-		m_pCurScene = m_scenes[curScene];
+		Scene* pScene = _CreateTestScene(name);
+		if(!pScene)
+			return false;
+
+		m_scenes.push_back(pScene);
+		_EnterScene(m_scenes.size() - 1);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void SceneManager::_EnterScene( uint32 index )
+	{
+		MemoryTracker::SSnapshot before, after;
+		MemoryTracker::TakeSnapshot(before);
+
+		EnableDebugRT(eDebugRT_None);
+
+		m_curSceneIndex = index;
+		m_pCurScene = m_scenes[index];
 		m_pCurScene->Enter();
+
+		// Textures only used by the previous scene are unreferenced now
+		m_pRenderSystem->GetTextureManager()->EvictToBudget();
+
+		MemoryTracker::TakeSnapshot(after);
+
+		m_sceneMemDiff.clear();
+		m_sceneMemDiff.push_back("Enter " + m_pCurScene->GetName() + ":");
+		MemoryTracker::Diff(before, after, m_sceneMemDiff);
 	}
 	//------------------------------------------------------------------------------------
 	void SceneManager::SetupSunLight( const VEC3& dir, const SColor& color )
@@ -0,0 +1,417 @@
+#include "ShaderCache.h"
+#include "ParallelFor.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+namespace Neo
+{
+	// Bump to drop every existing entry, e.g. when the compiler changes
+	static const unsigned int		CACHE_VERSION	=	1;
+	static const char*				MANIFEST_NAME	=	"manifest.txt";
+
+	namespace
+	{
+		const unsigned long long	FNV_OFFSET	=	14695981039346656037ULL;
+		const unsigned long long	FNV_PRIME	=	1099511628211ULL;
+
+		// FNV-1a
+		void HashBytes(unsigned long long& hash, const void* pData, size_t size)
+		{
+			const unsigned char* p = (const unsigned char*)pData;
+			for (size_t i=0; i<size; ++i)
+			{
+				hash ^= p[i];
+				hash *= FNV_PRIME;
+			}
+		}
+
+		// Length first, so "ab"+"c" and "a"+"bc" differ
+		void HashString(unsigned long long& hash, const std::string& str)
+		{
+			const unsigned int len = (unsigned int)str.length();
+			HashBytes(hash, &len, sizeof(len));
+			HashBytes(hash, str.data(), str.length());
+		}
+
+		std::string GetDirectory(const std::string& filename)
+		{
+			const size_t pos = filename.find_last_of("/\\");
+			return pos == std::string::npos ? std::string() : filename.substr(0, pos + 1);
+		}
+
+		// Names of #include "x" and #include <x> directives, in order
+		void ParseIncludes(const std::string& text, std::vector<std::string>& includes)
+		{
+			std::istringstream stream(text);
+			std::string line;
+
+			while (std::getline(stream, line))
+			{
+				size_t pos = line.find_first_not_of(" \t");
+				if(pos == std::string::npos || line[pos] != '#')
+					continue;
+
+				pos = line.find_first_not_of(" \t", pos + 1);
+				if(pos == std::string::npos || line.compare(pos, 7, "include") != 0)
+					continue;
+
+				const size_t start = line.find_first_of("\"<", pos + 7);
+				if(start == std::string::npos)
+					continue;
+
+				const size_t end = line.find_first_of("\">", start + 1);
+				if(end != std::string::npos)
+					includes.push_back(line.substr(start + 1, end - start - 1));
+			}
+		}
+
+		void SplitString(const std::string& str, char sep, std::vector<std::string>& parts)
+		{
+			size_t start = 0;
+			for (;;)
+			{
+				const size_t end = str.find(sep, start);
+				parts.push_back(str.substr(start, end == std::string::npos ? std::string::npos : end - start));
+				if(end == std::string::npos)
+					break;
+				start = end + 1;
+			}
+		}
+
+		void CreateDir(const std::string& dir)
+		{
+#ifdef _WIN32
+			CreateDirectoryA(dir.c_str(), nullptr);
+#else
+			mkdir(dir.c_str(), 0755);
+#endif
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	ShaderCache::ShaderCache( IShaderCompiler* pCompiler, const std::string& cacheDir )
+		:m_pCompiler(pCompiler)
+		,m_cacheDir(cacheDir)
+	{
+		if (!m_cacheDir.empty())
+		{
+			const char last = m_cacheDir[m_cacheDir.length() - 1];
+			if(last != '/' && last != '\\')
+				m_cacheDir += '/';
+
+			CreateDir(m_cacheDir);
+
+			// Keep what earlier runs recorded, new requests are appended
+			std::vector<SShaderCompileDesc> descs;
+			LoadManifest(m_cacheDir + MANIFEST_NAME, descs);
+			for (size_t i=0; i<descs.size(); ++i)
+				m_manifestLines.insert(_ToManifestLine(descs[i]));
+		}
+	}
+	//------------------------------------------------------------------------------------
+	ShaderCache::~ShaderCache()
+	{
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderCache::_HashSource( const std::string& filename, unsigned long long& hash, std::vector<std::string>& visited )
+	{
+		if(std::find(visited.begin(), visited.end(), filename) != visited.end())
+			return true;
+		visited.push_back(filename);
+
+		std::string text;
+		if(!m_pCompiler->LoadSource(filename, text))
+		{
+			// Missing include is the compiler's business, still part of the key
+			HashString(hash, filename);
+			return false;
+		}
+
+		HashString(hash, text);
+
+		// Include paths are relative to the including file
+		std::vector<std::string> includes;
+		ParseIncludes(text, includes);
+
+		const std::string dir = GetDirectory(filename);
+		for (size_t i=0; i<includes.size(); ++i)
+			_HashSource(dir + includes[i], hash, visited);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	unsigned long long ShaderCache::ComputeKey( const SShaderCompileDesc& desc )
+	{
+		unsigned long long hash = FNV_OFFSET;
+		HashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+
+		std::vector<std::string> visited;
+		if(!_HashSource(desc.filename, hash, visited))
+			return 0;
+
+		HashString(hash, desc.entryPoint);
+		HashString(hash, desc.profile);
+		HashBytes(hash, &desc.flags, sizeof(desc.flags));
+
+		for (size_t i=0; i<desc.macros.size(); ++i)
+		{
+			HashString(hash, desc.macros[i].name);
+			HashString(hash, desc.macros[i].value);
+		}
+
+		// 0 is reserved for failure
+		return hash ? hash : 1;
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderCache::GetBytecode( const SShaderCompileDesc& desc, ShaderBytecode& code, std::string& errors )
+	{
+		const unsigned long long key = ComputeKey(desc);
+		if (!key)
+		{
+			errors = "Can't read shader source " + desc.filename;
+			++m_stats.failures;
+			return false;
+		}
+
+		auto iter = m_entries.find(key);
+		if (iter != m_entries.end())
+		{
+			code = iter->second;
+			++m_stats.memoryHits;
+			_Record(desc);
+			return true;
+		}
+
+		if (_ReadEntry(key, code))
+		{
+			m_entries[key] = code;
+			++m_stats.diskHits;
+			_Record(desc);
+			return true;
+		}
+
+		if (!m_pCompiler->Compile(desc, code, errors))
+		{
+			++m_stats.failures;
+			return false;
+		}
+
+		++m_stats.compiles;
+		m_entries[key] = code;
+		_WriteEntry(key, code);
+		_Record(desc);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int ShaderCache::Precompile( const std::vector<SShaderCompileDesc>& descs, unsigned int numThreads )
+	{
+		struct SJob
+		{
+			const SShaderCompileDesc*	pDesc;
+			unsigned long long			key;
+			ShaderBytecode				code;
+			bool						bOk;
+		};
+
+		// Keys are computed here, workers only compile and write their own entry
+		std::vector<SJob> jobs;
+		std::set<unsigned long long> queued;
+		unsigned int nFailed = 0;
+
+		for (size_t i=0; i<descs.size(); ++i)
+		{
+			const unsigned long long key = ComputeKey(descs[i]);
+			if (!key)
+			{
+				++nFailed;
+				continue;
+			}
+
+			if(m_entries.find(key) != m_entries.end() || queued.find(key) != queued.end())
+				continue;
+
+			// Warm the memory layer on the way
+			ShaderBytecode code;
+			if (_ReadEntry(key, code))
+			{
+				m_entries[key].swap(code);
+				++m_stats.diskHits;
+				continue;
+			}
+
+			SJob job;
+			job.pDesc = &descs[i];
+			job.key = key;
+			job.bOk = false;
+			jobs.push_back(job);
+			queued.insert(key);
+		}
+
+		ParallelFor((unsigned int)jobs.size(), [&](unsigned int i)
+		{
+			SJob& job = jobs[i];
+			std::string errors;
+
+			job.bOk = m_pCompiler->Compile(*job.pDesc, job.code, errors);
+			if(job.bOk)
+				_WriteEntry(job.key, job.code);
+		}, numThreads);
+
+		for (size_t i=0; i<jobs.size(); ++i)
+		{
+			if (jobs[i].bOk)
+			{
+				m_entries[jobs[i].key].swap(jobs[i].code);
+				++m_stats.compiles;
+			}
+			else
+			{
+				++nFailed;
+				++m_stats.failures;
+			}
+		}
+
+		return nFailed;
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int ShaderCache::PrecompileManifest( unsigned int numThreads )
+	{
+		if(m_cacheDir.empty())
+			return 0;
+
+		std::vector<SShaderCompileDesc> descs;
+		LoadManifest(m_cacheDir + MANIFEST_NAME, descs);
+
+		return Precompile(descs, numThreads);
+	}
+	//------------------------------------------------------------------------------------
+	std::string ShaderCache::_GetEntryPath( unsigned long long key ) const
+	{
+		std::ostringstream name;
+		name << m_cacheDir << std::hex << std::setw(16) << std::setfill('0') << key << ".cso";
+
+		return name.str();
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderCache::_ReadEntry( unsigned long long key, ShaderBytecode& code ) const
+	{
+		if(m_cacheDir.empty())
+			return false;
+
+		std::ifstream file(_GetEntryPath(key).c_str(), std::ios::binary);
+		if(!file)
+			return false;
+
+		file.seekg(0, std::ios::end);
+		const std::streamoff size = file.tellg();
+		file.seekg(0, std::ios::beg);
+
+		if(size <= 0)
+			return false;
+
+		code.resize((size_t)size);
+		file.read(&code[0], size);
+
+		return !file.fail();
+	}
+	//------------------------------------------------------------------------------------
+	void ShaderCache::_WriteEntry( unsigned long long key, const ShaderBytecode& code ) const
+	{
+		if(m_cacheDir.empty() || code.empty())
+			return;
+
+		// A failed write only costs a compile next run
+		std::ofstream file(_GetEntryPath(key).c_str(), std::ios::binary | std::ios::trunc);
+		file.write(&code[0], code.size());
+	}
+	//------------------------------------------------------------------------------------
+	std::string ShaderCache::_ToManifestLine( const SShaderCompileDesc& desc )
+	{
+		// filename|entry|profile|flags|NAME=VALUE;NAME=VALUE
+		std::ostringstream line;
+		line << desc.filename << '|' << desc.entryPoint << '|' << desc.profile << '|' << desc.flags << '|';
+		for (size_t i=0; i<desc.macros.size(); ++i)
+		{
+			if(i > 0)
+				line << ';';
+			line << desc.macros[i].name << '=' << desc.macros[i].value;
+		}
+
+		return line.str();
+	}
+	//------------------------------------------------------------------------------------
+	void ShaderCache::_Record( const SShaderCompileDesc& desc )
+	{
+		if(m_cacheDir.empty())
+			return;
+
+		const std::string line = _ToManifestLine(desc);
+		if(!m_manifestLines.insert(line).second)
+			return;
+
+		std::ofstream file((m_cacheDir + MANIFEST_NAME).c_str(), std::ios::app);
+		file << line << '\n';
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderCache::SaveManifest( const std::string& filename, const std::vector<SShaderCompileDesc>& descs )
+	{
+		std::ofstream file(filename.c_str(), std::ios::trunc);
+		if(!file)
+			return false;
+
+		for (size_t i=0; i<descs.size(); ++i)
+			file << _ToManifestLine(descs[i]) << '\n';
+
+		return !file.fail();
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderCache::LoadManifest( const std::string& filename, std::vector<SShaderCompileDesc>& descs )
+	{
+		std::ifstream file(filename.c_str());
+		if(!file)
+			return false;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::vector<std::string> fields;
+			SplitString(line, '|', fields);
+			if(fields.size() != 5 || fields[0].empty())
+				continue;
+
+			SShaderCompileDesc desc;
+			desc.filename = fields[0];
+			desc.entryPoint = fields[1];
+			desc.profile = fields[2];
+			desc.flags = (unsigned int)strtoul(fields[3].c_str(), nullptr, 10);
+
+			if (!fields[4].empty())
+			{
+				std::vector<std::string> macros;
+				SplitString(fields[4], ';', macros);
+
+				for (size_t i=0; i<macros.size(); ++i)
+				{
+					const size_t eq = macros[i].find('=');
+					desc.macros.push_back(SShaderMacro(macros[i].substr(0, eq),
+						eq == std::string::npos ? std::string() : macros[i].substr(eq + 1)));
+				}
+			}
+
+			descs.push_back(desc);
+		}
+
+		return true;
+	}
+}
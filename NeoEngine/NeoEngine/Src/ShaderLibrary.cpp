@@ -0,0 +1,282 @@
+#include "stdafx.h"
+#include "ShaderLibrary.h"
+#include <D3Dcompiler.h>
+#include "D3D11RenderSystem.h"
+#include "MemoryTracker.h"
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	ShaderProgram::ShaderProgram( uint32 id )
+	:m_id(id)
+	,m_pVertexShader(nullptr)
+	,m_pPixelShader(nullptr)
+	,m_pVS_WithClipPlane(nullptr)
+	,m_pInputLayout(nullptr)
+	,m_pHullShader(nullptr)
+	,m_pDomainShader(nullptr)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	ShaderProgram::~ShaderProgram()
+	{
+		MemoryTracker::Remove(&m_vsCode);
+		MemoryTracker::Remove(m_pVertexShader);
+		MemoryTracker::Remove(m_pPixelShader);
+		MemoryTracker::Remove(m_pVS_WithClipPlane);
+		MemoryTracker::Remove(m_pHullShader);
+		MemoryTracker::Remove(m_pDomainShader);
+
+		SAFE_RELEASE(m_pInputLayout);
+		SAFE_RELEASE(m_pVertexShader);
+		SAFE_RELEASE(m_pPixelShader);
+		SAFE_RELEASE(m_pVS_WithClipPlane);
+		SAFE_RELEASE(m_pHullShader);
+		SAFE_RELEASE(m_pDomainShader);
+	}
+	//------------------------------------------------------------------------------------
+	ShaderLibrary::ShaderLibrary( D3D11RenderSystem* pRenderSystem )
+	:m_pRenderSystem(pRenderSystem)
+	,m_numRequests(0)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	ShaderLibrary::~ShaderLibrary()
+	{
+		// Materials still holding a program keep it alive
+		for (auto iter=m_programs.begin(); iter!=m_programs.end(); ++iter)
+			iter->second->Release();
+		m_programs.clear();
+	}
+	//------------------------------------------------------------------------------------
+	STRING ShaderLibrary::_MakeKey( const STRING& files, uint32 shaderFlag, eVertexType vertType, const D3D_SHADER_MACRO* macros )
+	{
+		// Flag dependent macros are already in the list, but user macros aren't covered by
+		// the flag mask, so they have to be part of the key too
+		char szBuf[32];
+		sprintf_s(szBuf, sizeof(szBuf), "|%u|%d|", shaderFlag, (int)vertType);
+
+		STRING key = files + szBuf;
+		for (; macros && macros->Name; ++macros)
+		{
+			key += macros->Name;
+			key += '=';
+			if(macros->Definition)
+				key += macros->Definition;
+			key += ';';
+		}
+
+		return key;
+	}
+	//------------------------------------------------------------------------------------
+	ShaderProgram* ShaderLibrary::GetProgram( const STRING& vsFileName, const STRING& psFileName, uint32 shaderFlag,
+		eVertexType vertType, const D3D_SHADER_MACRO* macros )
+	{
+		++m_numRequests;
+
+		const STRING key = _MakeKey(vsFileName + "|" + psFileName, shaderFlag, vertType, macros);
+		auto iter = m_programs.find(key);
+		if (iter != m_programs.end())
+		{
+			iter->second->AddRef();
+			return iter->second;
+		}
+
+		ShaderProgram* pProgram = new ShaderProgram((uint32)m_programs.size() + 1);
+		if (!_CreateProgram(pProgram, vsFileName, psFileName, shaderFlag, vertType, macros))
+		{
+			pProgram->Release();
+			return nullptr;
+		}
+
+		// One reference for the library, one for the caller
+		pProgram->AddRef();
+		m_programs.insert(std::make_pair(key, pProgram));
+
+		return pProgram;
+	}
+	//------------------------------------------------------------------------------------
+	ShaderProgram* ShaderLibrary::GetTessellationProgram( const STRING& filename, uint32 shaderFlag, const D3D_SHADER_MACRO* macros )
+	{
+		++m_numRequests;
+
+		// No input layout, vertex type doesn't matter
+		const STRING key = _MakeKey("tess|" + filename, shaderFlag, eVertexType_General, macros);
+		auto iter = m_programs.find(key);
+		if (iter != m_programs.end())
+		{
+			iter->second->AddRef();
+			return iter->second;
+		}
+
+		ShaderProgram* pProgram = new ShaderProgram((uint32)m_programs.size() + 1);
+		if (!_CreateTessellationProgram(pProgram, filename, macros))
+		{
+			pProgram->Release();
+			return nullptr;
+		}
+
+		pProgram->AddRef();
+		m_programs.insert(std::make_pair(key, pProgram));
+
+		return pProgram;
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderLibrary::_Compile( const STRING& filename, const char* szEntryPoint, const char* szShaderModel,
+		const D3D_SHADER_MACRO* macros, ShaderBytecode& code )
+	{
+		SShaderCompileDesc desc;
+		desc.filename = filename;
+		desc.entryPoint = szEntryPoint;
+		desc.profile = szShaderModel;
+		desc.flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined( DEBUG ) || defined( _DEBUG )
+		desc.flags |= D3DCOMPILE_DEBUG;
+#endif
+
+		for (; macros && macros->Name; ++macros)
+			desc.macros.push_back(SShaderMacro(macros->Name, macros->Definition ? macros->Definition : ""));
+
+		// Most likely fetched from the shader cache
+		STRING errors;
+		if (!m_pRenderSystem->GetShaderCache()->GetBytecode(desc, code, errors))
+		{
+			MessageBoxA(nullptr, errors.c_str(), "Error", MB_OK | MB_ICONERROR);
+			return false;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderLibrary::_CreateProgram( ShaderProgram* pProgram, const STRING& vsFileName, const STRING& psFileName,
+		uint32 shaderFlag, eVertexType vertType, const D3D_SHADER_MACRO* macros )
+	{
+		ID3D11Device* pDevice = m_pRenderSystem->GetDevice();
+		ShaderBytecode& vsCode = pProgram->m_vsCode;
+		ShaderBytecode psCode;
+
+		if(!_Compile( vsFileName, "VS", "vs_4_0", macros, vsCode ) ||
+			!_Compile( psFileName, "PS", "ps_4_0", macros, psCode ))
+			return false;
+
+		if(FAILED(pDevice->CreateVertexShader( &vsCode[0], vsCode.size(), NULL, &pProgram->m_pVertexShader )) ||
+			FAILED(pDevice->CreatePixelShader( &psCode[0], psCode.size(), NULL, &pProgram->m_pPixelShader )))
+			return false;
+
+		// Driver copy of the byte code is the best estimate we have
+		MemoryTracker::Add(pProgram->m_pVertexShader, eMemTag_Material, eMemPool_GPU, vsCode.size(), vsFileName);
+		MemoryTracker::Add(pProgram->m_pPixelShader, eMemTag_Material, eMemPool_GPU, psCode.size(), psFileName);
+		MemoryTracker::Add(&pProgram->m_vsCode, eMemTag_Material, eMemPool_CPU, vsCode.size(), vsFileName);
+
+		// Create clip plane shader
+		if (shaderFlag & eShaderFlag_EnableClipPlane)
+		{
+			ShaderBytecode clipCode;
+			if(!_Compile( vsFileName, "VS_ClipPlane", "vs_4_0", macros, clipCode ))
+				return false;
+
+			if(FAILED(pDevice->CreateVertexShader( &clipCode[0], clipCode.size(), NULL, &pProgram->m_pVS_WithClipPlane )))
+				return false;
+
+			MemoryTracker::Add(pProgram->m_pVS_WithClipPlane, eMemTag_Material, eMemPool_GPU, clipCode.size(), vsFileName);
+		}
+
+		return _CreateVertexLayout(pProgram, vertType);
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderLibrary::_CreateTessellationProgram( ShaderProgram* pProgram, const STRING& filename, const D3D_SHADER_MACRO* macros )
+	{
+		ID3D11Device* pDevice = m_pRenderSystem->GetDevice();
+		ShaderBytecode hsCode, dsCode;
+
+		if(!_Compile( filename, "HS", "hs_5_0", macros, hsCode ) ||
+			!_Compile( filename, "DS", "ds_5_0", macros, dsCode ))
+			return false;
+
+		if(FAILED(pDevice->CreateHullShader( &hsCode[0], hsCode.size(), NULL, &pProgram->m_pHullShader )) ||
+			FAILED(pDevice->CreateDomainShader( &dsCode[0], dsCode.size(), NULL, &pProgram->m_pDomainShader )))
+			return false;
+
+		MemoryTracker::Add(pProgram->m_pHullShader, eMemTag_Material, eMemPool_GPU, hsCode.size(), filename);
+		MemoryTracker::Add(pProgram->m_pDomainShader, eMemTag_Material, eMemPool_GPU, dsCode.size(), filename);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool ShaderLibrary::_CreateVertexLayout( ShaderProgram* pProgram, eVertexType vertType )
+	{
+		const ShaderBytecode& vsCode = pProgram->m_vsCode;
+		HRESULT hr = E_FAIL;
+
+		switch (vertType)
+		{
+		case eVertexType_General:
+			{
+				D3D11_INPUT_ELEMENT_DESC layout[] =
+				{
+					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				};
+
+				hr = m_pRenderSystem->GetDevice()->CreateInputLayout(
+					layout, ARRAYSIZE(layout), &vsCode[0], vsCode.size(), &pProgram->m_pInputLayout );
+			}
+			break;
+
+		case eVertexType_TreeLeaf:
+			{
+				D3D11_INPUT_ELEMENT_DESC layout[] =
+				{
+					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 1, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 2, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 3, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				};
+
+				hr = m_pRenderSystem->GetDevice()->CreateInputLayout(
+					layout, ARRAYSIZE(layout), &vsCode[0], vsCode.size(), &pProgram->m_pInputLayout );
+			}
+			break;
+
+		case eVertexType_Text:
+			{
+				D3D11_INPUT_ELEMENT_DESC layout[] =
+				{
+					{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				};
+
+				hr = m_pRenderSystem->GetDevice()->CreateInputLayout(
+					layout, ARRAYSIZE(layout), &vsCode[0], vsCode.size(), &pProgram->m_pInputLayout );
+			}
+			break;
+
+		case eVertexType_Grass:
+			{
+				D3D11_INPUT_ELEMENT_DESC layout[] =
+				{
+					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+					// Root and scale, then rotation and tint
+					{ "TEXCOORD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+					{ "TEXCOORD", 2, DXGI_FORMAT_R32G32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				};
+
+				hr = m_pRenderSystem->GetDevice()->CreateInputLayout(
+					layout, ARRAYSIZE(layout), &vsCode[0], vsCode.size(), &pProgram->m_pInputLayout );
+			}
+			break;
+
+		default: assert(0); break;
+		}
+
+		assert(SUCCEEDED( hr ) && "Create vertex input layout failed!");
+
+		return SUCCEEDED(hr);
+	}
+}
@@ -2,12 +2,17 @@
 #include "Terrain.h"
 #include "Material.h"
 #include "D3D11Texture.h"
+#include "TextureManager.h"
 #include "D3D11RenderSystem.h"
 #include "SceneManager.h"
 #include "Camera.h"
 #include "ShadowMap.h"
 #include "Mesh.h"
 #include "Entity.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ParallelFor.h"
+#include "Grass.h"
 
 
 namespace Neo
@@ -16,33 +21,65 @@ namespace Neo
 	static const uint32		CELLS_PER_PATCH	=	64;
 	static const float		CELL_SPACE		=	0.5f;
 	static const float		HEIGHT_SCALE	=	50;
+	// Must match g_layerTexScale in Terrain.hlsl
+	static const float		LAYER_TEX_SCALE	=	50;
+	// Height map rows per ParallelFor item
+	static const uint32		ROWS_PER_JOB	=	64;
+	// Tessellation of a patch at full detail, one quad per cell
+	static const uint32		LEAF_TESS		=	CELLS_PER_PATCH;
+	// Screen space size a tessellated quad may reach before a finer LOD is used
+	static const float		MAX_PIXEL_ERROR	=	4;
+	// Pixels a node's grid may stray from the surface when roughness lowers its tessellation
+	static const float		MAX_HEIGHT_ERROR	=	1;
+	// Patch roughness ignores the roughest 10% of its samples
+	static const float		DENSITY_PERCENTILE	=	0.9f;
+	// Composite map covers the whole terrain, 2 texels per world unit
+	static const uint32		COMPOSITE_MAP_SIZE	=	2048;
+	// Blend map edits re-bake and re-upload whole tiles
+	static const uint32		COMPOSITE_TILE_SIZE	=	128;
+	static const float		COMPOSITE_MAP_DIST	=	300;
+	// Layer texture array of Terrain.hlsl, blended in this order
+	static const char*		LAYER_TEX_NAMES[]	=	{ "darkdirt.dds", "dirt_grayrocky.dds", "lightdirt.dds", "grass.dds", "Snow.dds" };
+	static const char*		BLEND_MAP_NAME		=	"blend.dds";
 
 	//------------------------------------------------------------------------------------
 	Terrain::Terrain(const STRING& heightmapName)
-	:m_pMesh(nullptr)
-	,m_pEntity(nullptr)
+	:m_pMaterial(nullptr)
+	,m_pCompositeMap(nullptr)
+	,m_bBlendMapEditable(false)
+	,m_pNodeVB(nullptr)
+	,m_maxNodes(0)
 	,m_pRenderSystem(g_env.pRenderSystem)
 	,m_pShadowMaterial(nullptr)
+	,m_dirtyRow0(HEIGHT_MAP_SIZE)
+	,m_dirtyCol0(HEIGHT_MAP_SIZE)
+	,m_dirtyRow1(0)
+	,m_dirtyCol1(0)
 	{
 		_InitHeightMap(heightmapName, HEIGHT_MAP_SIZE, HEIGHT_MAP_SIZE);
 		_CreateDensityMap();
 		_CalcAllPatchBoundY();
-		_InitMesh();
+		_InitHeightField();
+		_InitQuadTree();
+		_InitNodeBuffer();
 		_CalcAABB();
+		_InitCompositeMap();
 		_InitMaterial();
 		_InitConstantBuf();
 	}
 	//------------------------------------------------------------------------------------
 	Terrain::~Terrain()
 	{
+		MemoryTracker::Remove(m_pCB);
 		SAFE_RELEASE(m_pCB);
 		SAFE_RELEASE(m_pHeightMap);
 		SAFE_RELEASE(m_pLayerTexArray);
 		SAFE_RELEASE(m_pBlendMap);
-		SAFE_RELEASE(m_pDensityMap);
+		SAFE_RELEASE(m_pCompositeMap);
 		SAFE_RELEASE(m_pShadowMaterial);
-		SAFE_DELETE(m_pMesh);
-		SAFE_DELETE(m_pEntity);
+		SAFE_RELEASE(m_pMaterial);
+		MemoryTracker::Remove(m_pNodeVB);
+		SAFE_RELEASE(m_pNodeVB);
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_InitConstantBuf()
@@ -53,6 +90,7 @@ namespace Neo
 		m_cBuffer.maxTess = 6;
 		m_cBuffer.invTexSize.Set(1.0f/HEIGHT_MAP_SIZE, 1.0f/HEIGHT_MAP_SIZE);
 		m_cBuffer.terrainCellSpace = CELL_SPACE;
+		m_cBuffer.compositeMapDist = COMPOSITE_MAP_DIST;
 
 		D3D11_BUFFER_DESC bd;
 		ZeroMemory( &bd, sizeof(bd) );
@@ -63,6 +101,53 @@ namespace Neo
 
 		HRESULT hr = S_OK;
 		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pCB ));
+		MemoryTracker::AddBuffer(m_pCB, eMemTag_Terrain, "Terrain cbuffer");
+	}
+	//------------------------------------------------------------------------------------
+	// Exactly XMConvertFloatToHalf for zero and the normalized half range, which is
+	// everything the terrain produces. Other lanes fall back to XMConvertFloatToHalf.
+	static void ConvertToHalf(const float* pSrc, HALF* pDst, uint32 count)
+	{
+		const __m128i absMask	= _mm_set1_epi32(0x7FFFFFFF);
+		const __m128i signMask	= _mm_set1_epi32(0x8000);
+		const __m128i minNormal	= _mm_set1_epi32(0x38800000);
+		const __m128i maxNormal	= _mm_set1_epi32(0x47FFF000);
+		const __m128i rebias	= _mm_set1_epi32(0xC8000000);
+		const __m128i round		= _mm_set1_epi32(0x0FFF);
+		const __m128i one		= _mm_set1_epi32(1);
+		const __m128i halfMask	= _mm_set1_epi32(0x7FFF);
+
+		uint32 i = 0;
+		for (; i+4<=count; i+=4)
+		{
+			const __m128i v = _mm_castps_si128(_mm_loadu_ps(pSrc + i));
+			const __m128i sign = _mm_and_si128(_mm_srli_epi32(v, 16), signMask);
+			const __m128i a = _mm_and_si128(v, absMask);
+
+			// a < 2^31, so the signed compares are fine
+			const __m128i bNormal = _mm_andnot_si128(_mm_cmplt_epi32(a, minNormal), _mm_cmplt_epi32(a, maxNormal));
+			const __m128i bZero = _mm_cmpeq_epi32(a, _mm_setzero_si128());
+
+			if (_mm_movemask_epi8(_mm_or_si128(bNormal, bZero)) != 0xFFFF)
+			{
+				for (uint32 k=i; k<i+4; ++k)
+					pDst[k] = XMConvertFloatToHalf(pSrc[k]);
+				continue;
+			}
+
+			// ((a + rebias + 0xFFF + lsb) >> 13) & 0x7FFF, round to nearest even
+			__m128i r = _mm_add_epi32(a, rebias);
+			r = _mm_add_epi32(_mm_add_epi32(r, round), _mm_and_si128(_mm_srli_epi32(r, 13), one));
+			r = _mm_and_si128(_mm_srli_epi32(r, 13), halfMask);
+			r = _mm_or_si128(_mm_andnot_si128(bZero, r), sign);
+
+			// Sign extend so the saturating pack keeps all 16 bits
+			r = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+			_mm_storel_epi64((__m128i*)(pDst + i), _mm_packs_epi32(r, r));
+		}
+
+		for (; i<count; ++i)
+			pDst[i] = XMConvertFloatToHalf(pSrc[i]);
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_InitHeightMap(const STRING& filename, uint32 width, uint32 height)
@@ -75,97 +160,133 @@ namespace Neo
 		file.read((char*)&vecSrcData[0], nCount);
 		file.close();
 
-		// Height scale
+		// Height scale. Only 256 possible results, a table gives the very same floats.
+		float scaleTable[256];
+		for (uint32 i=0; i<256; ++i)
+			scaleTable[i] = i / 255.0f * HEIGHT_SCALE;
+
 		m_heightData.resize(nCount);
-		std::transform(vecSrcData.begin(), vecSrcData.end(), m_heightData.begin(), [=](uint8 data)
-		{ 
-			return data / 255.0f * HEIGHT_SCALE;
+
+		const uint32 numJobs = (height + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+		ParallelFor(numJobs, [&](unsigned int job)
+		{
+			const uint32 begin = job * ROWS_PER_JOB * width;
+			const uint32 end = min(begin + ROWS_PER_JOB * width, nCount);
+
+			for (uint32 i=begin; i<end; ++i)
+				m_heightData[i] = scaleTable[vecSrcData[i]];
 		});
 
-		// Smooth
-		_SmoothHeightMap(m_heightData);
-		_SmoothHeightMap(m_heightData);
+		// Smooth, ping-ponging with one scratch buffer
+		TerrainHeights scratch(nCount);
+		_SmoothHeightMap(m_heightData, scratch);
+		_SmoothHeightMap(m_heightData, scratch);
 
 		// Convert to half-float
 		std::vector<HALF> vecHeightData(nCount);
-		std::transform(m_heightData.begin(), m_heightData.end(), vecHeightData.begin(), XMConvertFloatToHalf);
+		ParallelFor(numJobs, [&](unsigned int job)
+		{
+			const uint32 begin = job * ROWS_PER_JOB * width;
+			const uint32 end = min(begin + ROWS_PER_JOB * width, nCount);
+
+			ConvertToHalf(&m_heightData[begin], &vecHeightData[begin], end - begin);
+		});
 
+		// Default usage, brush edits update sub boxes of it
 		m_pHeightMap = new D3D11Texture(HEIGHT_MAP_SIZE, HEIGHT_MAP_SIZE, (char*)&vecHeightData[0],
-			ePF_R16F, eTextureUsage_DomainShader | eTextureUsage_WriteOnly, false);
+			ePF_R16F, eTextureUsage_DomainShader, false);
+		m_pHeightMap->SetMemoryTag(eMemTag_Terrain, "Terrain height map");
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_CreateDensityMap()
 	{
-		// Create density map same desc as height map
-		m_pDensityMap = new D3D11Texture(m_pHeightMap->GetWidth(), m_pHeightMap->GetHeight(), 
-			nullptr, m_pHeightMap->GetFormat(), eTextureUsage_HullShader | eTextureUsage_ReadWrite, false);
+		m_densityMap.Build(&m_heightData[0], HEIGHT_MAP_SIZE, CELL_SPACE, CELLS_PER_PATCH, DENSITY_PERCENTILE);
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_InitNodeBuffer()
+	{
+		// Every area is drawn by one node at most, so never more nodes than patches
+		const uint32 patchPerSide = (HEIGHT_MAP_SIZE - 1) / CELLS_PER_PATCH;
+		m_maxNodes = patchPerSide * patchPerSide;
+
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory( &bd, sizeof(bd) );
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.ByteWidth = sizeof(SVertex) * 4 * m_maxNodes;
+
+		HRESULT hr = S_OK;
+		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pNodeVB ));
+		MemoryTracker::AddBuffer(m_pNodeVB, eMemTag_Terrain, "Terrain node patches");
+
+		m_visibleNodes.reserve(m_maxNodes);
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_InitQuadTree()
+	{
+		const uint32 patchPerSide = (HEIGHT_MAP_SIZE - 1) / CELLS_PER_PATCH;
+		const float fHalfDim = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE / 2;
 
-		for (uint32 i=0; i<HEIGHT_MAP_SIZE; ++i)
+		m_quadTree.Build(patchPerSide, -fHalfDim, -fHalfDim, CELLS_PER_PATCH * CELL_SPACE, LEAF_TESS, &m_patchBoundY[0].x);
+		m_quadTree.UpdateRoughness(m_densityMap.GetPatchPercentile(), 0, 0, patchPerSide - 1, patchPerSide - 1);
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_SelectNodes(Camera* pCam, const PLANE* frustumPlane)
+	{
+		STerrainView view;
+		const VEC3& camPos = pCam->GetPos();
+		view.camPos[0] = camPos.x;
+		view.camPos[1] = camPos.y;
+		view.camPos[2] = camPos.z;
+		view.pixelsPerUnit = pCam->GetProjMatrix().m11 * m_pRenderSystem->GetWndHeight() / 2;
+		view.maxPixelError = MAX_PIXEL_ERROR;
+		view.maxHeightError = MAX_HEIGHT_ERROR;
+
+		// Shadows need the casters outside the view, and the reflection camera is mirrored
+		if (g_env.pSceneMgr->GetLodPass() == eLodPass_Main)
+		{
+			view.pPlanes = &frustumPlane[0].n.x;
+			view.numPlanes = 6;
+		}
+
+		m_quadTree.Select(view, m_visibleNodes);
+		assert(m_visibleNodes.size() <= m_maxNodes);
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(m_pRenderSystem->GetDeviceContext()->Map(m_pNodeVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			m_visibleNodes.clear();
+			return;
+		}
+
+		// One quad patch per node, corners in the order the hull shader expects.
+		// Bounds, tessellation and morph band ride in the spare vertex attributes.
+		const float dimension = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE;
+		const float fHalfDim = dimension / 2;
+		SVertex* pVerts = (SVertex*)mapped.pData;
+
+		for (size_t i=0; i<m_visibleNodes.size(); ++i)
 		{
-			for (uint32 j=0; j<HEIGHT_MAP_SIZE; ++j)
+			const STerrainNode& node = m_visibleNodes[i];
+
+			for (int k=0; k<4; ++k)
 			{
+				SVertex& v = pVerts[i * 4 + k];
+				const float x = node.x + (k & 1) * node.size;
+				const float z = node.z + (k >> 1) * node.size;
 
+				v.pos.Set(x, 0, z);
+				v.uv.Set((x + fHalfDim) / dimension, (z + fHalfDim) / dimension);
+				v.normal.Set(node.morphStart, node.morphScale, 0);
+				v.color.b = node.minY;
+				v.color.g = node.maxY;
+				v.color.r = node.tessFactor;
+				v.color.a = node.edgeTessFactor;
 			}
 		}
-	}
-	//------------------------------------------------------------------------------------
-	void Terrain::_InitMesh()
-	{
- 		const uint32 patchPerSide = (HEIGHT_MAP_SIZE - 1) / CELLS_PER_PATCH;
- 		const uint32 vertsPerSide = patchPerSide + 1;
- 		const float dimension = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE;
- 		const float halfDim = dimension / 2;	
- 		float uvInc = 1.0f / patchPerSide;
- 
- 		int nVerts = vertsPerSide * vertsPerSide;
- 		int nIndex = patchPerSide * patchPerSide * 4;
- 
- 		SVertex* vert = new SVertex[nVerts];
- 		DWORD* pIndices = new DWORD[nIndex];
- 
- 		if(!vert || !pIndices)
- 			throw std::exception("Error!Not enough memory!");
- 
- 		float posZ = -halfDim;
- 		for (int z=0; z<vertsPerSide; ++z)
- 		{
- 			float posX = -halfDim;
- 			for (int x=0; x<vertsPerSide; ++x)
- 			{
- 				int idx = z*vertsPerSide+x;
- 
- 				vert[idx].pos.Set(posX, 0, posZ);
- 				vert[idx].uv.Set(x*uvInc, z*uvInc);
- 
- 				posX += CELL_SPACE * CELLS_PER_PATCH;
- 			}
- 			posZ += CELL_SPACE * CELLS_PER_PATCH;
- 		}
- 
- 		int idx = 0;
- 		for (int z=0; z<patchPerSide; ++z)
- 		{
- 			for (int x=0; x<patchPerSide; ++x)
- 			{
- 				pIndices[idx + 0] = z		* vertsPerSide + x;
- 				pIndices[idx + 1] = z		* vertsPerSide + x + 1;
- 				pIndices[idx + 2] = (z + 1) * vertsPerSide + x;
- 				pIndices[idx + 3] = (z + 1) * vertsPerSide + x + 1;
-
-				// Store y-bound
-				const uint32 leftTopIdx = z * vertsPerSide + x;
-				const VEC2& bound = m_patchBoundY[z * patchPerSide + x];
-				vert[leftTopIdx].color.b = bound.x;
-				vert[leftTopIdx].color.g = bound.y;
- 
- 				idx += 4;
- 			}
- 		}		m_pMesh = new Mesh;
-		SubMesh* pSubMesh = new SubMesh;
- 		pSubMesh->InitVertData(eVertexType_General, vert, nVerts, true);
- 		pSubMesh->InitIndexData(pIndices, nIndex, true);		m_pMesh->AddSubMesh(pSubMesh);		m_pEntity = new Entity(m_pMesh, false);
- 		SAFE_DELETE_ARRAY(vert);
- 		SAFE_DELETE_ARRAY(pIndices);
+
+		m_pRenderSystem->GetDeviceContext()->Unmap(m_pNodeVB, 0);
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_InitMaterial()
@@ -174,25 +295,26 @@ namespace Neo
 
 		// Create layer texture array
 		StringVector vecTexNames;
-		vecTexNames.push_back(GetResPath("darkdirt.dds"));
-		vecTexNames.push_back(GetResPath("dirt_grayrocky.dds"));
-		vecTexNames.push_back(GetResPath("lightdirt.dds"));
-		vecTexNames.push_back(GetResPath("grass.dds"));
-		vecTexNames.push_back(GetResPath("Snow.dds"));
+		for (uint32 i=0; i<ARRAYSIZE(LAYER_TEX_NAMES); ++i)
+			vecTexNames.push_back(GetResPath(LAYER_TEX_NAMES[i]));
+
+		TextureManager* pTexMgr = g_env.pRenderSystem->GetTextureManager();
 
-		m_pLayerTexArray = new D3D11Texture(vecTexNames);
+		m_pLayerTexArray = pTexMgr->LoadArray(vecTexNames, eTextureUsage_Streamed);
+		m_pLayerTexArray->AddRef();
 
 		// Load layer blend map
-		m_pBlendMap = new D3D11Texture(GetResPath("blend.dds"));
+		m_pBlendMap = pTexMgr->Load(GetResPath(BLEND_MAP_NAME), eTextureType_2D, eTextureUsage_Streamed);
+		m_pBlendMap->AddRef();
 
 		// Setup texture stages
 		pMaterial->SetTexture(0, m_pHeightMap);
 		pMaterial->SetTexture(1, m_pLayerTexArray);
 		pMaterial->SetTexture(2, m_pBlendMap);
 
-		D3D11Texture* pNormalMap = new D3D11Texture(GetResPath("dirt_grayrocky_ddn.dds"));
-		pMaterial->SetTexture(3, pNormalMap);
-		pNormalMap->Release();
+		pMaterial->SetTexture(3, pTexMgr->Load(GetResPath("dirt_grayrocky_ddn.dds"), eTextureType_2D, eTextureUsage_Streamed));
+		// Stage 4 is left for the shadow map
+		pMaterial->SetTexture(5, m_pCompositeMap);
 
 		// ?????????????????????????????????????????
 		pMaterial->SetCullMode(D3D11_CULL_NONE);
@@ -232,14 +354,258 @@ namespace Neo
 			pMaterial->SetSamplerStateDesc(3, samDesc);
 		}
 
-		m_pMesh->GetSubMesh(0)->SetMaterial(pMaterial);
-		pMaterial->Release();
+		{
+			D3D11_SAMPLER_DESC& samDesc = pMaterial->GetSamplerStateDesc(5);
+			samDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+			samDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+			samDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+
+			pMaterial->SetSamplerStateDesc(5, samDesc);
+		}
+
+		m_pMaterial = pMaterial;
+	}
+	//------------------------------------------------------------------------------------
+	// Top mip of a texture file as RGBA8, decompressed by D3DX
+	static bool LoadImageRGBA(const STRING& filename, std::vector<uint8>& texels, uint32& width, uint32& height)
+	{
+		D3DX11_IMAGE_LOAD_INFO loadInfo;
+		loadInfo.Width  = D3DX11_FROM_FILE;
+		loadInfo.Height = D3DX11_FROM_FILE;
+		loadInfo.Depth  = D3DX11_FROM_FILE;
+		loadInfo.FirstMipLevel = 0;
+		loadInfo.BindFlags = 0;
+		loadInfo.Usage = D3D11_USAGE_STAGING;
+		loadInfo.MipLevels = 1;
+		loadInfo.CpuAccessFlags = D3D11_CPU_ACCESS_READ;
+		loadInfo.MiscFlags = 0;
+		loadInfo.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		loadInfo.Filter = D3DX11_FILTER_NONE;
+		loadInfo.MipFilter = D3DX11_FILTER_NONE;
+		loadInfo.pSrcInfo  = 0;
+
+		ID3D11Texture2D* pTex = nullptr;
+		if (FAILED(D3DX11CreateTextureFromFileA(g_env.pRenderSystem->GetDevice(), filename.c_str(),
+			&loadInfo, nullptr, (ID3D11Resource**)&pTex, nullptr)))
+			return false;
+
+		D3D11_TEXTURE2D_DESC desc;
+		pTex->GetDesc(&desc);
+		width = desc.Width;
+		height = desc.Height;
+		texels.resize(width * height * 4);
+
+		ID3D11DeviceContext* pContext = g_env.pRenderSystem->GetDeviceContext();
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		const bool bMapped = SUCCEEDED(pContext->Map(pTex, 0, D3D11_MAP_READ, 0, &mapped));
+		if (bMapped)
+		{
+			for (uint32 y=0; y<height; ++y)
+				memcpy(&texels[y * width * 4], (const uint8*)mapped.pData + y * mapped.RowPitch, width * 4);
+
+			pContext->Unmap(pTex, 0);
+		}
+
+		pTex->Release();
+
+		return bMapped;
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_InitCompositeMap()
+	{
+		m_compositeBaker.Init(COMPOSITE_MAP_SIZE, COMPOSITE_TILE_SIZE, LAYER_TEX_SCALE);
+
+		std::vector<uint8> texels;
+		uint32 width, height;
+		for (uint32 i=0; i<ARRAYSIZE(LAYER_TEX_NAMES); ++i)
+		{
+			if(LoadImageRGBA(GetResPath(LAYER_TEX_NAMES[i]), texels, width, height))
+				m_compositeBaker.SetLayer(i, &texels[0], width, height, width * 4);
+		}
+
+		if(LoadImageRGBA(GetResPath(BLEND_MAP_NAME), texels, width, height))
+			m_compositeBaker.SetBlendMap(&texels[0], width, height, width * 4);
+
+		// Tiles carry their own mips, the ones coarser than a tile come from the whole map
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory( &desc, sizeof(desc) );
+		desc.Width = COMPOSITE_MAP_SIZE;
+		desc.Height = COMPOSITE_MAP_SIZE;
+		desc.MipLevels = m_compositeBaker.GetMapMipCount();
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		m_pCompositeMap = new D3D11Texture(desc, nullptr, eTextureType_2D);
+		m_pCompositeMap->SetMemoryTag(eMemTag_Terrain, "Terrain composite map");
+
+		_UpdateCompositeMap();
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_UpdateCompositeMap()
+	{
+		if(!m_compositeBaker.HasDirtyTiles())
+			return;
+
+		std::vector<uint32> vecTiles;
+		m_compositeBaker.Bake(vecTiles);
+
+		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
+		const uint32 tileSize = m_compositeBaker.GetTileSize();
+		const uint32 tilesPerSide = m_compositeBaker.GetTilesPerSide();
+		const uint32 tileMipCount = m_compositeBaker.GetMipCount();
+		const uint32 mipCount = m_compositeBaker.GetMapMipCount();
+
+		for (size_t i=0; i<vecTiles.size(); ++i)
+		{
+			const uint32 tile = vecTiles[i];
+
+			for (uint32 mip=0; mip<tileMipCount; ++mip)
+			{
+				const uint32 size = tileSize >> mip;
+
+				D3D11_BOX box;
+				box.left = (tile % tilesPerSide) * size;
+				box.right = box.left + size;
+				box.top = (tile / tilesPerSide) * size;
+				box.bottom = box.top + size;
+				box.front = 0;
+				box.back = 1;
+
+				pContext->UpdateSubresource(m_pCompositeMap->GetInternalTex(), D3D11CalcSubresource(mip, 0, mipCount),
+					&box, m_compositeBaker.GetTileData(tile, mip), size * 4, 0);
+			}
+		}
+
+		// Rebuilt from the whole map by every bake, small enough to upload whole
+		for (uint32 mip=tileMipCount; mip<mipCount; ++mip)
+		{
+			pContext->UpdateSubresource(m_pCompositeMap->GetInternalTex(), D3D11CalcSubresource(mip, 0, mipCount),
+				nullptr, m_compositeBaker.GetCoarseMipData(mip), (COMPOSITE_MAP_SIZE >> mip) * 4, 0);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_InitEditableBlendMap()
+	{
+		const uint32 mipCount = m_compositeBaker.GetBlendMipCount();
+		uint32 width = 0, height = 0;
+
+		std::vector<D3D11_SUBRESOURCE_DATA> vecInitData(mipCount);
+		for (uint32 mip=0; mip<mipCount; ++mip)
+		{
+			uint32 mipWidth, mipHeight;
+			vecInitData[mip].pSysMem = m_compositeBaker.GetBlendMipData(mip, mipWidth, mipHeight);
+			vecInitData[mip].SysMemPitch = mipWidth * 4;
+			vecInitData[mip].SysMemSlicePitch = 0;
+
+			if (mip == 0)
+			{
+				width = mipWidth;
+				height = mipHeight;
+			}
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory( &desc, sizeof(desc) );
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = mipCount;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		D3D11Texture* pBlendMap = new D3D11Texture(desc, &vecInitData[0], eTextureType_2D);
+		pBlendMap->SetMemoryTag(eMemTag_Terrain, "Terrain blend map");
+
+		SAFE_RELEASE(m_pBlendMap);
+		m_pBlendMap = pBlendMap;
+		m_pMaterial->SetTexture(2, m_pBlendMap);
+
+		m_bBlendMapEditable = true;
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::UpdateBlendMap( const uint8* pRGBA, uint32 x, uint32 y, uint32 width, uint32 height, uint32 pitch )
+	{
+		// Nothing to edit if the CPU copy failed to load
+		if(m_compositeBaker.GetBlendMipCount() == 0)
+			return;
+
+		m_compositeBaker.UpdateBlendMap(pRGBA, x, y, width, height, pitch);
+
+		// Created from the CPU mips, which already have the edit
+		if (!m_bBlendMapEditable)
+		{
+			_InitEditableBlendMap();
+			return;
+		}
+
+		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
+		const uint32 mipCount = m_compositeBaker.GetBlendMipCount();
+		uint32 x0 = x, y0 = y, x1 = x + width, y1 = y + height;
+
+		for (uint32 mip=0; mip<mipCount; ++mip)
+		{
+			uint32 mipWidth, mipHeight;
+			const uint8* pTexels = m_compositeBaker.GetBlendMipData(mip, mipWidth, mipHeight);
+
+			// Same texels the baker refreshed in this mip
+			if (mip > 0)
+			{
+				x0 /= 2;
+				y0 /= 2;
+				x1 = min((x1 + 1) / 2, mipWidth);
+				y1 = min((y1 + 1) / 2, mipHeight);
+			}
+
+			if(x0 >= x1 || y0 >= y1)
+				continue;
+
+			D3D11_BOX box;
+			box.left = x0;
+			box.right = x1;
+			box.top = y0;
+			box.bottom = y1;
+			box.front = 0;
+			box.back = 1;
+
+			pContext->UpdateSubresource(m_pBlendMap->GetInternalTex(), D3D11CalcSubresource(mip, 0, mipCount),
+				&box, pTexels + (y0 * mipWidth + x0) * 4, mipWidth * 4, 0);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	const uint8* Terrain::GetBlendMapData( uint32& width, uint32& height ) const
+	{
+		if (m_compositeBaker.GetBlendMipCount() == 0)
+		{
+			width = height = 0;
+			return nullptr;
+		}
+
+		return m_compositeBaker.GetBlendMipData(0, width, height);
+	}
+	//------------------------------------------------------------------------------------
+	bool Terrain::OpenTileSet( const STRING& filename, const STerrainStreamSettings& settings )
+	{
+		return m_tileStreamer.Open(filename, settings);
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::Update()
+	{
+		const VEC3& camPos = g_env.pSceneMgr->GetCamera()->GetPos();
+		m_tileStreamer.Update(camPos.x, camPos.z);
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::Render(Material* pMaterial)
 	{
 		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
 
+		_FlushEdits();
+		_UpdateCompositeMap();
+
 		// Update constants
 		Camera* pCam = g_env.pSceneMgr->GetCamera();
 		const MAT44 matViewProj = pCam->GetViewMatrix() * pCam->GetProjMatrix();
@@ -249,18 +615,111 @@ namespace Neo
 
 		memcpy(&m_cBuffer.m_frustumPlane[0], frustumPlane, sizeof(PLANE) * 4);
 
+		// Shadow and reflection passes don't decide texture residency
+		if(!pMaterial && !m_pRenderSystem->IsClipPlaneEnabled())
+			_RequestTextureMips(frustumPlane);
+
 		pContext->UpdateSubresource( m_pCB, 0, NULL, &m_cBuffer, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_cBuffer));
 		pContext->VSSetConstantBuffers( 1, 1, &m_pCB );
 		pContext->PSSetConstantBuffers( 1, 1, &m_pCB );
 		pContext->HSSetConstantBuffers( 1, 1, &m_pCB );
 		pContext->DSSetConstantBuffers( 1, 1, &m_pCB );
 
-		m_pEntity->Render(pMaterial);
+		_SelectNodes(pCam, frustumPlane);
+		if (!m_visibleNodes.empty())
+		{
+			m_pRenderSystem->SetTransform(eTransform_World, MAT44::IDENTITY, false);
+			m_pRenderSystem->SetTransform(eTransform_WorldIT, MAT44::IDENTITY, true);
+
+			if(pMaterial)
+				pMaterial->Activate();
+			else
+				m_pMaterial->Activate();
+
+			const UINT stride = sizeof(SVertex);
+			UINT offset = 0;
+			pContext->IASetVertexBuffers( 0, 1, &m_pNodeVB, &stride, &offset );
+			pContext->Draw( (UINT)m_visibleNodes.size() * 4, 0 );
+
+			PROFILE_COUNTER(eProfileCounter_DrawCall, 1);
+			for (size_t i=0; i<m_visibleNodes.size(); ++i)
+				PROFILE_COUNTER(eProfileCounter_Triangle, (uint32)(m_visibleNodes[i].tessFactor * m_visibleNodes[i].tessFactor) * 2);
+		}
+
+		m_pMaterial->TurnOffTessellation();
+	}
+	//------------------------------------------------------------------------------------
+	// Same as AabbBehindPlaneTest in Terrain.hlsl
+	static bool AabbBehindPlane(const VEC3& vMin, const VEC3& vMax, const PLANE& plane)
+	{
+		const VEC3 center((vMin.x + vMax.x) * 0.5f, (vMin.y + vMax.y) * 0.5f, (vMin.z + vMax.z) * 0.5f);
+		const VEC3 extents(vMax.x - center.x, vMax.y - center.y, vMax.z - center.z);
+
+		const float r = extents.x * fabsf(plane.n.x) + extents.y * fabsf(plane.n.y) + extents.z * fabsf(plane.n.z);
+		const float s = Common::DotProduct_Vec3_By_Vec3(plane.n, center) + plane.d;
+
+		return s + r < 0;
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_RequestTextureMips( const PLANE* frustumPlane )
+	{
+		const uint32 patchPerSide = (HEIGHT_MAP_SIZE - 1) / CELLS_PER_PATCH;
+		const float dimension = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE;
+		const float patchSize = CELL_SPACE * CELLS_PER_PATCH;
+
+		const Camera* pCam = g_env.pSceneMgr->GetCamera();
+		const VEC3& camPos = pCam->GetPos();
+
+		// Nearest patch surviving the same culling the hull shader does
+		float fMinDist = FLT_MAX;
+		for (uint32 z=0; z<patchPerSide; ++z)
+		{
+			for (uint32 x=0; x<patchPerSide; ++x)
+			{
+				const VEC2& bound = m_patchBoundY[z * patchPerSide + x];
+				const VEC3 vMin(-dimension / 2 + x * patchSize, bound.x, -dimension / 2 + z * patchSize);
+				const VEC3 vMax(vMin.x + patchSize, bound.y, vMin.z + patchSize);
+
+				bool bCulled = false;
+				for (int i=0; i<4 && !bCulled; ++i)
+					bCulled = AabbBehindPlane(vMin, vMax, frustumPlane[i]);
+
+				if(bCulled)
+					continue;
+
+				const float dx = max(max(vMin.x - camPos.x, camPos.x - vMax.x), 0.0f);
+				const float dy = max(max(vMin.y - camPos.y, camPos.y - vMax.y), 0.0f);
+				const float dz = max(max(vMin.z - camPos.z, camPos.z - vMax.z), 0.0f);
+
+				fMinDist = min(fMinDist, sqrtf(dx * dx + dy * dy + dz * dz));
+			}
+		}
+
+		if(fMinDist == FLT_MAX)
+			return;
+
+		const float fPixelsPerUnit = TextureStreamer::CalcPixelsPerUnit(max(fMinDist, pCam->GetNearClip()),
+			pCam->GetProjMatrix().m11, m_pRenderSystem->GetWndHeight());
+
+		Material* pMaterial = m_pMaterial;
+		TextureManager* pTexMgr = m_pRenderSystem->GetTextureManager();
+
+		// Layers and normal map tile LAYER_TEX_SCALE times, blend map covers the terrain once
+		for (int stage=1; stage<=3; ++stage)
+		{
+			D3D11Texture* pTexture = pMaterial->GetTexture(stage);
+			if(!pTexture || !pTexture->IsStreamed())
+				continue;
+
+			const float fRepeat = pTexture == m_pBlendMap ? 1.0f : LAYER_TEX_SCALE;
+			const float fTexelsPerUnit = max(pTexture->GetWidth(), pTexture->GetHeight()) * fRepeat / dimension;
 
-		m_pMesh->GetSubMesh(0)->GetMaterial()->TurnOffTessellation();
+			pTexMgr->RequestMip(pTexture, TextureStreamer::CalcRequiredMip(fTexelsPerUnit, fPixelsPerUnit));
+		}
 	}
 	//------------------------------------------------------------------------------------
-	static float Average(std::vector<float>& vecData, int i, int j)
+	static float Average(TerrainHeights& vecData, int i, int j)
 	{
 		POINT filter[9] = 
 		{
@@ -287,19 +746,75 @@ namespace Neo
 		return fSum / fCnt;
 	}
 	//------------------------------------------------------------------------------------
-	void Terrain::_SmoothHeightMap(std::vector<float>& vecData)
+	// Interior of one row, 4 columns at a time. Same taps in the same order as Average,
+	// so the result is bit identical to it.
+	static void AverageRowSSE(const float* pSrc, float* pDst, int i)
+	{
+		const float* r0 = pSrc + (i - 1) * HEIGHT_MAP_SIZE;
+		const float* r1 = r0 + HEIGHT_MAP_SIZE;
+		const float* r2 = r1 + HEIGHT_MAP_SIZE;
+		const __m128 cnt = _mm_set1_ps(9.0f);
+
+		int j = 1;
+		for (; j+4<=HEIGHT_MAP_SIZE-1; j+=4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r0 + j - 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r1 + j - 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r2 + j - 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r0 + j));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r1 + j));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r2 + j));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r0 + j + 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r1 + j + 1));
+			sum = _mm_add_ps(sum, _mm_loadu_ps(r2 + j + 1));
+
+			_mm_storeu_ps(pDst + i * HEIGHT_MAP_SIZE + j, _mm_div_ps(sum, cnt));
+		}
+
+		for (; j<HEIGHT_MAP_SIZE-1; ++j)
+		{
+			float fSum = 0;
+			fSum += r0[j-1]; fSum += r1[j-1]; fSum += r2[j-1];
+			fSum += r0[j]; fSum += r1[j]; fSum += r2[j];
+			fSum += r0[j+1]; fSum += r1[j+1]; fSum += r2[j+1];
+
+			pDst[i * HEIGHT_MAP_SIZE + j] = fSum / 9.0f;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_SmoothHeightMap(TerrainHeights& vecData, TerrainHeights& scratch)
 	{
-		std::vector<float> tmp(vecData.size());
+		scratch.resize(vecData.size());
+
+		const float* pSrc = &vecData[0];
+		float* pDst = &scratch[0];
 
-		for(UINT i = 0; i < HEIGHT_MAP_SIZE; ++i)
+		// Each job owns its output rows, the input is read only
+		const uint32 numJobs = (HEIGHT_MAP_SIZE + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+		ParallelFor(numJobs, [&](unsigned int job)
 		{
-			for(UINT j = 0; j < HEIGHT_MAP_SIZE; ++j)
+			const int begin = job * ROWS_PER_JOB;
+			const int end = min(begin + (int)ROWS_PER_JOB, HEIGHT_MAP_SIZE);
+
+			for (int i=begin; i<end; ++i)
 			{
-				tmp[i*HEIGHT_MAP_SIZE+j] = Average(vecData, i,j);
+				if (i == 0 || i == HEIGHT_MAP_SIZE - 1)
+				{
+					for (int j=0; j<HEIGHT_MAP_SIZE; ++j)
+						pDst[i*HEIGHT_MAP_SIZE+j] = Average(vecData, i, j);
+					continue;
+				}
+
+				// Border columns clip the filter
+				pDst[i*HEIGHT_MAP_SIZE] = Average(vecData, i, 0);
+				pDst[i*HEIGHT_MAP_SIZE+HEIGHT_MAP_SIZE-1] = Average(vecData, i, HEIGHT_MAP_SIZE-1);
+
+				AverageRowSSE(pSrc, pDst, i);
 			}
-		}
+		});
 
-		vecData.swap(tmp);
+		vecData.swap(scratch);
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_CalcAllPatchBoundY()
@@ -308,13 +823,14 @@ namespace Neo
 
 		m_patchBoundY.resize(patchPerSide * patchPerSide);
 
-		for (uint32 i=0; i<patchPerSide; ++i)
+		// Patches only write their own bound
+		ParallelFor(patchPerSide, [&](unsigned int i)
 		{
 			for (uint32 j=0; j<patchPerSide; ++j)
 			{
 				_CalcPatchBoundY(i, j);
 			}
-		}
+		});
 	}
 	//------------------------------------------------------------------------------------
 	void Terrain::_CalcPatchBoundY(uint32 i, uint32 j)
@@ -323,26 +839,292 @@ namespace Neo
 		const uint32 vertsPerSide = CELLS_PER_PATCH + 1;
 		uint32 curIdx = i * HEIGHT_MAP_SIZE * CELLS_PER_PATCH + j * CELLS_PER_PATCH;
 
-		float fMin = FLT_MAX;
-		float fMax = FLT_MIN;
+		__m128 vMin = _mm_set1_ps(FLT_MAX);
+		__m128 vMax = _mm_set1_ps(FLT_MIN);
 
 		for (uint32 x=0; x<vertsPerSide; ++x)
 		{
-			for (uint32 y=0; y<vertsPerSide; ++y)
+			const float* pRow = &m_heightData[curIdx];
+			uint32 y = 0;
+
+			for (; y+4<=vertsPerSide; y+=4)
 			{
-				float h = m_heightData[curIdx + y];
+				const __m128 h = _mm_loadu_ps(pRow + y);
+				vMin = _mm_min_ps(vMin, h);
+				vMax = _mm_max_ps(vMax, h);
+			}
 
-				fMin = min(fMin, h);
-				fMax = max(fMax, h);
+			for (; y<vertsPerSide; ++y)
+			{
+				const __m128 h = _mm_set1_ps(pRow[y]);
+				vMin = _mm_min_ps(vMin, h);
+				vMax = _mm_max_ps(vMax, h);
 			}
 
 			curIdx += HEIGHT_MAP_SIZE;
 		}
 
+		// Fold the lanes
+		vMin = _mm_min_ps(vMin, _mm_movehl_ps(vMin, vMin));
+		vMax = _mm_max_ps(vMax, _mm_movehl_ps(vMax, vMax));
+		vMin = _mm_min_ss(vMin, _mm_shuffle_ps(vMin, vMin, 1));
+		vMax = _mm_max_ss(vMax, _mm_shuffle_ps(vMax, vMax, 1));
+
+		float fMin, fMax;
+		_mm_store_ss(&fMin, vMin);
+		_mm_store_ss(&fMax, vMax);
+
 		m_patchBoundY[i * patchPerSide + j].x = fMin;
 		m_patchBoundY[i * patchPerSide + j].y = fMax;
 	}
 	//------------------------------------------------------------------------------------
+	void Terrain::_InitHeightField()
+	{
+		const float fHalfDim = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE / 2;
+		m_heightField.Build(&m_heightData[0], HEIGHT_MAP_SIZE, -fHalfDim, -fHalfDim, CELL_SPACE);
+	}
+	//------------------------------------------------------------------------------------
+	float Terrain::GetHeightAt( float x, float z, bool bExact ) const
+	{
+		float height;
+		if(m_tileStreamer.GetHeightAt(x, z, height))
+			return height;
+
+		return bExact ? m_heightField.GetHeightExact(x, z) : m_heightField.GetHeightBilinear(x, z);
+	}
+	//------------------------------------------------------------------------------------
+	VEC3 Terrain::GetNormalAt( float x, float z, bool bExact ) const
+	{
+		VEC3 normal;
+		if(bExact)
+			m_heightField.GetNormalExact(x, z, &normal.x);
+		else
+			m_heightField.GetNormalBilinear(x, z, &normal.x);
+
+		return normal;
+	}
+	//------------------------------------------------------------------------------------
+	bool Terrain::RayIntersect( const VEC3& origin, const VEC3& dir, VEC3& hitPos, float maxDist ) const
+	{
+		STerrainRayHit hit;
+		if(!m_heightField.RayCast(&origin.x, &dir.x, maxDist, hit))
+			return false;
+
+		hitPos.Set(hit.pos[0], hit.pos[1], hit.pos[2]);
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	struct SBrushParams
+	{
+		eTerrainBrushShape	shape;
+		eTerrainBrushOp		op;
+		float				gx, gz;			// Center in samples
+		float				invRadius;		// In samples
+		float				invFalloff;
+		float				amount;			// Raise and lower, at full weight
+		float				blend;			// Smooth and flatten, at full weight
+		float				target;
+		const float*		pSnapshot;		// Smooth input, edge replicated past the map border
+		int					snapPitch;
+		int					snapRow0, snapCol0;	// Sample at pSnapshot[0]
+	};
+
+	// Brush applied to 4 samples starting at (row, col)
+	static __m128 BrushKernel(const SBrushParams& p, __m128 h, int row, int col)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)col), _mm_setr_ps(0, 1, 2, 3)), _mm_set1_ps(p.gx));
+		const __m128 dz = _mm_set1_ps(row - p.gz);
+
+		__m128 d;
+		if (p.shape == eTerrainBrushShape_Circle)
+		{
+			d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+		}
+		else
+		{
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			d = _mm_max_ps(_mm_andnot_ps(signMask, dx), _mm_andnot_ps(signMask, dz));
+		}
+
+		// Full inside, smoothstep to zero over the falloff band
+		__m128 w = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(d, _mm_set1_ps(p.invRadius))), _mm_set1_ps(p.invFalloff));
+		w = _mm_min_ps(_mm_max_ps(w, _mm_setzero_ps()), one);
+		w = _mm_mul_ps(_mm_mul_ps(w, w), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(w, w)));
+
+		switch (p.op)
+		{
+		case eTerrainBrushOp_Raise: return _mm_add_ps(h, _mm_mul_ps(w, _mm_set1_ps(p.amount)));
+		case eTerrainBrushOp_Lower: return _mm_sub_ps(h, _mm_mul_ps(w, _mm_set1_ps(p.amount)));
+		case eTerrainBrushOp_Flatten:
+			return _mm_add_ps(h, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(p.target), h), _mm_mul_ps(w, _mm_set1_ps(p.blend))));
+		case eTerrainBrushOp_Smooth:
+			{
+				const float* s = p.pSnapshot + (row - p.snapRow0) * p.snapPitch + (col - p.snapCol0);
+				const int pitch = p.snapPitch;
+
+				__m128 sum = _mm_loadu_ps(s - pitch - 1);
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s - pitch));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s - pitch + 1));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s - 1));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s + 1));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s + pitch - 1));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s + pitch));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(s + pitch + 1));
+
+				const __m128 avg = _mm_mul_ps(sum, _mm_set1_ps(1.0f / 9));
+				return _mm_add_ps(h, _mm_mul_ps(_mm_sub_ps(avg, h), _mm_mul_ps(w, _mm_set1_ps(p.blend))));
+			}
+		default: assert(0); return h;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::ApplyBrush( const STerrainBrush& brush, float dt )
+	{
+		const float fHalfDim = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE / 2;
+		const float radius = brush.radius / CELL_SPACE;
+		if(radius <= 0 || dt <= 0)
+			return;
+
+		SBrushParams p;
+		p.shape = brush.shape;
+		p.op = brush.op;
+		p.gx = (brush.centerX + fHalfDim) / CELL_SPACE;
+		p.gz = (brush.centerZ + fHalfDim) / CELL_SPACE;
+		p.invRadius = 1.0f / radius;
+		p.invFalloff = brush.falloff > 0 ? 1.0f / brush.falloff : FLT_MAX;
+		p.amount = brush.strength * dt;
+		p.blend = min(brush.strength * dt, 1.0f);
+		p.target = brush.flattenHeight;
+		p.pSnapshot = nullptr;
+
+		// Samples under the brush
+		const int r0 = max((int)ceilf(p.gz - radius), 0);
+		const int r1 = min((int)floorf(p.gz + radius), (int)HEIGHT_MAP_SIZE - 1);
+		const int c0 = max((int)ceilf(p.gx - radius), 0);
+		const int c1 = min((int)floorf(p.gx + radius), (int)HEIGHT_MAP_SIZE - 1);
+		if(r0 > r1 || c0 > c1)
+			return;
+
+		const int width = c1 - c0 + 1;
+		const int height = r1 - r0 + 1;
+
+		// Smoothing reads neighbours, so it reads a copy or the result would depend on the order.
+		// One sample border, plus 3 more columns for the last group of 4.
+		if (brush.op == eTerrainBrushOp_Smooth)
+		{
+			p.snapPitch = width + 5;
+			p.snapRow0 = r0 - 1;
+			p.snapCol0 = c0 - 1;
+			m_brushScratch.resize(p.snapPitch * (height + 2));
+
+			for (int r=0; r<height+2; ++r)
+			{
+				const int srcRow = min(max(p.snapRow0 + r, 0), (int)HEIGHT_MAP_SIZE - 1);
+				for (int c=0; c<p.snapPitch; ++c)
+				{
+					const int srcCol = min(max(p.snapCol0 + c, 0), (int)HEIGHT_MAP_SIZE - 1);
+					m_brushScratch[r * p.snapPitch + c] = m_heightData[srcRow * HEIGHT_MAP_SIZE + srcCol];
+				}
+			}
+
+			p.pSnapshot = &m_brushScratch[0];
+		}
+
+		// Runs every frame while dragging. Even a large brush takes well under a millisecond
+		// at 4 samples per op, less than creating threads for it would cost.
+		for (int r=r0; r<=r1; ++r)
+		{
+			float* pRow = &m_heightData[r * HEIGHT_MAP_SIZE];
+			int c = c0;
+
+			for (; c+3<=c1; c+=4)
+				_mm_storeu_ps(pRow + c, BrushKernel(p, _mm_loadu_ps(pRow + c), r, c));
+
+			if (c <= c1)
+			{
+				float tail[4] = { 0 };
+				for(int k=0; c+k<=c1; ++k)
+					tail[k] = pRow[c + k];
+
+				_mm_storeu_ps(tail, BrushKernel(p, _mm_loadu_ps(tail), r, c));
+
+				for(int k=0; c+k<=c1; ++k)
+					pRow[c + k] = tail[k];
+			}
+		}
+
+		m_heightField.UpdateRegion(r0, c0, r1, c1);
+
+		m_dirtyRow0 = min(m_dirtyRow0, (uint32)r0);
+		m_dirtyCol0 = min(m_dirtyCol0, (uint32)c0);
+		m_dirtyRow1 = max(m_dirtyRow1, (uint32)r1);
+		m_dirtyCol1 = max(m_dirtyCol1, (uint32)c1);
+
+		// Grass stands on the old heights
+		Grass* pGrass = g_env.pSceneMgr->GetGrass();
+		if(pGrass)
+		{
+			pGrass->GetLayer().InvalidateRegion(c0 * CELL_SPACE - fHalfDim, r0 * CELL_SPACE - fHalfDim,
+				c1 * CELL_SPACE - fHalfDim, r1 * CELL_SPACE - fHalfDim);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void Terrain::_FlushEdits()
+	{
+		if(m_dirtyRow0 > m_dirtyRow1)
+			return;
+
+		const uint32 width = m_dirtyCol1 - m_dirtyCol0 + 1;
+		const uint32 height = m_dirtyRow1 - m_dirtyRow0 + 1;
+
+		// Only the edited box of the height map
+		std::vector<HALF> vecHalf(width * height);
+		for (uint32 r=0; r<height; ++r)
+			ConvertToHalf(&m_heightData[(m_dirtyRow0 + r) * HEIGHT_MAP_SIZE + m_dirtyCol0], &vecHalf[r * width], width);
+
+		D3D11_BOX box;
+		box.left = m_dirtyCol0;
+		box.right = m_dirtyCol1 + 1;
+		box.top = m_dirtyRow0;
+		box.bottom = m_dirtyRow1 + 1;
+		box.front = 0;
+		box.back = 1;
+
+		m_pRenderSystem->GetDeviceContext()->UpdateSubresource(m_pHeightMap->GetInternalTex(), 0, &box,
+			&vecHalf[0], width * sizeof(HALF), 0);
+
+		// Samples on a patch edge belong to the patches on both sides
+		const uint32 pr0 = (m_dirtyRow0 > 0 ? m_dirtyRow0 - 1 : 0) / CELLS_PER_PATCH;
+		const uint32 pc0 = (m_dirtyCol0 > 0 ? m_dirtyCol0 - 1 : 0) / CELLS_PER_PATCH;
+		const uint32 pr1 = min(m_dirtyRow1, HEIGHT_MAP_SIZE - 2) / CELLS_PER_PATCH;
+		const uint32 pc1 = min(m_dirtyCol1, HEIGHT_MAP_SIZE - 2) / CELLS_PER_PATCH;
+
+		for (uint32 i=pr0; i<=pr1; ++i)
+		{
+			for (uint32 j=pc0; j<=pc1; ++j)
+				_CalcPatchBoundY(i, j);
+		}
+
+		m_quadTree.UpdateBounds(&m_patchBoundY[0].x, pr0, pc0, pr1, pc1);
+
+		// Curvature of the samples around the edit changes too
+		const uint32 dr0 = m_dirtyRow0 > 0 ? m_dirtyRow0 - 1 : 0;
+		const uint32 dc0 = m_dirtyCol0 > 0 ? m_dirtyCol0 - 1 : 0;
+		const uint32 dr1 = min(m_dirtyRow1 + 1, HEIGHT_MAP_SIZE - 1);
+		const uint32 dc1 = min(m_dirtyCol1 + 1, HEIGHT_MAP_SIZE - 1);
+		m_densityMap.UpdateRegion(dr0, dc0, dr1, dc1);
+
+		m_quadTree.UpdateRoughness(m_densityMap.GetPatchPercentile(),
+			(dr0 > 0 ? dr0 - 1 : 0) / CELLS_PER_PATCH, (dc0 > 0 ? dc0 - 1 : 0) / CELLS_PER_PATCH,
+			min(dr1, HEIGHT_MAP_SIZE - 2) / CELLS_PER_PATCH, min(dc1, HEIGHT_MAP_SIZE - 2) / CELLS_PER_PATCH);
+		_CalcAABB();
+
+		m_dirtyRow0 = m_dirtyCol0 = HEIGHT_MAP_SIZE;
+		m_dirtyRow1 = m_dirtyCol1 = 0;
+	}
+	//------------------------------------------------------------------------------------
 	void Terrain::_CalcAABB()
 	{
 		const float fHalfDim = (HEIGHT_MAP_SIZE - 1.0f) * CELL_SPACE / 2;
@@ -0,0 +1,455 @@
+#include "TerrainCompositeMap.h"
+#include "TextureCooker.h"
+#include "ParallelFor.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace Neo
+{
+	namespace
+	{
+		inline __m128 LoadTexel(const unsigned char* p)
+		{
+			int packed;
+			memcpy(&packed, p, 4);
+
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+
+			return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+		}
+
+		inline void StoreTexel(__m128 c, unsigned char* p)
+		{
+			const __m128i i32 = _mm_cvtps_epi32(c);
+			const __m128i i16 = _mm_packs_epi32(i32, i32);
+			const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+
+			memcpy(p, &packed, 4);
+		}
+
+		inline __m128 Lerp(__m128 a, __m128 b, __m128 t)
+		{
+			return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+		}
+
+		inline unsigned int Wrap(int i, unsigned int n)
+		{
+			const int r = i % (int)n;
+			return r < 0 ? r + n : r;
+		}
+
+		// Bilinear, coordinates in texels with texel centers at .5
+		template<bool bWrap>
+		__m128 SampleBilinear(const unsigned char* pTexels, unsigned int width, unsigned int height, float x, float y)
+		{
+			x -= 0.5f;
+			y -= 0.5f;
+
+			const float fx0 = floorf(x), fy0 = floorf(y);
+			const __m128 tx = _mm_set1_ps(x - fx0);
+			const __m128 ty = _mm_set1_ps(y - fy0);
+
+			unsigned int x0, x1, y0, y1;
+			if (bWrap)
+			{
+				x0 = Wrap((int)fx0, width);
+				x1 = x0 + 1 == width ? 0 : x0 + 1;
+				y0 = Wrap((int)fy0, height);
+				y1 = y0 + 1 == height ? 0 : y0 + 1;
+			}
+			else
+			{
+				x0 = (unsigned int)std::min(std::max((int)fx0, 0), (int)width - 1);
+				x1 = (unsigned int)std::min(std::max((int)fx0 + 1, 0), (int)width - 1);
+				y0 = (unsigned int)std::min(std::max((int)fy0, 0), (int)height - 1);
+				y1 = (unsigned int)std::min(std::max((int)fy0 + 1, 0), (int)height - 1);
+			}
+
+			const unsigned char* pRow0 = pTexels + y0 * width * 4;
+			const unsigned char* pRow1 = pTexels + y1 * width * 4;
+
+			const __m128 top = Lerp(LoadTexel(pRow0 + x0 * 4), LoadTexel(pRow0 + x1 * 4), tx);
+			const __m128 bottom = Lerp(LoadTexel(pRow1 + x0 * 4), LoadTexel(pRow1 + x1 * 4), tx);
+
+			return Lerp(top, bottom, ty);
+		}
+
+		// Rounded 2x2 average, dst is half of src per side
+		void Downsample(const unsigned char* pSrc, unsigned char* pDst, unsigned int dstSize)
+		{
+			const unsigned int srcPitch = dstSize * 2 * 4;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i two = _mm_set1_epi16(2);
+
+			for (unsigned int y=0; y<dstSize; ++y)
+			{
+				const unsigned char* pRow0 = pSrc + y * 2 * srcPitch;
+				const unsigned char* pRow1 = pRow0 + srcPitch;
+				unsigned char* pOut = pDst + y * dstSize * 4;
+
+				for (unsigned int x=0; x<dstSize; ++x)
+				{
+					// Two texels of each row, widened to 16 bits
+					const __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pRow0 + x * 8)), zero);
+					const __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pRow1 + x * 8)), zero);
+
+					__m128i sum = _mm_add_epi16(a, b);
+					sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+					sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+
+					const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+					memcpy(pOut + x * 4, &packed, 4);
+				}
+			}
+		}
+
+		// Like Downsample for any size and only over dst texels [x0, x1) x [y0, y1).
+		// Odd src sides drop their last texel, a side of 1 repeats it.
+		void DownsampleRegion(const unsigned char* pSrc, unsigned int srcWidth, unsigned int srcHeight,
+			unsigned char* pDst, unsigned int dstWidth, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+		{
+			for (unsigned int y=y0; y<y1; ++y)
+			{
+				const unsigned char* pRow0 = pSrc + std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+				const unsigned char* pRow1 = pSrc + std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+				unsigned char* pOut = pDst + y * dstWidth * 4;
+
+				for (unsigned int x=x0; x<x1; ++x)
+				{
+					const unsigned int sx0 = std::min(x * 2, srcWidth - 1) * 4;
+					const unsigned int sx1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+					for (unsigned int c=0; c<4; ++c)
+						pOut[x * 4 + c] = (unsigned char)((pRow0[sx0 + c] + pRow0[sx1 + c] + pRow1[sx0 + c] + pRow1[sx1 + c] + 2) >> 2);
+				}
+			}
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	TerrainCompositeMap::TerrainCompositeMap()
+	:m_size(0)
+	,m_tileSize(1)
+	,m_tilesPerSide(0)
+	,m_mipCount(1)
+	,m_layerTexScale(1)
+	,m_numLayers(0)
+	,m_numDirty(0)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::Init( unsigned int size, unsigned int tileSize, float layerTexScale )
+	{
+		assert(tileSize > 0 && (tileSize & (tileSize - 1)) == 0 && size % tileSize == 0);
+
+		m_size = size;
+		m_tileSize = tileSize;
+		m_tilesPerSide = size / tileSize;
+		m_layerTexScale = layerTexScale;
+
+		m_mipCount = 1;
+		while((tileSize >> (m_mipCount - 1)) > 1)
+			++m_mipCount;
+
+		unsigned int tileBytes = 0;
+		for (unsigned int mip=0; mip<m_mipCount; ++mip)
+			tileBytes += (tileSize >> mip) * (tileSize >> mip) * 4;
+
+		m_tiles.assign(m_tilesPerSide * m_tilesPerSide, std::vector<unsigned char>(tileBytes));
+
+		// The last tile mip is one texel per tile, keep halving that while it divides evenly
+		m_coarseMips.clear();
+		for (unsigned int n=m_tilesPerSide; n>1 && n%2==0; n/=2)
+		{
+			m_coarseMips.push_back(SImage());
+			SImage& mip = m_coarseMips.back();
+			mip.width = mip.height = n / 2;
+			mip.texels.resize(mip.width * mip.height * 4);
+		}
+
+		MarkAllDirty();
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::SetLayer( unsigned int layer, const unsigned char* pRGBA, unsigned int width, unsigned int height, unsigned int pitch )
+	{
+		assert(layer < MAX_LAYERS && width > 0 && height > 0);
+
+		// Mips are built the way the texture cooker builds them, in float
+		SFloatImage cur;
+		cur.Resize(width, height);
+		for (unsigned int y=0; y<height; ++y)
+		{
+			for (unsigned int x=0; x<width * 4; ++x)
+				cur.pixels[y * width * 4 + x] = pRGBA[y * pitch + x] / 255.0f;
+		}
+
+		MipChain& mips = m_layers[layer];
+		mips.clear();
+
+		for (;;)
+		{
+			mips.push_back(SImage());
+			SImage& image = mips.back();
+			image.width = cur.width;
+			image.height = cur.height;
+			image.texels.resize(cur.pixels.size());
+
+			for (size_t i=0; i<cur.pixels.size(); ++i)
+				image.texels[i] = (unsigned char)(std::min(std::max(cur.pixels[i], 0.0f), 1.0f) * 255 + 0.5f);
+
+			if(cur.width == 1 && cur.height == 1)
+				break;
+
+			SFloatImage next;
+			TextureCooker::GenerateMip(cur, next, eMipFilter_Box);
+			std::swap(cur, next);
+		}
+
+		m_numLayers = std::max(m_numLayers, layer + 1);
+		MarkAllDirty();
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::SetBlendMap( const unsigned char* pRGBA, unsigned int width, unsigned int height, unsigned int pitch )
+	{
+		assert(width > 0 && height > 0);
+
+		m_blendMap.clear();
+		for (unsigned int w=width, h=height;; w=std::max(w/2, 1u), h=std::max(h/2, 1u))
+		{
+			m_blendMap.push_back(SImage());
+			SImage& image = m_blendMap.back();
+			image.width = w;
+			image.height = h;
+			image.texels.resize(w * h * 4);
+
+			if(w == 1 && h == 1)
+				break;
+		}
+
+		SImage& source = m_blendMap[0];
+		for (unsigned int y=0; y<height; ++y)
+			memcpy(&source.texels[y * width * 4], pRGBA + y * pitch, width * 4);
+
+		_BuildBlendMips(0, 0, width, height);
+		MarkAllDirty();
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::UpdateBlendMap( const unsigned char* pRGBA, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned int pitch )
+	{
+		assert(!m_blendMap.empty());
+
+		SImage& source = m_blendMap[0];
+		assert(width > 0 && height > 0 && x + width <= source.width && y + height <= source.height);
+
+		for (unsigned int row=0; row<height; ++row)
+			memcpy(&source.texels[((y + row) * source.width + x) * 4], pRGBA + row * pitch, width * 4);
+
+		_BuildBlendMips(x, y, x + width, y + height);
+
+		// Composite texels whose bilinear footprint reaches the edited blend texels
+		const float scaleX = (float)m_size / source.width;
+		const float scaleY = (float)m_size / source.height;
+
+		const int x0 = (int)floorf((x - 0.5f) * scaleX);
+		const int y0 = (int)floorf((y - 0.5f) * scaleY);
+		const int x1 = (int)ceilf((x + width + 0.5f) * scaleX);
+		const int y1 = (int)ceilf((y + height + 0.5f) * scaleY);
+
+		_MarkTilesDirty(std::max(x0, 0), std::max(y0, 0),
+			std::min(x1, (int)m_size - 1), std::min(y1, (int)m_size - 1));
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::_BuildBlendMips( unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1 )
+	{
+		for (size_t mip=1; mip<m_blendMap.size(); ++mip)
+		{
+			const SImage& src = m_blendMap[mip - 1];
+			SImage& dst = m_blendMap[mip];
+
+			// Every dst texel some of whose 2x2 src texels changed
+			x0 /= 2;
+			y0 /= 2;
+			x1 = std::min((x1 + 1) / 2, dst.width);
+			y1 = std::min((y1 + 1) / 2, dst.height);
+
+			DownsampleRegion(&src.texels[0], src.width, src.height, &dst.texels[0], dst.width, x0, y0, x1, y1);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::MarkAllDirty()
+	{
+		m_dirty.assign(m_tiles.size(), true);
+		m_numDirty = m_tiles.size();
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::_MarkTilesDirty( unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1 )
+	{
+		for (unsigned int ty=y0/m_tileSize; ty<=y1/m_tileSize; ++ty)
+		{
+			for (unsigned int tx=x0/m_tileSize; tx<=x1/m_tileSize; ++tx)
+			{
+				const unsigned int tile = ty * m_tilesPerSide + tx;
+				if (!m_dirty[tile])
+				{
+					m_dirty[tile] = true;
+					++m_numDirty;
+				}
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::Bake( std::vector<unsigned int>& bakedTiles )
+	{
+		bakedTiles.clear();
+		if(m_numDirty == 0 || m_numLayers == 0 || m_blendMap.empty())
+			return;
+
+		// A composite texel covers the same layer footprint everywhere, so every
+		// layer is sampled from the same pair of mips all over the map.
+		SLayerSampler layers[MAX_LAYERS];
+		for (unsigned int i=0; i<m_numLayers; ++i)
+		{
+			const MipChain& mips = m_layers[i];
+			assert(!mips.empty() && "Layers below the last one must be set!");
+
+			const float footprint = std::max(mips[0].width, mips[0].height) * m_layerTexScale / m_size;
+			const float lod = std::min(logf(std::max(footprint, 1.0f)) / logf(2.0f), (float)(mips.size() - 1));
+			const unsigned int mip0 = (unsigned int)lod;
+
+			layers[i].pMip0 = &mips[mip0];
+			layers[i].pMip1 = &mips[std::min(mip0 + 1, (unsigned int)mips.size() - 1)];
+			layers[i].mipBlend = lod - mip0;
+			layers[i].uvScale = m_layerTexScale;
+		}
+
+		for (unsigned int tile=0; tile<m_dirty.size(); ++tile)
+		{
+			if(m_dirty[tile])
+				bakedTiles.push_back(tile);
+		}
+
+		ParallelFor(bakedTiles.size(), [&](unsigned int i)
+		{
+			_BakeTile(bakedTiles[i], layers, m_numLayers);
+		});
+
+		_BuildCoarseMips();
+
+		m_dirty.assign(m_tiles.size(), false);
+		m_numDirty = 0;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::_BakeTile( unsigned int tile, const SLayerSampler* pLayers, unsigned int numLayers )
+	{
+		const unsigned int tileX = (tile % m_tilesPerSide) * m_tileSize;
+		const unsigned int tileY = (tile / m_tilesPerSide) * m_tileSize;
+		const float invSize = 1.0f / m_size;
+		const SImage& blendMap = m_blendMap[0];
+		const float blendScaleX = (float)blendMap.width;
+		const float blendScaleY = (float)blendMap.height;
+		const __m128 invByte = _mm_set1_ps(1.0f / 255);
+
+		unsigned char* pOut = &m_tiles[tile][0];
+
+		for (unsigned int y=0; y<m_tileSize; ++y)
+		{
+			const float v = (tileY + y + 0.5f) * invSize;
+
+			for (unsigned int x=0; x<m_tileSize; ++x)
+			{
+				const float u = (tileX + x + 0.5f) * invSize;
+
+				__m128 weights = _mm_mul_ps(SampleBilinear<false>(&blendMap.texels[0],
+					blendMap.width, blendMap.height, u * blendScaleX, v * blendScaleY), invByte);
+
+				__m128 color = _mm_setzero_ps();
+				for (unsigned int i=0; i<numLayers; ++i)
+				{
+					const SLayerSampler& layer = pLayers[i];
+					const float lu = u * layer.uvScale, lv = v * layer.uvScale;
+
+					const SImage& m0 = *layer.pMip0;
+					const SImage& m1 = *layer.pMip1;
+					const __m128 c0 = SampleBilinear<true>(&m0.texels[0], m0.width, m0.height, lu * m0.width, lv * m0.height);
+					const __m128 c1 = SampleBilinear<true>(&m1.texels[0], m1.width, m1.height, lu * m1.width, lv * m1.height);
+					const __m128 c = Lerp(c0, c1, _mm_set1_ps(layer.mipBlend));
+
+					if (i == 0)
+					{
+						color = c;
+					}
+					else
+					{
+						// Weight of layer i is channel i - 1 of the blend map
+						color = Lerp(color, c, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)));
+						weights = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 3, 2, 1));
+					}
+				}
+
+				StoreTexel(color, pOut + (y * m_tileSize + x) * 4);
+			}
+		}
+
+		// Tile local mips, tiles are aligned so they match mips of the whole map
+		for (unsigned int mip=1; mip<m_mipCount; ++mip)
+		{
+			const unsigned int srcSize = m_tileSize >> (mip - 1);
+			unsigned char* pDst = pOut + srcSize * srcSize * 4;
+
+			Downsample(pOut, pDst, srcSize / 2);
+			pOut = pDst;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainCompositeMap::_BuildCoarseMips()
+	{
+		if(m_coarseMips.empty())
+			return;
+
+		// Tile i is texel i of this level, both are row major
+		std::vector<unsigned char> level(m_tiles.size() * 4);
+		for (unsigned int tile=0; tile<m_tiles.size(); ++tile)
+			memcpy(&level[tile * 4], GetTileData(tile, m_mipCount - 1), 4);
+
+		const unsigned char* pSrc = &level[0];
+		for (size_t i=0; i<m_coarseMips.size(); ++i)
+		{
+			Downsample(pSrc, &m_coarseMips[i].texels[0], m_coarseMips[i].width);
+			pSrc = &m_coarseMips[i].texels[0];
+		}
+	}
+	//------------------------------------------------------------------------------------
+	const unsigned char* TerrainCompositeMap::GetTileData( unsigned int tile, unsigned int mip ) const
+	{
+		assert(tile < m_tiles.size() && mip < m_mipCount);
+
+		unsigned int offset = 0;
+		for (unsigned int i=0; i<mip; ++i)
+			offset += (m_tileSize >> i) * (m_tileSize >> i) * 4;
+
+		return &m_tiles[tile][offset];
+	}
+	//------------------------------------------------------------------------------------
+	const unsigned char* TerrainCompositeMap::GetCoarseMipData( unsigned int mip ) const
+	{
+		assert(mip >= m_mipCount && mip < GetMapMipCount());
+
+		return &m_coarseMips[mip - m_mipCount].texels[0];
+	}
+	//------------------------------------------------------------------------------------
+	const unsigned char* TerrainCompositeMap::GetBlendMipData( unsigned int mip, unsigned int& width, unsigned int& height ) const
+	{
+		assert(mip < m_blendMap.size());
+
+		const SImage& image = m_blendMap[mip];
+		width = image.width;
+		height = image.height;
+
+		return &image.texels[0];
+	}
+}
@@ -0,0 +1,215 @@
+#include "TerrainDensityMap.h"
+#include "ParallelFor.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace Neo
+{
+	static const unsigned int	ROWS_PER_JOB		=	64;
+	// Regions below this many samples, a brush stroke or so, stay on the calling thread
+	static const unsigned int	PARALLEL_SAMPLES	=	128 * 128;
+
+	namespace
+	{
+		// Larger absolute eigenvalue of [hxx hxz; hxz hzz]
+		inline float MaxCurvature(float hxx, float hzz, float hxz)
+		{
+			const float mean = (hxx + hzz) * 0.5f;
+			const float diff = (hxx - hzz) * 0.5f;
+
+			return fabsf(mean) + sqrtf(diff * diff + hxz * hxz);
+		}
+
+		inline __m128 MaxCurvatureSSE(__m128 hxx, __m128 hzz, __m128 hxz)
+		{
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+			const __m128 mean = _mm_mul_ps(_mm_add_ps(hxx, hzz), half);
+			const __m128 diff = _mm_mul_ps(_mm_sub_ps(hxx, hzz), half);
+			const __m128 root = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(diff, diff), _mm_mul_ps(hxz, hxz)));
+
+			return _mm_add_ps(_mm_and_ps(mean, absMask), root);
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	TerrainDensityMap::TerrainDensityMap()
+	:m_pHeights(nullptr)
+	,m_size(0)
+	,m_cellsPerPatch(1)
+	,m_patchesPerSide(0)
+	,m_invCellSpaceSq(1)
+	,m_percentile(0.9f)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainDensityMap::Build( const float* pHeights, unsigned int size, float cellSpace, unsigned int cellsPerPatch, float percentile )
+	{
+		assert(size >= 3 && cellsPerPatch > 0 && (size - 1) % cellsPerPatch == 0);
+		assert(percentile >= 0 && percentile <= 1);
+
+		m_pHeights = pHeights;
+		m_size = size;
+		m_cellsPerPatch = cellsPerPatch;
+		m_patchesPerSide = (size - 1) / cellsPerPatch;
+		m_invCellSpaceSq = 1.0f / (cellSpace * cellSpace);
+		m_percentile = percentile;
+
+		m_density.resize(size * size);
+		m_patchMax.resize(m_patchesPerSide * m_patchesPerSide);
+		m_patchMean.resize(m_patchesPerSide * m_patchesPerSide);
+		m_patchPercentile.resize(m_patchesPerSide * m_patchesPerSide);
+
+		UpdateRegion(0, 0, size - 1, size - 1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainDensityMap::UpdateRegion( unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		assert(row0 <= row1 && col0 <= col1 && row1 < m_size && col1 < m_size);
+
+		_ComputeRows(row0, col0, row1, col1);
+
+		// Samples on a patch edge belong to the patches on both sides
+		const unsigned int pr0 = (row0 > 0 ? row0 - 1 : 0) / m_cellsPerPatch;
+		const unsigned int pc0 = (col0 > 0 ? col0 - 1 : 0) / m_cellsPerPatch;
+		const unsigned int pr1 = std::min(row1, m_size - 2) / m_cellsPerPatch;
+		const unsigned int pc1 = std::min(col1, m_size - 2) / m_cellsPerPatch;
+
+		_ReducePatches(pr0, pc0, pr1, pc1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainDensityMap::_ComputeRows( unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		const unsigned int size = m_size;
+		const float* pHeights = m_pHeights;
+		float* pDensity = &m_density[0];
+		const float invSq = m_invCellSpaceSq;
+
+		// Border samples use their own height for the missing neighbours.
+		// Same operation order as the SSE path, so a sample doesn't depend on which path computed it.
+		auto sampleDensity = [=](unsigned int r, unsigned int c) -> float
+		{
+			const unsigned int rm = r > 0 ? r - 1 : 0, rp = std::min(r + 1, size - 1);
+			const unsigned int cm = c > 0 ? c - 1 : 0, cp = std::min(c + 1, size - 1);
+			const float* pRow = pHeights + r * size;
+			const float* pUp = pHeights + rm * size;
+			const float* pDown = pHeights + rp * size;
+
+			const float hxx = ((pRow[cp] + pRow[cm]) - pRow[c] * 2) * invSq;
+			const float hzz = ((pDown[c] + pUp[c]) - pRow[c] * 2) * invSq;
+			const float hxz = ((pDown[cp] - pDown[cm]) + (pUp[cm] - pUp[cp])) * (0.25f * invSq);
+
+			return MaxCurvature(hxx, hzz, hxz);
+		};
+
+		const unsigned int numRows = row1 - row0 + 1;
+		const unsigned int numJobs = (numRows + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+		const unsigned int numThreads = numRows * (col1 - col0 + 1) < PARALLEL_SAMPLES ? 1 : 0;
+
+		ParallelFor(numJobs, [&](unsigned int job)
+		{
+			const __m128 vInvSq = _mm_set1_ps(invSq);
+			const __m128 vQuarterInvSq = _mm_set1_ps(0.25f * invSq);
+			const __m128 two = _mm_set1_ps(2.0f);
+
+			const unsigned int jobRow0 = row0 + job * ROWS_PER_JOB;
+			const unsigned int jobRow1 = std::min(jobRow0 + ROWS_PER_JOB - 1, row1);
+
+			for (unsigned int r=jobRow0; r<=jobRow1; ++r)
+			{
+				const unsigned int rm = r > 0 ? r - 1 : 0, rp = std::min(r + 1, size - 1);
+				const float* pRow = pHeights + r * size;
+				const float* pUp = pHeights + rm * size;
+				const float* pDown = pHeights + rp * size;
+				float* pDst = pDensity + r * size;
+
+				// Columns with both neighbours in the map go 4 at a time
+				unsigned int c = col0;
+				if (c == 0)
+				{
+					pDst[0] = sampleDensity(r, 0);
+					++c;
+				}
+
+				const unsigned int inner1 = std::min(col1, size - 2);
+				for (; c+3<=inner1; c+=4)
+				{
+					const __m128 h = _mm_loadu_ps(pRow + c);
+					const __m128 twoH = _mm_mul_ps(h, two);
+
+					const __m128 hxx = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(pRow + c + 1), _mm_loadu_ps(pRow + c - 1)), twoH), vInvSq);
+					const __m128 hzz = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(pDown + c), _mm_loadu_ps(pUp + c)), twoH), vInvSq);
+					const __m128 hxz = _mm_mul_ps(_mm_add_ps(
+						_mm_sub_ps(_mm_loadu_ps(pDown + c + 1), _mm_loadu_ps(pDown + c - 1)),
+						_mm_sub_ps(_mm_loadu_ps(pUp + c - 1), _mm_loadu_ps(pUp + c + 1))), vQuarterInvSq);
+
+					_mm_storeu_ps(pDst + c, MaxCurvatureSSE(hxx, hzz, hxz));
+				}
+
+				for (; c<=col1; ++c)
+					pDst[c] = sampleDensity(r, c);
+			}
+		}, numThreads);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainDensityMap::_ReducePatches( unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		const unsigned int samplesPerSide = m_cellsPerPatch + 1;
+		const unsigned int numPatches = (row1 - row0 + 1) * (col1 - col0 + 1);
+		const unsigned int numThreads = numPatches * samplesPerSide * samplesPerSide < PARALLEL_SAMPLES ? 1 : 0;
+
+		ParallelFor(row1 - row0 + 1, [&](unsigned int job)
+		{
+			const unsigned int row = row0 + job;
+			std::vector<float> samples(samplesPerSide * samplesPerSide);
+
+			for (unsigned int col=col0; col<=col1; ++col)
+			{
+				__m128 vMax = _mm_setzero_ps();
+				__m128 vSum = _mm_setzero_ps();
+				float* pOut = &samples[0];
+
+				for (unsigned int r=0; r<samplesPerSide; ++r)
+				{
+					const float* pSrc = &m_density[(row * m_cellsPerPatch + r) * m_size + col * m_cellsPerPatch];
+
+					unsigned int c = 0;
+					for (; c+4<=samplesPerSide; c+=4)
+					{
+						const __m128 d = _mm_loadu_ps(pSrc + c);
+						vMax = _mm_max_ps(vMax, d);
+						vSum = _mm_add_ps(vSum, d);
+						_mm_storeu_ps(pOut + c, d);
+					}
+					for (; c<samplesPerSide; ++c)
+					{
+						const __m128 d = _mm_set_ss(pSrc[c]);
+						vMax = _mm_max_ps(vMax, d);
+						vSum = _mm_add_ps(vSum, d);
+						pOut[c] = pSrc[c];
+					}
+
+					pOut += samplesPerSide;
+				}
+
+				vMax = _mm_max_ps(vMax, _mm_movehl_ps(vMax, vMax));
+				vSum = _mm_add_ps(vSum, _mm_movehl_ps(vSum, vSum));
+				vMax = _mm_max_ss(vMax, _mm_shuffle_ps(vMax, vMax, 1));
+				vSum = _mm_add_ss(vSum, _mm_shuffle_ps(vSum, vSum, 1));
+
+				const unsigned int i = row * m_patchesPerSide + col;
+				_mm_store_ss(&m_patchMax[i], vMax);
+				_mm_store_ss(&m_patchMean[i], vSum);
+				m_patchMean[i] /= samples.size();
+
+				const size_t nth = (size_t)(m_percentile * (samples.size() - 1) + 0.5f);
+				std::nth_element(samples.begin(), samples.begin() + nth, samples.end());
+				m_patchPercentile[i] = samples[nth];
+			}
+		}, numThreads);
+	}
+}
@@ -0,0 +1,532 @@
+#include "TerrainHeightField.h"
+#include "ParallelFor.h"
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace Neo
+{
+	// Cells per side of a leaf block. Smaller prunes better, larger keeps the pyramid small.
+	static const unsigned int	LEAF_CELLS			=	8;
+	// Batched lookups below this many points don't pay for starting threads
+	static const unsigned int	PARALLEL_BATCH		=	16384;
+	static const unsigned int	POINTS_PER_JOB		=	4096;
+	// Same for refitting leaf blocks, a brush stroke touches a handful
+	static const unsigned int	PARALLEL_BLOCKS		=	1024;
+
+	namespace
+	{
+		// Clip [tn, tf] to the slab lo <= o + t * d <= hi, false if it becomes empty
+		inline bool ClipSlab(float o, float d, float lo, float hi, float& tn, float& tf)
+		{
+			if (fabsf(d) < 1e-12f)
+				return o >= lo && o <= hi;
+
+			const float inv = 1.0f / d;
+			float t0 = (lo - o) * inv;
+			float t1 = (hi - o) * inv;
+			if(t0 > t1)
+				std::swap(t0, t1);
+
+			tn = std::max(tn, t0);
+			tf = std::min(tf, t1);
+
+			return tn <= tf;
+		}
+
+		// Two sided Moller-Trumbore, t only accepted in [0, tMax]
+		inline bool IntersectTriangle(const float o[3], const float d[3], const float a[3], const float b[3], const float c[3],
+			float tMax, float& t)
+		{
+			const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			const float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+
+			const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			if(fabsf(det) < 1e-12f)
+				return false;
+
+			const float invDet = 1.0f / det;
+			const float s[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+
+			// Small tolerance so rays through the shared edges don't slip between triangles
+			const float eps = 1e-5f;
+			const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+			if(u < -eps || u > 1 + eps)
+				return false;
+
+			const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+			if(v < -eps || u + v > 1 + eps)
+				return false;
+
+			t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+
+			return t >= 0 && t <= tMax;
+		}
+
+		inline void MakeNormal(float dhdx, float dhdz, float normal[3])
+		{
+			const float invLen = 1.0f / sqrtf(dhdx * dhdx + 1 + dhdz * dhdz);
+			normal[0] = -dhdx * invLen;
+			normal[1] = invLen;
+			normal[2] = -dhdz * invLen;
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	TerrainHeightField::TerrainHeightField()
+	:m_pHeights(nullptr)
+	,m_size(0)
+	,m_numCells(0)
+	,m_numBlocks(0)
+	,m_originX(0)
+	,m_originZ(0)
+	,m_cellSpace(1)
+	,m_invCellSpace(1)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::Build( const float* pHeights, unsigned int size, float originX, float originZ, float cellSpace )
+	{
+		assert(pHeights && size >= 2 && cellSpace > 0);
+
+		m_pHeights = pHeights;
+		m_size = size;
+		m_numCells = size - 1;
+		m_numBlocks = (m_numCells + LEAF_CELLS - 1) / LEAF_CELLS;
+		m_originX = originX;
+		m_originZ = originZ;
+		m_cellSpace = cellSpace;
+		m_invCellSpace = 1.0f / cellSpace;
+
+		m_levels.clear();
+		for (unsigned int level=0; ; ++level)
+		{
+			const unsigned int dim = _GetLevelDim(level);
+			m_levels.push_back(Level(dim * dim));
+			if(dim == 1)
+				break;
+		}
+
+		_BuildLeaves(0, 0, m_numBlocks - 1, m_numBlocks - 1);
+		for (unsigned int level=1; level<m_levels.size(); ++level)
+			_BuildParents(level, 0, 0, _GetLevelDim(level) - 1, _GetLevelDim(level) - 1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::UpdateRegion( unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		assert(row0 <= row1 && col0 <= col1 && row1 < m_size && col1 < m_size);
+
+		// A sample is a corner of the cells on both sides of it
+		unsigned int blockRow0 = (row0 > 0 ? row0 - 1 : 0) / LEAF_CELLS;
+		unsigned int blockCol0 = (col0 > 0 ? col0 - 1 : 0) / LEAF_CELLS;
+		unsigned int blockRow1 = std::min(row1, m_numCells - 1) / LEAF_CELLS;
+		unsigned int blockCol1 = std::min(col1, m_numCells - 1) / LEAF_CELLS;
+
+		_BuildLeaves(blockRow0, blockCol0, blockRow1, blockCol1);
+
+		for (unsigned int level=1; level<m_levels.size(); ++level)
+		{
+			blockRow0 >>= 1; blockCol0 >>= 1;
+			blockRow1 >>= 1; blockCol1 >>= 1;
+			_BuildParents(level, blockRow0, blockCol0, blockRow1, blockCol1);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::_BuildLeaves( unsigned int blockRow0, unsigned int blockCol0, unsigned int blockRow1, unsigned int blockCol1 )
+	{
+		Level& leaves = m_levels[0];
+		const unsigned int numRows = blockRow1 - blockRow0 + 1;
+		const unsigned int numBlocks = numRows * (blockCol1 - blockCol0 + 1);
+
+		ParallelFor(numRows, [&](unsigned int i)
+		{
+			const unsigned int blockRow = blockRow0 + i;
+			const unsigned int r0 = blockRow * LEAF_CELLS;
+			const unsigned int r1 = std::min(r0 + LEAF_CELLS, m_numCells);
+
+			for (unsigned int blockCol=blockCol0; blockCol<=blockCol1; ++blockCol)
+			{
+				const unsigned int c0 = blockCol * LEAF_CELLS;
+				const unsigned int c1 = std::min(c0 + LEAF_CELLS, m_numCells);
+
+				__m128 vMin = _mm_set1_ps(FLT_MAX);
+				__m128 vMax = _mm_set1_ps(-FLT_MAX);
+
+				for (unsigned int r=r0; r<=r1; ++r)
+				{
+					const float* pRow = m_pHeights + r * m_size;
+					unsigned int c = c0;
+
+					for (; c+4<=c1+1; c+=4)
+					{
+						const __m128 h = _mm_loadu_ps(pRow + c);
+						vMin = _mm_min_ps(vMin, h);
+						vMax = _mm_max_ps(vMax, h);
+					}
+
+					for (; c<=c1; ++c)
+					{
+						const __m128 h = _mm_set1_ps(pRow[c]);
+						vMin = _mm_min_ps(vMin, h);
+						vMax = _mm_max_ps(vMax, h);
+					}
+				}
+
+				vMin = _mm_min_ps(vMin, _mm_movehl_ps(vMin, vMin));
+				vMax = _mm_max_ps(vMax, _mm_movehl_ps(vMax, vMax));
+				vMin = _mm_min_ss(vMin, _mm_shuffle_ps(vMin, vMin, 1));
+				vMax = _mm_max_ss(vMax, _mm_shuffle_ps(vMax, vMax, 1));
+
+				SMinMax& node = leaves[blockRow * m_numBlocks + blockCol];
+				_mm_store_ss(&node.fMin, vMin);
+				_mm_store_ss(&node.fMax, vMax);
+			}
+		}, numBlocks < PARALLEL_BLOCKS ? 1 : 0);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::_BuildParents( unsigned int level, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		const Level& children = m_levels[level - 1];
+		const unsigned int childDim = _GetLevelDim(level - 1);
+		const unsigned int dim = _GetLevelDim(level);
+		Level& nodes = m_levels[level];
+
+		for (unsigned int row=row0; row<=row1; ++row)
+		{
+			for (unsigned int col=col0; col<=col1; ++col)
+			{
+				SMinMax node = { FLT_MAX, -FLT_MAX };
+
+				// Children past an odd sized level don't exist
+				const unsigned int cr1 = std::min(row * 2 + 1, childDim - 1);
+				const unsigned int cc1 = std::min(col * 2 + 1, childDim - 1);
+				for (unsigned int cr=row*2; cr<=cr1; ++cr)
+				{
+					for (unsigned int cc=col*2; cc<=cc1; ++cc)
+					{
+						const SMinMax& child = children[cr * childDim + cc];
+						node.fMin = std::min(node.fMin, child.fMin);
+						node.fMax = std::max(node.fMax, child.fMax);
+					}
+				}
+
+				nodes[row * dim + col] = node;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainHeightField::RayCast( const float origin[3], const float dir[3], float maxT, STerrainRayHit& hit ) const
+	{
+		if(m_levels.empty())
+			return false;
+
+		// Grid space, a cell is 1x1 in xz. Affine, so t is the same as in world space.
+		const float o[3] = { (origin[0] - m_originX) * m_invCellSpace, origin[1], (origin[2] - m_originZ) * m_invCellSpace };
+		const float d[3] = { dir[0] * m_invCellSpace, dir[1], dir[2] * m_invCellSpace };
+
+		struct SNode
+		{
+			unsigned int	level, row, col;
+		};
+
+		// Depth first, 3 siblings left behind per level at most
+		SNode stack[64];
+		int top = 0;
+
+		SNode root = { (unsigned int)m_levels.size() - 1, 0, 0 };
+		stack[top++] = root;
+
+		// Push the child nearest along the ray last so it's visited first
+		const unsigned int nearCol = d[0] < 0 ? 1 : 0;
+		const unsigned int nearRow = d[2] < 0 ? 1 : 0;
+
+		bool bHit = false;
+		hit.t = maxT;
+
+		while (top > 0)
+		{
+			const SNode node = stack[--top];
+			const SMinMax& bound = m_levels[node.level][node.row * _GetLevelDim(node.level) + node.col];
+
+			const float extent = (float)(LEAF_CELLS << node.level);
+			float tn = 0, tf = hit.t;
+
+			if (!ClipSlab(o[0], d[0], node.col * extent, std::min((node.col + 1) * extent, (float)m_numCells), tn, tf) ||
+				!ClipSlab(o[2], d[2], node.row * extent, std::min((node.row + 1) * extent, (float)m_numCells), tn, tf) ||
+				!ClipSlab(o[1], d[1], bound.fMin, bound.fMax, tn, tf))
+				continue;
+
+			if (node.level == 0)
+			{
+				if(_RayCastLeaf(o, d, node.row, node.col, tn, tf, hit))
+					bHit = true;
+				continue;
+			}
+
+			const unsigned int childDim = _GetLevelDim(node.level - 1);
+			for (int i=3; i>=0; --i)
+			{
+				SNode child = { node.level - 1, node.row * 2 + ((i >> 1) ^ nearRow), node.col * 2 + ((i & 1) ^ nearCol) };
+				if(child.row < childDim && child.col < childDim)
+					stack[top++] = child;
+			}
+		}
+
+		if(!bHit)
+			return false;
+
+		hit.pos[0] = origin[0] + dir[0] * hit.t;
+		hit.pos[1] = origin[1] + dir[1] * hit.t;
+		hit.pos[2] = origin[2] + dir[2] * hit.t;
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainHeightField::_RayCastLeaf( const float o[3], const float d[3], unsigned int blockRow, unsigned int blockCol,
+		float tEnter, float tExit, STerrainRayHit& hit ) const
+	{
+		const int c0 = blockCol * LEAF_CELLS, c1 = std::min(c0 + (int)LEAF_CELLS, (int)m_numCells) - 1;
+		const int r0 = blockRow * LEAF_CELLS, r1 = std::min(r0 + (int)LEAF_CELLS, (int)m_numCells) - 1;
+
+		// 2D DDA from the entry point
+		const float x = o[0] + d[0] * tEnter;
+		const float z = o[2] + d[2] * tEnter;
+		int col = std::min(std::max((int)floorf(x), c0), c1);
+		int row = std::min(std::max((int)floorf(z), r0), r1);
+
+		const int stepCol = d[0] > 0 ? 1 : -1;
+		const int stepRow = d[2] > 0 ? 1 : -1;
+		const float tDeltaCol = d[0] != 0 ? fabsf(1.0f / d[0]) : FLT_MAX;
+		const float tDeltaRow = d[2] != 0 ? fabsf(1.0f / d[2]) : FLT_MAX;
+		float tNextCol = d[0] != 0 ? ((d[0] > 0 ? col + 1 : col) - o[0]) / d[0] : FLT_MAX;
+		float tNextRow = d[2] != 0 ? ((d[2] > 0 ? row + 1 : row) - o[2]) / d[2] : FLT_MAX;
+
+		for (;;)
+		{
+			if(_RayCastCell(o, d, row, col, hit.t, hit))
+				return true;
+
+			if (tNextCol < tNextRow)
+			{
+				if(tNextCol > tExit)
+					return false;
+				col += stepCol;
+				tNextCol += tDeltaCol;
+			}
+			else
+			{
+				if(tNextRow > tExit)
+					return false;
+				row += stepRow;
+				tNextRow += tDeltaRow;
+			}
+
+			if(col < c0 || col > c1 || row < r0 || row > r1)
+				return false;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainHeightField::_RayCastCell( const float o[3], const float d[3], unsigned int row, unsigned int col,
+		float tMax, STerrainRayHit& hit ) const
+	{
+		const float h00 = _Sample(row, col), h01 = _Sample(row, col + 1);
+		const float h10 = _Sample(row + 1, col), h11 = _Sample(row + 1, col + 1);
+
+		const float a[3] = { (float)col,		h00, (float)row };
+		const float b[3] = { (float)col + 1,	h01, (float)row };
+		const float c[3] = { (float)col,		h10, (float)row + 1 };
+		const float e[3] = { (float)col + 1,	h11, (float)row + 1 };
+
+		float t0 = FLT_MAX, t1 = FLT_MAX;
+		const bool bHit0 = IntersectTriangle(o, d, a, b, c, tMax, t0);
+		const bool bHit1 = IntersectTriangle(o, d, b, e, c, tMax, t1);
+
+		if(!bHit0 && !bHit1)
+			return false;
+
+		// Slopes in world units
+		if (t0 <= t1)
+		{
+			hit.t = t0;
+			MakeNormal((h01 - h00) * m_invCellSpace, (h10 - h00) * m_invCellSpace, hit.normal);
+		}
+		else
+		{
+			hit.t = t1;
+			MakeNormal((h11 - h10) * m_invCellSpace, (h11 - h01) * m_invCellSpace, hit.normal);
+		}
+
+		hit.row = row;
+		hit.col = col;
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::_ToCell( float x, float z, unsigned int& row, unsigned int& col, float& fx, float& fz ) const
+	{
+		const float gx = std::min(std::max((x - m_originX) * m_invCellSpace, 0.0f), (float)m_numCells);
+		const float gz = std::min(std::max((z - m_originZ) * m_invCellSpace, 0.0f), (float)m_numCells);
+
+		// The far border belongs to the last cell
+		col = std::min((unsigned int)gx, m_numCells - 1);
+		row = std::min((unsigned int)gz, m_numCells - 1);
+		fx = gx - col;
+		fz = gz - row;
+	}
+	//------------------------------------------------------------------------------------
+	float TerrainHeightField::GetHeightBilinear( float x, float z ) const
+	{
+		unsigned int row, col;
+		float fx, fz;
+		_ToCell(x, z, row, col, fx, fz);
+
+		const float h0 = _Sample(row, col) + (_Sample(row, col + 1) - _Sample(row, col)) * fx;
+		const float h1 = _Sample(row + 1, col) + (_Sample(row + 1, col + 1) - _Sample(row + 1, col)) * fx;
+
+		return h0 + (h1 - h0) * fz;
+	}
+	//------------------------------------------------------------------------------------
+	float TerrainHeightField::GetHeightExact( float x, float z ) const
+	{
+		unsigned int row, col;
+		float fx, fz;
+		_ToCell(x, z, row, col, fx, fz);
+
+		if (fx + fz <= 1)
+		{
+			const float h00 = _Sample(row, col);
+			return h00 + (_Sample(row, col + 1) - h00) * fx + (_Sample(row + 1, col) - h00) * fz;
+		}
+		else
+		{
+			const float h11 = _Sample(row + 1, col + 1);
+			return h11 + (_Sample(row + 1, col) - h11) * (1 - fx) + (_Sample(row, col + 1) - h11) * (1 - fz);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::GetNormalBilinear( float x, float z, float normal[3] ) const
+	{
+		unsigned int row, col;
+		float fx, fz;
+		_ToCell(x, z, row, col, fx, fz);
+
+		const float h00 = _Sample(row, col), h01 = _Sample(row, col + 1);
+		const float h10 = _Sample(row + 1, col), h11 = _Sample(row + 1, col + 1);
+
+		const float dhdx = ((h01 - h00) + ((h11 - h10) - (h01 - h00)) * fz) * m_invCellSpace;
+		const float dhdz = ((h10 - h00) + ((h11 - h01) - (h10 - h00)) * fx) * m_invCellSpace;
+
+		MakeNormal(dhdx, dhdz, normal);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::GetNormalExact( float x, float z, float normal[3] ) const
+	{
+		unsigned int row, col;
+		float fx, fz;
+		_ToCell(x, z, row, col, fx, fz);
+
+		const float h00 = _Sample(row, col), h01 = _Sample(row, col + 1);
+		const float h10 = _Sample(row + 1, col), h11 = _Sample(row + 1, col + 1);
+
+		if(fx + fz <= 1)
+			MakeNormal((h01 - h00) * m_invCellSpace, (h10 - h00) * m_invCellSpace, normal);
+		else
+			MakeNormal((h11 - h10) * m_invCellSpace, (h11 - h01) * m_invCellSpace, normal);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::GetHeights( const float* pXZ, float* pHeights, unsigned int count, bool bExact ) const
+	{
+		if (count < PARALLEL_BATCH)
+		{
+			_GetHeightsRange(pXZ, pHeights, count, bExact);
+			return;
+		}
+
+		const unsigned int numJobs = (count + POINTS_PER_JOB - 1) / POINTS_PER_JOB;
+		ParallelFor(numJobs, [&](unsigned int job)
+		{
+			const unsigned int begin = job * POINTS_PER_JOB;
+			const unsigned int n = std::min(POINTS_PER_JOB, count - begin);
+
+			_GetHeightsRange(pXZ + begin * 2, pHeights + begin, n, bExact);
+		});
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainHeightField::_GetHeightsRange( const float* pXZ, float* pHeights, unsigned int count, bool bExact ) const
+	{
+		const __m128 origin = _mm_setr_ps(m_originX, m_originZ, m_originX, m_originZ);
+		const __m128 invSpace = _mm_set1_ps(m_invCellSpace);
+		const __m128 maxCoord = _mm_set1_ps((float)m_numCells);
+		const __m128i maxCell = _mm_set1_epi32(m_numCells - 1);
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		unsigned int i = 0;
+		for (; i+4<=count; i+=4)
+		{
+			// Two (x, z) pairs per register, then split into x and z lanes
+			const __m128 p01 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pXZ + i * 2), origin), invSpace);
+			const __m128 p23 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pXZ + i * 2 + 4), origin), invSpace);
+			__m128 gx = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 gz = _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1));
+
+			gx = _mm_min_ps(_mm_max_ps(gx, _mm_setzero_ps()), maxCoord);
+			gz = _mm_min_ps(_mm_max_ps(gz, _mm_setzero_ps()), maxCoord);
+
+			// Non negative, truncation is floor. SSE2 has no unsigned min, values fit in int.
+			__m128i col = _mm_cvttps_epi32(gx);
+			__m128i row = _mm_cvttps_epi32(gz);
+			col = _mm_sub_epi32(col, _mm_and_si128(_mm_cmpgt_epi32(col, maxCell), _mm_set1_epi32(1)));
+			row = _mm_sub_epi32(row, _mm_and_si128(_mm_cmpgt_epi32(row, maxCell), _mm_set1_epi32(1)));
+
+			const __m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(col));
+			const __m128 fz = _mm_sub_ps(gz, _mm_cvtepi32_ps(row));
+
+			// SSE2 has no gather. Unaligned access keeps the arrays free of compiler specific alignment.
+			int rows[4], cols[4];
+			_mm_storeu_si128((__m128i*)rows, row);
+			_mm_storeu_si128((__m128i*)cols, col);
+
+			float h00[4], h01[4], h10[4], h11[4];
+			for (int k=0; k<4; ++k)
+			{
+				const float* p = m_pHeights + rows[k] * m_size + cols[k];
+				h00[k] = p[0];
+				h01[k] = p[1];
+				h10[k] = p[m_size];
+				h11[k] = p[m_size + 1];
+			}
+
+			const __m128 v00 = _mm_loadu_ps(h00), v01 = _mm_loadu_ps(h01);
+			const __m128 v10 = _mm_loadu_ps(h10), v11 = _mm_loadu_ps(h11);
+			__m128 h;
+
+			if (bExact)
+			{
+				const __m128 lower = _mm_add_ps(v00, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v01, v00), fx), _mm_mul_ps(_mm_sub_ps(v10, v00), fz)));
+				const __m128 upper = _mm_add_ps(v11, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v10, v11), _mm_sub_ps(one, fx)),
+					_mm_mul_ps(_mm_sub_ps(v01, v11), _mm_sub_ps(one, fz))));
+				const __m128 bLower = _mm_cmple_ps(_mm_add_ps(fx, fz), one);
+				h = _mm_or_ps(_mm_and_ps(bLower, lower), _mm_andnot_ps(bLower, upper));
+			}
+			else
+			{
+				const __m128 h0 = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v01, v00), fx));
+				const __m128 h1 = _mm_add_ps(v10, _mm_mul_ps(_mm_sub_ps(v11, v10), fx));
+				h = _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fz));
+			}
+
+			_mm_storeu_ps(pHeights + i, h);
+		}
+
+		for (; i<count; ++i)
+		{
+			pHeights[i] = bExact ? GetHeightExact(pXZ[i * 2], pXZ[i * 2 + 1]) :
+				GetHeightBilinear(pXZ[i * 2], pXZ[i * 2 + 1]);
+		}
+	}
+}
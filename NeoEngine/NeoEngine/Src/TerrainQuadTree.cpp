@@ -0,0 +1,278 @@
+#include "TerrainQuadTree.h"
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace Neo
+{
+	// Fraction of a LOD's distance band before morphing to the next one starts
+	static const float	MORPH_START_RATIO	=	0.66f;
+	// Lowest tessellation roughness may bring a node down to
+	static const unsigned int	MIN_TESS	=	2;
+
+	namespace
+	{
+		float DistanceSqToBox(const float p[3], const float vMin[3], const float vMax[3])
+		{
+			float dSq = 0;
+			for (int i=0; i<3; ++i)
+			{
+				const float d = std::max(std::max(vMin[i] - p[i], p[i] - vMax[i]), 0.0f);
+				dSq += d * d;
+			}
+
+			return dSq;
+		}
+
+		// Same test as AabbBehindPlaneTest in Terrain.hlsl
+		bool IsBoxCulled(const float* pPlanes, unsigned int numPlanes, const float vMin[3], const float vMax[3])
+		{
+			for (unsigned int i=0; i<numPlanes; ++i)
+			{
+				const float* plane = pPlanes + i * 4;
+
+				float s = plane[3], r = 0;
+				for (int k=0; k<3; ++k)
+				{
+					s += plane[k] * (vMin[k] + vMax[k]) * 0.5f;
+					r += fabsf(plane[k]) * (vMax[k] - vMin[k]) * 0.5f;
+				}
+
+				if(s + r < 0)
+					return true;
+			}
+
+			return false;
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	TerrainQuadTree::TerrainQuadTree()
+	:m_patchesPerSide(0)
+	,m_originX(0)
+	,m_originZ(0)
+	,m_patchSize(1)
+	,m_leafTess(64)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::Build( unsigned int patchesPerSide, float originX, float originZ, float patchSize,
+		unsigned int leafTess, const float* pPatchBoundY )
+	{
+		assert(patchesPerSide > 0 && (patchesPerSide & (patchesPerSide - 1)) == 0);
+		assert(leafTess >= 4 && leafTess <= 64 && (leafTess & (leafTess - 1)) == 0);
+
+		m_patchesPerSide = patchesPerSide;
+		m_originX = originX;
+		m_originZ = originZ;
+		m_patchSize = patchSize;
+		m_leafTess = leafTess;
+
+		m_levels.clear();
+		for (unsigned int dim=patchesPerSide; dim>0; dim>>=1)
+			m_levels.push_back(Level(dim * dim));
+
+		UpdateBounds(pPatchBoundY, 0, 0, patchesPerSide - 1, patchesPerSide - 1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::UpdateBounds( const float* pPatchBoundY, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		assert(row0 <= row1 && col0 <= col1 && row1 < m_patchesPerSide && col1 < m_patchesPerSide);
+
+		Level& leaves = m_levels[0];
+		for (unsigned int row=row0; row<=row1; ++row)
+		{
+			for (unsigned int col=col0; col<=col1; ++col)
+			{
+				const unsigned int i = row * m_patchesPerSide + col;
+				leaves[i].minY = pPatchBoundY[i * 2];
+				leaves[i].maxY = pPatchBoundY[i * 2 + 1];
+			}
+		}
+
+		_RefitParents(row0, col0, row1, col1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::UpdateRoughness( const float* pPatchRoughness, unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		assert(row0 <= row1 && col0 <= col1 && row1 < m_patchesPerSide && col1 < m_patchesPerSide);
+
+		Level& leaves = m_levels[0];
+		for (unsigned int row=row0; row<=row1; ++row)
+		{
+			for (unsigned int col=col0; col<=col1; ++col)
+			{
+				const unsigned int i = row * m_patchesPerSide + col;
+				leaves[i].roughness = pPatchRoughness[i];
+			}
+		}
+
+		_RefitParents(row0, col0, row1, col1);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::_RefitParents( unsigned int row0, unsigned int col0, unsigned int row1, unsigned int col1 )
+	{
+		for (unsigned int level=1; level<m_levels.size(); ++level)
+		{
+			row0 >>= 1; col0 >>= 1;
+			row1 >>= 1; col1 >>= 1;
+
+			const Level& children = m_levels[level - 1];
+			const unsigned int childDim = _GetLevelDim(level - 1);
+			const unsigned int dim = _GetLevelDim(level);
+			Level& nodes = m_levels[level];
+
+			for (unsigned int row=row0; row<=row1; ++row)
+			{
+				for (unsigned int col=col0; col<=col1; ++col)
+				{
+					const SBound& c00 = children[(row * 2) * childDim + col * 2];
+					const SBound& c01 = children[(row * 2) * childDim + col * 2 + 1];
+					const SBound& c10 = children[(row * 2 + 1) * childDim + col * 2];
+					const SBound& c11 = children[(row * 2 + 1) * childDim + col * 2 + 1];
+
+					SBound& node = nodes[row * dim + col];
+					node.minY = std::min(std::min(c00.minY, c01.minY), std::min(c10.minY, c11.minY));
+					node.maxY = std::max(std::max(c00.maxY, c01.maxY), std::max(c10.maxY, c11.maxY));
+					node.roughness = std::max(std::max(c00.roughness, c01.roughness), std::max(c10.roughness, c11.roughness));
+				}
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::_GetBox( unsigned int level, unsigned int row, unsigned int col, float vMin[3], float vMax[3] ) const
+	{
+		const SBound& bound = m_levels[level][row * _GetLevelDim(level) + col];
+		const float size = m_patchSize * (1 << level);
+
+		vMin[0] = m_originX + col * size;
+		vMin[1] = bound.minY;
+		vMin[2] = m_originZ + row * size;
+		vMax[0] = vMin[0] + size;
+		vMax[1] = bound.maxY;
+		vMax[2] = vMin[2] + size;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::Select( const STerrainView& view, std::vector<STerrainNode>& nodes ) const
+	{
+		nodes.clear();
+		if(m_levels.empty())
+			return;
+
+		SSelectContext ctx;
+		ctx.pView = &view;
+		ctx.pNodes = &nodes;
+
+		// Grid spacing of LOD L is patchSize * 2^L / leafTess, it reaches the allowed
+		// error on screen at spacing * pixelsPerUnit / maxPixelError.
+		const unsigned int numLevels = GetLevelCount();
+		assert(numLevels < 32);
+
+		const float leafRange = m_patchSize / m_leafTess * view.pixelsPerUnit / view.maxPixelError;
+		for (unsigned int level=0; level<numLevels; ++level)
+			ctx.ranges[level] = leafRange * (1 << level);
+
+		// Whatever is left is drawn with the coarsest LOD
+		ctx.ranges[numLevels - 1] = FLT_MAX;
+
+		_Select(ctx, numLevels - 1, 0, 0);
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainQuadTree::_Select( SSelectContext& ctx, unsigned int level, unsigned int row, unsigned int col ) const
+	{
+		const STerrainView& view = *ctx.pView;
+
+		float vMin[3], vMax[3];
+		_GetBox(level, row, col, vMin, vMax);
+
+		const float distSq = DistanceSqToBox(view.camPos, vMin, vMax);
+		if(ctx.ranges[level] != FLT_MAX && distSq > ctx.ranges[level] * ctx.ranges[level])
+			return false;
+
+		// Handled, nothing to draw
+		if(view.pPlanes && IsBoxCulled(view.pPlanes, view.numPlanes, vMin, vMax))
+			return true;
+
+		if (level == 0 || distSq > ctx.ranges[level - 1] * ctx.ranges[level - 1])
+		{
+			_AddNode(ctx, level, row, col, level);
+			return true;
+		}
+
+		// Nearest child first
+		const float midX = (vMin[0] + vMax[0]) * 0.5f;
+		const float midZ = (vMin[2] + vMax[2]) * 0.5f;
+		const unsigned int nearCol = view.camPos[0] < midX ? 0 : 1;
+		const unsigned int nearRow = view.camPos[2] < midZ ? 0 : 1;
+
+		for (unsigned int i=0; i<4; ++i)
+		{
+			const unsigned int childRow = row * 2 + ((i >> 1) ^ nearRow);
+			const unsigned int childCol = col * 2 + ((i & 1) ^ nearCol);
+
+			// Too far for the child's LOD, draw its area with ours
+			if(!_Select(ctx, level - 1, childRow, childCol))
+				_AddNode(ctx, level - 1, childRow, childCol, level);
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainQuadTree::_AddNode( SSelectContext& ctx, unsigned int level, unsigned int row, unsigned int col, unsigned int lod ) const
+	{
+		const STerrainView& view = *ctx.pView;
+
+		float vMin[3], vMax[3];
+		_GetBox(level, row, col, vMin, vMax);
+
+		// A child drawn with its parent's LOD may still be outside the frustum
+		if(level != lod && view.pPlanes && IsBoxCulled(view.pPlanes, view.numPlanes, vMin, vMax))
+			return;
+
+		STerrainNode node;
+		node.x = vMin[0];
+		node.z = vMin[2];
+		node.size = vMax[0] - vMin[0];
+		node.minY = vMin[1];
+		node.maxY = vMax[1];
+		node.lod = lod;
+
+		// Halve the inner grid while the flat grid it leaves stays within the height error.
+		// Roughness differs between neighbours, so edges keep the LOD's grid to stay shared.
+		const unsigned int edgeTess = (m_leafTess << level) >> lod;
+		unsigned int tess = edgeTess;
+		if (view.maxHeightError > 0)
+		{
+			const float roughness = m_levels[level][row * _GetLevelDim(level) + col].roughness;
+			const float dist = std::max(sqrtf(DistanceSqToBox(view.camPos, vMin, vMax)), 1e-3f);
+			const float pixelsPerHeight = view.pixelsPerUnit / dist;
+
+			while (tess > MIN_TESS)
+			{
+				const float spacing = node.size / (tess >> 1);
+				if(roughness * spacing * spacing * 0.25f * pixelsPerHeight > view.maxHeightError)
+					break;
+
+				tess >>= 1;
+			}
+		}
+		node.tessFactor = (float)tess;
+		node.edgeTessFactor = (float)edgeTess;
+
+		const float rangeEnd = ctx.ranges[lod];
+		if (rangeEnd == FLT_MAX)
+		{
+			node.morphStart = FLT_MAX;
+			node.morphScale = 0;
+		}
+		else
+		{
+			const float rangeStart = lod > 0 ? ctx.ranges[lod - 1] : 0;
+			node.morphStart = rangeStart + (rangeEnd - rangeStart) * MORPH_START_RATIO;
+			node.morphScale = 1.0f / (rangeEnd - node.morphStart);
+		}
+
+		ctx.pNodes->push_back(node);
+	}
+}
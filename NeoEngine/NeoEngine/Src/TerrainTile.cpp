@@ -0,0 +1,312 @@
+#include "TerrainTile.h"
+#include "ParallelFor.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace Neo
+{
+	static const unsigned int	TILE_SET_MAGIC		=	0x5354544E;		// "NTTS"
+	static const unsigned int	TILE_SET_VERSION	=	1;
+	static const unsigned int	HEADER_FIELDS		=	11;
+	static const unsigned int	ENTRY_FIELDS		=	4;
+	static const float			QUANT_MAX			=	65535.0f;
+
+	namespace
+	{
+		// Files are little endian, like every platform the engine and tools run on
+		inline void PutU32(std::vector<unsigned char>& out, unsigned int v)
+		{
+			unsigned char bytes[4];
+			memcpy(bytes, &v, 4);
+			out.insert(out.end(), bytes, bytes + 4);
+		}
+
+		inline void PutF32(std::vector<unsigned char>& out, float v)
+		{
+			unsigned int bits;
+			memcpy(&bits, &v, 4);
+			PutU32(out, bits);
+		}
+
+		inline unsigned int GetU32(const unsigned char* p)
+		{
+			unsigned int v;
+			memcpy(&v, p, 4);
+			return v;
+		}
+
+		inline float GetF32(const unsigned char* p)
+		{
+			float v;
+			memcpy(&v, p, 4);
+			return v;
+		}
+
+		inline int Predict(const int* pRow, const int* pPrevRow, unsigned int c)
+		{
+			if(!pPrevRow)
+				return c > 0 ? pRow[c - 1] : 0;
+			if(c == 0)
+				return pPrevRow[0];
+
+			return pRow[c - 1] + pPrevRow[c] - pPrevRow[c - 1];
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	void TerrainTileCodec::Encode( const float* pHeights, unsigned int samples, float minY, float maxY, std::vector<unsigned char>& out )
+	{
+		const float scale = maxY > minY ? QUANT_MAX / (maxY - minY) : 0;
+
+		std::vector<int> rows(samples * 2);
+		int* pRow = &rows[0];
+		int* pPrevRow = nullptr;
+
+		for (unsigned int r=0; r<samples; ++r)
+		{
+			for (unsigned int c=0; c<samples; ++c)
+			{
+				const float q = (pHeights[r * samples + c] - minY) * scale + 0.5f;
+				pRow[c] = (int)std::min(std::max(q, 0.0f), QUANT_MAX);
+
+				// Zigzag, then 7 bits per byte with the high bit flagging more
+				const int residual = pRow[c] - Predict(pRow, pPrevRow, c);
+				unsigned int v = ((unsigned int)residual << 1) ^ (unsigned int)(residual >> 31);
+				while (v >= 0x80)
+				{
+					out.push_back((unsigned char)(v | 0x80));
+					v >>= 7;
+				}
+				out.push_back((unsigned char)v);
+			}
+
+			pPrevRow = pRow;
+			pRow = &rows[(r + 1) % 2 * samples];
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainTileCodec::Decode( const unsigned char* pData, unsigned int size, unsigned int samples, float minY, float maxY, float* pHeights )
+	{
+		const float scale = (maxY - minY) / QUANT_MAX;
+		const unsigned char* pEnd = pData + size;
+
+		std::vector<int> rows(samples * 2);
+		int* pRow = &rows[0];
+		int* pPrevRow = nullptr;
+
+		for (unsigned int r=0; r<samples; ++r)
+		{
+			for (unsigned int c=0; c<samples; ++c)
+			{
+				unsigned int v = 0;
+				for (unsigned int shift=0; ; shift+=7)
+				{
+					if(pData == pEnd || shift > 28)
+						return false;
+
+					const unsigned char b = *pData++;
+					v |= (unsigned int)(b & 0x7F) << shift;
+					if(!(b & 0x80))
+						break;
+				}
+
+				const int residual = (int)(v >> 1) ^ -(int)(v & 1);
+				pRow[c] = Predict(pRow, pPrevRow, c) + residual;
+				pHeights[r * samples + c] = minY + pRow[c] * scale;
+			}
+
+			pPrevRow = pRow;
+			pRow = &rows[(r + 1) % 2 * samples];
+		}
+
+		return pData == pEnd;
+	}
+	//------------------------------------------------------------------------------------
+	bool BuildTerrainTileSet( const std::string& filename, const float* pHeights, unsigned int width, unsigned int height,
+		float cellSpace, unsigned int tileCells, unsigned int mipCount )
+	{
+		assert(width > 1 && height > 1);
+		assert(tileCells > 0 && (tileCells & (tileCells - 1)) == 0);
+		assert(mipCount > 0 && (tileCells >> (mipCount - 1)) > 0);
+
+		STerrainTileSetDesc desc;
+		desc.tilesX = (width - 1 + tileCells - 1) / tileCells;
+		desc.tilesZ = (height - 1 + tileCells - 1) / tileCells;
+		desc.tileCells = tileCells;
+		desc.mipCount = mipCount;
+		desc.cellSpace = cellSpace;
+		// Centered on the origin like Terrain
+		desc.originX = -0.5f * (width - 1) * cellSpace;
+		desc.originZ = -0.5f * (height - 1) * cellSpace;
+
+		const unsigned int count = width * height;
+		desc.minY = *std::min_element(pHeights, pHeights + count);
+		desc.maxY = *std::max_element(pHeights, pHeights + count);
+
+		const unsigned int numTiles = desc.tilesX * desc.tilesZ;
+		std::vector<std::vector<unsigned char>> blobs(numTiles * mipCount);
+		std::vector<STerrainTileMip> table(numTiles * mipCount);
+
+		ParallelFor(numTiles, [&](unsigned int tile)
+		{
+			const unsigned int tileX = tile % desc.tilesX;
+			const unsigned int tileZ = tile / desc.tilesX;
+			std::vector<float> samples;
+
+			for (unsigned int mip=0; mip<mipCount; ++mip)
+			{
+				const unsigned int n = desc.GetSamples(mip);
+				const unsigned int step = 1 << mip;
+				samples.resize(n * n);
+
+				// Past the map the border samples repeat
+				for (unsigned int r=0; r<n; ++r)
+				{
+					const unsigned int row = std::min(tileZ * tileCells + r * step, height - 1);
+					for (unsigned int c=0; c<n; ++c)
+					{
+						const unsigned int col = std::min(tileX * tileCells + c * step, width - 1);
+						samples[r * n + c] = pHeights[row * width + col];
+					}
+				}
+
+				const unsigned int i = tile * mipCount + mip;
+				TerrainTileCodec::Encode(&samples[0], n, desc.minY, desc.maxY, blobs[i]);
+
+				// Bounds of what decodes, so they hold for the quantized heights too
+				TerrainTileCodec::Decode(&blobs[i][0], blobs[i].size(), n, desc.minY, desc.maxY, &samples[0]);
+				table[i].minY = *std::min_element(samples.begin(), samples.end());
+				table[i].maxY = *std::max_element(samples.begin(), samples.end());
+			}
+		});
+
+		std::vector<unsigned char> header;
+		PutU32(header, TILE_SET_MAGIC);
+		PutU32(header, TILE_SET_VERSION);
+		PutU32(header, desc.tilesX);
+		PutU32(header, desc.tilesZ);
+		PutU32(header, desc.tileCells);
+		PutU32(header, desc.mipCount);
+		PutF32(header, desc.cellSpace);
+		PutF32(header, desc.originX);
+		PutF32(header, desc.originZ);
+		PutF32(header, desc.minY);
+		PutF32(header, desc.maxY);
+
+		unsigned int offset = (HEADER_FIELDS + table.size() * ENTRY_FIELDS) * 4;
+		for (size_t i=0; i<table.size(); ++i)
+		{
+			table[i].offset = offset;
+			table[i].size = blobs[i].size();
+			offset += table[i].size;
+
+			PutU32(header, table[i].offset);
+			PutU32(header, table[i].size);
+			PutF32(header, table[i].minY);
+			PutF32(header, table[i].maxY);
+		}
+
+		std::ofstream file(filename.c_str(), std::ios_base::binary);
+		if(!file)
+			return false;
+
+		file.write((const char*)&header[0], header.size());
+		for (size_t i=0; i<blobs.size(); ++i)
+		{
+			if(!blobs[i].empty())
+				file.write((const char*)&blobs[i][0], blobs[i].size());
+		}
+
+		return file.good();
+	}
+	//------------------------------------------------------------------------------------
+	TerrainTileFile::TerrainTileFile()
+	{
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainTileFile::Open( const std::string& filename )
+	{
+		Close();
+
+		m_file.open(filename.c_str(), std::ios_base::binary);
+		if(!m_file)
+			return false;
+
+		unsigned char header[HEADER_FIELDS * 4];
+		if (!m_file.read((char*)header, sizeof(header)) ||
+			GetU32(header) != TILE_SET_MAGIC || GetU32(header + 4) != TILE_SET_VERSION)
+		{
+			Close();
+			return false;
+		}
+
+		m_desc.tilesX = GetU32(header + 8);
+		m_desc.tilesZ = GetU32(header + 12);
+		m_desc.tileCells = GetU32(header + 16);
+		m_desc.mipCount = GetU32(header + 20);
+		m_desc.cellSpace = GetF32(header + 24);
+		m_desc.originX = GetF32(header + 28);
+		m_desc.originZ = GetF32(header + 32);
+		m_desc.minY = GetF32(header + 36);
+		m_desc.maxY = GetF32(header + 40);
+
+		const unsigned int numEntries = m_desc.tilesX * m_desc.tilesZ * m_desc.mipCount;
+		std::vector<unsigned char> table(numEntries * ENTRY_FIELDS * 4);
+		if (table.empty() || !m_file.read((char*)&table[0], table.size()))
+		{
+			Close();
+			return false;
+		}
+
+		m_table.resize(numEntries);
+		for (unsigned int i=0; i<numEntries; ++i)
+		{
+			const unsigned char* p = &table[i * ENTRY_FIELDS * 4];
+			m_table[i].offset = GetU32(p);
+			m_table[i].size = GetU32(p + 4);
+			m_table[i].minY = GetF32(p + 8);
+			m_table[i].maxY = GetF32(p + 12);
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileFile::Close()
+	{
+		if(m_file.is_open())
+			m_file.close();
+		m_file.clear();
+
+		m_desc = STerrainTileSetDesc();
+		m_table.clear();
+	}
+	//------------------------------------------------------------------------------------
+	const STerrainTileMip& TerrainTileFile::GetMipEntry( unsigned int tileX, unsigned int tileZ, unsigned int mip ) const
+	{
+		assert(tileX < m_desc.tilesX && tileZ < m_desc.tilesZ && mip < m_desc.mipCount);
+		return m_table[(tileZ * m_desc.tilesX + tileX) * m_desc.mipCount + mip];
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainTileFile::ReadTile( unsigned int tileX, unsigned int tileZ, unsigned int mip, STerrainTileData& tile )
+	{
+		const STerrainTileMip& entry = GetMipEntry(tileX, tileZ, mip);
+
+		m_readBuf.resize(std::max(entry.size, 1u));
+		m_file.clear();
+		m_file.seekg(entry.offset);
+		if(!m_file.read((char*)&m_readBuf[0], entry.size))
+			return false;
+
+		tile.tileX = tileX;
+		tile.tileZ = tileZ;
+		tile.mip = mip;
+		tile.samples = m_desc.GetSamples(mip);
+		tile.minY = entry.minY;
+		tile.maxY = entry.maxY;
+		tile.heights.resize(tile.samples * tile.samples);
+
+		return TerrainTileCodec::Decode(&m_readBuf[0], entry.size, tile.samples, m_desc.minY, m_desc.maxY, &tile.heights[0]);
+	}
+}
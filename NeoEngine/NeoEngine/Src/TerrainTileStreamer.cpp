@@ -0,0 +1,556 @@
+#include "TerrainTileStreamer.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+namespace Neo
+{
+	static const unsigned int	NOT_WANTED		=	0xFFFFFFFF;
+	static const unsigned int	NO_NEIGHBOUR	=	0xFFFFFFFF;
+
+	namespace
+	{
+		struct SRequest
+		{
+			unsigned int	tileX, tileZ, mip;
+			float			priority;		// Lower is more urgent
+
+			// Most urgent last, the worker pops from the back
+			bool operator< (const SRequest& rhs) const { return priority > rhs.priority; }
+
+			bool IsFor(const STerrainTileData& data) const { return tileX == data.tileX && tileZ == data.tileZ && mip == data.mip; }
+		};
+	}
+
+	// Loading thread and what it shares with the main thread
+	struct TerrainTileStreamer::SWorker
+	{
+#ifdef _WIN32
+		CRITICAL_SECTION	lock;
+		HANDLE				hWake;
+		HANDLE				hThread;
+#else
+		pthread_mutex_t		lock;
+		pthread_cond_t		wake;
+		pthread_t			thread;
+#endif
+		TerrainTileFile		file;			// Only touched by the loading thread after Open
+		// Guarded by lock
+		std::vector<SRequest>			queue;
+		std::vector<STerrainTileData*>	done;	// Null heights on read failure
+		SRequest			current;		// Being loaded while bBusy
+		bool				bBusy;
+		bool				bQuit;
+
+		void	Lock()
+		{
+#ifdef _WIN32
+			EnterCriticalSection(&lock);
+#else
+			pthread_mutex_lock(&lock);
+#endif
+		}
+
+		void	Unlock()
+		{
+#ifdef _WIN32
+			LeaveCriticalSection(&lock);
+#else
+			pthread_mutex_unlock(&lock);
+#endif
+		}
+
+		void	Wake()
+		{
+#ifdef _WIN32
+			SetEvent(hWake);
+#else
+			pthread_mutex_lock(&lock);
+			pthread_cond_signal(&wake);
+			pthread_mutex_unlock(&lock);
+#endif
+		}
+
+		// Called with the lock held, returns with it held
+		void	Wait()
+		{
+#ifdef _WIN32
+			LeaveCriticalSection(&lock);
+			WaitForSingleObject(hWake, INFINITE);
+			EnterCriticalSection(&lock);
+#else
+			pthread_cond_wait(&wake, &lock);
+#endif
+		}
+
+		void	Run()
+		{
+			Lock();
+			while (!bQuit)
+			{
+				if (queue.empty())
+				{
+					bBusy = false;
+					Wait();
+					continue;
+				}
+
+				const SRequest req = queue.back();
+				queue.pop_back();
+				current = req;
+				bBusy = true;
+				Unlock();
+
+				STerrainTileData* pData = new STerrainTileData;
+				if (!file.ReadTile(req.tileX, req.tileZ, req.mip, *pData))
+				{
+					pData->tileX = req.tileX;
+					pData->tileZ = req.tileZ;
+					pData->mip = req.mip;
+					pData->heights.clear();
+				}
+
+				Lock();
+				done.push_back(pData);
+			}
+			bBusy = false;
+			Unlock();
+		}
+
+#ifdef _WIN32
+		static DWORD WINAPI ThreadProc(LPVOID pParam)
+		{
+			((SWorker*)pParam)->Run();
+			return 0;
+		}
+#else
+		static void* ThreadProc(void* pParam)
+		{
+			((SWorker*)pParam)->Run();
+			return nullptr;
+		}
+#endif
+	};
+
+	//------------------------------------------------------------------------------------
+	TerrainTileStreamer::TerrainTileStreamer()
+	:m_pWorker(nullptr)
+	,m_frame(0)
+	,m_residentBytes(0)
+	,m_residentCount(0)
+	,m_pendingCount(0)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	TerrainTileStreamer::~TerrainTileStreamer()
+	{
+		Close();
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainTileStreamer::Open( const std::string& filename, const STerrainStreamSettings& settings )
+	{
+		Close();
+
+		SWorker* pWorker = new SWorker;
+		if (!pWorker->file.Open(filename))
+		{
+			delete pWorker;
+			return false;
+		}
+
+		m_desc = pWorker->file.GetDesc();
+		m_settings = settings;
+
+		const unsigned int numTiles = m_desc.tilesX * m_desc.tilesZ;
+		m_tiles.assign(numTiles, nullptr);
+		m_wantedMip.assign(numTiles, NOT_WANTED);
+		m_failed.assign(numTiles, false);
+		m_frame = 0;
+
+		pWorker->bBusy = false;
+		pWorker->bQuit = false;
+
+#ifdef _WIN32
+		InitializeCriticalSection(&pWorker->lock);
+		pWorker->hWake = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		pWorker->hThread = CreateThread(nullptr, 0, SWorker::ThreadProc, pWorker, 0, nullptr);
+		// Loading shouldn't take time from the render thread
+		SetThreadPriority(pWorker->hThread, THREAD_PRIORITY_BELOW_NORMAL);
+#else
+		pthread_mutex_init(&pWorker->lock, nullptr);
+		pthread_cond_init(&pWorker->wake, nullptr);
+		pthread_create(&pWorker->thread, nullptr, SWorker::ThreadProc, pWorker);
+#endif
+
+		m_pWorker = pWorker;
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::Close()
+	{
+		if(!m_pWorker)
+			return;
+
+		m_pWorker->Lock();
+		m_pWorker->bQuit = true;
+		m_pWorker->Unlock();
+		m_pWorker->Wake();
+
+#ifdef _WIN32
+		WaitForSingleObject(m_pWorker->hThread, INFINITE);
+		CloseHandle(m_pWorker->hThread);
+		CloseHandle(m_pWorker->hWake);
+		DeleteCriticalSection(&m_pWorker->lock);
+#else
+		pthread_join(m_pWorker->thread, nullptr);
+		pthread_cond_destroy(&m_pWorker->wake);
+		pthread_mutex_destroy(&m_pWorker->lock);
+#endif
+
+		for (size_t i=0; i<m_pWorker->done.size(); ++i)
+			delete m_pWorker->done[i];
+
+		delete m_pWorker;
+		m_pWorker = nullptr;
+
+		for (size_t i=0; i<m_tiles.size(); ++i)
+			delete m_tiles[i];
+
+		m_tiles.clear();
+		m_wantedMip.clear();
+		m_failed.clear();
+		m_residentBytes = 0;
+		m_residentCount = 0;
+		m_pendingCount = 0;
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int TerrainTileStreamer::CalcWantedMip( float distance ) const
+	{
+		unsigned int mip = 0;
+		for (float d=m_settings.lodDistance; distance > d && mip + 1 < m_desc.mipCount; d*=2)
+			++mip;
+
+		return mip;
+	}
+	//------------------------------------------------------------------------------------
+	float TerrainTileStreamer::_DistanceToTile( float camX, float camZ, unsigned int tileX, unsigned int tileZ ) const
+	{
+		const float size = m_desc.GetTileSize();
+		const float x0 = m_desc.originX + tileX * size;
+		const float z0 = m_desc.originZ + tileZ * size;
+
+		const float dx = std::max(std::max(x0 - camX, camX - x0 - size), 0.0f);
+		const float dz = std::max(std::max(z0 - camZ, camZ - z0 - size), 0.0f);
+
+		return sqrtf(dx * dx + dz * dz);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::Update( float camX, float camZ )
+	{
+		if(!m_pWorker)
+			return;
+
+		++m_frame;
+
+		// Install first, or tiles loaded since the last frame would be asked for again
+		std::vector<STerrainTileData*> done;
+		m_pWorker->Lock();
+		done.swap(m_pWorker->done);
+		m_pWorker->Unlock();
+
+		for (size_t i=0; i<done.size(); ++i)
+			_Install(done[i]);
+
+		// Tiles in range, and what they need loaded
+		const float size = m_desc.GetTileSize();
+		const float radius = m_settings.loadRadius;
+		const int x0 = std::max((int)floorf((camX - radius - m_desc.originX) / size), 0);
+		const int z0 = std::max((int)floorf((camZ - radius - m_desc.originZ) / size), 0);
+		const int x1 = std::min((int)floorf((camX + radius - m_desc.originX) / size), (int)m_desc.tilesX - 1);
+		const int z1 = std::min((int)floorf((camZ + radius - m_desc.originZ) / size), (int)m_desc.tilesZ - 1);
+
+		std::fill(m_wantedMip.begin(), m_wantedMip.end(), NOT_WANTED);
+
+		std::vector<SRequest> requests;
+		for (int z=z0; z<=z1; ++z)
+		{
+			for (int x=x0; x<=x1; ++x)
+			{
+				const float dist = _DistanceToTile(camX, camZ, x, z);
+				if(dist > radius)
+					continue;
+
+				const unsigned int index = z * m_desc.tilesX + x;
+				const unsigned int mip = CalcWantedMip(dist);
+				m_wantedMip[index] = mip;
+
+				STerrainResidentTile* pTile = m_tiles[index];
+				if(pTile)
+					pTile->lastWanted = m_frame;
+
+				if(m_failed[index] || (pTile && pTile->data.mip == mip))
+					continue;
+
+				// Holes first, refinements after them
+				SRequest req;
+				req.tileX = x;
+				req.tileZ = z;
+				req.mip = mip;
+				req.priority = dist + (pTile ? radius : 0);
+				requests.push_back(req);
+			}
+		}
+
+		std::sort(requests.begin(), requests.end());
+
+		m_pWorker->Lock();
+		{
+			// Skip what is being loaded or finished since the install above, the rest replaces the old queue
+			SWorker& w = *m_pWorker;
+			requests.erase(std::remove_if(requests.begin(), requests.end(), [&w](const SRequest& req)
+			{
+				if(w.bBusy && req.tileX == w.current.tileX && req.tileZ == w.current.tileZ && req.mip == w.current.mip)
+					return true;
+
+				for (size_t i=0; i<w.done.size(); ++i)
+				{
+					if(req.IsFor(*w.done[i]))
+						return true;
+				}
+
+				return false;
+			}), requests.end());
+
+			w.queue.swap(requests);
+			m_pendingCount = w.queue.size() + w.done.size() + (w.bBusy ? 1 : 0);
+		}
+		m_pWorker->Unlock();
+
+		if(m_pendingCount > 0)
+			m_pWorker->Wake();
+
+		_EvictOverBudget();
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::Flush( float camX, float camZ )
+	{
+		for (;;)
+		{
+			Update(camX, camZ);
+
+			bool bDone = m_pendingCount == 0;
+			for (size_t i=0; bDone && i<m_tiles.size(); ++i)
+			{
+				if(m_wantedMip[i] != NOT_WANTED && !m_failed[i] && (!m_tiles[i] || m_tiles[i]->data.mip != m_wantedMip[i]))
+					bDone = false;
+			}
+
+			if(bDone)
+				break;
+
+#ifdef _WIN32
+			Sleep(1);
+#else
+			usleep(1000);
+#endif
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::_Install( STerrainTileData* pData )
+	{
+		const unsigned int index = pData->tileZ * m_desc.tilesX + pData->tileX;
+
+		if (pData->heights.empty())
+		{
+			m_failed[index] = true;
+			delete pData;
+			return;
+		}
+
+		// A stale load may arrive after the camera moved on, keep whichever mip is closer to what is wanted
+		STerrainResidentTile* pOld = m_tiles[index];
+		if (pOld)
+		{
+			const unsigned int wanted = m_wantedMip[index] == NOT_WANTED ? pOld->data.mip : m_wantedMip[index];
+			if (abs((int)pData->mip - (int)wanted) >= abs((int)pOld->data.mip - (int)wanted))
+			{
+				delete pData;
+				return;
+			}
+
+			_Evict(index);
+		}
+
+		STerrainResidentTile* pTile = new STerrainResidentTile;
+		pTile->data.tileX = pData->tileX;
+		pTile->data.tileZ = pData->tileZ;
+		pTile->data.mip = pData->mip;
+		pTile->data.samples = pData->samples;
+		pTile->data.minY = pData->minY;
+		pTile->data.maxY = pData->maxY;
+		pTile->data.heights.swap(pData->heights);
+		pTile->lastWanted = m_wantedMip[index] == NOT_WANTED ? 0 : m_frame;
+		delete pData;
+
+		const unsigned int n = pTile->data.samples;
+		const float* pHeights = &pTile->data.heights[0];
+		for (unsigned int e=0; e<eTerrainTileEdge_Count; ++e)
+		{
+			pTile->stitchMip[e] = NO_NEIGHBOUR;
+			pTile->edges[e].resize(n);
+		}
+		for (unsigned int i=0; i<n; ++i)
+		{
+			pTile->edges[eTerrainTileEdge_MinZ][i] = pHeights[i];
+			pTile->edges[eTerrainTileEdge_MaxX][i] = pHeights[i * n + n - 1];
+			pTile->edges[eTerrainTileEdge_MaxZ][i] = pHeights[(n - 1) * n + i];
+			pTile->edges[eTerrainTileEdge_MinX][i] = pHeights[i * n];
+		}
+
+		pTile->bytes = sizeof(STerrainResidentTile) + (n * n + eTerrainTileEdge_Count * n) * sizeof(float);
+		m_residentBytes += pTile->bytes;
+		++m_residentCount;
+		m_tiles[index] = pTile;
+
+		// The tile and its neighbours see a new mip across their shared edges
+		const unsigned int x = pTile->data.tileX, z = pTile->data.tileZ;
+		_Stitch(x, z);
+		if(z > 0)					_Stitch(x, z - 1);
+		if(x + 1 < m_desc.tilesX)	_Stitch(x + 1, z);
+		if(z + 1 < m_desc.tilesZ)	_Stitch(x, z + 1);
+		if(x > 0)					_Stitch(x - 1, z);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::_Evict( unsigned int index )
+	{
+		STerrainResidentTile* pTile = m_tiles[index];
+		assert(pTile);
+
+		m_residentBytes -= pTile->bytes;
+		--m_residentCount;
+		m_tiles[index] = nullptr;
+
+		const unsigned int x = pTile->data.tileX, z = pTile->data.tileZ;
+		delete pTile;
+
+		// Neighbours stitched against it go back to their own edges
+		if(z > 0)					_Stitch(x, z - 1);
+		if(x + 1 < m_desc.tilesX)	_Stitch(x + 1, z);
+		if(z + 1 < m_desc.tilesZ)	_Stitch(x, z + 1);
+		if(x > 0)					_Stitch(x - 1, z);
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::_Stitch( unsigned int tileX, unsigned int tileZ )
+	{
+		STerrainResidentTile* pTile = m_tiles[tileZ * m_desc.tilesX + tileX];
+		if(!pTile)
+			return;
+
+		const STerrainResidentTile* neighbours[eTerrainTileEdge_Count] =
+		{
+			tileZ > 0 ? m_tiles[(tileZ - 1) * m_desc.tilesX + tileX] : nullptr,
+			tileX + 1 < m_desc.tilesX ? m_tiles[tileZ * m_desc.tilesX + tileX + 1] : nullptr,
+			tileZ + 1 < m_desc.tilesZ ? m_tiles[(tileZ + 1) * m_desc.tilesX + tileX] : nullptr,
+			tileX > 0 ? m_tiles[tileZ * m_desc.tilesX + tileX - 1] : nullptr
+		};
+
+		const unsigned int n = pTile->data.samples;
+		float* pHeights = &pTile->data.heights[0];
+
+		for (unsigned int e=0; e<eTerrainTileEdge_Count; ++e)
+		{
+			const unsigned int neighbourMip = neighbours[e] ? neighbours[e]->data.mip : NO_NEIGHBOUR;
+			if(neighbourMip == pTile->stitchMip[e])
+				continue;
+
+			pTile->stitchMip[e] = neighbourMip;
+
+			// Start over from the decoded edge, shared samples are the same in both tiles.
+			// Against a coarser neighbour, the samples it lacks go onto the line between its samples.
+			const std::vector<float>& edge = pTile->edges[e];
+			const unsigned int step = neighbourMip != NO_NEIGHBOUR && neighbourMip > pTile->data.mip ?
+				1 << (neighbourMip - pTile->data.mip) : 1;
+
+			for (unsigned int i=0; i<n; ++i)
+			{
+				const unsigned int i0 = i - i % step;
+				const float h = i0 == i ? edge[i] : edge[i0] + (edge[i0 + step] - edge[i0]) * (i - i0) / step;
+
+				switch (e)
+				{
+				case eTerrainTileEdge_MinZ: pHeights[i] = h; break;
+				case eTerrainTileEdge_MaxX: pHeights[i * n + n - 1] = h; break;
+				case eTerrainTileEdge_MaxZ: pHeights[(n - 1) * n + i] = h; break;
+				case eTerrainTileEdge_MinX: pHeights[i * n] = h; break;
+				}
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TerrainTileStreamer::_EvictOverBudget()
+	{
+		if(m_residentBytes <= m_settings.budgetBytes)
+			return;
+
+		// Least recently wanted first, never what is wanted this frame
+		std::vector<std::pair<unsigned int, unsigned int>> candidates;
+		for (unsigned int i=0; i<m_tiles.size(); ++i)
+		{
+			if(m_tiles[i] && m_tiles[i]->lastWanted != m_frame)
+				candidates.push_back(std::make_pair(m_tiles[i]->lastWanted, i));
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+
+		for (size_t i=0; i<candidates.size() && m_residentBytes > m_settings.budgetBytes; ++i)
+			_Evict(candidates[i].second);
+	}
+	//------------------------------------------------------------------------------------
+	const STerrainResidentTile* TerrainTileStreamer::GetTile( unsigned int tileX, unsigned int tileZ ) const
+	{
+		assert(tileX < m_desc.tilesX && tileZ < m_desc.tilesZ);
+		return m_tiles[tileZ * m_desc.tilesX + tileX];
+	}
+	//------------------------------------------------------------------------------------
+	bool TerrainTileStreamer::GetHeightAt( float x, float z, float& height ) const
+	{
+		if(m_tiles.empty())
+			return false;
+
+		const float size = m_desc.GetTileSize();
+		const float fx = (x - m_desc.originX) / size;
+		const float fz = (z - m_desc.originZ) / size;
+		if(fx < 0 || fz < 0 || fx >= m_desc.tilesX || fz >= m_desc.tilesZ)
+			return false;
+
+		const unsigned int tileX = (unsigned int)fx, tileZ = (unsigned int)fz;
+		const STerrainResidentTile* pTile = m_tiles[tileZ * m_desc.tilesX + tileX];
+		if(!pTile)
+			return false;
+
+		const unsigned int cells = pTile->data.samples - 1;
+		const float gx = (fx - tileX) * cells;
+		const float gz = (fz - tileZ) * cells;
+		const unsigned int c = std::min((unsigned int)gx, cells - 1);
+		const unsigned int r = std::min((unsigned int)gz, cells - 1);
+		const float tx = gx - c, tz = gz - r;
+
+		const float* pRow0 = &pTile->data.heights[r * (cells + 1) + c];
+		const float* pRow1 = pRow0 + cells + 1;
+		const float h0 = pRow0[0] + (pRow0[1] - pRow0[0]) * tx;
+		const float h1 = pRow1[0] + (pRow1[1] - pRow1[0]) * tx;
+		height = h0 + (h1 - h0) * tz;
+
+		return true;
+	}
+}
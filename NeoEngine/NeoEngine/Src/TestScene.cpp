@@ -4,6 +4,7 @@
 #include "Material.h"
 #include "D3D11RenderSystem.h"
 #include "D3D11Texture.h"
+#include "TextureManager.h"
 #include "SceneManager.h"
 #include "SSAO.h"
 #include "Entity.h"
@@ -12,11 +13,10 @@
 using namespace Neo;
 
 
-#define ADD_TEST_SCENE($setupFunc, $enterFunc)						\
+#define ADD_TEST_SCENE($name)										\
 {																	\
-	Scene::StrategyFunc setupFunc = $setupFunc;						\
-	Scene::StrategyFunc enterFunc = $enterFunc;						\
-	Scene* pScene = new Scene(setupFunc, enterFunc);				\
+	Scene* pScene = _CreateTestScene($name);						\
+	assert(pScene);													\
 	m_scenes.push_back(pScene);										\
 }
 
@@ -29,7 +29,7 @@ void SetupTestScene1(Scene* scene)
 
 	Neo::Material* pMaterial = new Material;
 
-	pMaterial->SetTexture(0, new D3D11Texture(GetResPath("White1x1.png")));
+	pMaterial->SetTexture(0, g_env.pRenderSystem->GetTextureManager()->Load(GetResPath("White1x1.png")));
 	pMaterial->InitShader(GetResPath("Opaque.hlsl"), GetResPath("Opaque.hlsl"), eShaderFlag_EnableSSAO);
 
 	pEntity->SetMaterial(0, pMaterial);
@@ -51,7 +51,7 @@ void EnterTestScene1(Scene* scene)
 void SetupTestScene2(Scene* scene)
 {
 	Neo::Material* pMaterial = new Neo::Material;
-	pMaterial->SetTexture(0, new Neo::D3D11Texture(GetResPath("lion.bmp")));
+	pMaterial->SetTexture(0, g_env.pRenderSystem->GetTextureManager()->Load(GetResPath("lion.bmp")));
 	pMaterial->InitShader(GetResPath("Opaque.hlsl"), GetResPath("Opaque.hlsl"), eShaderFlag_EnableClipPlane);
 
 	/// Create a cube to observe reflection
@@ -75,10 +75,16 @@ void SetupTestScene2(Scene* scene)
 
 		scene->AddEntity(pEntity);
 
-		pEntity->SetMaterial(0, pMaterial);
+		// Shares the cube's shaders and samplers, only the tint differs
+		Neo::MaterialInstance* pInstance = new Neo::MaterialInstance(pMaterial);
+		pInstance->SetDiffuse(SColor(1.0f, 0.8f, 0.6f));
+
+		pEntity->SetMaterialInstance(0, pInstance);
 		pEntity->SetCastShadow(false);
 		pEntity->SetReceiveShadow(false);
 		pEntity->SetPosition(VEC3(2000, 0, 0));
+
+		pInstance->Release();
 	}
 
 	pMaterial->Release();
@@ -108,6 +114,7 @@ void EnterTestScene3(Scene* scene)
 {
 	g_env.pSceneMgr->CreateSky();
 	g_env.pSceneMgr->CreateTerrain();
+	g_env.pSceneMgr->CreateGrass();
 	g_env.pSceneMgr->CreateWater(5.0f);
 
 	Neo::Camera* pCamera = g_env.pSceneMgr->GetCamera();
@@ -131,7 +138,7 @@ void SetupTestScene4(Scene* scene)
 	pEntity->SetCastShadow(false);
 
 	Neo::Material* pMaterial = new Neo::Material;
-	pMaterial->SetTexture(0, new Neo::D3D11Texture(GetResPath("White1x1.png")));
+	pMaterial->SetTexture(0, g_env.pRenderSystem->GetTextureManager()->Load(GetResPath("White1x1.png")));
 	pMaterial->InitShader(GetResPath("Opaque.hlsl"), GetResPath("Opaque.hlsl"), eShaderFlag_EnableShadowReceive);
 	pEntity->SetMaterial(0, pMaterial);
 	pMaterial->Release();
@@ -143,7 +150,7 @@ void SetupTestScene4(Scene* scene)
 	scene->AddEntity(pCaster);
 
 	pMaterial = new Neo::Material;
-	pMaterial->SetTexture(0, new Neo::D3D11Texture(GetResPath("White1x1.png")));
+	pMaterial->SetTexture(0, g_env.pRenderSystem->GetTextureManager()->Load(GetResPath("White1x1.png")));
 	pMaterial->InitShader(GetResPath("Opaque.hlsl"), GetResPath("Opaque.hlsl"));
 
 	pCaster->SetMaterial(0, pMaterial);
@@ -183,24 +190,57 @@ void EnterTestScene5(Scene* scene)
 	g_env.pSceneMgr->SetRenderFlag(eRenderPhase_All & ~eRenderPhase_SSAO & ~eRenderPhase_ShadowMap);
 }
 
+struct STestSceneDesc
+{
+	const char*		name;
+	void			(*setupFunc)(Scene*);
+	void			(*enterFunc)(Scene*);
+};
+
+// Names are used by the benchmark mode to pick a scene
+static const STestSceneDesc TEST_SCENES[] =
+{
+	{ "Mesh",		SetupTestScene1, EnterTestScene1 },		// mesh, SSAO post effect
+	{ "Water",		SetupTestScene2, EnterTestScene2 },		// Sky, Water
+	{ "Terrain",	SetupTestScene3, EnterTestScene3 },		// Terrain
+	{ "Shadow",		SetupTestScene4, EnterTestScene4 },		// Shadow testing
+	{ "Vegetation",	SetupTestScene5, EnterTestScene5 },		// Vegetation
+};
+
 namespace Neo
 {
 	void SceneManager::_InitAllScene()
 	{
 		//// Test Scene 1: mesh, SSAO post effect
-//		ADD_TEST_SCENE(SetupTestScene1, EnterTestScene1);
+//		ADD_TEST_SCENE("Mesh");
 // 
 // 		//// Test Scene 2: Sky, Water
-// 		ADD_TEST_SCENE(SetupTestScene2, EnterTestScene2);
+// 		ADD_TEST_SCENE("Water");
 // 
 // 		//// Test Scene 3: Terrain
-// 		ADD_TEST_SCENE(SetupTestScene3, EnterTestScene3);
+// 		ADD_TEST_SCENE("Terrain");
 // 
 // 		//// Test Scene 4: Shadow testing
-// 		ADD_TEST_SCENE(SetupTestScene4, EnterTestScene4);
+// 		ADD_TEST_SCENE("Shadow");
 
 		//// Test Scene 5: Vegetation
-		ADD_TEST_SCENE(SetupTestScene5, EnterTestScene5);
+		ADD_TEST_SCENE("Vegetation");
+	}
+	//------------------------------------------------------------------------------------
+	Scene* SceneManager::_CreateTestScene( const STRING& name )
+	{
+		for (int i=0; i<ARRAYSIZE(TEST_SCENES); ++i)
+		{
+			if (name == TEST_SCENES[i].name)
+			{
+				Scene::StrategyFunc setupFunc = TEST_SCENES[i].setupFunc;
+				Scene::StrategyFunc enterFunc = TEST_SCENES[i].enterFunc;
+
+				return new Scene(name, setupFunc, enterFunc);
+			}
+		}
+
+		return nullptr;
 	}
 }
 
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "TextureAtlas.h"
+#include "D3D11Texture.h"
+#include "D3D11RenderSystem.h"
+#include "TextureManager.h"
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	TextureAtlas::TextureAtlas( const SPackOptions& options, bool bArray )
+		:m_packer(options)
+		,m_pTexture(nullptr)
+		,m_bArray(bArray)
+	{
+	}
+	//------------------------------------------------------------------------------------
+	TextureAtlas::~TextureAtlas()
+	{
+		SAFE_RELEASE(m_pTexture);
+	}
+	//------------------------------------------------------------------------------------
+	bool TextureAtlas::AddImage( const STRING& filename )
+	{
+		ID3D11Device* pDevice = g_env.pRenderSystem->GetDevice();
+		ID3D11DeviceContext* pContext = g_env.pRenderSystem->GetDeviceContext();
+
+		// Let D3DX decode and convert to RGBA8 in a staging texture we can read back
+		D3DX11_IMAGE_LOAD_INFO loadInfo;
+		loadInfo.MipLevels = 1;
+		loadInfo.Usage = D3D11_USAGE_STAGING;
+		loadInfo.BindFlags = 0;
+		loadInfo.CpuAccessFlags = D3D11_CPU_ACCESS_READ;
+		loadInfo.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		loadInfo.Filter = D3DX11_FILTER_NONE;
+
+		ID3D11Resource* pRes = nullptr;
+		if(FAILED(D3DX11CreateTextureFromFileA(pDevice, filename.c_str(), &loadInfo, nullptr, &pRes, nullptr)))
+			return false;
+
+		ID3D11Texture2D* pTex = nullptr;
+		pRes->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&pTex);
+		SAFE_RELEASE(pRes);
+
+		if(!pTex)
+			return false;
+
+		D3D11_TEXTURE2D_DESC desc;
+		pTex->GetDesc(&desc);
+
+		bool bOk = false;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (SUCCEEDED(pContext->Map(pTex, 0, D3D11_MAP_READ, 0, &mapped)))
+		{
+			bOk = AddImage(filename, mapped.pData, desc.Width, desc.Height, mapped.RowPitch);
+			pContext->Unmap(pTex, 0);
+		}
+
+		SAFE_RELEASE(pTex);
+
+		return bOk;
+	}
+	//------------------------------------------------------------------------------------
+	bool TextureAtlas::AddImage( const STRING& name, const void* pRGBA, uint32 width, uint32 height, uint32 pitch )
+	{
+		assert(!m_pTexture && "Atlas already built!");
+
+		const STRING key = TextureManager::NormalizePath(name);
+		if(m_entries.find(key) != m_entries.end())
+			return true;
+
+		m_entries[key] = m_packer.AddImage(pRGBA, width, height, pitch);
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	const SAtlasEntry* TextureAtlas::GetEntry( const STRING& name ) const
+	{
+		auto iter = m_entries.find(TextureManager::NormalizePath(name));
+		if(iter == m_entries.end() || !m_pTexture)
+			return nullptr;
+
+		return &m_packer.GetEntry(iter->second);
+	}
+	//------------------------------------------------------------------------------------
+	bool TextureAtlas::Build()
+	{
+		if(!m_packer.Pack())
+			return false;
+
+		const uint32 nPages = m_packer.GetPageCount();
+		if(nPages == 0 || (!m_bArray && nPages > 1))
+			return false;
+
+		const SPackOptions& options = m_packer.GetOptions();
+
+		// Deeper mips would mix neighbouring images
+		const uint32 nMips = m_packer.GetSafeMipCount();
+
+		std::vector<std::vector<std::vector<unsigned char>>> pageMips(nPages);
+		std::vector<D3D11_SUBRESOURCE_DATA> subres;
+
+		for (uint32 iPage=0; iPage<nPages; ++iPage)
+		{
+			m_packer.BuildPageMips(iPage, nMips, pageMips[iPage]);
+
+			for (uint32 iMip=0; iMip<nMips; ++iMip)
+			{
+				D3D11_SUBRESOURCE_DATA data;
+				data.pSysMem = &pageMips[iPage][iMip][0];
+				data.SysMemPitch = max(options.pageWidth >> iMip, 1u) * 4;
+				data.SysMemSlicePitch = pageMips[iPage][iMip].size();
+				subres.push_back(data);
+			}
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		desc.Width				= options.pageWidth;
+		desc.Height				= options.pageHeight;
+		desc.MipLevels			= nMips;
+		desc.ArraySize			= nPages;
+		desc.Format				= DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count	= 1;
+		desc.SampleDesc.Quality	= 0;
+		desc.Usage				= D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags			= D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags		= 0;
+		desc.MiscFlags			= 0;
+
+		SAFE_RELEASE(m_pTexture);
+		m_pTexture = new D3D11Texture(desc, &subres[0], m_bArray ? eTextureType_TextureArray : eTextureType_2D);
+
+		return true;
+	}
+}
@@ -0,0 +1,909 @@
+#include "TextureCooker.h"
+#include "ParallelFor.h"
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <xmmintrin.h>
+
+namespace Neo
+{
+	namespace
+	{
+		typedef unsigned char	uint8;
+		typedef unsigned short	uint16;
+		typedef unsigned int	uint32;
+
+		const float PI = 3.14159265f;
+
+		//------------------------------------------------------------------------------------
+		// Color space
+		//------------------------------------------------------------------------------------
+		inline float SRGBToLinear(float c)
+		{
+			return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		inline float LinearToSRGB(float c)
+		{
+			return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+		}
+
+		inline uint8 FloatToByte(float c)
+		{
+			c = std::min(std::max(c, 0.0f), 1.0f);
+			return (uint8)(c * 255.0f + 0.5f);
+		}
+
+		//------------------------------------------------------------------------------------
+		// Mip filters
+		//------------------------------------------------------------------------------------
+		const float KAISER_WIDTH = 3.0f;
+		const float KAISER_ALPHA = 4.0f;
+
+		float Bessel0(float x)
+		{
+			float sum = 1.0f, term = 1.0f;
+			const float halfX = x * 0.5f;
+			for (int k=1; k<32; ++k)
+			{
+				const float t = halfX / k;
+				term *= t * t;
+				sum += term;
+				if(term < sum * 1e-8f)
+					break;
+			}
+			return sum;
+		}
+
+		inline float Sinc(float x)
+		{
+			if(fabs(x) < 1e-4f)
+				return 1.0f - x * x / 6.0f;
+			return sinf(x) / x;
+		}
+
+		// x is in destination pixel units
+		float EvalFilter(eMipFilter filter, float x)
+		{
+			if (filter == eMipFilter_Box)
+				return fabs(x) <= 0.5f ? 1.0f : 0.0f;
+
+			const float t = x / KAISER_WIDTH;
+			if(t * t >= 1.0f)
+				return 0.0f;
+
+			static const float invBesselAlpha = 1.0f / Bessel0(KAISER_ALPHA);
+			return Sinc(PI * x) * Bessel0(KAISER_ALPHA * sqrtf(1.0f - t * t)) * invBesselAlpha;
+		}
+
+		float GetFilterSupport(eMipFilter filter)
+		{
+			return filter == eMipFilter_Box ? 0.5f : KAISER_WIDTH;
+		}
+
+		// Weights of all source texels contributing to one destination texel
+		struct SFilterTaps
+		{
+			uint32				start;
+			std::vector<float>	weights;
+		};
+
+		void BuildTaps(uint32 srcSize, uint32 dstSize, eMipFilter filter, std::vector<SFilterTaps>& taps)
+		{
+			taps.resize(dstSize);
+
+			const float scale = (float)dstSize / srcSize;		// src -> dst units
+			const float radius = GetFilterSupport(filter) / scale;
+
+			for (uint32 x=0; x<dstSize; ++x)
+			{
+				SFilterTaps& tap = taps[x];
+				const float center = (x + 0.5f) / scale;
+
+				int lo = (int)floorf(center - radius);
+				int hi = (int)ceilf(center + radius);
+				const int first = std::max(lo, 0), last = std::min(hi, (int)srcSize - 1);
+
+				tap.start = first;
+				tap.weights.assign(last - first + 1, 0.0f);
+
+				// Clamp addressing, outside texels add to the border one
+				float sum = 0;
+				for (int i=lo; i<=hi; ++i)
+				{
+					const float w = EvalFilter(filter, (i + 0.5f - center) * scale);
+					const int idx = std::min(std::max(i, first), last);
+					tap.weights[idx - first] += w;
+					sum += w;
+				}
+
+				if (fabs(sum) < 1e-6f)
+				{
+					// Degenerated, take the nearest texel
+					std::fill(tap.weights.begin(), tap.weights.end(), 0.0f);
+					tap.weights[std::min((uint32)center, srcSize - 1) - first] = 1.0f;
+				}
+				else
+				{
+					for (size_t i=0; i<tap.weights.size(); ++i)
+						tap.weights[i] /= sum;
+				}
+			}
+		}
+
+		// Separable resample, one RGBA texel per SSE register
+		void Resample(const SFloatImage& src, SFloatImage& dst, eMipFilter filter)
+		{
+			std::vector<SFilterTaps> tapsX, tapsY;
+			BuildTaps(src.width, dst.width, filter, tapsX);
+			BuildTaps(src.height, dst.height, filter, tapsY);
+
+			SFloatImage tmp;
+			tmp.Resize(dst.width, src.height);
+
+			for (uint32 y=0; y<src.height; ++y)
+			{
+				const float* pSrcRow = &src.pixels[y * src.width * 4];
+				float* pTmpRow = &tmp.pixels[y * tmp.width * 4];
+
+				for (uint32 x=0; x<dst.width; ++x)
+				{
+					const SFilterTaps& tap = tapsX[x];
+					__m128 acc = _mm_setzero_ps();
+					for (size_t k=0; k<tap.weights.size(); ++k)
+					{
+						const __m128 texel = _mm_loadu_ps(pSrcRow + (tap.start + k) * 4);
+						acc = _mm_add_ps(acc, _mm_mul_ps(texel, _mm_set1_ps(tap.weights[k])));
+					}
+					_mm_storeu_ps(pTmpRow + x * 4, acc);
+				}
+			}
+
+			for (uint32 y=0; y<dst.height; ++y)
+			{
+				const SFilterTaps& tap = tapsY[y];
+				float* pDstRow = &dst.pixels[y * dst.width * 4];
+
+				for (uint32 x=0; x<dst.width; ++x)
+				{
+					__m128 acc = _mm_setzero_ps();
+					for (size_t k=0; k<tap.weights.size(); ++k)
+					{
+						const __m128 texel = _mm_loadu_ps(&tmp.pixels[((tap.start + k) * tmp.width + x) * 4]);
+						acc = _mm_add_ps(acc, _mm_mul_ps(texel, _mm_set1_ps(tap.weights[k])));
+					}
+					_mm_storeu_ps(pDstRow + x * 4, acc);
+				}
+			}
+		}
+
+		// 2x2 average, both dimensions even
+		void BoxDownsample(const SFloatImage& src, SFloatImage& dst)
+		{
+			const __m128 quarter = _mm_set1_ps(0.25f);
+
+			for (uint32 y=0; y<dst.height; ++y)
+			{
+				const float* pRow0 = &src.pixels[(y * 2) * src.width * 4];
+				const float* pRow1 = pRow0 + src.width * 4;
+				float* pDstRow = &dst.pixels[y * dst.width * 4];
+
+				for (uint32 x=0; x<dst.width; ++x)
+				{
+					__m128 sum = _mm_add_ps(_mm_loadu_ps(pRow0 + x * 8), _mm_loadu_ps(pRow0 + x * 8 + 4));
+					sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(pRow1 + x * 8), _mm_loadu_ps(pRow1 + x * 8 + 4)));
+					_mm_storeu_ps(pDstRow + x * 4, _mm_mul_ps(sum, quarter));
+				}
+			}
+		}
+
+		//------------------------------------------------------------------------------------
+		// BC1
+		//------------------------------------------------------------------------------------
+		inline int Clamp255(float v)
+		{
+			return std::min(std::max((int)(v + 0.5f), 0), 255);
+		}
+
+		inline uint16 PackRGB565(const float c[3])
+		{
+			const int r = (Clamp255(c[0]) * 31 + 127) / 255;
+			const int g = (Clamp255(c[1]) * 63 + 127) / 255;
+			const int b = (Clamp255(c[2]) * 31 + 127) / 255;
+			return (uint16)((r << 11) | (g << 5) | b);
+		}
+
+		inline void UnpackRGB565(uint16 v, int out[3])
+		{
+			const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			out[0] = (r << 3) | (r >> 2);
+			out[1] = (g << 2) | (g >> 4);
+			out[2] = (b << 3) | (b >> 2);
+		}
+
+		struct SColorBlock
+		{
+			float	rgb[16][3];
+			bool	bTransparent[16];
+			int		numOpaque;
+		};
+
+		// Index weights of endpoint 0 for each palette entry
+		const float BC1_WEIGHTS_4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		const float BC1_WEIGHTS_3[3] = { 1.0f, 0.0f, 0.5f };
+
+		/**	Choose the nearest palette entry for each texel.
+			@return Squared error of opaque texels
+		*/
+		int FitBC1Indices(const SColorBlock& block, uint16 c0, uint16 c1, bool bThreeColor, uint32& indices)
+		{
+			int e0[3], e1[3], palette[4][3];
+			UnpackRGB565(c0, e0);
+			UnpackRGB565(c1, e1);
+
+			for (int i=0; i<3; ++i)
+			{
+				palette[0][i] = e0[i];
+				palette[1][i] = e1[i];
+				if (bThreeColor)
+				{
+					palette[2][i] = (e0[i] + e1[i]) / 2;
+					palette[3][i] = 0;
+				}
+				else
+				{
+					palette[2][i] = (2 * e0[i] + e1[i]) / 3;
+					palette[3][i] = (e0[i] + 2 * e1[i]) / 3;
+				}
+			}
+
+			const int numColors = bThreeColor ? 3 : 4;
+			int error = 0;
+			indices = 0;
+
+			for (int p=0; p<16; ++p)
+			{
+				if (block.bTransparent[p])
+				{
+					indices |= 3u << (p * 2);
+					continue;
+				}
+
+				int best = 0, bestDist = INT_MAX;
+				for (int i=0; i<numColors; ++i)
+				{
+					const int dr = Clamp255(block.rgb[p][0]) - palette[i][0];
+					const int dg = Clamp255(block.rgb[p][1]) - palette[i][1];
+					const int db = Clamp255(block.rgb[p][2]) - palette[i][2];
+					const int dist = dr * dr + dg * dg + db * db;
+					if (dist < bestDist)
+					{
+						bestDist = dist;
+						best = i;
+					}
+				}
+
+				indices |= (uint32)best << (p * 2);
+				error += bestDist;
+			}
+
+			return error;
+		}
+
+		// Least squares endpoints for given indices, false if the system is singular
+		bool SolveBC1Endpoints(const SColorBlock& block, uint32 indices, bool bThreeColor, float e0[3], float e1[3])
+		{
+			float aa = 0, ab = 0, bb = 0;
+			float ax[3] = {0,0,0}, bx[3] = {0,0,0};
+
+			for (int p=0; p<16; ++p)
+			{
+				if(block.bTransparent[p])
+					continue;
+
+				const uint32 idx = (indices >> (p * 2)) & 3;
+				const float a = bThreeColor ? BC1_WEIGHTS_3[idx] : BC1_WEIGHTS_4[idx];
+				const float b = 1.0f - a;
+
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (int i=0; i<3; ++i)
+				{
+					ax[i] += a * block.rgb[p][i];
+					bx[i] += b * block.rgb[p][i];
+				}
+			}
+
+			const float det = aa * bb - ab * ab;
+			if(fabs(det) < 1e-6f)
+				return false;
+
+			const float invDet = 1.0f / det;
+			for (int i=0; i<3; ++i)
+			{
+				e0[i] = std::min(std::max((ax[i] * bb - bx[i] * ab) * invDet, 0.0f), 255.0f);
+				e1[i] = std::min(std::max((bx[i] * aa - ax[i] * ab) * invDet, 0.0f), 255.0f);
+			}
+
+			return true;
+		}
+
+		void ComputeBC1Endpoints(const SColorBlock& block, eCookQuality quality, float e0[3], float e1[3])
+		{
+			float minC[3] = {255,255,255}, maxC[3] = {0,0,0}, mean[3] = {0,0,0};
+			for (int p=0; p<16; ++p)
+			{
+				if(block.bTransparent[p])
+					continue;
+
+				for (int i=0; i<3; ++i)
+				{
+					minC[i] = std::min(minC[i], block.rgb[p][i]);
+					maxC[i] = std::max(maxC[i], block.rgb[p][i]);
+					mean[i] += block.rgb[p][i];
+				}
+			}
+
+			if (quality == eCookQuality_Fast)
+			{
+				// Inset the box a bit, extremes are rarely hit exactly
+				for (int i=0; i<3; ++i)
+				{
+					const float inset = (maxC[i] - minC[i]) / 16.0f;
+					e0[i] = maxC[i] - inset;
+					e1[i] = minC[i] + inset;
+				}
+				return;
+			}
+
+			for (int i=0; i<3; ++i)
+				mean[i] /= block.numOpaque;
+
+			// Covariance, then principal axis by power iteration
+			float cov[6] = {0,0,0,0,0,0};
+			for (int p=0; p<16; ++p)
+			{
+				if(block.bTransparent[p])
+					continue;
+
+				const float r = block.rgb[p][0] - mean[0];
+				const float g = block.rgb[p][1] - mean[1];
+				const float b = block.rgb[p][2] - mean[2];
+				cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+				cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+			}
+
+			float axis[3] = { maxC[0] - minC[0], maxC[1] - minC[1], maxC[2] - minC[2] };
+			for (int iter=0; iter<8; ++iter)
+			{
+				const float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+				const float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+				const float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+				const float len = std::max(std::max(fabs(x), fabs(y)), fabs(z));
+				if(len < 1e-6f)
+					break;
+
+				axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+			}
+
+			const float len2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			if (len2 < 1e-6f)
+			{
+				// Flat block
+				for (int i=0; i<3; ++i)
+					e0[i] = e1[i] = mean[i];
+				return;
+			}
+
+			float tMin = FLT_MAX, tMax = -FLT_MAX;
+			for (int p=0; p<16; ++p)
+			{
+				if(block.bTransparent[p])
+					continue;
+
+				const float t = ((block.rgb[p][0] - mean[0]) * axis[0] + (block.rgb[p][1] - mean[1]) * axis[1]
+					+ (block.rgb[p][2] - mean[2]) * axis[2]) / len2;
+				tMin = std::min(tMin, t);
+				tMax = std::max(tMax, t);
+			}
+
+			for (int i=0; i<3; ++i)
+			{
+				e0[i] = mean[i] + axis[i] * tMax;
+				e1[i] = mean[i] + axis[i] * tMin;
+			}
+		}
+
+		void EncodeColorBlock(const SColorBlock& block, uint8* pOut, eCookQuality quality, bool bThreeColor)
+		{
+			uint16 c0 = 0, c1 = 0;
+			uint32 indices = 0xFFFFFFFF;
+
+			if (block.numOpaque > 0)
+			{
+				float e0[3], e1[3];
+				ComputeBC1Endpoints(block, quality, e0, e1);
+
+				c0 = PackRGB565(e0);
+				c1 = PackRGB565(e1);
+				int error = FitBC1Indices(block, c0, c1, bThreeColor, indices);
+
+				// Refit endpoints to the chosen indices
+				const int numIter = quality == eCookQuality_High ? 8 : (quality == eCookQuality_Normal ? 1 : 0);
+				for (int iter=0; iter<numIter && error>0; ++iter)
+				{
+					if(!SolveBC1Endpoints(block, indices, bThreeColor, e0, e1))
+						break;
+
+					const uint16 n0 = PackRGB565(e0), n1 = PackRGB565(e1);
+					uint32 newIndices;
+					const int newError = FitBC1Indices(block, n0, n1, bThreeColor, newIndices);
+					if(newError >= error)
+						break;
+
+					c0 = n0; c1 = n1; indices = newIndices; error = newError;
+				}
+
+				// Greedy search of neighbour endpoints in 565 space
+				if (quality == eCookQuality_High)
+				{
+					static const uint16 steps[3] = { 1 << 11, 1 << 5, 1 };
+					static const uint16 masks[3] = { 31 << 11, 63 << 5, 31 };
+
+					bool bImproved = true;
+					for (int pass=0; pass<4 && bImproved && error>0; ++pass)
+					{
+						bImproved = false;
+						for (int e=0; e<2; ++e)
+						{
+							for (int ch=0; ch<3; ++ch)
+							{
+								for (int dir=-1; dir<=1; dir+=2)
+								{
+									uint16 n[2] = { c0, c1 };
+									const int field = n[e] & masks[ch];
+									const int next = field + dir * steps[ch];
+									if(next < 0 || next > masks[ch])
+										continue;
+
+									n[e] = (uint16)((n[e] & ~masks[ch]) | next);
+
+									uint32 newIndices;
+									const int newError = FitBC1Indices(block, n[0], n[1], bThreeColor, newIndices);
+									if (newError < error)
+									{
+										c0 = n[0]; c1 = n[1]; indices = newIndices; error = newError;
+										bImproved = true;
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+
+			// Endpoint order selects the mode: c0 > c1 is 4 color, c0 <= c1 is 3 color
+			if (bThreeColor ? (c0 > c1) : (c0 < c1))
+			{
+				std::swap(c0, c1);
+				for (int p=0; p<16; ++p)
+				{
+					const uint32 idx = (indices >> (p * 2)) & 3;
+					uint32 newIdx = idx;
+					if(idx < 2)
+						newIdx = idx ^ 1;
+					else if(!bThreeColor)
+						newIdx = idx ^ 1;		// 2 <-> 3
+
+					indices = (indices & ~(3u << (p * 2))) | (newIdx << (p * 2));
+				}
+			}
+			else if (!bThreeColor && c0 == c1)
+			{
+				// Would be decoded as 3 color mode, index 0 is the only safe one
+				indices = 0;
+			}
+
+			pOut[0] = (uint8)(c0 & 0xff);
+			pOut[1] = (uint8)(c0 >> 8);
+			pOut[2] = (uint8)(c1 & 0xff);
+			pOut[3] = (uint8)(c1 >> 8);
+			pOut[4] = (uint8)(indices & 0xff);
+			pOut[5] = (uint8)((indices >> 8) & 0xff);
+			pOut[6] = (uint8)((indices >> 16) & 0xff);
+			pOut[7] = (uint8)(indices >> 24);
+		}
+
+		//------------------------------------------------------------------------------------
+		// BC4
+		//------------------------------------------------------------------------------------
+		void BuildBC4Palette(int a0, int a1, int palette[8])
+		{
+			palette[0] = a0;
+			palette[1] = a1;
+
+			if (a0 > a1)
+			{
+				for (int i=2; i<8; ++i)
+					palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+			}
+			else
+			{
+				for (int i=2; i<6; ++i)
+					palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+		}
+
+		int FitBC4Indices(const uint8* pValues, int a0, int a1, uint8 indices[16])
+		{
+			int palette[8];
+			BuildBC4Palette(a0, a1, palette);
+
+			int error = 0;
+			for (int p=0; p<16; ++p)
+			{
+				int best = 0, bestDist = INT_MAX;
+				for (int i=0; i<8; ++i)
+				{
+					const int d = (int)pValues[p] - palette[i];
+					if (d * d < bestDist)
+					{
+						bestDist = d * d;
+						best = i;
+					}
+				}
+
+				indices[p] = (uint8)best;
+				error += bestDist;
+			}
+
+			return error;
+		}
+	}
+
+	//------------------------------------------------------------------------------------
+	TextureCooker::TextureCooker( const SCookOptions& options )
+		:m_options(options)
+	{
+		// Heights, masks and normals are never gamma encoded
+		if(options.format == eCookFormat_BC4 || options.format == eCookFormat_BC5)
+			m_options.bSRGB = false;
+	}
+	//------------------------------------------------------------------------------------
+	bool TextureCooker::SetSource( const void* pData, unsigned int width, unsigned int height, unsigned int pitch, unsigned int bytesPerPixel )
+	{
+		if(!pData || width == 0 || height == 0)
+			return false;
+		if(bytesPerPixel != 1 && bytesPerPixel != 3 && bytesPerPixel != 4)
+			return false;
+
+		float toLinear[256];
+		for (int i=0; i<256; ++i)
+			toLinear[i] = m_options.bSRGB ? SRGBToLinear(i / 255.0f) : i / 255.0f;
+
+		m_source.Resize(width, height);
+
+		for (uint32 y=0; y<height; ++y)
+		{
+			const uint8* pSrc = (const uint8*)pData + y * pitch;
+			float* pDst = &m_source.pixels[y * width * 4];
+
+			for (uint32 x=0; x<width; ++x, pSrc+=bytesPerPixel, pDst+=4)
+			{
+				if (bytesPerPixel == 1)
+				{
+					pDst[0] = pDst[1] = pDst[2] = toLinear[pSrc[0]];
+					pDst[3] = 1.0f;
+				}
+				else
+				{
+					pDst[0] = toLinear[pSrc[2]];
+					pDst[1] = toLinear[pSrc[1]];
+					pDst[2] = toLinear[pSrc[0]];
+					pDst[3] = bytesPerPixel == 4 ? pSrc[3] / 255.0f : 1.0f;
+				}
+			}
+		}
+
+		m_mipData.clear();
+		m_mipSize.clear();
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::Cook()
+	{
+		assert(m_source.width > 0 && "Source not set!");
+
+		m_mipData.clear();
+		m_mipSize.clear();
+
+		SFloatImage cur = m_source, next;
+		for (;;)
+		{
+			m_mipData.push_back(std::vector<unsigned char>());
+			m_mipSize.push_back(std::make_pair(cur.width, cur.height));
+			_Encode(cur, m_mipData.back());
+
+			if(!m_options.bGenMips || (cur.width == 1 && cur.height == 1))
+				break;
+
+			// Each level is filtered from the previous one
+			GenerateMip(cur, next, m_options.mipFilter);
+			std::swap(cur, next);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::GenerateMip( const SFloatImage& src, SFloatImage& dst, eMipFilter filter )
+	{
+		dst.Resize(std::max(src.width / 2, 1u), std::max(src.height / 2, 1u));
+
+		if (filter == eMipFilter_Box && src.width % 2 == 0 && src.height % 2 == 0)
+			BoxDownsample(src, dst);
+		else
+			Resample(src, dst, filter);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::_Quantize( const SFloatImage& image, std::vector<unsigned char>& out ) const
+	{
+		const uint32 count = image.width * image.height;
+		out.resize(count * 4);
+
+		for (uint32 i=0; i<count; ++i)
+		{
+			const float* pSrc = &image.pixels[i * 4];
+			for (int c=0; c<3; ++c)
+			{
+				const float v = std::max(pSrc[c], 0.0f);
+				out[i * 4 + c] = FloatToByte(m_options.bSRGB ? LinearToSRGB(v) : v);
+			}
+			out[i * 4 + 3] = FloatToByte(pSrc[3]);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::_Encode( const SFloatImage& image, std::vector<unsigned char>& out ) const
+	{
+		std::vector<unsigned char> rgba;
+		_Quantize(image, rgba);
+
+		const eCookFormat format = m_options.format;
+		if (format == eCookFormat_RGBA8)
+		{
+			out.swap(rgba);
+			return;
+		}
+
+		const uint32 blockBytes = GetBlockBytes(format);
+		const uint32 numBlocksX = (image.width + 3) / 4;
+		const uint32 numBlocksY = (image.height + 3) / 4;
+		out.resize(numBlocksX * numBlocksY * blockBytes);
+
+		const eCookQuality quality = m_options.quality;
+		const bool bThreeColor = m_options.bAlphaCutout;
+		const uint32 width = image.width, height = image.height;
+		const uint8* pRGBA = &rgba[0];
+		uint8* pOut = &out[0];
+
+		// One block row per job
+		ParallelFor(numBlocksY, [&](unsigned int by)
+		{
+			uint8 texels[64], channel[16];
+
+			for (uint32 bx=0; bx<numBlocksX; ++bx)
+			{
+				// Border blocks repeat the last row/column
+				for (uint32 p=0; p<16; ++p)
+				{
+					const uint32 x = std::min(bx * 4 + (p & 3), width - 1);
+					const uint32 y = std::min(by * 4 + (p >> 2), height - 1);
+					memcpy(texels + p * 4, pRGBA + (y * width + x) * 4, 4);
+				}
+
+				uint8* pBlock = pOut + (by * numBlocksX + bx) * blockBytes;
+
+				switch (format)
+				{
+				case eCookFormat_BC1:
+					EncodeBC1Block(texels, pBlock, quality, bThreeColor);
+					break;
+
+				case eCookFormat_BC3:
+					for(int p=0; p<16; ++p) channel[p] = texels[p * 4 + 3];
+					EncodeBC4Block(channel, pBlock, quality);
+					EncodeBC1Block(texels, pBlock + 8, quality, false);
+					break;
+
+				case eCookFormat_BC4:
+					for(int p=0; p<16; ++p) channel[p] = texels[p * 4];
+					EncodeBC4Block(channel, pBlock, quality);
+					break;
+
+				case eCookFormat_BC5:
+					for(int p=0; p<16; ++p) channel[p] = texels[p * 4];
+					EncodeBC4Block(channel, pBlock, quality);
+					for(int p=0; p<16; ++p) channel[p] = texels[p * 4 + 1];
+					EncodeBC4Block(channel, pBlock + 8, quality);
+					break;
+
+				default: assert(0);
+				}
+			}
+		}, m_options.numThreads);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::EncodeBC1Block( const unsigned char* pRGBA, unsigned char* pOut, eCookQuality quality, bool bThreeColor )
+	{
+		SColorBlock block;
+		block.numOpaque = 0;
+
+		for (int p=0; p<16; ++p)
+		{
+			for (int i=0; i<3; ++i)
+				block.rgb[p][i] = pRGBA[p * 4 + i];
+
+			block.bTransparent[p] = bThreeColor && pRGBA[p * 4 + 3] < 128;
+			if(!block.bTransparent[p])
+				++block.numOpaque;
+		}
+
+		// 3 color mode is only worth it when there is something to cut out
+		const bool bUseThreeColor = bThreeColor && block.numOpaque < 16;
+		EncodeColorBlock(block, pOut, quality, bUseThreeColor);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureCooker::EncodeBC4Block( const unsigned char* pValues, unsigned char* pOut, eCookQuality quality )
+	{
+		int minV = 255, maxV = 0, minInner = 255, maxInner = 0;
+		for (int p=0; p<16; ++p)
+		{
+			minV = std::min(minV, (int)pValues[p]);
+			maxV = std::max(maxV, (int)pValues[p]);
+
+			// Range without exact 0 and 255, they are free in 6 value mode
+			if (pValues[p] != 0 && pValues[p] != 255)
+			{
+				minInner = std::min(minInner, (int)pValues[p]);
+				maxInner = std::max(maxInner, (int)pValues[p]);
+			}
+		}
+
+		uint8 indices[16];
+		int a0 = maxV, a1 = minV;
+		int error = 0;
+
+		if (maxV == minV)
+		{
+			memset(indices, 0, sizeof(indices));
+		}
+		else
+		{
+			// 8 value mode
+			error = FitBC4Indices(pValues, a0, a1, indices);
+
+			if (quality == eCookQuality_High)
+			{
+				// Pull endpoints inwards, extremes are often outliers
+				for (int d0=0; d0<=4 && error>0; ++d0)
+				{
+					for (int d1=0; d1<=4; ++d1)
+					{
+						const int n0 = maxV - d0, n1 = minV + d1;
+						if(n0 <= n1 || (d0 == 0 && d1 == 0))
+							continue;
+
+						uint8 newIndices[16];
+						const int newError = FitBC4Indices(pValues, n0, n1, newIndices);
+						if (newError < error)
+						{
+							a0 = n0; a1 = n1; error = newError;
+							memcpy(indices, newIndices, sizeof(indices));
+						}
+					}
+				}
+			}
+
+			// 6 value mode with explicit 0 and 255
+			if (quality != eCookQuality_Fast && error > 0)
+			{
+				int n0 = minInner, n1 = maxInner;
+				if(n0 > n1)
+					n0 = n1 = 0;
+
+				uint8 newIndices[16];
+				const int newError = FitBC4Indices(pValues, n0, n1, newIndices);
+				if (newError < error)
+				{
+					a0 = n0; a1 = n1; error = newError;
+					memcpy(indices, newIndices, sizeof(indices));
+				}
+			}
+		}
+
+		pOut[0] = (uint8)a0;
+		pOut[1] = (uint8)a1;
+
+		// 16 3-bit indices, texel 0 in the lowest bits
+		unsigned long long bits = 0;
+		for (int p=0; p<16; ++p)
+			bits |= (unsigned long long)indices[p] << (p * 3);
+
+		for (int i=0; i<6; ++i)
+			pOut[2 + i] = (uint8)((bits >> (i * 8)) & 0xff);
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int TextureCooker::GetBlockBytes( eCookFormat format )
+	{
+		switch (format)
+		{
+		case eCookFormat_BC1:
+		case eCookFormat_BC4:	return 8;
+		case eCookFormat_BC3:
+		case eCookFormat_BC5:	return 16;
+		default:				return 0;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool TextureCooker::SaveDDS( const std::string& filename ) const
+	{
+		if(m_mipData.empty())
+			return false;
+
+		std::ofstream file(filename.c_str(), std::ios::binary);
+		if(!file)
+			return false;
+
+		// DX9 style header, readable by DDSLoader and D3DX
+		uint32 header[32];
+		memset(header, 0, sizeof(header));
+
+		const eCookFormat format = m_options.format;
+		const uint32 width = m_mipSize[0].first, height = m_mipSize[0].second;
+		const uint32 mipCount = m_mipData.size();
+		const bool bCompressed = format != eCookFormat_RGBA8;
+
+		header[0] = 0x20534444;						// "DDS "
+		header[1] = 124;							// size
+		header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (bCompressed ? 0x80000 : 0x8);
+		header[3] = height;
+		header[4] = width;
+		header[5] = bCompressed ? (uint32)m_mipData[0].size() : width * 4;
+		header[6] = 0;								// depth
+		header[7] = mipCount;
+
+		// Pixel format
+		uint32* pf = header + 19;
+		pf[0] = 32;
+		if (bCompressed)
+		{
+			static const char* fourCC[] = { "", "DXT1", "DXT5", "ATI1", "ATI2" };
+			const char* cc = fourCC[format];
+
+			pf[1] = 0x4;							// DDPF_FOURCC
+			pf[2] = (uint32)(uint8)cc[0] | ((uint32)(uint8)cc[1] << 8) | ((uint32)(uint8)cc[2] << 16) | ((uint32)(uint8)cc[3] << 24);
+		}
+		else
+		{
+			pf[1] = 0x40 | 0x1;						// DDPF_RGB | DDPF_ALPHAPIXELS
+			pf[3] = 32;
+			pf[4] = 0x000000ff;
+			pf[5] = 0x0000ff00;
+			pf[6] = 0x00ff0000;
+			pf[7] = 0xff000000;
+		}
+
+		header[27] = 0x1000 | (mipCount > 1 ? (0x8 | 0x400000) : 0);	// caps
+
+		file.write((const char*)header, sizeof(header));
+		for (size_t i=0; i<m_mipData.size(); ++i)
+			file.write((const char*)&m_mipData[i][0], m_mipData[i].size());
+
+		return file.good();
+	}
+}
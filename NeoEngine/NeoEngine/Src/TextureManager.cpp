@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "TextureManager.h"
+#include "D3D11Texture.h"
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	TextureManager::TextureManager()
+		:m_budget(0)
+		,m_usedBytes(0)
+		,m_useCounter(0)
+	{
+
+	}
+	//------------------------------------------------------------------------------------
+	TextureManager::~TextureManager()
+	{
+		// Textures still used by someone live on until their last Release
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+		{
+			m_streamer.Unregister(iter->second.pTexture);
+			m_texturePool.Release(iter->second.handle);
+		}
+
+		m_textures.clear();
+	}
+	//------------------------------------------------------------------------------------
+	STRING TextureManager::NormalizePath( const STRING& filename )
+	{
+		STRING path(filename);
+		std::transform(path.begin(), path.end(), path.begin(), ::tolower);
+		std::replace(path.begin(), path.end(), '/', '\\');
+
+		// Split and resolve "." and "..", leading ".." are kept since paths are relative
+		StringVector parts;
+		size_t start = 0;
+		while (start <= path.length())
+		{
+			size_t end = path.find('\\', start);
+			if(end == STRING::npos)
+				end = path.length();
+
+			const STRING part = path.substr(start, end - start);
+			if (part.empty() || part == ".")
+			{
+			}
+			else if (part == ".." && !parts.empty() && parts.back() != "..")
+			{
+				parts.pop_back();
+			}
+			else
+			{
+				parts.push_back(part);
+			}
+
+			start = end + 1;
+		}
+
+		STRING ret;
+		for (size_t i=0; i<parts.size(); ++i)
+		{
+			if(i > 0)
+				ret += '\\';
+			ret += parts[i];
+		}
+
+		return std::move(ret);
+	}
+	//------------------------------------------------------------------------------------
+	STRING TextureManager::_MakeKey( const STRING& name, eTextureType type, uint32 usage ) const
+	{
+		char szParam[32];
+		sprintf_s(szParam, sizeof(szParam), "|%d|%u", type, usage);
+
+		return NormalizePath(name) + szParam;
+	}
+	//------------------------------------------------------------------------------------
+	TextureHandle TextureManager::_Touch( TextureMap::iterator iter )
+	{
+		iter->second.lastUse = ++m_useCounter;
+		return iter->second.handle;
+	}
+	//------------------------------------------------------------------------------------
+	TextureHandle TextureManager::_Add( const STRING& key, D3D11Texture* pTexture )
+	{
+		STextureEntry entry;
+		entry.handle = m_texturePool.Create(pTexture);
+		entry.pTexture = pTexture;
+		entry.bytes = pTexture->GetEstimatedBytes();
+		entry.lastUse = ++m_useCounter;
+
+		m_textures.insert(std::make_pair(key, entry));
+		m_usedBytes += entry.bytes;
+
+		if (pTexture->IsStreamed())
+		{
+			std::vector<uint32> mipBytes;
+			pTexture->GetMipBytes(mipBytes);
+			m_streamer.Register(pTexture, mipBytes, pTexture->GetResidentMip());
+		}
+
+		// New texture isn't referenced yet, protect it from being evicted right away
+		pTexture->AddRef();
+		EvictToBudget();
+		pTexture->Release();
+
+		return entry.handle;
+	}
+	//------------------------------------------------------------------------------------
+	D3D11Texture* TextureManager::Load( const STRING& filename, eTextureType type, uint32 usage )
+	{
+		return m_texturePool.Resolve(LoadHandle(filename, type, usage));
+	}
+	//------------------------------------------------------------------------------------
+	D3D11Texture* TextureManager::LoadArray( const StringVector& vecTexNames, uint32 usage )
+	{
+		return m_texturePool.Resolve(LoadArrayHandle(vecTexNames, usage));
+	}
+	//------------------------------------------------------------------------------------
+	TextureHandle TextureManager::LoadHandle( const STRING& filename, eTextureType type, uint32 usage )
+	{
+		const STRING key = _MakeKey(filename, type, usage);
+
+		auto iter = m_textures.find(key);
+		if(iter != m_textures.end())
+			return _Touch(iter);
+
+		return _Add(key, new D3D11Texture(filename, type, usage));
+	}
+	//------------------------------------------------------------------------------------
+	TextureHandle TextureManager::LoadArrayHandle( const StringVector& vecTexNames, uint32 usage )
+	{
+		assert(!vecTexNames.empty());
+
+		STRING names;
+		for (size_t i=0; i<vecTexNames.size(); ++i)
+		{
+			names += vecTexNames[i];
+			names += ';';
+		}
+
+		const STRING key = _MakeKey(names, eTextureType_TextureArray, usage);
+
+		auto iter = m_textures.find(key);
+		if(iter != m_textures.end())
+			return _Touch(iter);
+
+		return _Add(key, new D3D11Texture(vecTexNames, usage));
+	}
+	//------------------------------------------------------------------------------------
+	void TextureManager::UpdateStreaming()
+	{
+		m_streamer.Update(m_mipChanges);
+		if(m_mipChanges.empty())
+			return;
+
+		for (size_t i=0; i<m_mipChanges.size(); ++i)
+		{
+			const SMipChange& change = m_mipChanges[i];
+
+			// Out of memory most likely, keep what we have and let the streamer know
+			if(!change.pTexture->SetResidentMip(change.residentMip))
+				m_streamer.SetResidentMip(change.pTexture, change.pTexture->GetResidentMip());
+		}
+
+		// Resident mips changed the size of some entries
+		m_usedBytes = 0;
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+		{
+			STextureEntry& entry = iter->second;
+			if(entry.pTexture->IsStreamed())
+				entry.bytes = entry.pTexture->GetEstimatedBytes();
+
+			m_usedBytes += entry.bytes;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TextureManager::SetBudget( uint32 bytes )
+	{
+		m_budget = bytes;
+		EvictToBudget();
+	}
+	//------------------------------------------------------------------------------------
+	void TextureManager::EvictToBudget()
+	{
+		if(m_budget > 0 && m_usedBytes > m_budget)
+			_Evict(m_budget);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureManager::EvictUnused()
+	{
+		_Evict(0);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureManager::_Evict( uint32 targetBytes )
+	{
+		// Collect unreferenced ones, the manager holds the only reference
+		std::vector<std::pair<uint32, STRING>> candidates;
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+		{
+			if(iter->second.pTexture->GetRefCount() == 1)
+				candidates.push_back(std::make_pair(iter->second.lastUse, iter->first));
+		}
+
+		// Least recently used first
+		std::sort(candidates.begin(), candidates.end());
+
+		for (size_t i=0; i<candidates.size() && m_usedBytes > targetBytes; ++i)
+		{
+			auto iter = m_textures.find(candidates[i].second);
+			assert(iter != m_textures.end());
+
+			m_usedBytes -= iter->second.bytes;
+			m_streamer.Unregister(iter->second.pTexture);
+			m_texturePool.Release(iter->second.handle);
+			m_textures.erase(iter);
+		}
+	}
+}
@@ -0,0 +1,289 @@
+#include "TexturePacker.h"
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+
+namespace Neo
+{
+	//------------------------------------------------------------------------------------
+	SkylinePacker::SkylinePacker( unsigned int width, unsigned int height )
+		:m_width(width)
+		,m_height(height)
+		,m_usedArea(0)
+	{
+		SNode node = { 0, 0, width };
+		m_skyline.push_back(node);
+	}
+	//------------------------------------------------------------------------------------
+	bool SkylinePacker::_Fit( size_t index, unsigned int width, unsigned int height, unsigned int& y ) const
+	{
+		const unsigned int x = m_skyline[index].x;
+		if(x + width > m_width)
+			return false;
+
+		// Rests on the highest node it spans
+		y = m_skyline[index].y;
+		int widthLeft = (int)width;
+		for (size_t i=index; widthLeft > 0; ++i)
+		{
+			assert(i < m_skyline.size());
+
+			y = std::max(y, m_skyline[i].y);
+			if(y + height > m_height)
+				return false;
+
+			widthLeft -= (int)m_skyline[i].width;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	bool SkylinePacker::Insert( unsigned int width, unsigned int height, unsigned int& x, unsigned int& y )
+	{
+		size_t bestIndex = m_skyline.size();
+		unsigned int bestTop = UINT_MAX, bestWidth = UINT_MAX;
+
+		for (size_t i=0; i<m_skyline.size(); ++i)
+		{
+			unsigned int posY;
+			if(!_Fit(i, width, height, posY))
+				continue;
+
+			// Lowest top, then the narrowest node to keep waste small
+			const unsigned int top = posY + height;
+			if (top < bestTop || (top == bestTop && m_skyline[i].width < bestWidth))
+			{
+				bestIndex = i;
+				bestTop = top;
+				bestWidth = m_skyline[i].width;
+				x = m_skyline[i].x;
+				y = posY;
+			}
+		}
+
+		if(bestIndex == m_skyline.size())
+			return false;
+
+		_AddLevel(bestIndex, x, y, width, height);
+		m_usedArea += width * height;
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void SkylinePacker::_AddLevel( size_t index, unsigned int x, unsigned int y, unsigned int width, unsigned int height )
+	{
+		SNode node = { x, y + height, width };
+		m_skyline.insert(m_skyline.begin() + index, node);
+
+		// Cut the nodes now covered by the new one
+		for (size_t i=index+1; i<m_skyline.size(); )
+		{
+			const unsigned int prevEnd = m_skyline[i-1].x + m_skyline[i-1].width;
+			if(m_skyline[i].x >= prevEnd)
+				break;
+
+			const unsigned int shrink = prevEnd - m_skyline[i].x;
+			if (m_skyline[i].width <= shrink)
+			{
+				m_skyline.erase(m_skyline.begin() + i);
+			}
+			else
+			{
+				m_skyline[i].x += shrink;
+				m_skyline[i].width -= shrink;
+				break;
+			}
+		}
+
+		// Merge neighbours at the same height
+		for (size_t i=0; i+1<m_skyline.size(); )
+		{
+			if (m_skyline[i].y == m_skyline[i+1].y)
+			{
+				m_skyline[i].width += m_skyline[i+1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	TexturePacker::TexturePacker( const SPackOptions& options )
+		:m_options(options)
+	{
+		assert(options.alignment > 0 && (options.alignment & (options.alignment - 1)) == 0);
+		assert(options.pageWidth % options.alignment == 0 && options.pageHeight % options.alignment == 0);
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int TexturePacker::AddImage( const void* pRGBA, unsigned int width, unsigned int height, unsigned int pitch )
+	{
+		assert(width > 0 && height > 0);
+
+		SImage image;
+		image.width = width;
+		image.height = height;
+		image.pixels.resize(width * height * 4);
+
+		for (unsigned int y=0; y<height; ++y)
+			memcpy(&image.pixels[y * width * 4], (const unsigned char*)pRGBA + y * pitch, width * 4);
+
+		m_images.push_back(image);
+
+		return m_images.size() - 1;
+	}
+	//------------------------------------------------------------------------------------
+	bool TexturePacker::Pack()
+	{
+		m_pages.clear();
+		m_entries.assign(m_images.size(), SAtlasEntry());
+
+		// Tallest first packs a skyline best
+		std::vector<unsigned int> order(m_images.size());
+		for (size_t i=0; i<order.size(); ++i)
+			order[i] = i;
+
+		std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+		{
+			if(m_images[a].height != m_images[b].height)
+				return m_images[a].height > m_images[b].height;
+			return m_images[a].width > m_images[b].width;
+		});
+
+		std::vector<SkylinePacker> bins;
+		const unsigned int pad = m_options.padding;
+
+		for (size_t i=0; i<order.size(); ++i)
+		{
+			const SImage& image = m_images[order[i]];
+			const unsigned int cellW = _AlignUp(image.width + pad * 2);
+			const unsigned int cellH = _AlignUp(image.height + pad * 2);
+
+			if(cellW > m_options.pageWidth || cellH > m_options.pageHeight)
+				return false;
+
+			// First page it fits in, open a new one otherwise
+			unsigned int x = 0, y = 0;
+			size_t page = 0;
+			while(page < bins.size() && !bins[page].Insert(cellW, cellH, x, y))
+				++page;
+
+			if (page == bins.size())
+			{
+				if(bins.size() == m_options.maxPages)
+					return false;
+
+				bins.push_back(SkylinePacker(m_options.pageWidth, m_options.pageHeight));
+				m_pages.push_back(std::vector<unsigned char>(m_options.pageWidth * m_options.pageHeight * 4, 0));
+
+				const bool bOk = bins.back().Insert(cellW, cellH, x, y);
+				assert(bOk); (void)bOk;
+			}
+
+			_Blit(image, x, y, m_pages[page]);
+
+			SAtlasEntry& entry = m_entries[order[i]];
+			entry.page = page;
+			entry.x = x + pad;
+			entry.y = y + pad;
+			entry.width = image.width;
+			entry.height = image.height;
+			entry.uvOffset[0] = entry.x / (float)m_options.pageWidth;
+			entry.uvOffset[1] = entry.y / (float)m_options.pageHeight;
+			entry.uvScale[0] = entry.width / (float)m_options.pageWidth;
+			entry.uvScale[1] = entry.height / (float)m_options.pageHeight;
+		}
+
+		return true;
+	}
+	//------------------------------------------------------------------------------------
+	void TexturePacker::_Blit( const SImage& image, unsigned int cellX, unsigned int cellY, std::vector<unsigned char>& page ) const
+	{
+		const unsigned int pad = m_options.padding;
+		const unsigned int cellW = _AlignUp(image.width + pad * 2);
+		const unsigned int cellH = _AlignUp(image.height + pad * 2);
+		const unsigned int pitch = m_options.pageWidth * 4;
+
+		// Image rows, clamped to the edge on left and right
+		for (unsigned int y=0; y<image.height; ++y)
+		{
+			unsigned char* pRow = &page[(cellY + pad + y) * pitch + cellX * 4];
+			const unsigned char* pSrc = &image.pixels[y * image.width * 4];
+
+			for (unsigned int x=0; x<cellW; ++x)
+			{
+				const int srcX = std::min(std::max((int)x - (int)pad, 0), (int)image.width - 1);
+				memcpy(pRow + x * 4, pSrc + srcX * 4, 4);
+			}
+		}
+
+		// Rows above and below repeat the first and last ones
+		for (unsigned int y=0; y<cellH; ++y)
+		{
+			if(y >= pad && y < pad + image.height)
+				continue;
+
+			const unsigned int srcY = y < pad ? pad : pad + image.height - 1;
+			memcpy(&page[(cellY + y) * pitch + cellX * 4], &page[(cellY + srcY) * pitch + cellX * 4], cellW * 4);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	unsigned int TexturePacker::GetSafeMipCount() const
+	{
+		// A texel of mip m spans 2^m texels, it must not cross a cell and
+		// bilinear filtering reaches half of it past the image edge.
+		unsigned int mips = 1;
+		unsigned int size = std::min(m_options.pageWidth, m_options.pageHeight);
+
+		while (size > 1)
+		{
+			const unsigned int footprint = 1 << mips;
+			if(footprint > m_options.alignment || footprint / 2 > m_options.padding)
+				break;
+
+			size /= 2;
+			++mips;
+		}
+
+		return mips;
+	}
+	//------------------------------------------------------------------------------------
+	void TexturePacker::BuildPageMips( unsigned int page, unsigned int mipCount, std::vector<std::vector<unsigned char>>& mips ) const
+	{
+		assert(mipCount > 0);
+
+		mips.resize(mipCount);
+		mips[0] = m_pages[page];
+
+		unsigned int w = m_options.pageWidth, h = m_options.pageHeight;
+		for (unsigned int iMip=1; iMip<mipCount; ++iMip)
+		{
+			const unsigned int dstW = std::max(w / 2, 1u), dstH = std::max(h / 2, 1u);
+			const std::vector<unsigned char>& src = mips[iMip - 1];
+			std::vector<unsigned char>& dst = mips[iMip];
+			dst.resize(dstW * dstH * 4);
+
+			for (unsigned int y=0; y<dstH; ++y)
+			{
+				const unsigned int y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+
+				for (unsigned int x=0; x<dstW; ++x)
+				{
+					const unsigned int x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+
+					for (int c=0; c<4; ++c)
+					{
+						const unsigned int sum = src[(y0 * w + x0) * 4 + c] + src[(y0 * w + x1) * 4 + c] +
+							src[(y1 * w + x0) * 4 + c] + src[(y1 * w + x1) * 4 + c];
+						dst[(y * dstW + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+
+			w = dstW;
+			h = dstH;
+		}
+	}
+}
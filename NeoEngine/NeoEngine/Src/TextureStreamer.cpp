@@ -0,0 +1,270 @@
+#include "stdafx.h"
+#include "TextureStreamer.h"
+
+namespace Neo
+{
+	// Textures never drop below a mip this size, so there is always something to sample
+	static const uint32		TAIL_SIZE	=	64;
+
+	//------------------------------------------------------------------------------------
+	uint32 TextureStreamer::SStreamEntry::GetBytesFrom( uint32 mip ) const
+	{
+		uint32 bytes = 0;
+		for (uint32 i=mip; i<mipBytes.size(); ++i)
+			bytes += mipBytes[i];
+
+		return bytes;
+	}
+	//------------------------------------------------------------------------------------
+	TextureStreamer::TextureStreamer()
+		:m_budget(64 * 1024 * 1024)
+		,m_uploadLimit(4 * 1024 * 1024)
+		,m_dropDelay(120)
+		,m_frame(0)
+		,m_nextId(0)
+	{
+
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::Register( D3D11Texture* pTexture, const std::vector<uint32>& mipBytes, uint32 tailMip )
+	{
+		assert(!mipBytes.empty() && tailMip < mipBytes.size());
+
+		SStreamEntry entry;
+		entry.pTexture = pTexture;
+		entry.id = m_nextId++;
+		entry.mipBytes = mipBytes;
+		entry.tailMip = tailMip;
+		entry.residentMip = tailMip;
+		entry.wantedMip = tailMip;
+		entry.targetMip = tailMip;
+		entry.requestedMip = FLT_MAX;
+		entry.lastRequestFrame = m_frame;
+
+		m_textures[pTexture] = entry;
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::Unregister( D3D11Texture* pTexture )
+	{
+		m_textures.erase(pTexture);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::RequestMip( D3D11Texture* pTexture, float mip )
+	{
+		auto iter = m_textures.find(pTexture);
+		if(iter == m_textures.end())
+			return;
+
+		iter->second.requestedMip = min(iter->second.requestedMip, mip);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::SetResidentMip( D3D11Texture* pTexture, uint32 mip )
+	{
+		auto iter = m_textures.find(pTexture);
+		if(iter != m_textures.end())
+			iter->second.residentMip = mip;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 TextureStreamer::GetResidentMip( D3D11Texture* pTexture ) const
+	{
+		auto iter = m_textures.find(pTexture);
+		assert(iter != m_textures.end());
+		return iter->second.residentMip;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 TextureStreamer::GetWantedMip( D3D11Texture* pTexture ) const
+	{
+		auto iter = m_textures.find(pTexture);
+		assert(iter != m_textures.end());
+		return iter->second.wantedMip;
+	}
+	//------------------------------------------------------------------------------------
+	uint32 TextureStreamer::GetResidentBytes() const
+	{
+		uint32 bytes = 0;
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+			bytes += iter->second.GetBytesFrom(iter->second.residentMip);
+
+		return bytes;
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::Update( MipChangeVector& changes )
+	{
+		changes.clear();
+		++m_frame;
+
+		_UpdateWanted();
+
+		// Sorted by registration order so results don't depend on hash order
+		std::vector<SStreamEntry*> entries;
+		entries.reserve(m_textures.size());
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+			entries.push_back(&iter->second);
+
+		std::sort(entries.begin(), entries.end(), [](const SStreamEntry* a, const SStreamEntry* b)
+		{
+			return a->id < b->id;
+		});
+
+		_AllocateBudget(entries);
+		_EmitChanges(entries, changes);
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::_UpdateWanted()
+	{
+		for (auto iter=m_textures.begin(); iter!=m_textures.end(); ++iter)
+		{
+			SStreamEntry& entry = iter->second;
+
+			uint32 request = entry.tailMip;
+			if (entry.requestedMip != FLT_MAX)
+			{
+				const float mip = floorf(entry.requestedMip);
+				request = mip <= 0 ? 0 : min((uint32)mip, entry.tailMip);
+			}
+
+			// Finer requests apply at once, coarser ones only after the drop delay
+			if (request <= entry.wantedMip || m_frame - entry.lastRequestFrame >= m_dropDelay)
+			{
+				entry.wantedMip = request;
+				entry.lastRequestFrame = m_frame;
+			}
+
+			entry.requestedMip = FLT_MAX;
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::_AllocateBudget( std::vector<SStreamEntry*>& entries )
+	{
+		uint32 used = 0;
+		for (size_t i=0; i<entries.size(); ++i)
+		{
+			SStreamEntry* pEntry = entries[i];
+			pEntry->targetMip = m_budget > 0 ? pEntry->tailMip : pEntry->wantedMip;
+			used += pEntry->GetBytesFrom(pEntry->targetMip);
+		}
+
+		if(m_budget == 0)
+			return;
+
+		// Refine one mip at a time, the texture furthest from what it wants goes first
+		struct SUpgrade
+		{
+			uint32			deficit;
+			uint32			cost;
+			SStreamEntry*	pEntry;
+
+			bool operator< (const SUpgrade& rhs) const
+			{
+				if(deficit != rhs.deficit) return deficit < rhs.deficit;
+				if(cost != rhs.cost) return cost > rhs.cost;
+				return pEntry->id > rhs.pEntry->id;
+			}
+		};
+
+		std::priority_queue<SUpgrade> queue;
+		for (size_t i=0; i<entries.size(); ++i)
+		{
+			SStreamEntry* pEntry = entries[i];
+			if (pEntry->targetMip > pEntry->wantedMip)
+			{
+				SUpgrade up = { pEntry->targetMip - pEntry->wantedMip, pEntry->mipBytes[pEntry->targetMip - 1], pEntry };
+				queue.push(up);
+			}
+		}
+
+		while (!queue.empty())
+		{
+			SUpgrade up = queue.top();
+			queue.pop();
+
+			// Doesn't fit, smaller ones still may
+			if(used + up.cost > m_budget)
+				continue;
+
+			SStreamEntry* pEntry = up.pEntry;
+			--pEntry->targetMip;
+			used += up.cost;
+
+			if (pEntry->targetMip > pEntry->wantedMip)
+			{
+				up.deficit = pEntry->targetMip - pEntry->wantedMip;
+				up.cost = pEntry->mipBytes[pEntry->targetMip - 1];
+				queue.push(up);
+			}
+		}
+	}
+	//------------------------------------------------------------------------------------
+	void TextureStreamer::_EmitChanges( std::vector<SStreamEntry*>& entries, MipChangeVector& changes )
+	{
+		std::vector<SStreamEntry*> upgrades;
+
+		for (size_t i=0; i<entries.size(); ++i)
+		{
+			SStreamEntry* pEntry = entries[i];
+
+			if (pEntry->targetMip > pEntry->residentMip)
+			{
+				// Dropping frees memory and is cheap, do it right away
+				pEntry->residentMip = pEntry->targetMip;
+			}
+			else if (pEntry->targetMip < pEntry->residentMip)
+			{
+				upgrades.push_back(pEntry);
+				continue;
+			}
+			else
+			{
+				continue;
+			}
+
+			SMipChange change = { pEntry->pTexture, pEntry->residentMip };
+			changes.push_back(change);
+		}
+
+		std::stable_sort(upgrades.begin(), upgrades.end(), [](const SStreamEntry* a, const SStreamEntry* b)
+		{
+			return a->residentMip - a->targetMip > b->residentMip - b->targetMip;
+		});
+
+		// Recreating uploads the whole new mip range
+		uint32 uploaded = 0;
+		for (size_t i=0; i<upgrades.size(); ++i)
+		{
+			SStreamEntry* pEntry = upgrades[i];
+			const uint32 cost = pEntry->GetBytesFrom(pEntry->targetMip);
+
+			if(m_uploadLimit > 0 && uploaded > 0 && uploaded + cost > m_uploadLimit)
+				break;
+
+			uploaded += cost;
+			pEntry->residentMip = pEntry->targetMip;
+
+			SMipChange change = { pEntry->pTexture, pEntry->residentMip };
+			changes.push_back(change);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	uint32 TextureStreamer::CalcTailMip( uint32 width, uint32 height, uint32 mipCount )
+	{
+		uint32 mip = 0;
+		while(mip + 1 < mipCount && max(width >> mip, height >> mip) > TAIL_SIZE)
+			++mip;
+
+		return mip;
+	}
+	//------------------------------------------------------------------------------------
+	float TextureStreamer::CalcRequiredMip( float texelsPerUnit, float pixelsPerUnit )
+	{
+		if(pixelsPerUnit <= 0 || texelsPerUnit <= 0)
+			return FLT_MAX;
+
+		// log2, VC doesn't have log2f
+		return logf(texelsPerUnit / pixelsPerUnit) * 1.4426950f;
+	}
+	//------------------------------------------------------------------------------------
+	float TextureStreamer::CalcPixelsPerUnit( float distance, float projScaleY, uint32 screenHeight )
+	{
+		return projScaleY * screenHeight * 0.5f / max(distance, 1e-3f);
+	}
+}
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "TransformStorage.h"
+#include <xmmintrin.h>
+#include <intrin.h>
+
+namespace Neo
+{
+	std::vector<float>		TransformStorage::s_posX;
+	std::vector<float>		TransformStorage::s_posY;
+	std::vector<float>		TransformStorage::s_posZ;
+	std::vector<float>		TransformStorage::s_rotX;
+	std::vector<float>		TransformStorage::s_rotY;
+	std::vector<float>		TransformStorage::s_rotZ;
+	std::vector<float>		TransformStorage::s_rotW;
+	std::vector<float>		TransformStorage::s_scaleX;
+	std::vector<float>		TransformStorage::s_scaleY;
+	std::vector<float>		TransformStorage::s_scaleZ;
+	std::vector<MAT44>		TransformStorage::s_world;
+	std::vector<MAT44>		TransformStorage::s_worldIT;
+	std::vector<uint32>		TransformStorage::s_dirty;
+	std::vector<uint32>		TransformStorage::s_changed;
+	std::vector<uint32>		TransformStorage::s_freeSlots;
+	uint32					TransformStorage::s_lastDirtyCount = 0;
+
+	//------------------------------------------------------------------------------------
+	uint32 TransformStorage::AllocSlot()
+	{
+		uint32 slot;
+
+		if (!s_freeSlots.empty())
+		{
+			slot = s_freeSlots.back();
+			s_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (uint32)s_world.size();
+
+			s_posX.push_back(0);	s_posY.push_back(0);	s_posZ.push_back(0);
+			s_rotX.push_back(0);	s_rotY.push_back(0);	s_rotZ.push_back(0);	s_rotW.push_back(1);
+			s_scaleX.push_back(1);	s_scaleY.push_back(1);	s_scaleZ.push_back(1);
+			s_world.push_back(MAT44::IDENTITY);
+			s_worldIT.push_back(MAT44::IDENTITY);
+
+			if ((slot & 31) == 0)
+			{
+				s_dirty.push_back(0);
+				s_changed.push_back(0);
+			}
+		}
+
+		SetPosition(slot, VEC3::ZERO);
+		SetRotation(slot, QUATERNION::IDENTITY);
+		SetScale(slot, VEC3(1, 1, 1));
+		_ClearBit(s_changed, slot);
+
+		return slot;
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::FreeSlot( uint32 slot )
+	{
+		assert(slot < s_world.size());
+
+		_ClearBit(s_dirty, slot);
+		_ClearBit(s_changed, slot);
+		s_freeSlots.push_back(slot);
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::SetPosition( uint32 slot, const VEC3& pos )
+	{
+		s_posX[slot] = pos.x;
+		s_posY[slot] = pos.y;
+		s_posZ[slot] = pos.z;
+		_SetBit(s_dirty, slot);
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::SetRotation( uint32 slot, const QUATERNION& quat )
+	{
+		s_rotX[slot] = quat.x;
+		s_rotY[slot] = quat.y;
+		s_rotZ[slot] = quat.z;
+		s_rotW[slot] = quat.w;
+		_SetBit(s_dirty, slot);
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::SetScale( uint32 slot, const VEC3& scale )
+	{
+		s_scaleX[slot] = scale.x;
+		s_scaleY[slot] = scale.y;
+		s_scaleZ[slot] = scale.z;
+		_SetBit(s_dirty, slot);
+	}
+	//------------------------------------------------------------------------------------
+	VEC3 TransformStorage::GetPosition( uint32 slot )
+	{
+		return VEC3(s_posX[slot], s_posY[slot], s_posZ[slot]);
+	}
+	//------------------------------------------------------------------------------------
+	QUATERNION TransformStorage::GetRotation( uint32 slot )
+	{
+		return QUATERNION(s_rotW[slot], s_rotX[slot], s_rotY[slot], s_rotZ[slot]);
+	}
+	//------------------------------------------------------------------------------------
+	VEC3 TransformStorage::GetScale( uint32 slot )
+	{
+		return VEC3(s_scaleX[slot], s_scaleY[slot], s_scaleZ[slot]);
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::UpdateDirty()
+	{
+		uint32 batch[4];
+		uint32 nBatch = 0;
+		s_lastDirtyCount = 0;
+
+		for (size_t iWord=0; iWord<s_dirty.size(); ++iWord)
+		{
+			uint32 bits = s_dirty[iWord];
+			if(!bits)
+				continue;
+
+			s_changed[iWord] |= bits;
+			s_dirty[iWord] = 0;
+
+			while (bits)
+			{
+				unsigned long iBit;
+				_BitScanForward(&iBit, bits);
+				bits &= bits - 1;
+
+				batch[nBatch++] = (uint32)(iWord * 32 + iBit);
+				if (nBatch == 4)
+				{
+					_Compose(batch, 4);
+					nBatch = 0;
+				}
+
+				++s_lastDirtyCount;
+			}
+		}
+
+		if(nBatch)
+			_Compose(batch, nBatch);
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::Flush( uint32 slot )
+	{
+		if (_TestBit(s_dirty, slot))
+		{
+			_Compose(&slot, 1);
+			_ClearBit(s_dirty, slot);
+			_SetBit(s_changed, slot);
+		}
+	}
+	//------------------------------------------------------------------------------------
+	bool TransformStorage::ConsumeChanged( uint32 slot )
+	{
+		const bool bChanged = _TestBit(s_changed, slot);
+		_ClearBit(s_changed, slot);
+		return bChanged;
+	}
+	//------------------------------------------------------------------------------------
+	void TransformStorage::_Compose( const uint32* slots, uint32 count )
+	{
+		assert(count > 0 && count <= 4);
+
+		// Missing lanes repeat the first slot, their results are never stored
+		uint32 s[4];
+		for (uint32 i=0; i<4; ++i)
+			s[i] = slots[i < count ? i : 0];
+
+		#define GATHER(arr)	_mm_set_ps(arr[s[3]], arr[s[2]], arr[s[1]], arr[s[0]])
+
+		const __m128 qx = GATHER(s_rotX), qy = GATHER(s_rotY), qz = GATHER(s_rotZ), qw = GATHER(s_rotW);
+		const __m128 sx = GATHER(s_scaleX), sy = GATHER(s_scaleY), sz = GATHER(s_scaleZ);
+		const __m128 tx = GATHER(s_posX), ty = GATHER(s_posY), tz = GATHER(s_posZ);
+
+		#undef GATHER
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+
+		// Rotation part of Matrix44::FromQuaternion, row vector convention
+		const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		const __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		const __m128 xw = _mm_mul_ps(qx, qw), yw = _mm_mul_ps(qy, qw), zw = _mm_mul_ps(qz, qw);
+
+		__m128 r[3][3];
+		r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+		r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, zw));
+		r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, yw));
+		r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, zw));
+		r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+		r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, xw));
+		r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, yw));
+		r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, xw));
+		r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+		const __m128 scale[3] = { sx, sy, sz };
+
+		/*	World = S * R * T: row i is R's row i scaled by s[i], translation in row 3.
+			Its inverse transpose is S^-1 * R * T^-T: row i is R's row i divided by s[i],
+			column 3 holds -dot(row, t) and row 3 is (0,0,0,1). No general inverse needed.
+		*/
+		__m128 world[4][4], worldIT[4][4];
+
+		for (int i=0; i<3; ++i)
+		{
+			const __m128 invScale = _mm_div_ps(one, scale[i]);
+
+			for (int j=0; j<3; ++j)
+			{
+				world[i][j] = _mm_mul_ps(r[i][j], scale[i]);
+				worldIT[i][j] = _mm_mul_ps(r[i][j], invScale);
+			}
+
+			world[i][3] = zero;
+			worldIT[i][3] = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(worldIT[i][0], tx), _mm_mul_ps(worldIT[i][1], ty)), _mm_mul_ps(worldIT[i][2], tz)));
+		}
+
+		world[3][0] = tx;	world[3][1] = ty;	world[3][2] = tz;	world[3][3] = one;
+		worldIT[3][0] = zero;	worldIT[3][1] = zero;	worldIT[3][2] = zero;	worldIT[3][3] = one;
+
+		// Lanes hold one element of four matrices, transpose to get each slot's row
+		for (int row=0; row<4; ++row)
+		{
+			__m128 w0 = world[row][0], w1 = world[row][1], w2 = world[row][2], w3 = world[row][3];
+			__m128 n0 = worldIT[row][0], n1 = worldIT[row][1], n2 = worldIT[row][2], n3 = worldIT[row][3];
+			_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+			_MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+
+			const __m128 wRows[4] = { w0, w1, w2, w3 };
+			const __m128 nRows[4] = { n0, n1, n2, n3 };
+
+			for (uint32 lane=0; lane<count; ++lane)
+			{
+				_mm_storeu_ps(s_world[slots[lane]].m_arr[row], wRows[lane]);
+				_mm_storeu_ps(s_worldIT[slots[lane]].m_arr[row], nRows[lane]);
+			}
+		}
+	}
+}
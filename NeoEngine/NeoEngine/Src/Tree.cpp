@@ -2,6 +2,8 @@
 #include "Tree.h"
 #include "SceneManager.h"
 #include "D3D11Texture.h"
+#include "TextureManager.h"
+#include "D3D11RenderSystem.h"
 #include "Mesh.h"
 
 namespace Neo
@@ -17,24 +19,30 @@ namespace Neo
 		static bool bInitMaterial = false;
 		if (!bInitMaterial)
 		{
+			TextureManager* pTexMgr = g_env.pRenderSystem->GetTextureManager();
+
 			s_pBranchMaterial = new Material;
 			s_pFrondMaterial = new Material;
 			s_pLeafMaterial = new Material(eVertexType_TreeLeaf);
 
-			s_pBranchMaterial->SetTexture(0, new D3D11Texture(GetResPath("Tree\\FanPalmBark.dds")));
+			s_pBranchMaterial->SetTexture(0, pTexMgr->Load(GetResPath("Tree\\FanPalmBark.dds"), eTextureType_2D, eTextureUsage_Streamed));
 			s_pBranchMaterial->InitShader(GetResPath("Tree\\Branch.hlsl"), GetResPath("Tree\\Branch.hlsl"));
 
-			s_pFrondMaterial->SetTexture(0, new D3D11Texture(GetResPath("Tree\\CompositeMap_Diffuse.dds")));
+			s_pFrondMaterial->SetTexture(0, pTexMgr->Load(GetResPath("Tree\\CompositeMap_Diffuse.dds"), eTextureType_2D, eTextureUsage_Streamed));
 			s_pFrondMaterial->InitShader(GetResPath("Tree\\Frond.hlsl"), GetResPath("Tree\\Frond.hlsl"));
 			s_pFrondMaterial->SetCullMode(D3D11_CULL_NONE);
 
-			s_pLeafMaterial->SetTexture(0, new D3D11Texture(GetResPath("Tree\\CompositeMap_Diffuse.dds")));
+			s_pLeafMaterial->SetTexture(0, pTexMgr->Load(GetResPath("Tree\\CompositeMap_Diffuse.dds"), eTextureType_2D, eTextureUsage_Streamed));
 			s_pLeafMaterial->InitShader(GetResPath("Tree\\Leaf.hlsl"), GetResPath("Tree\\Leaf.hlsl"));
 			s_pLeafMaterial->SetCullMode(D3D11_CULL_NONE);
 
 			bInitMaterial = true;
 		}
 
+		// Mesh is shared by all trees using it, so only build LODs once
+		if(m_pMesh->GetLodCount() == 1)
+			m_pMesh->GenerateLods(4);
+
 		_InitMaterial();
 
 		SetCastShadow(false);
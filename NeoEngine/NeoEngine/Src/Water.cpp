@@ -2,12 +2,15 @@
 #include "Water.h"
 #include "D3D11RenderSystem.h"
 #include "D3D11Texture.h"
+#include "TextureManager.h"
 #include "D3D11RenderTarget.h"
 #include "Mesh.h"
 #include "Entity.h"
 #include "Material.h"
 #include "Camera.h"
 #include "SceneManager.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 
 
 namespace Neo
@@ -34,6 +37,9 @@ namespace Neo
 	//------------------------------------------------------------------------------------
 	Water::~Water()
 	{
+		MemoryTracker::Remove(m_pCB_VS);
+		MemoryTracker::Remove(m_pCB_PS);
+		MemoryTracker::Remove(m_pCB_Depth);
 		SAFE_RELEASE(m_pCB_VS);
 		SAFE_RELEASE(m_pCB_PS);
 		SAFE_RELEASE(m_pCB_Depth);
@@ -56,14 +62,17 @@ namespace Neo
 		m_pRT_Reflection = m_pRenderSystem->CreateRenderTarget();
 		m_pRT_Reflection->Init(screenW / 2, screenH / 2, ePF_A8B8G8R8);
 		m_pRT_Reflection->SetRenderPhase(eRenderPhase_Geometry & ~eRenderPhase_Water);
+		m_pRT_Reflection->GetRenderTexture()->SetMemoryTag(eMemTag_Water, "Water reflection");
 
 		// Scene map (alpha channel uses for refraction mask)
 		m_pTexSceneWithRefracMask = new D3D11Texture(screenW, screenH, nullptr, ePF_A8B8G8R8, 
 			eTextureUsage_WriteOnly | eTextureUsage_RecreateOnWndResized, false);
+		m_pTexSceneWithRefracMask->SetMemoryTag(eMemTag_Water, "Water scene copy");
 
 		// Water depth map
 		m_pRT_Depth = m_pRenderSystem->CreateRenderTarget();
 		m_pRT_Depth->Init(screenW / 2, screenH / 2, ePF_A8B8G8R8);
+		m_pRT_Depth->GetRenderTexture()->SetMemoryTag(eMemTag_Water, "Water depth");
 
 		// TODO: terrain gets water-shore transition
 		m_pRT_Depth->SetRenderPhase(eRenderPhase_Solid /*| eRenderPhase_Terrain*/);
@@ -79,7 +88,7 @@ namespace Neo
 		m_pFinalComposeMaterial->InitShader(GetResPath("Water_Final.hlsl"), GetResPath("Water_Final.hlsl"));
 
 		// Noise map
-		m_pFinalComposeMaterial->SetTexture(0, new D3D11Texture(GetResPath("waves2.dds")));
+		m_pFinalComposeMaterial->SetTexture(0, m_pRenderSystem->GetTextureManager()->Load(GetResPath("waves2.dds")));
 		// Reflection map
 		m_pFinalComposeMaterial->SetTexture(1, m_pRT_Reflection->GetRenderTexture());
 		// Refraction mask map
@@ -149,7 +158,7 @@ namespace Neo
 		}
 
 		m_waterMesh = new Mesh;
-		SubMesh* pSubMesh = new SubMesh;
+		SubMesh* pSubMesh = new SubMesh(eMemTag_Water);
 
 		m_waterMesh->AddSubMesh(pSubMesh);
 
@@ -176,6 +185,7 @@ namespace Neo
 		bd.CPUAccessFlags = 0;
 		bd.ByteWidth = sizeof(cBufferVSFinal);
 		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pCB_VS ));
+		MemoryTracker::AddBuffer(m_pCB_VS, eMemTag_Water, "Water cbuffer");
 
 		m_constantBufVS.texScale	=	VEC2(25, 26);
 		m_constantBufVS.bumpSpeed	=	VEC2(0.015f, 0.005f);
@@ -185,6 +195,7 @@ namespace Neo
 
 		bd.ByteWidth = sizeof(cBufferPSFinal);
 		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pCB_PS ));
+		MemoryTracker::AddBuffer(m_pCB_PS, eMemTag_Water, "Water cbuffer");
 
 		m_constantBufPS.deepColor	=	VEC4(0.0f, 0.3f, 0.5f, 1.0f);
 		m_constantBufPS.shallowColor =	VEC4(0.0f, 1.0f, 1.0f, 1.0f);
@@ -198,6 +209,7 @@ namespace Neo
 
 		bd.ByteWidth = sizeof(cBufferDepth);
 		V(m_pRenderSystem->GetDevice()->CreateBuffer( &bd, NULL, &m_pCB_Depth ));
+		MemoryTracker::AddBuffer(m_pCB_Depth, eMemTag_Water, "Water cbuffer");
 
 		m_constantBufDepth.waterPlaneHeight	= m_waterPlane.d;
 		m_constantBufDepth.depthLimit = 1.0f / 90.0f;
@@ -272,6 +284,7 @@ namespace Neo
 		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
 
 		pContext->UpdateSubresource( m_pCB_Depth, 0, NULL, &m_constantBufDepth, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_constantBufDepth));
 		pContext->VSSetConstantBuffers( 1, 1, &m_pCB_Depth );
 		pContext->PSSetConstantBuffers( 1, 1, &m_pCB_Depth );
 
@@ -283,9 +296,11 @@ namespace Neo
 		ID3D11DeviceContext* pContext = m_pRenderSystem->GetDeviceContext();
 
 		pContext->UpdateSubresource( m_pCB_VS, 0, NULL, &m_constantBufVS, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_constantBufVS));
 		pContext->VSSetConstantBuffers( 1, 1, &m_pCB_VS );
 
 		pContext->UpdateSubresource( m_pCB_PS, 0, NULL, &m_constantBufPS, 0, 0 );
+		PROFILE_COUNTER(eProfileCounter_CBufferBytes, sizeof(m_constantBufPS));
 		pContext->PSSetConstantBuffers( 2, 1, &m_pCB_PS );
 
 		m_waterMesh->GetSubMesh(0)->SetMaterial(m_pFinalComposeMaterial);
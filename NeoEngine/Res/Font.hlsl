@@ -25,8 +25,7 @@ cbuffer cbufferGlobal : register( b0 )
 //--------------------------------------------------------------------------------------
 struct VS_INPUT
 {
-    float3 Pos : POSITION;
-	float3 normal : NORMAL;
+    float2 Pos : POSITION;
 	float2 uv  : TEXCOORD0;
 	float4 color : COLOR;
 };
@@ -45,7 +44,7 @@ VS_OUTPUT VS( VS_INPUT input )
 {
     VS_OUTPUT output = (VS_OUTPUT)0;
 
-    output.Pos = float4(input.Pos, 1);
+    output.Pos = float4(input.Pos, 0, 1);
     output.uv = input.uv;
     output.color = input.color;
     
@@ -62,7 +61,7 @@ SamplerState sam : register( s0 );
 float4 PS( VS_OUTPUT input ) : SV_Target
 {
 	float4 oColor = tex.Sample(sam, input.uv);
-	oColor.rgb *= input.color.rgb;
+	oColor *= input.color;
 	
 	return oColor;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "Common.h"
+
+//--------------------------------------------------------------------------------------
+// Constant Buffer Variables
+//--------------------------------------------------------------------------------------
+cbuffer cbufferGlobal : register( b0 )
+{
+    matrix	World;
+	matrix	View;
+	matrix	Projection;
+	matrix	WVP;
+	matrix	WorldIT;
+	matrix	ShadowTransform;
+	float4	clipPlane;
+	float4	frustumFarCorner[4];
+	float4	ambientColor;
+	float4	lightColor;
+	float3	lightDirection;
+	float3	camPos;
+	float	time;
+	float	nearZ, farZ;
+	float	shadowMapTexelSize;
+};
+
+// Same layout as Grass::cBufferGrass
+cbuffer cbufferGrass : register( b1 )
+{
+	float3	baseColor;
+	float	fadeStart;
+	float3	tipColor;
+	float	viewDistance;
+	float3	dryColor;
+	float	bladeWidth;
+	float	bladeHeight;
+	float	windStrength;
+};
+
+//--------------------------------------------------------------------------------------
+struct VS_INPUT
+{
+    float3 Pos			: POSITION;
+	float2 uv			: TEXCOORD0;
+	// Per instance
+	float4 rootScale	: TEXCOORD1;
+	float2 rotTint		: TEXCOORD2;
+};
+
+struct VS_OUTPUT
+{
+    float4 Pos		: SV_POSITION;
+	float3 PosW		: POSITION;
+	float3 color	: TEXCOORD0;
+	float3 normal	: TEXCOORD1;
+};
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader
+//--------------------------------------------------------------------------------------
+VS_OUTPUT VS( VS_INPUT input )
+{
+    VS_OUTPUT output = (VS_OUTPUT)0;
+
+	float3 root = input.rootScale.xyz;
+	float scale = input.rootScale.w;
+
+	// GrassLayer draws this fraction of a page at this distance. Blades widen as
+	// their neighbours go to keep the coverage, and sink into the ground at the end.
+	float dist = distance(root.xz, camPos.xz);
+	float keep = saturate(1 - (dist - fadeStart) / (viewDistance - fadeStart));
+	float widen = rsqrt(max(keep, 0.25));
+	float sink = saturate(keep * 4);
+
+	float h = input.uv.y;
+	float3 posL = float3(input.Pos.x * bladeWidth * widen, input.Pos.y * bladeHeight * sink, 0) * scale;
+
+	// Sway grows towards the tip, phase varies across the field
+	posL.z += windStrength * scale * h * h * sin(time * 2 + root.x * 0.3 + root.z * 0.2);
+
+	float s, c;
+	sincos(input.rotTint.x, s, c);
+	float3 posW = root + float3(posL.x * c + posL.z * s, posL.y, posL.z * c - posL.x * s);
+
+	output.Pos = mul(float4(posW, 1), WVP);
+	output.PosW = posW;
+	output.color = lerp(lerp(baseColor, tipColor, h), dryColor, input.rotTint.y * 0.6);
+	// Lit mostly like the ground it grows from, so it doesn't flicker as blades turn
+	output.normal = normalize(float3(-s * 0.3, 1, -c * 0.3));
+
+    return output;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader
+//--------------------------------------------------------------------------------------
+#ifdef SHADOW_RECEIVER
+Texture2D				gShadowMap		: register(t0);
+SamplerComparisonState	samShadowMap	: register(s0);
+#endif
+
+float4 PS( VS_OUTPUT input ) : SV_Target
+{
+#ifdef SHADOW_RECEIVER
+	float fLitFactor = ComputeShdow(input.PosW, ShadowTransform, shadowMapTexelSize, samShadowMap, gShadowMap);
+#else
+	float fLitFactor = 1.0f;
+#endif
+
+	float3 N = normalize(input.normal);
+	float3 cLight = max(0, dot(N, -lightDirection)) * lightColor.rgb * fLitFactor + ambientColor.rgb;
+
+	return float4(input.color * saturate(cLight), 1.0);
+}
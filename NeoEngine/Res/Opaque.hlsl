@@ -22,6 +22,13 @@ cbuffer cbufferGlobal : register( b0 )
 	float	shadowMapTexelSize;
 };
 
+cbuffer cbufferMaterial : register( b3 )
+{
+	float4	matAmbient;
+	float4	matDiffuse;
+	float4	matSpecular;
+	float	matShiness;
+};
 
 //--------------------------------------------------------------------------------------
 struct VS_INPUT
@@ -98,7 +105,7 @@ float4 PS( VS_OUTPUT input ) : SV_Target
 
 	// Do lighting
 	float3 N = normalize(input.normal);
-	float4 cLight = max(0, dot(N, -lightDirection)) * lightColor * fLitFactor;
+	float4 cLight = max(0, dot(N, -lightDirection)) * lightColor * matDiffuse * fLitFactor;
 
 	// SSAO
 #ifdef SSAO
@@ -106,9 +113,9 @@ float4 PS( VS_OUTPUT input ) : SV_Target
 
 	float fAmbientAccess = texSSAO.Sample(samSSAO, input.projUV.xy).r;
 	// SSAO affects only ambient term!
-	cLight += ambientColor * fAmbientAccess;
+	cLight += ambientColor * matAmbient * fAmbientAccess;
 #else
-	cLight += ambientColor;
+	cLight += ambientColor * matAmbient;
 #endif
 
 	cLight = saturate(cLight);
@@ -8,13 +8,17 @@ Texture2DArray	gLayerMaps		: register(t1);
 Texture2D		gBlendMap		: register(t2);
 Texture2D		gNormalMap		: register(t3);
 Texture2D		gShadowMap		: register(t4);
+Texture2D		gCompositeMap	: register(t5);
 SamplerState	samHeightmap	: register(s0);
 SamplerState	samLayerMap		: register(s1);
 SamplerState	samBlendMap		: register(s2);
 SamplerState	samNormalMap	: register(s3);
 SamplerComparisonState	samShadowMap	: register(s4);
+SamplerState	samCompositeMap	: register(s5);
 
 static const float2	g_layerTexScale = 50.0;
+// Fraction of compositeMapDist where splatting starts fading into the composite map
+static const float	g_compositeBlendStart = 0.9;
 
 //--------------------------------------------------------------------------------------
 // Constant Buffer Variables
@@ -47,6 +51,7 @@ cbuffer cbufferTerrain : register( b1 )
 	float	maxTess;
 	float2	invTexSize;
 	float	terrainCellSpace;
+	float	compositeMapDist;
 };
 
 //--------------------------------------------------------------------------------------
@@ -58,11 +63,15 @@ struct VS_INPUT
 	float4 color : COLOR;
 };
 
+// One quad patch per quadtree node, see Terrain::_SelectNodes.
+// color.xy is the node's y-bound, color.z its inner and color.w its edge
+// tessellation factor, normal.xy the start of its morph band and 1 / band width.
 struct VS_OUTPUT
 {
     float3 PosW		: POSITION;
 	float2 uv		: TEXCOORD0;
 	float2 boundY	: TEXCOORD1;
+	float4 lodParams	: TEXCOORD2;	// inner tess, morph start, morph scale, edge tess
 };
 
 //--------------------------------------------------------------------------------------
@@ -75,6 +84,7 @@ VS_OUTPUT VS( VS_INPUT input )
     OUT.PosW = input.Pos;
 	OUT.uv = input.uv;
 	OUT.boundY = input.color.xy;
+	OUT.lodParams = float4(input.color.z, input.normal.xy, input.color.w);
     
     return OUT;
 }
@@ -112,18 +122,6 @@ bool FrustumCull(float3 center, float3 extents)
 	return false;
 }
 
-float CalcTessFactor(float3 p)
-{
-	float d = distance(p, camPos);
-
-	// max norm in xz plane (useful to see detail levels from a bird's eye).
-	//float d = max( abs(p.x-gEyePosW.x), abs(p.z-gEyePosW.z) );
-	
-	float s = saturate( (d - minTessDist) / (maxTessDist - minTessDist) );
-	
-	return pow(2, (lerp(maxTess, minTess, s)) );
-}
-
 struct PatchTess
 {
 	float EdgeTess[4]   : SV_TessFactor;
@@ -160,25 +158,18 @@ PatchTess ConstantHS(InputPatch<VS_OUTPUT, 4> patch, uint patchID : SV_Primitive
 	}
 	else
 	{
-		// Do tessellation based on distance.
-		// It is important to do the tess factor calculation based on the
-		// edge properties so that edges shared by more than one patch will
-		// have the same tessellation factor.  Otherwise, gaps can appear.
-
-		// Compute midpoint on edges, and patch center
-		float3 e0 = 0.5f*(patch[0].PosW + patch[2].PosW);
-		float3 e1 = 0.5f*(patch[0].PosW + patch[1].PosW);
-		float3 e2 = 0.5f*(patch[1].PosW + patch[3].PosW);
-		float3 e3 = 0.5f*(patch[2].PosW + patch[3].PosW);
-		float3  c = 0.25f*(patch[0].PosW + patch[1].PosW + patch[2].PosW + patch[3].PosW);
-
-		pt.EdgeTess[0] = CalcTessFactor(e0);
-		pt.EdgeTess[1] = CalcTessFactor(e1);
-		pt.EdgeTess[2] = CalcTessFactor(e2);
-		pt.EdgeTess[3] = CalcTessFactor(e3);
-
-		pt.InsideTess[0] = CalcTessFactor(c);
-		pt.InsideTess[1] = pt.InsideTess[0];
+		// The node's LOD was picked on CPU. Edges use the LOD's factor, equal for all nodes
+		// of a LOD, and morphing in DS makes them match coarser neighbours. Only the inner
+		// grid drops with the node's roughness, it isn't shared with anyone.
+		float edgeTess = patch[0].lodParams.w;
+
+		pt.EdgeTess[0] = edgeTess;
+		pt.EdgeTess[1] = edgeTess;
+		pt.EdgeTess[2] = edgeTess;
+		pt.EdgeTess[3] = edgeTess;
+
+		pt.InsideTess[0] = patch[0].lodParams.x;
+		pt.InsideTess[1] = patch[0].lodParams.x;
 	}
 
 	return pt;
@@ -188,10 +179,11 @@ struct HullOut
 {
 	float3 PosW     : POSITION;
 	float2 Tex      : TEXCOORD0;
+	float4 lodParams	: TEXCOORD1;
 };
 
 [domain("quad")]
-[partitioning("fractional_even")]
+[partitioning("integer")]
 [outputtopology("triangle_cw")]
 [outputcontrolpoints(4)]
 [patchconstantfunc("ConstantHS")]
@@ -205,6 +197,7 @@ HullOut HS(InputPatch<VS_OUTPUT, 4> p,
 	// Pass through shader.
 	hout.PosW     = p[i].PosW;
 	hout.Tex      = p[i].uv;
+	hout.lodParams = p[i].lodParams;
 	
 	return hout;
 }
@@ -227,7 +220,20 @@ DomainOut DS(PatchTess patchTess,
              const OutputPatch<HullOut, 4> quad)
 {
 	DomainOut dout;
-	
+
+	// CDLOD morph: past the start of the node's morph band, odd grid vertices slide
+	// onto their even neighbours, reaching the grid of the next LOD at the band end.
+	// Vertices on an edge lie on the edge grid along it, the others on the inner grid.
+	float2 bEdge = float2(uv.y == 0 || uv.y == 1, uv.x == 0 || uv.x == 1);
+	float2 tess = lerp(quad[0].lodParams.xx, quad[0].lodParams.ww, bEdge);
+	float3 posW = lerp(lerp(quad[0].PosW, quad[1].PosW, uv.x), lerp(quad[2].PosW, quad[3].PosW, uv.x), uv.y);
+	float2 tex = lerp(lerp(quad[0].Tex, quad[1].Tex, uv.x), lerp(quad[2].Tex, quad[3].Tex, uv.x), uv.y);
+	posW.y = gHeightMap.SampleLevel( samHeightmap, tex, 0 ).r;
+
+	float morphK = saturate((distance(posW, camPos) - quad[0].lodParams.y) * quad[0].lodParams.z);
+	float2 gridPos = uv * tess;
+	uv -= frac(gridPos * 0.5f) * 2.0f / tess * morphK;
+
 	// Bilinear interpolation.
 	dout.PosW = lerp(
 		lerp(quad[0].PosW, quad[1].PosW, uv.x),
@@ -276,23 +282,43 @@ float4 PS( DomainOut IN ) : SV_Target
 	float3x3 matTBN = float3x3(tangent, bitan, cross(tangent, bitan));
 
 	//====================================================================================
-	// Texture splatting
+	// Texture splatting, or the baked composite map far away
 	//====================================================================================
-	float4 c0 = gLayerMaps.Sample( samLayerMap, float3(IN.TiledTex, 0.0f) );
-	float4 c1 = gLayerMaps.Sample( samLayerMap, float3(IN.TiledTex, 1.0f) );
-	float4 c2 = gLayerMaps.Sample( samLayerMap, float3(IN.TiledTex, 2.0f) );
-	float4 c3 = gLayerMaps.Sample( samLayerMap, float3(IN.TiledTex, 3.0f) );
-	float4 c4 = gLayerMaps.Sample( samLayerMap, float3(IN.TiledTex, 4.0f) ); 
+	float compositeK = saturate((distance(IN.PosW, camPos) - compositeMapDist * g_compositeBlendStart) / 
+		(compositeMapDist * (1.0f - g_compositeBlendStart)));
+
+	// Gradients outside the branches, so the samples inside may be skipped
+	float2 tiledDx = ddx(IN.TiledTex), tiledDy = ddy(IN.TiledTex);
+	float2 texDx = ddx(IN.Tex), texDy = ddy(IN.Tex);
+
+	float4 texColor = 0;
+
+	[branch]
+	if (compositeK < 1.0f)
+	{
+		float4 c0 = gLayerMaps.SampleGrad( samLayerMap, float3(IN.TiledTex, 0.0f), tiledDx, tiledDy );
+		float4 c1 = gLayerMaps.SampleGrad( samLayerMap, float3(IN.TiledTex, 1.0f), tiledDx, tiledDy );
+		float4 c2 = gLayerMaps.SampleGrad( samLayerMap, float3(IN.TiledTex, 2.0f), tiledDx, tiledDy );
+		float4 c3 = gLayerMaps.SampleGrad( samLayerMap, float3(IN.TiledTex, 3.0f), tiledDx, tiledDy );
+		float4 c4 = gLayerMaps.SampleGrad( samLayerMap, float3(IN.TiledTex, 4.0f), tiledDx, tiledDy ); 
 	
-	// blend map
-	float4 t  = gBlendMap.Sample( samBlendMap, IN.Tex ); 
+		// blend map
+		float4 t  = gBlendMap.SampleGrad( samBlendMap, IN.Tex, texDx, texDy ); 
     
-    // Blend the layers on top of each other.
-    float4 texColor = c0;
-    texColor = lerp(texColor, c1, t.r);
-    texColor = lerp(texColor, c2, t.g);
-    texColor = lerp(texColor, c3, t.b);
-    texColor = lerp(texColor, c4, t.a);
+		// Blend the layers on top of each other.
+		texColor = c0;
+		texColor = lerp(texColor, c1, t.r);
+		texColor = lerp(texColor, c2, t.g);
+		texColor = lerp(texColor, c3, t.b);
+		texColor = lerp(texColor, c4, t.a);
+	}
+
+	[branch]
+	if (compositeK > 0.0f)
+	{
+		float4 composite = gCompositeMap.SampleGrad( samCompositeMap, IN.Tex, texDx, texDy );
+		texColor = lerp(texColor, composite, compositeK);
+	}
 
 	// normal map
 	float3 N = gNormalMap.Sample(samNormalMap, IN.TiledTex);
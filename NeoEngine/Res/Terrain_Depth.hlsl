@@ -30,6 +30,7 @@ cbuffer cbufferTerrain : register( b1 )
 	float	maxTess;
 	float2	invTexSize;
 	float	terrainCellSpace;
+	float	compositeMapDist;
 };
 
 //--------------------------------------------------------------------------------------
@@ -38,6 +39,7 @@ struct VS_OUTPUT
     float3 PosW		: POSITION;
 	float2 uv		: TEXCOORD0;
 	float2 boundY	: TEXCOORD1;
+	float4 lodParams	: TEXCOORD2;
 };
 
 struct DomainOut
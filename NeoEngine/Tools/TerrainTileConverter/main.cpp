@@ -0,0 +1,113 @@
+/********************************************************************
+	created:	1:11:2014   18:05
+	filename	main.cpp
+	author:		maval
+
+	purpose:	Cuts a .raw height map into a terrain tile set for
+				TerrainTileStreamer. Only uses the portable engine sources,
+				so it builds on the build machines too:
+
+				g++ -std=c++11 -O2 -I../../NeoEngine/Include main.cpp
+					../../NeoEngine/Src/TerrainTile.cpp
+					../../NeoEngine/Src/ParallelFor.cpp -lpthread
+					-o TerrainTileConverter
+*********************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "TerrainTile.h"
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("Usage: TerrainTileConverter input.raw width height output [options]\n"
+			"  -16          16 bit little endian samples, 8 bit by default\n"
+			"  -cell x      Cell space, 0.5 by default\n"
+			"  -scale x     Height of the largest sample, 50 by default\n"
+			"  -tile n      Cells per tile side, power of 2, 64 by default\n"
+			"  -mips n      Mips per tile, 4 by default\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char* input = argv[1];
+	const unsigned int width = (unsigned int)atoi(argv[2]);
+	const unsigned int height = (unsigned int)atoi(argv[3]);
+	const char* output = argv[4];
+
+	bool b16Bit = false;
+	float cellSpace = 0.5f;
+	float heightScale = 50;
+	unsigned int tileCells = 64;
+	unsigned int mipCount = 4;
+
+	for (int i=5; i<argc; ++i)
+	{
+		const bool bHasValue = i + 1 < argc;
+		if(strcmp(argv[i], "-16") == 0)
+			b16Bit = true;
+		else if(strcmp(argv[i], "-cell") == 0 && bHasValue)
+			cellSpace = (float)atof(argv[++i]);
+		else if(strcmp(argv[i], "-scale") == 0 && bHasValue)
+			heightScale = (float)atof(argv[++i]);
+		else if(strcmp(argv[i], "-tile") == 0 && bHasValue)
+			tileCells = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "-mips") == 0 && bHasValue)
+			mipCount = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (width < 2 || height < 2 || tileCells == 0 || (tileCells & (tileCells - 1)) != 0 ||
+		mipCount == 0 || (tileCells >> (mipCount - 1)) == 0)
+	{
+		printf("Invalid size, tile size or mip count.\n");
+		return 1;
+	}
+
+	const unsigned int count = width * height;
+	const unsigned int sampleSize = b16Bit ? 2 : 1;
+	std::vector<unsigned char> raw(count * sampleSize);
+
+	std::ifstream file(input, std::ios_base::binary);
+	if (!file.read((char*)&raw[0], raw.size()))
+	{
+		printf("Can't read %u x %u samples from %s.\n", width, height, input);
+		return 1;
+	}
+
+	// Same scale as Terrain
+	std::vector<float> heights(count);
+	const float maxValue = b16Bit ? 65535.0f : 255.0f;
+	for (unsigned int i=0; i<count; ++i)
+	{
+		const unsigned int v = b16Bit ? raw[i * 2] | (raw[i * 2 + 1] << 8) : raw[i];
+		heights[i] = v / maxValue * heightScale;
+	}
+
+	if (!Neo::BuildTerrainTileSet(output, &heights[0], width, height, cellSpace, tileCells, mipCount))
+	{
+		printf("Can't write %s.\n", output);
+		return 1;
+	}
+
+	std::ifstream result(output, std::ios_base::binary | std::ios_base::ate);
+	printf("%s: %u x %u tiles, %u bytes.\n", output, (width - 2 + tileCells) / tileCells,
+		(height - 2 + tileCells) / tileCells, (unsigned int)result.tellg());
+
+	return 0;
+}
@@ -0,0 +1,232 @@
+/********************************************************************
+	created:	21:10:2014   14:20
+	filename	main.cpp
+	author:		maval
+
+	purpose:	Cooks a .tga image into a mipmapped, block compressed DDS
+				with TextureCooker. TGA is already in the BGR(A) order the
+				cooker takes. Only uses the portable engine sources, so it
+				builds on the build machines too:
+
+				g++ -std=c++11 -O2 -msse2 -I../../NeoEngine/Include main.cpp
+					../../NeoEngine/Src/TextureCooker.cpp
+					../../NeoEngine/Src/ParallelFor.cpp -lpthread
+					-o TextureCookerTool
+*********************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "TextureCooker.h"
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("Usage: TextureCookerTool input.tga output.dds [options]\n"
+			"  -format f    rgba8, bc1, bc3, bc4 or bc5, bc1 by default\n"
+			"  -quality q   fast, normal or high, normal by default\n"
+			"  -box         Box mip filter, Kaiser by default\n"
+			"  -linear      Not color data, filter without sRGB conversion\n"
+			"  -nomips      Top level only\n"
+			"  -cutout      BC1 1 bit alpha, alpha < 128 becomes transparent\n"
+			"  -threads n   Encoding threads, all cores by default\n");
+	}
+
+	/**	Uncompressed or RLE true color and grey scale TGA, 8, 24 or 32 bits.
+		Rows are returned top down, pixels as stored: BGR, BGRA or luminance.
+	*/
+	bool LoadTGA(const char* filename, std::vector<unsigned char>& pixels, unsigned int& width,
+		unsigned int& height, unsigned int& bytesPerPixel)
+	{
+		std::ifstream file(filename, std::ios_base::binary);
+		if(!file)
+			return false;
+
+		const std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if(data.size() < 18)
+			return false;
+
+		const unsigned char* pHeader = &data[0];
+		const unsigned int idLength = pHeader[0];
+		const unsigned int colorMapType = pHeader[1];
+		const unsigned int imageType = pHeader[2];
+		width = pHeader[12] | (pHeader[13] << 8);
+		height = pHeader[14] | (pHeader[15] << 8);
+		bytesPerPixel = pHeader[16] / 8;
+		const bool bTopDown = (pHeader[17] & 0x20) != 0;
+
+		// 2, 3 uncompressed true color and grey, 10, 11 their RLE versions
+		const bool bRLE = imageType == 10 || imageType == 11;
+		const bool bGrey = imageType == 3 || imageType == 11;
+		if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !bRLE) ||
+			width == 0 || height == 0 || (bGrey ? bytesPerPixel != 1 : bytesPerPixel != 3 && bytesPerPixel != 4))
+			return false;
+
+		const size_t imageBytes = (size_t)width * height * bytesPerPixel;
+		pixels.resize(imageBytes);
+
+		size_t src = 18 + idLength;
+		if (bRLE)
+		{
+			size_t dst = 0;
+			while (dst < imageBytes)
+			{
+				if(src >= data.size())
+					return false;
+
+				// High bit: one pixel repeated, else that many raw pixels
+				const unsigned char packet = data[src++];
+				const size_t count = (packet & 0x7f) + 1;
+				const size_t bytes = count * bytesPerPixel;
+				if(dst + bytes > imageBytes)
+					return false;
+
+				if (packet & 0x80)
+				{
+					if(src + bytesPerPixel > data.size())
+						return false;
+
+					for (size_t i=0; i<count; ++i)
+						memcpy(&pixels[dst + i * bytesPerPixel], &data[src], bytesPerPixel);
+					src += bytesPerPixel;
+				}
+				else
+				{
+					if(src + bytes > data.size())
+						return false;
+
+					memcpy(&pixels[dst], &data[src], bytes);
+					src += bytes;
+				}
+
+				dst += bytes;
+			}
+		}
+		else
+		{
+			if(src + imageBytes > data.size())
+				return false;
+
+			memcpy(&pixels[0], &data[src], imageBytes);
+		}
+
+		// TGA defaults to bottom up
+		if (!bTopDown)
+		{
+			const size_t rowBytes = (size_t)width * bytesPerPixel;
+			std::vector<unsigned char> row(rowBytes);
+			for (unsigned int y=0; y<height/2; ++y)
+			{
+				unsigned char* pTop = &pixels[y * rowBytes];
+				unsigned char* pBottom = &pixels[(height - 1 - y) * rowBytes];
+				memcpy(&row[0], pTop, rowBytes);
+				memcpy(pTop, pBottom, rowBytes);
+				memcpy(pBottom, &row[0], rowBytes);
+			}
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char* input = argv[1];
+	const char* output = argv[2];
+
+	Neo::SCookOptions options;
+
+	for (int i=3; i<argc; ++i)
+	{
+		const bool bHasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-format") == 0 && bHasValue)
+		{
+			static const char* names[] = { "rgba8", "bc1", "bc3", "bc4", "bc5" };
+			const char* value = argv[++i];
+
+			int format = -1;
+			for (int j=0; j<5; ++j)
+			{
+				if(strcmp(value, names[j]) == 0)
+					format = j;
+			}
+
+			if (format < 0)
+			{
+				PrintUsage();
+				return 1;
+			}
+
+			options.format = (Neo::eCookFormat)format;
+		}
+		else if (strcmp(argv[i], "-quality") == 0 && bHasValue)
+		{
+			const char* value = argv[++i];
+			if(strcmp(value, "fast") == 0)
+				options.quality = Neo::eCookQuality_Fast;
+			else if(strcmp(value, "normal") == 0)
+				options.quality = Neo::eCookQuality_Normal;
+			else if(strcmp(value, "high") == 0)
+				options.quality = Neo::eCookQuality_High;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "-box") == 0)
+			options.mipFilter = Neo::eMipFilter_Box;
+		else if(strcmp(argv[i], "-linear") == 0)
+			options.bSRGB = false;
+		else if(strcmp(argv[i], "-nomips") == 0)
+			options.bGenMips = false;
+		else if(strcmp(argv[i], "-cutout") == 0)
+			options.bAlphaCutout = true;
+		else if(strcmp(argv[i], "-threads") == 0 && bHasValue)
+			options.numThreads = (unsigned int)atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<unsigned char> pixels;
+	unsigned int width, height, bytesPerPixel;
+	if (!LoadTGA(input, pixels, width, height, bytesPerPixel))
+	{
+		printf("Can't read %s, only uncompressed or RLE 8, 24 and 32 bit TGA is supported.\n", input);
+		return 1;
+	}
+
+	Neo::TextureCooker cooker(options);
+	if (!cooker.SetSource(&pixels[0], width, height, width * bytesPerPixel, bytesPerPixel))
+	{
+		printf("Invalid source image %s.\n", input);
+		return 1;
+	}
+
+	cooker.Cook();
+
+	if (!cooker.SaveDDS(output))
+	{
+		printf("Can't write %s.\n", output);
+		return 1;
+	}
+
+	std::ifstream result(output, std::ios_base::binary | std::ios_base::ate);
+	printf("%s: %u x %u, %u mips, %u bytes.\n", output, width, height, cooker.GetMipCount(),
+		(unsigned int)result.tellg());
+
+	return 0;
+}